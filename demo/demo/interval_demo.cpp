@@ -0,0 +1,144 @@
+#include <iostream>
+#include <stdlib.h>
+#include <chrono>
+#include <iomanip>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "Yolo3Detection.h"
+#include "CenternetDetection.h"
+#include "MobilenetDetection.h"
+#include "IntervalDetection.h"
+#include "evaluation.h"
+
+/*
+    Accuracy against compute of IntervalDetection on a recorded clip.
+    The detector output on every frame is the reference, each mode is scored
+    with the mAP of its per frame boxes against it.
+
+    usage: interval_demo <network-rt-file> <kind-of-network> <path-to-video> <number-of-classes> <max-frames> <conf-thresh>
+*/
+
+static void toBoundingBoxes(const std::vector<tk::dnn::box> &in, std::vector<tk::dnn::BoundingBox> &out) {
+    out.clear();
+    for(const auto &d: in) {
+        tk::dnn::BoundingBox b;
+        b.x = d.x + d.w/2;
+        b.y = d.y + d.h/2;
+        b.w = d.w;
+        b.h = d.h;
+        b.prob = d.prob;
+        b.cl = d.cl;
+        out.push_back(b);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    std::string net = "yolo4_fp32.rt";
+    if(argc > 1)
+        net = argv[1];
+    char ntype = 'y';
+    if(argc > 2)
+        ntype = argv[2][0];
+    std::string input = "../demo/yolo_test.mp4";
+    if(argc > 3)
+        input = argv[3];
+    int n_classes = 80;
+    if(argc > 4)
+        n_classes = atoi(argv[4]);
+    int max_frames = 600;
+    if(argc > 5)
+        max_frames = atoi(argv[5]);
+    float conf_thresh = 0.3;
+    if(argc > 6)
+        conf_thresh = atof(argv[6]);
+
+    if(!fileExist(net.c_str()))
+        FatalError("The given network does not exist. Create the rt first.");
+
+    tk::dnn::Yolo3Detection yolo;
+    tk::dnn::CenternetDetection cnet;
+    tk::dnn::MobilenetDetection mbnet;
+    tk::dnn::DetectionNN *detNN;
+    switch(ntype) {
+        case 'y':
+            detNN = &yolo;
+            break;
+        case 'c':
+            detNN = &cnet;
+            break;
+        case 'm':
+            detNN = &mbnet;
+            n_classes++;
+            break;
+        default:
+            FatalError("Network type not allowed (2nd parameter)\n");
+    }
+    detNN->init(net, n_classes, 1, conf_thresh);
+
+    // the whole clip is kept in memory, so every mode sees the same frames
+    cv::VideoCapture cap(input);
+    if(!cap.isOpened())
+        FatalError("Can't open the input video");
+    std::vector<cv::Mat> clip;
+    cv::Mat frame;
+    while((int) clip.size() < max_frames && cap.read(frame))
+        clip.push_back(frame.clone());
+    std::cout<<"Frames: "<<clip.size()<<"\n";
+
+    // reference: the detector on every frame
+    std::vector<std::vector<tk::dnn::BoundingBox>> reference(clip.size());
+    double full_ms = 0;
+    std::vector<cv::Mat> batch(1);
+    for(size_t f=0; f<clip.size(); f++) {
+        batch[0] = clip[f];
+        auto start = std::chrono::steady_clock::now();
+        detNN->update(batch, 1);
+        full_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        toBoundingBoxes(detNN->batchDetected[0], reference[f]);
+    }
+
+    struct mode_t {
+        const char *name;
+        int interval;
+        bool adaptive, flow;
+    };
+    const mode_t modes[] = {
+        { "every 2",            2,  false, false },
+        { "every 3",            3,  false, false },
+        { "every 5",            5,  false, false },
+        { "every 10",           10, false, false },
+        { "every 3, flow",      3,  false, true  },
+        { "every 5, flow",      5,  false, true  },
+        { "adaptive <= 10",     10, true,  false },
+        { "adaptive <= 10, flow", 10, true, true }
+    };
+
+    std::cout<<std::left<<std::setw(24)<<"mode"<<std::setw(14)<<"detector %"<<std::setw(14)<<"ms/frame"
+             <<std::setw(12)<<"speedup"<<"mAP@0.5 vs every frame\n";
+    std::cout<<std::setw(24)<<"every frame"<<std::setw(14)<<100.0<<std::setw(14)<<full_ms/clip.size()
+             <<std::setw(12)<<1.0<<1.0<<"\n";
+
+    std::vector<tk::dnn::BoundingBox> out;
+    for(const mode_t &m: modes) {
+        tk::dnn::IntervalDetection idet(detNN, 1);
+        idet.interval = m.interval;
+        idet.adaptive = m.adaptive;
+        idet.opticalFlow = m.flow;
+
+        tk::dnn::MapAccumulator acc(n_classes, 0.5, 0);
+        double ms = 0;
+        for(size_t f=0; f<clip.size(); f++) {
+            batch[0] = clip[f];
+            auto start = std::chrono::steady_clock::now();
+            idet.update(batch, 1);
+            ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            toBoundingBoxes(idet.batchDetected[0], out);
+            acc.add(reference[f], out);
+        }
+        std::cout<<std::setw(24)<<m.name<<std::setw(14)<<100.0*idet.detected/idet.processed
+                 <<std::setw(14)<<ms/clip.size()<<std::setw(12)<<full_ms/ms<<acc.map(0)<<"\n";
+    }
+    return 0;
+}
@@ -19,14 +19,13 @@
 #include "MobilenetDetection.h"
 
 #include "evaluation.h"
+#include "CocoEvaluator.h"
+#include "DatasetLoader.h"
+#include "ResultSink.h"
 
 #include <map>
-
-void convertFilename(std::string &filename,const std::string l_folder, const std::string i_folder, const std::string l_ext,const std::string i_ext)
-{
-    filename.replace(filename.find(l_folder),l_folder.length(),i_folder);
-    filename.replace(filename.find(l_ext),l_ext.length(),i_ext);
-}
+#include <chrono>
+#include <memory>
 
 int main(int argc, char *argv[]) 
 {
@@ -41,6 +40,7 @@ int main(int argc, char *argv[])
     bool write_res_on_file = true;
     bool write_coco_json = false;
     int n_images = 5000;
+    const char *coco_annotations = nullptr;
 
     bool verbose;
     int classes, map_points, map_levels;
@@ -61,6 +61,8 @@ int main(int argc, char *argv[])
         n_batches = atoi(argv[5]); 
     if(argc > 6)
         confidence_thresh = atof(argv[6]); 
+    if(argc > 7)
+        coco_annotations = argv[7];
 
     std::cout<<"conf t: "<<confidence_thresh<<std::endl;
 
@@ -71,6 +73,8 @@ int main(int argc, char *argv[])
         FatalError("Wrong net file path.");
     if(!fileExist(labels_path))
         FatalError("Wrong labels file path.");
+    if(coco_annotations && !fileExist(coco_annotations))
+        FatalError("Wrong COCO annotations file path.");
 
     //read mAP parameters
     tk::dnn::readmAPParams( config_filename, classes,  map_points, map_levels, map_step,
@@ -82,12 +86,14 @@ int main(int argc, char *argv[])
     std::cout<<"Network: "<<net_name<<std::endl;
 
     //open files (if needed)
-    std::ofstream times, memory, coco_json;
+    std::ofstream times, memory;
 
-    if(write_coco_json){
-        coco_json.open(net_name+"_COCO_res.json");
-        coco_json << "[\n";
-    }
+    //detections are encoded and written by background threads
+    std::unique_ptr<tk::dnn::ResultSink> coco_json, dets_file;
+    if(write_coco_json)
+        coco_json.reset(new tk::dnn::ResultSink(net_name+"_COCO_res.json", tk::dnn::RESULT_COCO_JSON));
+    if(write_dets)
+        dets_file.reset(new tk::dnn::ResultSink("det_"+net_name+".bin", tk::dnn::RESULT_BINARY));
 
     if(write_res_on_file){
         times.open("times_"+net_name+"_"+ std::to_string(n_batches)+"_"+std::to_string(confidence_thresh)+".csv");
@@ -117,86 +123,75 @@ int main(int argc, char *argv[])
     }
     detNN->init(net,n_classes, 1, conf_thresh);
 
-    //read images 
-    std::ifstream all_labels(labels_path);
-    std::string l_filename;
+    //COCO protocol evaluation, results are kept in memory
+    tk::dnn::CocoEvaluator coco;
+    if(coco_annotations)
+        coco.readGroundtruth(coco_annotations);
+
+    //read images and groundtruth ahead of the inference
+    //images are decoded at the smallest JPEG reduction still covering the network input
+    //(full size when they are shown)
+    tk::dnn::dataDim_t input_dim = detNN->getInputDim();
+    tk::dnn::DatasetLoader loader(labels_path, n_batches, n_images, show ? cv::Size() : cv::Size(input_dim.w, input_dim.h));
     std::vector<tk::dnn::Frame> images;
-    std::vector<tk::dnn::box> detected_bbox;
+    double inference_ms = 0;
 
     std::cout<<"Reading groundtruth and generating detections"<<std::endl;
 
     if(show)
         cv::namedWindow("detection", cv::WINDOW_NORMAL);
 
-    bool file_ok = false;
+    int images_done = 0;
+    std::vector<tk::dnn::Frame> cur_frames;
+    std::vector<cv::Mat> batch_dnn_input;
+    while(loader.nextBatch(cur_frames, batch_dnn_input)) {
+        int cur_batches = cur_frames.size();
+        images_done += cur_batches;
 
-    int images_done;
-    for (images_done=0 ; images_done < n_images ;) {
-        
-
-        int cur_batches = 0;
         std::vector<cv::Mat> batch_frames;
-        std::vector<cv::Mat> batch_dnn_input;
-            
-        std::vector<tk::dnn::Frame> cur_frames;
-        for(;cur_batches<n_batches && images_done < n_images;cur_batches++, ++images_done){
-
-            std::getline(all_labels, l_filename);
-            file_ok = all_labels ? true : false ;
-            if (!file_ok)
-                break;
-
-            tk::dnn::Frame f;
-            f.lFilename = l_filename;
-            f.iFilename = l_filename;
-            convertFilename(f.iFilename, "labels", "images", ".txt", ".jpg");
-
-            // read frame
-            if(!fileExist(f.iFilename.c_str()))
-                FatalError("Wrong image file path.");
-
-            cv::Mat frame = cv::imread(f.iFilename.c_str(), cv::IMREAD_COLOR);
-            batch_frames.push_back(frame);
-            f.height = frame.rows;
-            f.width = frame.cols;
-
-            if(!frame.data) 
-                break;
-            batch_dnn_input.push_back(frame.clone());
-
-            // read and save groundtruth labels
-            if(fileExist(f.lFilename.c_str()))
-            {
-                std::ifstream labels(f.lFilename);
-                for(std::string line; std::getline(labels, line); ){
-                    std::istringstream in(line); 
-                    tk::dnn::BoundingBox b;
-                    in >> b.cl >> b.x >> b.y >> b.w >> b.h;  
-                    b.prob = 1;
-                    b.truthFlag = 1;
-                    f.gt.push_back(b);
-
-                    if(show)// draw rectangle for groundtruth
-                        cv::rectangle(batch_frames[cur_batches], cv::Point((b.x-b.w/2)*f.width, (b.y-b.h/2)*f.height), cv::Point((b.x+b.w/2)*f.width,(b.y+b.h/2)*f.height), cv::Scalar(0, 255, 0), 2);             
-                }
-            } 
-
-            cur_frames.push_back(f);
+        if(show){
+            for(int j=0; j<cur_batches; ++j){
+                batch_frames.push_back(batch_dnn_input[j].clone());
+                for(const auto &b: cur_frames[j].gt)// draw rectangle for groundtruth
+                    cv::rectangle(batch_frames[j], cv::Point((b.x-b.w/2)*cur_frames[j].width, (b.y-b.h/2)*cur_frames[j].height), cv::Point((b.x+b.w/2)*cur_frames[j].width,(b.y+b.h/2)*cur_frames[j].height), cv::Scalar(0, 255, 0), 2);
+            }
         }
-        if (!file_ok)
-            break;
+
+        //size of the decoded images, the frames have the full size
+        std::vector<cv::Size> decoded_size;
+        for(const auto &m: batch_dnn_input)
+            decoded_size.push_back(cv::Size(m.cols, m.rows));
 
         //inference 
+        auto start = std::chrono::steady_clock::now();
         detNN->update(batch_dnn_input,cur_batches,write_res_on_file, &times, write_coco_json);
-        detNN->draw(batch_frames);
+        inference_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        //detections back to the full image
+        for(int j=0;j<cur_batches; ++j){
+            float scale_x = float(cur_frames[j].width) / decoded_size[j].width;
+            float scale_y = float(cur_frames[j].height) / decoded_size[j].height;
+            if(scale_x == 1 && scale_y == 1)
+                continue;
+            for(auto &d: detNN->batchDetected[j]){
+                d.x *= scale_x;
+                d.w *= scale_x;
+                d.y *= scale_y;
+                d.h *= scale_y;
+            }
+        }
+        if(show)
+            detNN->draw(batch_frames);
 
         for(int j=0;j<cur_frames.size(); ++j){
-            if(write_coco_json)
-            printJsonCOCOFormat(&coco_json, cur_frames[j].iFilename.c_str(), detNN->batchDetected[j], classes,  cur_frames[j].width, cur_frames[j].height);        
-
-            std::ofstream myfile;
-            if(write_dets)
-                myfile.open ("det/"+cur_frames[j].lFilename.substr(cur_frames[j].lFilename.find("labels/") + 7));
+            if(write_coco_json || coco_annotations){
+                std::vector<tk::dnn::CocoAnnotation> results = tk::dnn::cocoResults(cur_frames[j].iFilename, detNN->batchDetected[j], classes, cur_frames[j].width, cur_frames[j].height);
+                if(write_coco_json)
+                    coco_json->add(results);
+                if(coco_annotations)
+                    for(auto &r: results)
+                        coco.addResult(r);
+            }
 
             // save detections labels
             for(auto d:detNN->batchDetected[j]){
@@ -211,17 +206,15 @@ int main(int argc, char *argv[])
                 b.cl = d.cl;
                 cur_frames[j].det.push_back(b);
 
-                if(write_dets)
-                    myfile << d.cl << " "<< d.prob << " "<< b.x << " "<< b.y << " "<< b.w << " "<< b.h <<"\n";
+                if(write_dets)// frame index in the labels list
+                    dets_file->add(tk::dnn::ResultRecord{ int64_t(images.size()), d.cl, d.prob, b.x, b.y, b.w, b.h });
 
                 if(show)// draw rectangle for detection
                     cv::rectangle(batch_frames[j], cv::Point(d.x, d.y), cv::Point(d.x + d.w, d.y + d.h), cv::Scalar(0, 0, 255), 2);             
                 }
 
-            if(write_dets)
-                myfile.close();
       
-            images.push_back(cur_frames[j]);
+            images.push_back(std::move(cur_frames[j]));
         
             if(show){
                 cv::imshow("detection", batch_frames[j]);
@@ -238,12 +231,17 @@ int main(int argc, char *argv[])
         
     }
 
-    if(write_coco_json){
-        coco_json.seekp (coco_json.tellp() - std::streampos(2));
-        coco_json << "\n]\n";
-        coco_json.close();
+    if(coco_json){
+        coco_json->close();
+        coco_json->printStats();
+    }
+    if(dets_file){
+        dets_file->close();
+        dets_file->printStats();
     }
 
+    loader.printStats();
+    std::cout << "Loader wait [ms]: " << loader.wait_ms << ";Inference [ms]: " << inference_ms << std::endl;
     std::cout << "Avg VM[MB]: " << vm_total/images_done/1024.0 << ";Avg RSS[MB]: " << rss_total/images_done/1024.0 << std::endl;
 
     //compute mAP
@@ -253,6 +251,12 @@ int main(int argc, char *argv[])
     //compute average precision, recall and f1score
     tk::dnn::computeTPFPFN(images,classes,IoU_thresh,confidence_thresh, verbose, write_res_on_file, net_name +"_"+ std::to_string(n_batches)+"_"+std::to_string(confidence_thresh));
 
+    //compute COCO AP/AR on the detections kept in memory
+    if(coco_annotations){
+        coco.evaluate(0, verbose);
+        coco.summarize();
+    }
+
     if(write_res_on_file){
         memory<<vm_total/images_done/1024.0<<";"<<rss_total/images_done/1024.0<<"\n";
         times.close();
@@ -0,0 +1,163 @@
+#ifndef BOXTRACKER_H
+#define BOXTRACKER_H
+
+#include <vector>
+#include <stdint.h>
+
+#include "tkdnn.h"
+#include "Matcher.h"
+#include "SpatialGrid.h"
+
+namespace tk { namespace dnn {
+
+/**
+    Constant velocity Kalman filters of boxes, one row per box, as columns.
+    The state is center, width and height with their velocities; with the
+    noises proportional to the box height (as SORT/ByteTrack) and diagonal,
+    the filter of each coordinate is independent, so every coordinate is a
+    2x2 filter: position, velocity and the covariance pp, pv, vv.
+*/
+struct boxKalman {
+    static const int DIMS = 4;              // cx, cy, w, h
+    float std_pos = 1.0f / 20;              // position noise, relative to the height
+    float std_vel = 1.0f / 160;             // velocity noise, relative to the height
+
+    std::vector<float> pos[DIMS], vel[DIMS];
+    std::vector<float> p_pp[DIMS], p_pv[DIMS], p_vv[DIMS];
+
+    int count() const { return pos[0].size(); }
+    void add(const float cx, const float cy, const float w, const float h);
+    void remove(const int i);
+    void clear();
+    void reserve(const int n);
+
+    /**
+        Advance all the filters by one frame
+    */
+    void predict();
+
+    /**
+        Correct filter i with a measured box
+    */
+    void update(const int i, const float cx, const float cy, const float w, const float h);
+};
+
+/**
+    A box output by BoxTracker: the filtered box in the DetectionNN format
+    (top left corner, width and height) with its track id and velocity
+*/
+struct trackedBox {
+    int64_t id;
+    int cl;
+    float prob;
+    float x, y, w, h;
+    float vx, vy;
+};
+
+enum trackState_t {
+    TRACK_NEW,          // not confirmed yet, removed when missed
+    TRACK_TRACKED,      // confirmed and matched in the last frame
+    TRACK_LOST          // confirmed but missed, kept for maxLost frames
+};
+
+/**
+    SORT/ByteTrack style tracking by detection for DetectionNN outputs, one
+    tracker per stream: tracker[bi].update(detNN->batchDetected[bi]).
+
+    Each frame the filters are predicted, then the association on 1 - IoU
+    is done in two tiers: first all the tracks with the high score
+    detections, then the still unmatched tracked ones with the low score
+    detections, so occluded objects are kept alive by weak detections
+    without starting tracks from them. Candidate pairs come from a spatial
+    grid of the detection centers, the assignment from Matcher.
+    Unmatched high detections start new tracks, which are confirmed after
+    minHits matches; lost tracks are removed after maxLost frames.
+    Once the buffers have grown to the scene size, update does not allocate.
+
+    The cost is about linear in the tracks: on one core of a 2 GHz Xeon,
+    test_box_tracker measures 0.22-0.32 ms per frame with 1000 tracks and
+    0.86-1.06 ms with 3000, so 3000 tracks take the whole 1 ms budget of a
+    frame rather than fitting in it; about 0.3 us per track is the number
+    to plan with.
+*/
+class BoxTracker {
+
+public:
+    float highThresh = 0.5;         // detections of the first tier
+    float lowThresh = 0.1;          // detections under this are ignored
+    float newThresh = 0.6;          // minimum score to start a track
+    float matchIoU = 0.2;           // minimum IoU of the first tier
+    float lowMatchIoU = 0.5;        // minimum IoU of the second tier
+    int minHits = 2;                // matches to confirm a track
+    int maxLost = 30;               // updates a lost track is kept (predict() does not age it)
+    bool perClass = true;           // match only boxes of the same class
+    matchMode_t matchMode = MATCH_OPTIMAL;
+
+    /**
+        Confirmed tracks matched in the last update, with the filtered boxes
+    */
+    std::vector<trackedBox> tracked;
+
+    /**
+        The buffers are allocated for reserve_tracks tracks and as many
+        detections per frame, larger scenes grow them
+    */
+    BoxTracker(const int reserve_tracks = 1024);
+
+    /**
+        Track the detections of a new frame and fill tracked
+    */
+    void update(const std::vector<tk::dnn::box> &dets);
+
+    /**
+        Advance the tracks by one frame without detections (e.g. on the
+        frames the detector is skipped) and fill tracked with the predicted
+        boxes of the confirmed tracks matched in the last update, and with
+        unconfirmed also of the new ones (the detections the last update
+        output, not only the tracks it confirmed)
+    */
+    void predict(const bool unconfirmed = false);
+
+    /**
+        Largest position standard deviation of the tracks in tracked,
+        relative to their height (0 if there are none)
+    */
+    float uncertainty() const;
+
+    /**
+        Remove all the tracks (e.g. on a scene cut), ids keep increasing
+    */
+    void clear();
+
+    int count() const { return kf.count(); }
+    int64_t frame() const { return frame_id; }
+
+private:
+    void associate(const std::vector<tk::dnn::box> &dets, const std::vector<int> &det_idx,
+                   const bool low_tier, const float min_iou);
+    void addTrack(const tk::dnn::box &d);
+    void removeTrack(const int i);
+    void fillTracked(const bool unconfirmed);
+
+    boxKalman kf;
+    std::vector<int64_t> id;
+    std::vector<int> cl, hits, lost;
+    std::vector<float> score;
+    std::vector<char> state;
+    std::vector<int> det_of;        // matched detection of each track in this frame, -1 if none
+
+    int64_t next_id = 1;
+    int64_t frame_id = 0;
+
+    // per frame buffers
+    std::vector<int> high, low, candidates;
+    std::vector<char> det_used;
+    std::vector<int> det_track, track_det;
+    std::vector<float> det_x0, det_y0, det_x1, det_y1, det_area;
+    std::vector<int> det_cl;
+    SpatialGrid grid;
+    Matcher matcher;
+};
+
+}}
+#endif //BOXTRACKER_H
@@ -12,6 +12,10 @@
 #include <algorithm>    // std::sort
 
 #include "TrackingNN.h"
+#include "Matcher.h"
+#include "SpatialGrid.h"
+#include "HeatmapRenderer.h"
+#include "BoxProjector.h"
 
 #ifdef _WIN32
 #define _USE_MATH_DEFINES
@@ -27,31 +31,39 @@ struct detectionRes
 {
     float score;
     int cl;
-    cv::Mat ct, tr, bb0, bb1;
+    float ct[2], tr[2], bb0[2], bb1[2];
     float dep;
     float dim[3];
     float alpha;
     float x,y,z;
     float rot_y;
-    detectionRes() : ct(cv::Mat(cv::Size(1,2), CV_32F)),
-                          tr(cv::Mat(cv::Size(1,2), CV_32F)),
-                          bb0(cv::Mat(cv::Size(1,2), CV_32F)),
-                          bb1(cv::Mat(cv::Size(1,2), CV_32F)) { }
-    ~detectionRes() {
-        ct.release();
-        tr.release();
-        bb0.release();
-        bb1.release();
-    }
+
+    float area() const { return (bb1[0] - bb0[0]) * (bb1[1] - bb0[1]); }
 };
 
-struct trackingRes
+/**
+ * Tracks of a stream, one column per field: center, area and class used by 
+ * the association are contiguous, the rest of the detection is a plain 
+ * struct. Rows are deleted by swap-remove, so the order of the tracks is not 
+ * kept. Track ids grow for the whole stream and are never reused.
+ */
+struct trackTable
 {
-    struct detectionRes det_res;
-    int tracking_id;
-    int age;
-    int active;
-    int color;
+    std::vector<float> ct_x, ct_y, area;
+    std::vector<int> cl;
+    std::vector<detectionRes> det;
+    std::vector<int64_t> tracking_id;
+    std::vector<int> age;
+    std::vector<int> active;
+    std::vector<int> color;
+    int64_t next_id = 0;
+
+    int count() const { return det.size(); }
+    void add(const detectionRes &d, const int color);
+    void update(const int i, const detectionRes &d);
+    void remove(const int i);
+    void clear();
+    void reserve(const int n);
 };
 
 class CenterTrack : public TrackingNN
@@ -96,6 +108,14 @@ public:
     tk::dnn::dataDim_t dim_in0;
     tk::dnn::dataDim_t dim_in1;
     dnnType *out_d;
+    // engines with 7 input channels (image, previous image, previous heatmap)
+    // contain the pre-phase convolutions, no pre_phase_net is needed
+    bool fusedPre = false;
+    std::vector<char> hasPrevImg;       // per stream, fused engines only
+    // previous heatmap of each stream, rendered from its tracks
+    std::vector<HeatmapRenderer> preHm;
+    float preThresh = 0.3;
+    int hmStream = -1;                  // stream whose heatmap is in hm_d
 
 
     /* postprocessing */
@@ -132,9 +152,9 @@ public:
     float *target_coords;
 
     /* visualization */
-    cv::Mat r;
     std::vector<cv::Mat> calibs;
-    cv::Mat corners, pts3DHomo;  
+    BoxProjector proj;                  // 3D boxes of the drawn tracks
+    std::vector<int> projRow;           // box of each track, -1 if not drawn
 
     std::vector<std::vector<int>> faceId;
     cv::Scalar trColors[256];
@@ -152,9 +172,12 @@ public:
     std::vector<struct detectionRes> detRes;
     int countDet;
     //tracks
-    std::vector<std::vector<struct trackingRes>> trRes;
-    std::vector<int> countTr;
-    std::vector<int> trackId;
+    std::vector<trackTable> trRes;
+    SpatialGrid grid;                   // detection centers, for the gating
+    Matcher matcher;
+    matchMode_t matchMode = MATCH_GREEDY;   // MATCH_OPTIMAL for crowded scenes
+    std::vector<int> detTrack;          // matched track of each detection, -1 if none
+    std::vector<int> trackDet;          // matched detection of each track, -1 if none
   
     
     bool init_preprocessing();
@@ -162,8 +185,9 @@ public:
     bool init_postprocessing();
     bool init_visualization(const int n_classes);
     void pre_inf(const int bi);
+    void renderPreHm(const int bi);
     void _get_additional_inputs();
-    cv::Mat transform_preds_with_trans(float x1, float x2);
+    void transform_preds_with_trans(float x1, float x2, float *out);
     void tracking(const int bi);
 
 public:
@@ -15,6 +15,7 @@
 #endif 
 
 #include "DetectionNN3D.h"
+#include "BoxProjector.h"
 
 #include "kernelsThrust.h"
 
@@ -64,7 +65,6 @@ private:
         cv::Vec<float, 3> stddev;
         dnnType *input;
     #endif
-    cv::Mat r;
     float *d_ptrs;
     
     cv::Size sz_old;
@@ -84,7 +84,10 @@ private:
     int *idsOut;
 
     struct threshold op;
-    cv::Mat corners, pts3DHomo;  
+    // 3D boxes of the frame, projected in one pass
+    BoxProjector proj;
+    std::vector<int> projCl;
+    std::vector<float> projProb;
 
     std::vector<std::vector<int>> faceId;
 
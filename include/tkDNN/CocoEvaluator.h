@@ -0,0 +1,106 @@
+#ifndef COCOEVALUATOR_H
+#define COCOEVALUATOR_H
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <stdint.h>
+
+#include "tkdnn.h"
+#include "evaluation.h"
+
+namespace tk { namespace dnn {
+
+/**
+ * A COCO annotation (groundtruth) or result (detection). bbox is
+ * [x, y, width, height] in pixels, area is the segmentation area for
+ * groundtruths and the box area for results.
+ */
+struct CocoAnnotation
+{
+    int64_t image_id = 0;
+    int category_id = 0;
+    double x = 0, y = 0, w = 0, h = 0;
+    double area = 0;
+    double score = 1;
+    bool iscrowd = false;
+};
+
+/**
+ * COCO image id from an image path (.../images/<id>.jpg) and COCO category id
+ * of a class index (80 classes)
+ */
+int64_t cocoImageId(const std::string &image_path);
+int cocoCategoryId(const int cl);
+
+/**
+ * Detections of a frame as COCO results, in the same way they are written by
+ * printJsonCOCOFormat (boxes clipped to the image, one result per class
+ * probability when the box carries all of them)
+ */
+std::vector<CocoAnnotation> cocoResults(const std::string &image_path, const std::vector<tk::dnn::box> &bbox,
+                                        const int classes, const int w, const int h);
+
+void printCocoResult(std::ostream &out, const CocoAnnotation &r);
+
+/**
+ * COCO detection protocol (bbox), as pycocotools COCOeval: IoU thresholds
+ * 0.50:0.05:0.95, 101 recall points, area ranges all/small/medium/large,
+ * maxDets 1/10/100, crowd groundtruths matched by any number of detections
+ * (IoU over the detection area). Images and categories are evaluated in
+ * parallel (TKDNN_CPU_THREADS).
+ *
+ * Groundtruth comes from a COCO annotations json or from darknet frames;
+ * results from a results json or added in process, so threshold and batch
+ * sweeps do not need to go through files.
+ */
+class CocoEvaluator
+{
+public:
+    /**
+     * Read images, categories and annotations of a COCO annotations json
+     * (instances_*.json), segmentations are skipped
+     */
+    void readGroundtruth(const std::string &json_file);
+    /**
+     * Read a results json: [{"image_id", "category_id", "bbox", "score"}, ...]
+     */
+    void readResults(const std::string &json_file);
+    void writeResults(const std::string &json_file) const;
+
+    void addImage(const int64_t image_id);
+    void addCategory(const int category_id);
+    void addGroundtruth(const CocoAnnotation &gt);
+    void addResult(const CocoAnnotation &det);
+    /**
+     * Groundtruth and detections of a frame (normalized center boxes, as
+     * computed by the map demo). Without segmentations the groundtruth area
+     * is the box area.
+     */
+    void addFrame(const int64_t image_id, const Frame &frame, const int classes);
+    void clearResults();
+
+    /**
+     * Evaluate the results with score at least min_score, fills stats,
+     * categoryAP and categoryAR. Returns AP IoU=0.50:0.95.
+     */
+    double evaluate(const float min_score = 0, const bool verbose = false);
+    /**
+     * Print the stats as pycocotools summarize
+     */
+    void summarize() const;
+
+    /**
+     * AP @[.5:.95, .5, .75], AP small/medium/large, AR maxDets 1/10/100,
+     * AR small/medium/large. -1 when not available.
+     */
+    std::vector<double> stats;
+    std::map<int, double> categoryAP, categoryAR;  // IoU=0.50:0.95, area all, maxDets 100
+
+    std::vector<int64_t> images;
+    std::vector<int> categories;
+    std::vector<CocoAnnotation> groundtruths, results;
+};
+
+}}
+#endif /*COCOEVALUATOR_H*/
@@ -1,5 +1,7 @@
 #pragma once
 #include <iostream>
+#include <memory>
+#include <ctime>
 #include "tkDNN/tkdnn.h"
 
 namespace tk { namespace dnn {
@@ -26,10 +28,17 @@ namespace tk { namespace dnn {
         int coords = 4;
         int nms_kind = 0;
         int new_coords= 0;
+        int output = 1;                 // connected
+        int weights_type = 0;           // shortcut, tkdnnShortcutWeights_t
+        int weights_normalization = 0;  // shortcut, tkdnnShortcutNormalization_t
+        int scale_wh = 0;               // scale_channels
         float scale_xy = 1;
         float nms_thresh = 0.45;
         std::vector<int> layers;
+        std::vector<float> mask;
+        std::vector<float> anchors;
         std::string activation = "linear";
+        int line = 0;   // index of the section header among the non empty cfg lines
 
         friend std::ostream& operator<<(std::ostream& os, const darknetFields_t& f){
             os << f.width << " " << f.height << " " << f.channels << " " << f.batch_normalize<< " " << f.filters << " "  << f.activation<< " " << f.scale_xy;
@@ -37,15 +46,50 @@ namespace tk { namespace dnn {
         }
     };
 
+    /**
+        Parsed cfg file, every section in order (the first one is [net])
+    */
+    struct darknetCfg_t {
+        std::string path;
+        time_t mtime = 0;
+        std::vector<darknetFields_t> sections;
+    };
+
     std::string darknetParseType(const std::string& line);
+    std::string darknetTrim(const std::string& str);
     bool divideNameAndValue(const std::string& line, std::string&name, std::string& value);
     std::vector<int> fromStringToIntVec(const std::string& line, const char delimiter);
     
     bool darknetParseFields(const std::string& line, darknetFields_t& fields);
+    /**
+        Parse a cfg file in a single pass, the result is cached by path (and
+        modification time) so every consumer below reads the file once
+    */
+    std::shared_ptr<const darknetCfg_t> darknetReadCfg(const std::string& cfg_file);
     tk::dnn::Network *darknetAddNet(darknetFields_t &fields);
     void darknetAddLayer(tk::dnn::Network *net, darknetFields_t &f, std::string wgs_path, 
                          std::vector<tk::dnn::Layer*> &netLayers, const std::vector<std::string>& names);
     std::vector<std::string> darknetReadNames(const std::string& names_file);
+    /**
+        Convolution weights in a darknet .weights file, in file order.
+        Also used for connected layers and for the weights of shortcuts (outputs = 0).
+    */
+    struct darknetConvWgs_t {
+        std::string name;   // tensor name, the weights path given to the layer
+        int outputs;
+        int weights;
+        bool batchnorm;
+        bool connected = false;  // darknet order is bias, weights, [scales, mean, variance]
+    };
+
+    /**
+        Read a darknet .weights file in background, in a single sequential pass.
+        Tensors are published to the network WeightsLoader in the tkDNN layout.
+    */
+    void darknetStreamWeights(tk::dnn::Network *net, const std::string& weights_file, 
+                              const std::vector<darknetFields_t> &sections);
+    void darknetStreamConvWeights(tk::dnn::Network *net, const std::string& weights_file, 
+                                  const std::vector<darknetConvWgs_t> &convs);
     tk::dnn::Network* darknetParser(const std::string& cfg_file, const std::string& wgs_path, const std::string& names_file);
     void loadYoloInfo(const std::string &cfg_file,int lineNo,std::vector<float> &mask,std::vector<float> &anchors,int &num,int &classes,float &nms_thresh,int &nms_kind,int &coords);
     void loadYoloInitInfo(int &channels,int &width,int &height,const std::string &cfg_file);
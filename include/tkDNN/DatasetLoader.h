@@ -0,0 +1,81 @@
+#ifndef DATASETLOADER_H
+#define DATASETLOADER_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <opencv2/core/core.hpp>
+
+#include "evaluation.h"
+
+namespace tk { namespace dnn {
+
+/**
+    Prefetching reader of a darknet validation set: a text file listing the
+    label files (path/to/labels/<name>.txt), with the images in
+    path/to/images/<name>.jpg.
+    A pool of threads decodes the images and parses the labels ahead of the
+    consumer, up to prefetch_batches batches, and the batches are returned in
+    the list order. With a decode_size (the network input) JPEGs are decoded
+    at the smallest libjpeg reduction still covering it, see imreadReduced:
+    frames keep the full image size, images are the decoded ones.
+    The parsed groundtruth of the whole list is cached in
+    <labels list>.gt.bin and reused by the next runs, as long as the list
+    and the size and modification time of every label file are the same.
+*/
+class DatasetLoader {
+
+public:
+    DatasetLoader(const std::string &labels_list, const int batch_size, const int max_images = -1,
+                  const cv::Size decode_size = cv::Size(), const int n_threads = 0,
+                  const int prefetch_batches = 4, const bool gt_cache = true);
+    virtual ~DatasetLoader();
+
+    /**
+        Wait for the next batch (full, except the last one), false when the list is over
+    */
+    bool nextBatch(std::vector<Frame> &frames, std::vector<cv::Mat> &images);
+
+    int size() const { return label_files.size(); }
+    void printStats();
+
+    int n_threads;
+    double wait_ms = 0;     // time the consumer spent blocked in nextBatch()
+    double decode_ms = 0;   // sum of the image decode time of every sample
+    double parse_ms = 0;    // sum of the label parse time of every sample
+    bool cache_hit = false;
+
+private:
+    struct sample_t {
+        Frame frame;
+        cv::Mat image;
+        std::string error;
+        bool ready = false;
+    };
+
+    void worker();
+    void load(const int index, sample_t &sample);
+    bool readCache();
+    void writeCache();
+    void stopWorkers();
+
+    std::string cache_file;
+    std::vector<std::string> label_files;
+    std::vector<std::vector<BoundingBox>> gt;   // cached or collected groundtruth
+    int batch_size;
+    cv::Size decode_size;
+    bool gt_cache;
+
+    std::mutex mtx;
+    std::condition_variable cv_free, cv_ready;
+    std::vector<sample_t> ring;
+    int next_load = 0, next_read = 0;
+    std::vector<std::thread> workers;
+    bool stop = false;
+};
+
+}}
+#endif //DATASETLOADER_H
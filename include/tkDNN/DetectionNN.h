@@ -2,6 +2,7 @@
 #define DETECTIONNN_H
 
 #include <iostream>
+#include <cstdio>
 #include <signal.h>
 #include <stdlib.h>    
 #ifdef __linux__
@@ -78,6 +79,11 @@ class DetectionNN {
         DetectionNN() {};
         ~DetectionNN(){};
 
+        /**
+         * Input dimension of the network, valid after init
+         */
+        tk::dnn::dataDim_t getInputDim() const { return netRT->input_dim; }
+
         /**
          * Method used to initialize the class, allocate memory and compute 
          * needed data.
@@ -106,6 +112,9 @@ class DetectionNN {
             if(cur_batches > nBatches)
                 FatalError("A batch size greater than nBatches cannot be used");
 
+            // times are written once at the end, outside the timed sections
+            double times_ns[3];
+
             originalSize.clear();
             if(TKDNN_VERBOSE) printCenteredTitle(" TENSORRT detection ", '=', 30); 
             {
@@ -117,7 +126,7 @@ class DetectionNN {
                     preprocess(frames[bi], bi);    
                 }
                 TKDNN_TSTOP
-                if(save_times) *times<<t_ns<<";";
+                times_ns[0] = t_ns;
             }
 
             //do inference
@@ -130,7 +139,7 @@ class DetectionNN {
                 TKDNN_TSTOP
                 if(TKDNN_VERBOSE) dim.print();
                 stats.push_back(t_ns);
-                if(save_times) *times<<t_ns<<";";
+                times_ns[1] = t_ns;
             }
 
             batchDetected.clear();
@@ -139,7 +148,12 @@ class DetectionNN {
                 for(int bi=0; bi<cur_batches;++bi)
                     postprocess(bi, mAP);
                 TKDNN_TSTOP
-                if(save_times) *times<<t_ns<<"\n";
+                times_ns[2] = t_ns;
+            }
+            if(save_times){
+                char line[96];
+                int len = snprintf(line, sizeof(line), "%g;%g;%g\n", times_ns[0], times_ns[1], times_ns[2]);
+                times->write(line, len);
             }
         }      
 
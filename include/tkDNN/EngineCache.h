@@ -0,0 +1,66 @@
+#ifndef ENGINECACHE_H
+#define ENGINECACHE_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "Network.h"
+
+namespace tk { namespace dnn {
+
+/**
+    Output head of an engine (yolo and region layers, plus the final output)
+*/
+struct engineHead_t {
+    std::string type;
+    int classes = 0, num = 0, n_masks = 0;
+    dataDim_t dim;
+};
+
+/**
+    Sidecar of a tensorRT engine (<engine>.yaml): what the engine has been built
+    from and what a detector needs to use it without rebuilding the network.
+*/
+struct engineMeta_t {
+    std::string key;            // content hash, see engineMetaFromNetwork
+    std::string precision;      // fp32, fp16, int8, dla
+    int maxBatchSize = 1;
+    std::string trtVersion, cudnnVersion, tkdnnVersion, device;
+    dataDim_t input_dim, output_dim;
+    std::vector<std::string> classesNames;
+    std::vector<engineHead_t> heads;
+
+    bool empty() const { return key.empty(); }
+};
+
+/**
+    Describe the engine a network would build. The key hashes the layers
+    (type, dims, host weights), the precision, the max batch size, the
+    tensorRT/cudnn/tkDNN versions and the device, so any of them changing
+    invalidates the engine.
+*/
+engineMeta_t engineMetaFromNetwork(Network *net);
+
+/**
+    Read/write the sidecar of an engine, read returns false if missing or invalid
+*/
+bool readEngineMeta(const std::string &engine, engineMeta_t &meta);
+bool writeEngineMeta(const std::string &engine, const engineMeta_t &meta);
+/**
+    Check the sidecar tensorRT version and device against the running ones,
+    prints what differs
+*/
+bool engineMetaCompatible(const engineMeta_t &meta);
+
+/**
+    Engine cache (TKDNN_ENGINE_CACHE=<folder>, TKDNN_ENGINE_CACHE_SIZE=<MB>, default 4096).
+    engineCachePath returns where the engine for the given name and key is stored:
+    <folder>/<name>_<key>.rt, or name itself if the cache is disabled.
+    engineCacheInsert links name to the cached engine (and its sidecar) and evicts
+    the least recently used engines over the size limit.
+*/
+std::string engineCachePath(const std::string &name, const std::string &key);
+void engineCacheInsert(const std::string &name, const std::string &engine);
+
+}}
+#endif //ENGINECACHE_H
@@ -0,0 +1,63 @@
+#ifndef HEATMAPRENDERER_H
+#define HEATMAPRENDERER_H
+
+#include <vector>
+
+namespace tk { namespace dnn {
+
+/**
+    CPU renderer of CenterNet style heatmaps (e.g. the CenterTrack pre_hm
+    input): a peak is the max of the map and a gaussian of radius given by
+    the object size, as draw_umich_gaussian. The gaussian of each radius is
+    computed once and kept. The map is not cleared as a whole: begin() zeroes
+    only the rectangles drawn in the previous frame, and changedRows() gives
+    the rows that can differ from the previous frame, to upload only them.
+*/
+class HeatmapRenderer {
+
+public:
+    void init(const int width, const int height);
+
+    /**
+        Start a new frame, zeroing the peaks of the previous one
+    */
+    void begin();
+
+    /**
+        Draw the peak of an object centered in (cx, cy) with size w x h
+    */
+    void splat(const float cx, const float cy, const float w, const float h, const float peak = 1.0f);
+    void splatRadius(const int cx, const int cy, const int radius, const float peak = 1.0f);
+
+    /**
+        Rows [y0, y1) that can differ from the previous frame, false if none
+    */
+    bool changedRows(int &y0, int &y1) const;
+
+    const float *data() const { return map.data(); }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    /**
+        Radius of the gaussian of a h x w object (CenterNet gaussian_radius)
+    */
+    static int gaussianRadius(const float h, const float w, const float min_overlap = 0.7f);
+
+    /**
+        (2*radius+1)^2 gaussian of sigma (2*radius+1)/6, as gaussian2D
+    */
+    const std::vector<float> &kernel(const int radius);
+
+private:
+    struct rect_t {
+        int x0, y0, x1, y1;
+    };
+
+    int width = 0, height = 0;
+    std::vector<float> map;
+    std::vector<std::vector<float>> kernels;
+    std::vector<rect_t> drawn, cleared;     // this frame, previous frame
+};
+
+}}
+#endif //HEATMAPRENDERER_H
@@ -0,0 +1,35 @@
+#ifndef IMAGEREADER_H
+#define IMAGEREADER_H
+
+#include <string>
+#include <opencv2/core/core.hpp>
+
+namespace tk { namespace dnn {
+
+/**
+    Size of a JPEG image read from its frame header (SOF marker), without
+    decoding it. Returns false if the file is not a JPEG.
+*/
+bool jpegSize(const std::string &fname, int &width, int &height);
+
+/**
+    Largest JPEG decode reduction (1, 2, 4 or 8) that still gives an image of
+    at least min_width x min_height. The reduced size is ceil(size/factor) on
+    each side; the check holds in both orientations, since the decoder applies
+    the EXIF rotation after the reduction.
+*/
+int jpegReduction(const int width, const int height, const int min_width, const int min_height);
+
+/**
+    cv::imread for images that are going to be resized to min_width x
+    min_height (or less): JPEGs are decoded directly at 1/2, 1/4 or 1/8 of
+    their size by the libjpeg DCT scaling (cv::IMREAD_REDUCED_COLOR_*), other
+    formats or min sizes <= 0 give the full image.
+    orig_size, if given, is set to the size of the full image, to bring
+    coordinates computed on the decoded one back to it.
+*/
+cv::Mat imreadReduced(const std::string &fname, const int min_width, const int min_height,
+                      cv::Size *orig_size = nullptr);
+
+}}
+#endif //IMAGEREADER_H
@@ -0,0 +1,75 @@
+#ifndef INTERVALDETECTION_H
+#define INTERVALDETECTION_H
+
+#include <vector>
+
+#include "DetectionNN.h"
+#include "BoxTracker.h"
+
+namespace tk { namespace dnn {
+
+/**
+    Runs a DetectionNN only on some frames and propagates the boxes on the
+    others, still giving batchDetected for every frame.
+
+    The detector runs every interval frames and, if adaptive, earlier when
+    the tracks get uncertain (Kalman position deviation over maxUncertainty
+    box heights) or have moved more than maxDisplacement box heights since
+    the last detection. On detection frames batchDetected is the detector
+    output, which also updates a BoxTracker per stream; on the other frames
+    it is the Kalman prediction of the tracks matched on the last detection
+    frame, confirmed or new, or, with opticalFlow, the previous boxes moved
+    by the median sparse optical flow of points near their corners.
+    The trackers only see the detection frames, so their maxLost counts
+    detector runs: a lost track is kept for about maxLost * interval frames.
+
+    usage:
+        tk::dnn::IntervalDetection idet(detNN, n_batch);
+        idet.interval = 3;
+        idet.update(batch_frames, n_batch);   // every frame
+        ... idet.batchDetected[bi]
+*/
+class IntervalDetection {
+
+public:
+    int interval = 3;                   // detector period in frames (1 = every frame)
+    bool adaptive = false;              // also run the detector when the tracks get uncertain
+    float maxUncertainty = 0.1;         // position std over box height (adaptive)
+    float maxDisplacement = 0.5;        // motion since the last detection over box height (adaptive)
+    bool opticalFlow = false;           // propagate with optical flow instead of Kalman prediction
+
+    std::vector<std::vector<tk::dnn::box>> batchDetected; /*bounding boxes of every frame*/
+    std::vector<tk::dnn::BoxTracker> trackers;            /*one per stream*/
+
+    int processed = 0;                  // frames processed, per stream
+    int detected = 0;                   // frames where the detector ran
+
+    IntervalDetection(tk::dnn::DetectionNN *detNN, const int n_streams = 1);
+
+    /**
+        Process the next frame of each stream, returns true if the detector ran
+    */
+    bool update(std::vector<cv::Mat> &frames, const int cur_batches = 1);
+
+    /**
+        Forget the tracks and the counters, detect on the next frame (e.g. on a new clip)
+    */
+    void reset();
+
+private:
+    void propagateFlow(const int bi);
+    bool needDetection() const;
+
+    tk::dnn::DetectionNN *detNN;
+    int since_detection = 0;            // frames since the last detection
+    bool detect_next = true;
+
+    // optical flow state
+    std::vector<cv::Mat> prev_gray, gray;
+    std::vector<cv::Point2f> pts, next_pts;
+    std::vector<unsigned char> status;
+    std::vector<float> err, dx, dy;
+};
+
+}}
+#endif //INTERVALDETECTION_H
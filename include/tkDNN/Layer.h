@@ -33,6 +33,8 @@ enum layerType_t {
     LAYER_REGION,
     LAYER_YOLO,
     LAYER_PADDING,
+    LAYER_SAM,
+    LAYER_SCALE_CHANNELS,
 };
 
 #define TKDNN_BN_MIN_EPSILON 1e-5
@@ -89,6 +91,8 @@ public:
             case LAYER_REGION:              return "Region";
             case LAYER_YOLO:                return "Yolo";
             case LAYER_PADDING:             return "Padding";
+            case LAYER_SAM:                 return "Sam";
+            case LAYER_SCALE_CHANNELS:      return "ScaleChannels";
             default:                        return "unknown";
         }
     }
@@ -116,6 +120,9 @@ public:
     dnnType *data_h, *data_d;
     dnnType *bias_h, *bias_d;
 
+    // data_h, bias_h, bias2_h and scales_h are views of a mapped WeightsArchive or prefetched buffer
+    bool hostView = false;
+
     // additional bias for DCN
     bool additional_bias;
     dnnType *bias2_h = nullptr, *bias2_d = nullptr;
@@ -137,7 +144,21 @@ public:
     __half *mean16_h     = nullptr,     *mean16_d = nullptr;
     __half *variance16_h = nullptr, *variance16_d = nullptr;
 
+    /**
+        Bytes of host weights allocated by the layer and bytes viewed inside
+        mapped or prefetched buffers (see Network::weightsResidency)
+    */
+    size_t hostOwnedBytes();
+    size_t hostViewBytes();
+    /**
+        Read back the host weights after a releaseHost, does nothing if they are resident
+    */
+    void reloadHost();
+
     void releaseHost(bool release32 = true, bool release16 = true) {
+        if(release32 && hostView) {
+            data_h = bias_h = bias2_h = scales_h = nullptr;
+        }
         if(release32) {
             if(    data_h != nullptr) { delete []     data_h;     data_h = nullptr; }
             if(    bias_h != nullptr) { delete []     bias_h;     bias_h = nullptr; }
@@ -177,6 +198,9 @@ public:
             if(   power16_d != nullptr) { cudaFree(   power16_d);    power16_d = nullptr; }
         }
     }
+
+protected:
+    void foldBatchnorm();
 };
 
 
@@ -208,11 +232,14 @@ public:
 class Dense : public LayerWgs {
 
 public:
-    Dense(Network *net, int out_ch, std::string fname_weights); 
+    Dense(Network *net, int out_ch, std::string fname_weights, bool batchnorm = false); 
     virtual ~Dense();
     virtual layerType_t getLayerType() { return LAYER_DENSE; };
 
     virtual dnnType* infer(dataDim_t &dim, dnnType* srcData);
+
+protected:
+    cudnnTensorDescriptor_t bnTensorDesc;
 };
 
 
@@ -393,6 +420,14 @@ public:
     virtual layerType_t getLayerType() { return LAYER_DEFORMCONV2D; };
 
     virtual dnnType* infer(dataDim_t &dim, dnnType* srcData);
+
+    /**
+        Host reference inference (multithreaded, no cuda/cublas).
+        srcData_h is a host buffer of input_dim, the result is a host buffer of output_dim
+        owned by the layer. Requires the host weights (do not call releaseHost before).
+    */
+    dnnType* inferCPU(dataDim_t &dim, dnnType* srcData_h);
+
     tk::dnn::Conv2d *preconv; 
     int out_ch;
     int deformableGroup;
@@ -411,6 +446,13 @@ protected:
     cudnnTensorDescriptor_t biasTensorDesc;
     void initCUDNN();
 
+    // host buffers used by inferCPU
+    std::vector<dnnType> offsetMask_h;  // preconv output: offsets (2*dg*kh*kw ch) + mask (dg*kh*kw ch)
+    std::vector<dnnType> columns_h;     // (in_c*kh*kw) x (out_h*out_w) sampled columns
+    std::vector<int>     sampleIdx_h;   // 4 bilinear neighbours for each (dg, tap, out pixel)
+    std::vector<dnnType> sampleWgs_h;   // bilinear weights premultiplied by the mask
+    std::vector<dnnType> dstData_h;
+
 };
 
 /**
@@ -488,7 +530,8 @@ typedef enum {
     POOLING_MAX     = 0,
     POOLING_AVERAGE = 1,                    // count for average includes padded values
     POOLING_AVERAGE_EXCLUDE_PADDING = 2,    // count for average does not include padded values
-    POOLING_MAX_FIXEDSIZE = 100             // max pool darknet fashion
+    POOLING_MAX_FIXEDSIZE = 100,            // max pool darknet fashion
+    POOLING_AVERAGE_FIXEDSIZE = 101         // average pool darknet fashion (local_avgpool), padding not counted
 } tkdnnPoolingMode_t;
 
 /**
@@ -600,6 +643,21 @@ public:
     int stride;
 };
 
+/**
+    Weights of a darknet multi-input shortcut
+*/
+typedef enum {
+    SHORTCUT_WEIGHTS_NONE = 0,
+    SHORTCUT_WEIGHTS_PER_FEATURE = 1,   // one weight for every input
+    SHORTCUT_WEIGHTS_PER_CHANNEL = 2    // one weight for every input channel
+} tkdnnShortcutWeights_t;
+
+typedef enum {
+    SHORTCUT_NORM_NONE = 0,
+    SHORTCUT_NORM_RELU = 1,
+    SHORTCUT_NORM_SOFTMAX = 2
+} tkdnnShortcutNormalization_t;
+
 /**
     Shortcut layer
     sum with stride another layer
@@ -608,6 +666,14 @@ class Shortcut : public Layer {
 
 public:
     Shortcut(Network *net, Layer *backLayer, bool mul=false); 
+    /**
+        Darknet multi-input shortcut: input plus every back layer (same dims),
+        each optionally scaled by the weights read from fname_weights.
+        Weights are normalized once at load time.
+    */
+    Shortcut(Network *net, const std::vector<Layer*> &backLayers, std::string fname_weights = "",
+             tkdnnShortcutWeights_t weights_type = SHORTCUT_WEIGHTS_NONE,
+             tkdnnShortcutNormalization_t weights_normalization = SHORTCUT_NORM_NONE);
     virtual ~Shortcut();
     virtual layerType_t getLayerType() { return LAYER_SHORTCUT; };
 
@@ -615,9 +681,56 @@ public:
 
     int c,h,w;
 
+    /**
+        Number of weights in the file for the given inputs and channels (darknet nweights)
+    */
+    static int nWeights(int n_back, int c, tkdnnShortcutWeights_t weights_type);
+
 public:
     Layer *backLayer;
     bool mul = false;
+
+    // multi-input version, backLayer is backLayers[0]
+    std::vector<Layer*> backLayers;
+    std::string weights_path;
+    tkdnnShortcutWeights_t weights_type = SHORTCUT_WEIGHTS_NONE;
+    tkdnnShortcutNormalization_t weights_normalization = SHORTCUT_NORM_NONE;
+    // normalized weights, one per channel for the input and every back layer ((backLayers+1) x c)
+    dnnType *weights_h = nullptr, *weights_d = nullptr;
+
+    bool multiInput() const { return backLayers.size() > 1 || weights_type != SHORTCUT_WEIGHTS_NONE; }
+};
+
+/**
+    Spatial attention (darknet sam): backLayer output multiplied element-wise by the input
+*/
+class Sam : public Layer {
+
+public:
+    Sam(Network *net, Layer *backLayer);
+    virtual ~Sam();
+    virtual layerType_t getLayerType() { return LAYER_SAM; };
+
+    virtual dnnType* infer(dataDim_t &dim, dnnType* srcData);
+
+    Layer *backLayer;
+};
+
+/**
+    Channel attention (darknet scale_channels): every channel of the backLayer output
+    is multiplied by the input (1x1xC), or every pixel by the input (WxHx1) with scale_wh
+*/
+class ScaleChannels : public Layer {
+
+public:
+    ScaleChannels(Network *net, Layer *backLayer, int scale_wh = 0);
+    virtual ~ScaleChannels();
+    virtual layerType_t getLayerType() { return LAYER_SCALE_CHANNELS; };
+
+    virtual dnnType* infer(dataDim_t &dim, dnnType* srcData);
+
+    Layer *backLayer;
+    int scale_wh;
 };
 
 /**
@@ -686,7 +799,7 @@ public:
 
     enum nmsKind_t {GREEDY_NMS=0, DIOU_NMS=1};
 
-    Yolo(Network *net, int classes, int num, std::string fname_weights,int n_masks=3, float scale_xy=1, double nms_thresh=0.45, nmsKind_t nsm_kind=GREEDY_NMS, int new_coords=0);
+    Yolo(Network *net, int classes, int num, std::string fname_weights,int n_masks=3, float scale_xy=1, double nms_thresh=0.45, nmsKind_t nsm_kind=GREEDY_NMS, int new_coords=0, bool gaussian=false);
     virtual ~Yolo();
     virtual layerType_t getLayerType() { return LAYER_YOLO; };
 
@@ -696,6 +809,7 @@ public:
     float scaleXY;
     double nms_thresh;
     nmsKind_t nsm_kind; 
+    bool gaussian;  // darknet gaussian_yolo: mean and uncertainty for every coordinate (8+1+classes entries)
     std::vector<std::string> classesNames;
 
     virtual dnnType* infer(dataDim_t &dim, dnnType* srcData);
@@ -0,0 +1,38 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <stdint.h>
+
+namespace tk { namespace dnn {
+
+/**
+    Read-only view of a whole file.
+    On linux the file is mapped (pages are loaded by the kernel, no heap copy),
+    elsewhere it is read into an 8 byte aligned buffer.
+*/
+class MappedFile {
+
+public:
+    MappedFile() {}
+    virtual ~MappedFile();
+
+    /**
+        sequential: the file is read front to back (readahead hints)
+        populate:   fault every page in before returning (MAP_POPULATE)
+    */
+    bool open(const std::string &fname, bool sequential = true, bool populate = false);
+    void close();
+
+    bool isOpen() { return base != nullptr; }
+    const char* data() { return base; }
+    uint64_t size = 0;
+    std::string path;
+
+private:
+    char *base = nullptr;
+    bool mapped = false;
+};
+
+}}
+#endif //MAPPEDFILE_H
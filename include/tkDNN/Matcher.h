@@ -0,0 +1,71 @@
+#ifndef MATCHER_H
+#define MATCHER_H
+
+#include <vector>
+
+namespace tk { namespace dnn {
+
+enum matchMode_t {
+    /** detections, in index order, take the cheapest free track (first index on ties) */
+    MATCH_GREEDY,
+    /** minimum total cost, leaving a track unmatched costs cost_limit: a pair
+        is used only when it lowers the total (linear assignment) */
+    MATCH_OPTIMAL
+};
+
+/**
+    Track-detection association on a sparse cost matrix: only the gated pairs
+    (e.g. same class and close enough) are added, the other ones can not be
+    matched. MATCH_OPTIMAL solves the linear assignment with the shortest
+    augmenting path of Jonker-Volgenant (Dijkstra with potentials, one track at
+    a time), every track having a private "unmatched" column of cost
+    cost_limit. Greedy is O(pairs), optimal O(tracks * pairs * log(pairs)) in
+    the worst case and close to O(pairs) on sparse scenes.
+    The pair lists and the path search state (potentials, distances, heap)
+    are sized by reserve() for the largest frame expected and reused.
+*/
+class Matcher {
+
+public:
+    /**
+        Start a new frame with n_tracks tracks and n_dets detections
+    */
+    void clear(const int n_tracks, const int n_dets);
+    void addPair(const int track, const int det, const float cost);
+    int pairs() const { return pair_track.size(); }
+
+    /**
+        Allocate the buffers for frames up to these sizes
+    */
+    void reserve(const int n_tracks, const int n_dets, const int n_pairs);
+
+    /**
+        Match the pairs with cost lower than cost_limit. det_track[d] is the
+        track of detection d (-1 if none), track_det[t] the detection of track t.
+        Returns the number of matches.
+    */
+    int solve(const matchMode_t mode, const float cost_limit,
+              std::vector<int> &det_track, std::vector<int> &track_det);
+
+private:
+    void greedy(const float cost_limit, std::vector<int> &det_track, std::vector<int> &track_det);
+    void optimal(const float cost_limit, std::vector<int> &det_track, std::vector<int> &track_det);
+
+    int n_tracks = 0, n_dets = 0;
+    std::vector<int> pair_track, pair_det;
+    std::vector<float> pair_cost;
+
+    // pairs grouped by track (optimal) or by detection (greedy)
+    std::vector<int> offsets, order;
+
+    // shortest augmenting path state, columns are dets then one per track
+    std::vector<double> u, v, shortest;
+    std::vector<int> path, row4col, col4row;
+    std::vector<char> scanned_row, scanned_col;
+    std::vector<int> touched_rows, touched_cols;
+    std::vector<int> det_degree;
+    std::vector<std::pair<double, int>> heap;
+};
+
+}}
+#endif //MATCHER_H
@@ -2,6 +2,9 @@
 #define NETWORK_H
 
 #include <string>
+#include <map>
+#include <memory>
+#include <vector>
 #include "utils.h"
 
 namespace tk { namespace dnn {
@@ -33,8 +36,20 @@ struct dataDim_t {
 };
 
 class Layer;
+class WeightsArchive;
+class WeightsLoader;
 const int MAX_LAYERS = 512;
 
+/**
+    Host copies of the weights once the tensorRT engine is built or loaded
+    (TKDNN_WEIGHTS_RESIDENCY=keep|drop|reload)
+*/
+enum weightsResidency_t {
+    WEIGHTS_KEEP = 0,   // keep them (default)
+    WEIGHTS_DROP,       // free them, they can not be used anymore
+    WEIGHTS_RELOAD      // free them, they are read again from the weights source when needed
+};
+
 class Network {
 
 public:
@@ -52,6 +67,47 @@ public:
     const char *getNetworkRTName(const char *network_name);
     void adjustFeatureMapSizeWithShortcuts();
 
+    /**
+        Read size floats of a weights file (from seek) to a host and a device buffer.
+        If the folder of fname has been packed into a weights archive
+        (<folder>.tkw, see WeightsArchive) the data is taken from the mapped archive
+        and, with view=true, the host buffer points inside the mapping: in that case
+        true is returned and the host buffer must not be deleted.
+        Files queued with prefetchWeights are served from the loader buffers the
+        same way, blocking only if the file has not been read yet.
+    */
+    bool readWeights(const std::string &fname, int size, dnnType** data_h, dnnType** data_d, 
+                     int seek = 0, bool view = false);
+    bool readHostWeights(const std::string &fname, int size, dnnType** data_h, int seek = 0, bool view = false);
+    WeightsArchive* getWeightsArchive(const std::string &fname);
+
+    /**
+        Start reading the given weights files in background (see WeightsLoader),
+        files already available in a weights archive are skipped.
+    */
+    void prefetchWeights(const std::vector<std::string> &fnames);
+    WeightsLoader* getWeightsLoader();
+    /**
+        Wait for the pending reads, stop the loader threads and print the loading stats.
+        The buffers are kept, layers may still point to them.
+    */
+    void finishWeightsPrefetch();
+
+    /**
+        Apply weightsResidency to the host weights of every layer, called by NetworkRT
+        once the engine is ready. Prints the resident bytes before and after.
+    */
+    void applyWeightsResidency();
+    /**
+        Read back the host weights released with WEIGHTS_RELOAD
+    */
+    void reloadHostWeights();
+    /**
+        Print the host weights bytes (owned copies and views of mapped or prefetched
+        buffers), per layer if requested. Returns the total resident bytes.
+    */
+    size_t printHostWeights(bool per_layer = false);
+
     cudnnDataType_t dataType;
     cudnnTensorFormat_t tensorFormat;
     cudnnHandle_t cudnnHandle;
@@ -70,6 +126,14 @@ public:
     std::string fileLabelList;
     std::string networkName;
     std::string networkNameRT;
+    std::vector<std::string> classesNames; // stored in the engine sidecar, taken from the yolo layers if empty
+
+    bool useWeightsArchive; // TKDNN_WEIGHTS_ARCHIVE=0 forces the per layer .bin files
+    std::map<std::string, std::shared_ptr<WeightsArchive>> weightsArchives; // by folder
+    bool prefetch;          // TKDNN_WEIGHTS_PREFETCH=0 reads the weights synchronously
+    std::shared_ptr<WeightsLoader> weightsLoader;
+    weightsResidency_t weightsResidency;
+    bool hostWeightsReleased = false;
     
 };
 
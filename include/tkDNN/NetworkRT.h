@@ -6,6 +6,7 @@
 #include "Network.h"
 #include "Layer.h"
 #include "NvInfer.h"
+#include "EngineCache.h"
 #include <memory>
 #include <tkDNN/kernels.h>
 #include <pluginsRT/ActivationLeakyRT.h>
@@ -54,6 +55,7 @@ public:
     cudaStream_t stream;
 
     std::vector<nvinfer1::YoloRT*> yolo_plugins; // yolo layers in network
+    engineMeta_t meta;  // engine sidecar, empty if missing
 
     NetworkRT(Network *net, const char *name);
     virtual ~NetworkRT();
@@ -91,6 +93,8 @@ public:
     nvinfer1::IPluginV2Layer* convert_layer(nvinfer1::ITensor *input, Reorg *l);
     nvinfer1::IPluginV2Layer* convert_layer(nvinfer1::ITensor *input, Region *l);
     nvinfer1::ILayer* convert_layer(nvinfer1::ITensor *input, Shortcut *l);
+    nvinfer1::ILayer* convert_layer(nvinfer1::ITensor *input, Sam *l);
+    nvinfer1::ILayer* convert_layer(nvinfer1::ITensor *input, ScaleChannels *l);
     nvinfer1::IPluginV2Layer* convert_layer(nvinfer1::ITensor *input, Yolo *l);
     nvinfer1::ILayer* convert_layer(nvinfer1::ITensor *input, Upsample *l);
     nvinfer1::ILayer* convert_layer(nvinfer1::ITensor *input, DeformConv2d *l);
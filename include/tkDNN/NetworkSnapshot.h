@@ -0,0 +1,72 @@
+#ifndef NETWORKSNAPSHOT_H
+#define NETWORKSNAPSHOT_H
+
+#include <string>
+#include <stdint.h>
+#include "Network.h"
+
+namespace tk { namespace dnn {
+
+/**
+    Prebuilt network description (.tkn), replaces the cfg parsing on startup.
+
+    Layout (little endian):
+        header  : magic "TKDNNSN\0", version, counts and offsets of the tables below
+        layers  : one fixed size record per layer (type, dims, hyper parameters)
+        refs    : layer ids referenced by routes, shortcuts, sam and scale_channels
+        data    : small inline tensors (yolo masks and anchors)
+        names   : (offset, length) of every class name in the strings blob
+        strings : weights paths (convolutions, connected, weighted shortcuts) and class names
+
+    The weights are not copied: every layer keeps the path it was built with,
+    so they are read from the weights archive, the layers folder or the darknet
+    .weights file as usual (prefetched in background).
+    Loading maps the file, rebuilds the layers from the records and checks the
+    stored input/output dims against the rebuilt ones.
+
+    Supported layers: the ones created by the darknet parser.
+*/
+namespace snapshot {
+
+    const uint32_t VERSION = 1;
+    const int MAX_INTS = 12;
+    const int MAX_FLOATS = 4;
+
+    struct header_t {
+        char     magic[8];
+        uint32_t version;
+        uint32_t n_layers;
+        int32_t  input_dim[5];
+        uint32_t n_names;
+        uint64_t layers_offset;
+        uint64_t refs_offset;
+        uint64_t data_offset;
+        uint64_t names_offset;
+        uint64_t strings_offset;
+        uint64_t size;
+    };
+
+    struct layer_t {
+        int32_t type;               // layerType_t
+        int32_t input_dim[5];
+        int32_t output_dim[5];
+        int32_t i[MAX_INTS];        // integer hyper parameters
+        float   f[MAX_FLOATS];      // float hyper parameters
+        int32_t refs_offset, refs_n;
+        int32_t data_offset, data_n;
+        int32_t str_offset, str_n;  // weights path
+    };
+}
+
+/**
+    Write a snapshot of a network built by the darknet parser
+*/
+void saveNetworkSnapshot(Network *net, const std::string &fname);
+
+/**
+    Rebuild a network from a snapshot, returns nullptr if the file is missing or not valid
+*/
+Network* loadNetworkSnapshot(const std::string &fname);
+
+}}
+#endif //NETWORKSNAPSHOT_H
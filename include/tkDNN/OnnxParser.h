@@ -0,0 +1,82 @@
+#pragma once
+#include <iostream>
+#include <map>
+#include <vector>
+#include <stdint.h>
+#include "tkDNN/tkdnn.h"
+
+namespace tk { namespace dnn {
+
+    /**
+        ONNX tensor (initializer or Constant), converted to float (data) and to
+        int64 (ints) whatever the stored type is
+    */
+    struct onnxTensor_t {
+        std::string name;
+        std::vector<int64_t> dims;
+        std::vector<float> data;
+        std::vector<int64_t> ints;
+    };
+
+    struct onnxAttribute_t {
+        std::string name;
+        float f = 0;
+        int64_t i = 0;
+        std::string s;
+        std::vector<float> floats;
+        std::vector<int64_t> ints;
+        onnxTensor_t t;
+    };
+
+    struct onnxNode_t {
+        std::string name;
+        std::string op_type;
+        std::vector<std::string> inputs, outputs;
+        std::map<std::string, onnxAttribute_t> attrs;
+
+        bool has(const std::string &attr) const { return attrs.count(attr) > 0; }
+        int64_t getInt(const std::string &attr, int64_t def) const;
+        float getFloat(const std::string &attr, float def) const;
+        std::string getString(const std::string &attr, const std::string &def) const;
+        std::vector<int64_t> getInts(const std::string &attr, const std::vector<int64_t> &def) const;
+    };
+
+    struct onnxValueInfo_t {
+        std::string name;
+        std::vector<int64_t> dims;  // 0 for symbolic dimensions
+    };
+
+    /**
+        Decoded ONNX model, only the parts used to build a network:
+        nodes (topologically sorted, as the format requires), initializers,
+        graph inputs (without the initializers) and graph outputs
+    */
+    struct onnxGraph_t {
+        std::string path;
+        int64_t opset = 0;
+        std::vector<onnxNode_t> nodes;
+        std::map<std::string, onnxTensor_t> initializers;
+        std::vector<onnxValueInfo_t> inputs, outputs;
+    };
+
+    /**
+        Decode an .onnx file. The protobuf wire format is read directly (no protobuf
+        dependency), tensors with external data are not supported.
+    */
+    onnxGraph_t onnxReadGraph(const std::string& onnx_file);
+
+    /**
+        Build a network from an .onnx file with a single NCHW input (batch 1).
+        Supported operators: Conv (a following BatchNormalization is folded in),
+        BatchNormalization, Relu, LeakyRelu, Sigmoid, Mish, Clip (as relu6),
+        MaxPool, AveragePool, GlobalAveragePool, GlobalMaxPool, Concat (channels),
+        Add, Mul (tensors or scalars), Sub and Div (scalars), Resize, Upsample,
+        Reshape, Flatten, Gemm, Identity, Dropout and Constant.
+        Initializers are handed to the layers through the weights loader, under
+        the names <onnx_file>/<layer id>.bin. Inputs that are not the output of the
+        previous layer are brought back with a single-input route. With more than
+        one graph output every output layer is marked final.
+    */
+    tk::dnn::Network *onnxParser(const std::string& onnx_file);
+
+}}
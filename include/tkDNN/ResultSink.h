@@ -0,0 +1,106 @@
+#ifndef RESULTSINK_H
+#define RESULTSINK_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+
+#include "tkdnn.h"
+#include "CocoEvaluator.h"
+
+namespace tk { namespace dnn {
+
+/**
+    A detection as written by ResultSink: frame (or COCO image id), class
+    (or COCO category id), score and box [x, y, w, h]
+*/
+struct ResultRecord {
+    int64_t frame;
+    int cl;
+    float score;
+    float x, y, w, h;
+};
+
+enum ResultFormat {
+    /** chunks of columns: "TKRS", version, n, then frame[n] (int64), cl[n] (int32),
+        score[n], x[n], y[n], w[n], h[n] (float32), little endian */
+    RESULT_BINARY,
+    /** one json object per line: {"frame":..,"class":..,"score":..,"bbox":[x,y,w,h]} */
+    RESULT_JSONL,
+    /** COCO results json, as printJsonCOCOFormat */
+    RESULT_COCO_JSON
+};
+
+/**
+    Detection writer with a background thread. add() only copies the records
+    to the current chunk, full chunks are encoded and written by the writer
+    thread in large blocks, so the inference thread does not format or write.
+    At most max_chunks chunks wait for the writer, then add() blocks.
+*/
+class ResultSink {
+
+public:
+    ResultSink(const std::string &fname, const ResultFormat format, const int chunk_records = 1 << 16,
+               const int max_chunks = 8);
+    virtual ~ResultSink();
+
+    void add(const ResultRecord &r);
+    void add(const int64_t frame, const std::vector<tk::dnn::box> &dets);
+    void add(const std::vector<CocoAnnotation> &results);
+
+    /**
+        Write everything added and close the file (called by the destructor)
+    */
+    void close();
+    void printStats();
+
+    /**
+        Read back a RESULT_BINARY file
+    */
+    static std::vector<ResultRecord> readBinary(const std::string &fname);
+
+    /**
+        Append v to p with at most decimals decimals (trailing zeros removed),
+        returns the end. Faster than the stream formatting, values that can't be
+        represented with 15 digits fall back to %g.
+    */
+    static char *formatFloat(char *p, const double v, const int decimals);
+
+    /**
+        Append v to p with digits significant digits, like %.<digits>g: used
+        for the scores, whose small values must keep their precision
+    */
+    static char *formatSignificant(char *p, const double v, const int digits);
+
+    size_t records = 0;
+    size_t bytes = 0;
+    double wait_ms = 0;     // time add() spent blocked on a full queue
+    double write_ms = 0;    // encode and write time of the writer thread
+
+private:
+    void writer();
+    void push();
+    void encode(const std::vector<ResultRecord> &chunk, std::string &out);
+
+    std::string fname;
+    ResultFormat format;
+    int chunk_records, max_chunks;
+    std::ofstream out;
+    bool first = true;   // no comma before the first COCO result
+
+    std::vector<ResultRecord> pending;
+    std::mutex mtx;
+    std::condition_variable cv_queue, cv_free;
+    std::deque<std::vector<ResultRecord>> queue;
+    std::thread thread;
+    bool stop = false;
+    bool closed = false;
+};
+
+}}
+#endif //RESULTSINK_H
@@ -0,0 +1,118 @@
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include <vector>
+
+namespace tk { namespace dnn {
+
+/**
+    Uniform grid of 2D points (e.g. the detection centers of a frame) for
+    the association gating: query() visits only the points of the cells
+    overlapping the search square, so finding the candidate pairs of N
+    objects is O(N) instead of O(N^2) when the cell size is close to the
+    gating radius. The grid covers the bounding box of the points, the
+    cells of a row are contiguous so a query scans one range per row; the
+    cell size grows if needed to keep at most about 4 cells per point, so
+    the cell table reserve() allocates is bounded by the number of points.
+
+    usage:
+        grid.clear(cell_size);
+        for each detection: grid.add(x, y);
+        grid.build();
+        for each track: grid.query(x, y, radius, [&](int det, float dist2) { ... });
+*/
+class SpatialGrid {
+
+public:
+    /**
+        Start a new frame with cells of cell_size side
+    */
+    void clear(const float cell_size);
+
+    /**
+        Add a point, its index is the number of points added before it
+    */
+    void add(const float x, const float y) {
+        px.push_back(x);
+        py.push_back(y);
+    }
+    int count() const { return px.size(); }
+
+    /**
+        Allocate the buffers for frames up to n points
+    */
+    void reserve(const int n);
+
+    /**
+        Index the added points
+    */
+    void build();
+
+    /**
+        Call f(index, squared distance) for every point within radius of (x, y)
+    */
+    template<typename F> void query(const float x, const float y, const float radius, F f) const {
+        if(px.empty() || !(radius >= 0) || x + radius < min_x || x - radius > max_x ||
+           y + radius < min_y || y - radius > max_y)
+            return;
+        const float r2 = radius*radius;
+        const int cx0 = cellOf(x - radius - min_x, cols), cx1 = cellOf(x + radius - min_x, cols);
+        const int cy0 = cellOf(y - radius - min_y, rows), cy1 = cellOf(y + radius - min_y, rows);
+        for(int cy=cy0; cy<=cy1; cy++) {
+            const int end = start[cy*cols + cx1 + 1];
+            for(int k=start[cy*cols + cx0]; k<end; k++) {
+                const float dx = sx[k] - x, dy = sy[k] - y;
+                const float d2 = dx*dx + dy*dy;
+                if(d2 <= r2)
+                    f(items[k], d2);
+            }
+        }
+    }
+
+    /**
+        Call f(index) for every point with |px - x| <= half_w and
+        |py - y| <= half_h, e.g. the centers of the boxes that may overlap a
+        box: no distance is computed and the rectangle scans fewer points
+        than the circle around it
+    */
+    template<typename F> void queryBox(const float x, const float y, const float half_w, const float half_h, F f) const {
+        if(px.empty() || !(half_w >= 0 && half_h >= 0) || x + half_w < min_x || x - half_w > max_x ||
+           y + half_h < min_y || y - half_h > max_y)
+            return;
+        const float x0 = x - half_w, x1 = x + half_w, y0 = y - half_h, y1 = y + half_h;
+        const int cx0 = cellOf(x0 - min_x, cols), cx1 = cellOf(x1 - min_x, cols);
+        const int cy0 = cellOf(y0 - min_y, rows), cy1 = cellOf(y1 - min_y, rows);
+        for(int cy=cy0; cy<=cy1; cy++) {
+            const int end = start[cy*cols + cx1 + 1];
+            for(int k=start[cy*cols + cx0]; k<end; k++)
+                if(sx[k] >= x0 && sx[k] <= x1 && sy[k] >= y0 && sy[k] <= y1)
+                    f(items[k]);
+        }
+    }
+
+    /**
+        Indexes of the points within radius of (x, y), in out (cleared first)
+    */
+    void candidates(const float x, const float y, const float radius, std::vector<int> &out) const;
+
+private:
+    // cell of an offset from the grid origin, clamped to [0, n-1]
+    int cellOf(const float v, const int n) const {
+        const float c = v * inv_cell;
+        if(!(c > 0))
+            return 0;
+        return c >= n - 1 ? n - 1 : (int) c;
+    }
+
+    float cell_size = 1, inv_cell = 1;
+    float min_x = 0, min_y = 0, max_x = 0, max_y = 0;
+    int cols = 1, rows = 1;
+    std::vector<float> px, py;
+
+    // points sorted by cell (row major), cell c is [start[c], start[c+1])
+    std::vector<int> start, items, cell;
+    std::vector<float> sx, sy;
+};
+
+}}
+#endif //SPATIALGRID_H
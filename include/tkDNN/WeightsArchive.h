@@ -0,0 +1,95 @@
+#ifndef WEIGHTSARCHIVE_H
+#define WEIGHTSARCHIVE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <stdint.h>
+#include "utils.h"
+#include "MappedFile.h"
+
+namespace tk { namespace dnn {
+
+/**
+    Single file weights container (.tkw), replaces a folder of per layer .bin files.
+
+    Layout (little endian):
+        header   : magic "TKDNNWA\0", version, number of tensors, payload offset
+        index    : one entry per tensor (name, dtype, shape, offset, bytes, crc32)
+        payloads : raw tensor data, every payload starts on a 64 byte boundary
+
+    The file is mapped read-only (mmap on linux, a single aligned read elsewhere)
+    and tensors are returned as host views inside the mapping, no copy is done.
+    Each payload crc32 is checked the first time the tensor is requested.
+
+    scripts/pack_weights.py converts a layers/ folder into <folder>.tkw, one tensor
+    for each .bin file, named as the file without extension.
+*/
+class WeightsArchive {
+
+public:
+    static const uint32_t VERSION = 1;
+    static const uint64_t ALIGNMENT = 64;
+    static const int MAX_NAME = 96;
+    static const int MAX_DIMS = 4;
+
+    enum dtype_t {
+        WA_FLOAT32 = 0,
+        WA_FLOAT16 = 1,
+        WA_INT32   = 2
+    };
+
+    struct header_t {
+        char     magic[8];
+        uint32_t version;
+        uint32_t n_tensors;
+        uint64_t payload_offset;
+    };
+
+    struct entry_t {
+        char     name[MAX_NAME];
+        uint32_t dtype;
+        uint32_t ndims;
+        int32_t  shape[MAX_DIMS];
+        uint64_t offset;        // from the beginning of the file
+        uint64_t bytes;
+        uint32_t crc32;
+        uint32_t reserved;
+    };
+
+    WeightsArchive();
+    virtual ~WeightsArchive();
+
+    /**
+        Map an archive, returns false if the file does not exist or is not valid
+    */
+    bool open(const std::string &fname, bool verify = true);
+    void close();
+
+    bool isOpen() { return base != nullptr; }
+    bool has(const std::string &name) { return index.find(name) != index.end(); }
+    const entry_t* getEntry(const std::string &name);
+
+    /**
+        Host view of a float32 tensor, count is set to the number of elements.
+        Returns nullptr if the tensor is missing.
+    */
+    const dnnType* getFloat(const std::string &name, int &count);
+
+    std::vector<std::string> names();
+    std::string path;
+    uint64_t size = 0;
+
+    static uint32_t crc32(const void *data, uint64_t len, uint32_t crc = 0);
+
+private:
+    MappedFile file;
+    const char *base = nullptr;
+    bool verify = true;
+    const header_t *header = nullptr;
+    std::map<std::string, int> index;   // name -> entry number
+    std::vector<bool> checked;
+};
+
+}}
+#endif //WEIGHTSARCHIVE_H
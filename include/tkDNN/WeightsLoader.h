@@ -0,0 +1,82 @@
+#ifndef WEIGHTSLOADER_H
+#define WEIGHTSLOADER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include "utils.h"
+
+namespace tk { namespace dnn {
+
+/**
+    Asynchronous weights reader.
+    Tensors (named as the weights file they replace) are registered up front and
+    filled by a pool of threads while the network is being built, a layer blocks
+    in get() only if its tensor is not loaded yet.
+    Buffers are kept until the loader is destroyed, so layers can use host views.
+*/
+class WeightsLoader {
+
+public:
+    WeightsLoader(int n_threads = 0);
+    virtual ~WeightsLoader();
+
+    /**
+        Read a whole weights file in background
+    */
+    void enqueue(const std::string &fname);
+
+    /**
+        Register a tensor that will be filled by a submitted task with provide()
+    */
+    void expect(const std::string &name);
+    void provide(const std::string &name, std::vector<dnnType> &&data, double read_ms = 0);
+    void fail(const std::string &name, const std::string &error);
+    void submit(std::function<void()> task);
+
+    bool has(const std::string &name);
+
+    /**
+        Wait for a tensor and return its content (nullptr if it was never registered)
+    */
+    const std::vector<dnnType>* get(const std::string &name);
+
+    /**
+        Wait for every registered tensor and stop the threads, loaded buffers are kept
+    */
+    void finish();
+    void printStats();
+
+    int n_threads;
+    double wait_ms = 0;    // time spent blocked in get()
+    double read_ms = 0;    // sum of the read time of every task
+    size_t read_bytes = 0;
+
+private:
+    struct job_t {
+        std::vector<dnnType> data;
+        bool done = false;
+        std::string error;
+    };
+
+    void worker();
+    void stopWorkers();
+
+    std::mutex mtx;
+    std::condition_variable cv_queue, cv_done;
+    std::deque<std::function<void()>> queue;
+    std::map<std::string, std::unique_ptr<job_t>> jobs;
+    std::vector<std::thread> workers;
+    bool stop = false;
+    std::chrono::steady_clock::time_point first_enqueue, last_done;
+};
+
+}}
+#endif //WEIGHTSLOADER_H
@@ -3,6 +3,8 @@
 
 #include <iostream>
 #include <vector>
+#include <map>
+#include <functional>
 #include <algorithm>
 
 #include <yaml-cpp/yaml.h>
@@ -37,6 +39,22 @@ void readmAPParams( const char* config_filename, int& classes, int& map_points,
                     int& map_levels, float& map_step, float& IoU_thresh, 
                     float& conf_thresh, bool& verbose);
 
+/**
+ * This method computes the Average Precision of a class from its 
+ * precision-recall curve, one point per detection of the class in descending 
+ * confidence order (recall never decreases along the curve).
+ *
+ * @param precision precision at each point of the curve
+ * @param recall recall at each point of the curve
+ * @param map_points number of point used to compute the AP. if 0 is given, 
+ *                  all the recall levels are evaluated, otherwise only 
+ *                  map_point recall levels are used (binary search on recall).
+ *
+ * @return AP of the class
+ */
+double averagePrecision(const std::vector<double> &precision, const std::vector<double> &recall,
+                        const int map_points);
+
 /**
  * This method computes the mean Average Precision for a set of detections and 
  * groundtruths. It returns the mAP for a given IoU threshold, and a given 
@@ -65,6 +83,8 @@ double computeMap(  std::vector<Frame> &images,const int classes,
  * groundtruths on several IoU thresholds. It is used to compute, for example, 
  * the most used metric in Object Detection, namely the mAP 0.5:0.95, which is 
  * the average among the mAP for IoU level from 0.5 to 0.95 with a step of 0.05.
+ * The best groundtruth of each detection is searched once, with the frames 
+ * processed in parallel (TKDNN_CPU_THREADS), and shared by all the IoU levels.
  *
  * @param images collection of frames on which to compute the metrics
  * @param classes number of classes of the considered dataset
@@ -110,6 +130,65 @@ void computeTPFPFN( std::vector<Frame> &images,const int classes,
                     bool verbose=false, const bool write_on_file=false,    
                     std::string net="");
 
+/**
+ * Incremental mAP for long or live sequences: frames are added as they are 
+ * produced and only counters are kept, per class the number of detections and 
+ * of true positives (per IoU level) at each confidence, plus the groundtruth 
+ * count. The mAP can be read at any time and matches computeMap and 
+ * computeMapNIoULevels on the same frames (detections with the same 
+ * confidence can be ranked differently, as in the batch sort).
+ *
+ * A groundtruth is matched only by detections of its own frame, so the 
+ * highest confidence detection matching it is the true positive and the 
+ * matching is resolved when the frame is added. 
+ * With score_bins > 0 the confidences are quantized to score_bins levels: 
+ * memory is bounded by classes * score_bins * map_levels counters and the 
+ * mAP is approximated. With 0 every distinct confidence has its counters.
+ */
+class MapAccumulator
+{
+public:
+    MapAccumulator(const int classes, const float i_IoU_thresh=0.5, const float conf_thresh=0.3, 
+                   const int map_points=101, const float map_step=0.05, const int map_levels=10, 
+                   const int score_bins=0);
+
+    /**
+     * Match the detections of a frame with its groundtruth and update the counters 
+     */
+    void add(const std::vector<BoundingBox> &gt, const std::vector<BoundingBox> &det);
+    void add(const Frame &frame) { add(frame.gt, frame.det); }
+    void clear();
+
+    /**
+     * mAP at the IoU level-th threshold (i_IoU_thresh + level*map_step)
+     */
+    double map(const int level) const;
+    /**
+     * mAP averaged over all the IoU levels
+     */
+    double mapNIoULevels() const;
+
+    int frames = 0;
+    int detections = 0;
+    int groundtruths = 0;
+
+private:
+    // detections with the same (quantized) confidence of a class
+    struct scoreCount_t {
+        int dets = 0;
+        std::vector<int> tp;    // true positives for each IoU level
+    };
+    typedef std::map<float, scoreCount_t, std::greater<float>> scoreCounts_t;
+
+    float score(const float prob) const;
+
+    int classes, map_points, score_bins;
+    float conf_thresh;
+    std::vector<float> IoU_threshs;
+    std::vector<scoreCounts_t> class_scores;
+    std::vector<int> truth_classes_count;
+    float max_score = 0;
+};
 
 void printJsonCOCOFormat(std::ofstream *out_file, const std::string image_path, std::vector<tk::dnn::box> bbox, const int classes, const int w, const int h);
 
@@ -19,6 +19,7 @@ void reorgForward(dnnType *srcData, dnnType *dstData,
                   int n, int c, int h, int w, int stride, cudaStream_t stream = cudaStream_t(0));
 
 void MaxPoolingForward(dnnType *srcData, dnnType *dstData, int n, int c, int h, int w, int stride_x, int stride_y, int size, int padding, cudaStream_t stream = cudaStream_t(0));
+void AvgPoolingForward(dnnType *srcData, dnnType *dstData, int n, int c, int h, int w, int stride_x, int stride_y, int size, int padding, cudaStream_t stream = cudaStream_t(0));
 
 void softmaxForward(float *input, int n, int batch, int batch_offset,
                     int groups, int group_offset, int stride, float temp, float *output, cudaStream_t stream = cudaStream_t(0));
@@ -26,6 +27,12 @@ void softmaxForward(float *input, int n, int batch, int batch_offset,
 void shortcutForward(dnnType *srcData, dnnType *dstData, int n1, int c1, int h1, int w1, int s1,
                      int n2, int c2, int h2, int w2, int s2, bool mul,
                      cudaStream_t stream = cudaStream_t(0));
+void shortcutWeightedForward(dnnType *srcData, dnnType *dstData, const dnnType *weights,
+                             int n, int c, int hw, bool accumulate, cudaStream_t stream = cudaStream_t(0));
+
+void scaleChannelsForward(dnnType *srcData, dnnType *scales, dnnType *dstData, int size,
+                          int channel_size, int batch_size, bool scale_wh, cudaStream_t stream = cudaStream_t(0));
+void samForward(dnnType *srcData, dnnType *scales, dnnType *dstData, int size, cudaStream_t stream = cudaStream_t(0));
 
 void upsampleForward(dnnType *srcData, dnnType *dstData,
                      int n, int c, int h, int w, int s, int forward, float scale,
@@ -13,7 +13,7 @@ namespace nvinfer1 {
 
     public:
         YoloRT(int classes, int num,int c,int h,int w, int n_masks = 3, float scale_xy = 1,
-               float nms_thresh = 0.45, int nms_kind = 0, int new_coords = 0);
+               float nms_thresh = 0.45, int nms_kind = 0, int new_coords = 0, int gaussian = 0);
 
         YoloRT(const void *data, size_t length);
 
@@ -79,6 +79,7 @@ namespace nvinfer1 {
         float nms_thresh;
         int nms_kind;
         int new_coords;
+        int gaussian;   // serialized after the classes names, engines built before it have none
 
         std::vector<std::string> classesNames;
         std::vector<dnnType> mask;
@@ -88,7 +89,8 @@ namespace nvinfer1 {
         int entry_index(int batch, int location, int entry) {
             int n = location / (w * h);
             int loc = location % (w * h);
-            return batch * c * h * w + n * w * h * (4 + classes + 1) + entry * w * h + loc;
+            int coords = gaussian ? 8 : 4;
+            return batch * c * h * w + n * w * h * (coords + classes + 1) + entry * w * h + loc;
         }
 
     private:
@@ -75,4 +75,34 @@ int testInference(std::vector<std::string> input_bins, std::vector<std::string>
     delete [] input_h;
     checkCuda( cudaFree(data) );
     return ret_cudnn | ret_tensorrt | ret_cudnn_tensorrt;
-}
\ No newline at end of file
+}
+/**
+    Check the host implementation of every DeformConv2d in the net against
+    its cudnn output. Needs a previous net->infer() on the same input.
+*/
+int testDeformConv2dCPU(tk::dnn::Network *net) {
+
+    int ret = 0;
+    for(int i=1; i<net->num_layers; i++) {
+        if(net->layers[i]->getLayerType() != tk::dnn::LAYER_DEFORMCONV2D)
+            continue;
+        tk::dnn::DeformConv2d *l = (tk::dnn::DeformConv2d*) net->layers[i];
+        tk::dnn::Layer *prev = net->layers[i-1];
+
+        std::vector<dnnType> input_h(prev->output_dim.tot()), cudnn_h(l->output_dim.tot());
+        checkCuda( cudaMemcpy(input_h.data(), prev->dstData, input_h.size()*sizeof(dnnType), cudaMemcpyDeviceToHost) );
+        checkCuda( cudaMemcpy(cudnn_h.data(), l->dstData, cudnn_h.size()*sizeof(dnnType), cudaMemcpyDeviceToHost) );
+
+        printCenteredTitle((std::string(" DEFORMCONV2D ") + std::to_string(i) + " CPU ").c_str(), '=', 30);
+        tk::dnn::dataDim_t dim = prev->output_dim;
+        dnnType *cpu_out;
+        {
+            TKDNN_TSTART
+            cpu_out = l->inferCPU(dim, input_h.data());
+            TKDNN_TSTOP_C(COL_CYANB, true)
+        }
+        std::cout<<"CPU   vs CUDNN  ";
+        ret |= checkResult(cudnn_h.size(), cpu_out, cudnn_h.data(), false) == 0 ? 0 : ERROR_CPUvsCUDNN;
+    }
+    return ret;
+}
@@ -22,6 +22,7 @@
 
 #include <ios>
 #include <chrono>
+#include <functional>
 
 #include <yaml-cpp/yaml.h>
 
@@ -140,7 +141,8 @@ double t_ns = time_ms.count();
 typedef enum {
   ERROR_CUDNN = 2,
   ERROR_TENSORRT = 4,
-  ERROR_CUDNNvsTENSORRT = 8    
+  ERROR_CUDNNvsTENSORRT = 8,
+  ERROR_CPUvsCUDNN = 16
 } resultError_t;
 
 void printCenteredTitle(const char *title, char fill, int dim = 30);
@@ -160,6 +162,13 @@ void matrixMulAdd(  cublasHandle_t handle, dnnType* srcData, dnnType* dstData,
 void getMemUsage(double& vm_usage_kb, double& resident_set_kb);
 void printCudaMemUsage();
 void removePathAndExtension(const std::string &full_string, std::string &name);
+
+/**
+    Split [0, n) in contiguous chunks and run body(begin, end) on each one in a
+    separate thread. n_threads <= 0 means TKDNN_CPU_THREADS or all the available cores.
+*/
+int  getCPUThreads();
+void parallelFor(int n, const std::function<void(int, int)> &body, int n_threads = 0);
 static inline bool isCudaPointer(void *data) {
   cudaPointerAttributes attr;
   return cudaPointerGetAttributes(&attr, data) == 0;
@@ -0,0 +1,74 @@
+"""
+Pack a tkDNN layers/ folder (one .bin file per layer) into a single weights
+archive <folder>.tkw, that is mapped by tk::dnn::WeightsArchive at network
+construction instead of opening every .bin file.
+
+usage: python3 pack_weights.py path/to/layers [output.tkw]
+"""
+import os
+import sys
+import struct
+import zlib
+
+MAGIC = b"TKDNNWA\0"
+VERSION = 1
+ALIGNMENT = 64
+MAX_NAME = 96
+MAX_DIMS = 4
+WA_FLOAT32 = 0
+
+HEADER_FMT = "<8sIIQ"
+ENTRY_FMT = "<%dsII%diQQII" % (MAX_NAME, MAX_DIMS)
+
+
+def align(v):
+    return (v + ALIGNMENT - 1) // ALIGNMENT * ALIGNMENT
+
+
+def tensor_name(fname):
+    # same rule as removePathAndExtension in src/utils.cpp
+    return os.path.basename(fname).split(".")[0]
+
+
+def pack(layers_dir, out_file):
+    files = sorted(f for f in os.listdir(layers_dir) if f.endswith(".bin"))
+    if len(files) == 0:
+        sys.exit("no .bin files in " + layers_dir)
+
+    names = [tensor_name(f) for f in files]
+    if len(set(names)) != len(names):
+        sys.exit("duplicated tensor names in " + layers_dir)
+
+    index_size = struct.calcsize(HEADER_FMT) + len(files) * struct.calcsize(ENTRY_FMT)
+    offset = align(index_size)
+    entries, payloads = [], []
+    for f, name in zip(files, names):
+        with open(os.path.join(layers_dir, f), "rb") as fd:
+            data = fd.read()
+        if len(data) % 4 != 0:
+            sys.exit(f + " is not a float32 file")
+        if len(name.encode()) >= MAX_NAME:
+            sys.exit("tensor name too long: " + name)
+        shape = [len(data) // 4] + [0] * (MAX_DIMS - 1)
+        entries.append(struct.pack(ENTRY_FMT, name.encode(), WA_FLOAT32, 1, *shape,
+                                   offset, len(data), zlib.crc32(data) & 0xFFFFFFFF, 0))
+        payloads.append((offset, data))
+        offset = align(offset + len(data))
+
+    with open(out_file, "wb") as out:
+        out.write(struct.pack(HEADER_FMT, MAGIC, VERSION, len(files), align(index_size)))
+        for e in entries:
+            out.write(e)
+        for off, data in payloads:
+            out.write(b"\0" * (off - out.tell()))
+            out.write(data)
+
+    print("packed %d tensors (%.1f MB) into %s" % (len(files), offset / 1e6, out_file))
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    layers_dir = os.path.normpath(sys.argv[1])
+    out_file = sys.argv[2] if len(sys.argv) > 2 else layers_dir + ".tkw"
+    pack(layers_dir, out_file)
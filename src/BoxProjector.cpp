@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cmath>
+
+#include "BoxProjector.h"
+
+namespace tk { namespace dnn {
+
+static const int BLOCK = 64;
+
+/*
+    sin and cos of a in [-pi/4, pi/4] plus a multiple q of pi/2, with the
+    minimax polynomials of the cephes sinf/cosf (about 1e-7 error) and the
+    quadrant picked arithmetically: unlike std::sin/std::cos this is branch
+    free code the block loop vectorizes.
+*/
+static inline void sinCos(const float r, float &s, float &c) {
+    const int q = int(r * 0.63661977f + std::copysign(0.5f, r));
+    const float a = (r - q * 1.5703125f) - q * 4.8382679e-4f;
+    const float a2 = a * a;
+    const float ps = a + a * a2 * ((-1.9515296e-4f * a2 + 8.3321609e-3f) * a2 - 1.6666655e-1f);
+    const float pc = 1.0f - 0.5f * a2 + a2 * a2 * ((2.4433157e-5f * a2 - 1.3887316e-3f) * a2 + 4.1666646e-2f);
+    // quadrant q mod 4: (sin, cos) = (ps, pc), (pc, -ps), (-ps, -pc), (-pc, ps)
+    const float odd = q & 1, even = 1 - odd;
+    s = (odd * pc + even * ps) * float(1 - (q & 2));
+    c = (odd * ps + even * pc) * float(1 - ((q + 1) & 2));
+}
+
+// projected location, half length and half width, height of a block of boxes
+struct blockTerms_t {
+    // location plus and minus the half length (corners 0, 1, 4, 5 and 2, 3, 6, 7)
+    float fu[BLOCK], fv[BLOCK], fw[BLOCK], bu[BLOCK], bv[BLOCK], bw[BLOCK];
+    float wu[BLOCK], wv[BLOCK], ww[BLOCK], hu[BLOCK], hv[BLOCK], hw[BLOCK];
+};
+
+/*
+    Bottom corner base + sw * half width and the top corner above it (plus
+    the height): sw is a constant once inlined, so each coordinate is two
+    or three additions, and with restrict outputs the loop vectorizes
+    without alias checks.
+*/
+static inline void cornerPair(const int m, const float *bu, const float *bv, const float *bw,
+                              const blockTerms_t &t, const float sw,
+                              float * __restrict u0, float * __restrict v0,
+                              float * __restrict u1, float * __restrict v1) {
+    for(int i=0; i<m; i++) {
+        const float nu = bu[i] + sw * t.wu[i], nv = bv[i] + sw * t.wv[i], nw = bw[i] + sw * t.ww[i];
+        const float inv0 = 1.0f / nw, inv1 = 1.0f / (nw + t.hw[i]);
+        u0[i] = nu * inv0;
+        v0[i] = nv * inv0;
+        u1[i] = (nu + t.hu[i]) * inv1;
+        v1[i] = (nv + t.hv[i]) * inv1;
+    }
+}
+
+/*
+    The projection is linear before the division, so every corner of a box
+    is the projected location plus the signed projections of the three half
+    axes (length and width rotated around Y, height). Those terms are
+    computed for a block of m boxes into local arrays, which cannot alias
+    the outputs, then the corners are summed from them a pair at a time.
+*/
+static void projectBlock(const int m, const int n, const float *P,
+                         const float *h, const float *w, const float *l,
+                         const float *x, const float *y, const float *z, const float *rot,
+                         float *u, float *v) {
+    const float p00 = P[0], p01 = P[1], p02 = P[2],  p03 = P[3];
+    const float p10 = P[4], p11 = P[5], p12 = P[6],  p13 = P[7];
+    const float p20 = P[8], p21 = P[9], p22 = P[10], p23 = P[11];
+    blockTerms_t t;
+    for(int i=0; i<m; i++) {
+        float s, c;
+        sinCos(rot[i], s, c);
+        const float lx = 0.5f * l[i] * c, lz = -0.5f * l[i] * s;
+        const float wx = 0.5f * w[i] * s, wz =  0.5f * w[i] * c;
+        const float cu = p00 * x[i] + p01 * y[i] + p02 * z[i] + p03;
+        const float cv = p10 * x[i] + p11 * y[i] + p12 * z[i] + p13;
+        const float cw = p20 * x[i] + p21 * y[i] + p22 * z[i] + p23;
+        const float lu = p00 * lx + p02 * lz, lv = p10 * lx + p12 * lz, lw = p20 * lx + p22 * lz;
+        t.fu[i] = cu + lu;
+        t.fv[i] = cv + lv;
+        t.fw[i] = cw + lw;
+        t.bu[i] = cu - lu;
+        t.bv[i] = cv - lv;
+        t.bw[i] = cw - lw;
+        t.wu[i] = p00 * wx + p02 * wz;
+        t.wv[i] = p10 * wx + p12 * wz;
+        t.ww[i] = p20 * wx + p22 * wz;
+        t.hu[i] = -p01 * h[i];
+        t.hv[i] = -p11 * h[i];
+        t.hw[i] = -p21 * h[i];
+    }
+    // corner k and k + 4: (+l, +w), (+l, -w), (-l, -w), (-l, +w)
+    cornerPair(m, t.fu, t.fv, t.fw, t,  1, u,       v,       u + 4*n, v + 4*n);
+    cornerPair(m, t.fu, t.fv, t.fw, t, -1, u + n,   v + n,   u + 5*n, v + 5*n);
+    cornerPair(m, t.bu, t.bv, t.bw, t, -1, u + 2*n, v + 2*n, u + 6*n, v + 6*n);
+    cornerPair(m, t.bu, t.bv, t.bw, t,  1, u + 3*n, v + 3*n, u + 7*n, v + 7*n);
+}
+
+void BoxProjector::clear() {
+    n = 0;
+    boxes = 0;
+}
+
+void BoxProjector::reserve(const int n) {
+    if(n > capacity) {
+        for(std::vector<float> *c: { &dim_h, &dim_w, &dim_l, &loc_x, &loc_y, &loc_z, &rot_y })
+            c->resize(n);
+        capacity = n;
+    }
+    pu.reserve(8*n);
+    pv.reserve(8*n);
+}
+
+void BoxProjector::project(const float *calib) {
+    n = boxes;
+    pu.resize(8*n);
+    pv.resize(8*n);
+    for(int i=0; i<n; i+=BLOCK)
+        projectBlock(std::min(BLOCK, n - i), n, calib, dim_h.data() + i, dim_w.data() + i, dim_l.data() + i,
+                     loc_x.data() + i, loc_y.data() + i, loc_z.data() + i, rot_y.data() + i,
+                     pu.data() + i, pv.data() + i);
+}
+
+void BoxProjector::corners(const int i, std::vector<float> &out) const {
+    out.resize(16);
+    for(int k=0; k<8; k++) {
+        out[2*k]     = pu[k*n + i];
+        out[2*k + 1] = pv[k*n + i];
+    }
+}
+
+}}
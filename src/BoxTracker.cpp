@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <cmath>
+
+#include "BoxTracker.h"
+
+namespace tk { namespace dnn {
+
+void boxKalman::add(const float cx, const float cy, const float w, const float h) {
+    const float z[DIMS] = { cx, cy, w, h };
+    const float sp = 2*std_pos*h, sv = 10*std_vel*h;
+    for(int d=0; d<DIMS; d++) {
+        pos[d].push_back(z[d]);
+        vel[d].push_back(0);
+        p_pp[d].push_back(sp*sp);
+        p_pv[d].push_back(0);
+        p_vv[d].push_back(sv*sv);
+    }
+}
+
+void boxKalman::remove(const int i) {
+    for(int d=0; d<DIMS; d++) {
+        for(std::vector<float> *c: { &pos[d], &vel[d], &p_pp[d], &p_pv[d], &p_vv[d] }) {
+            (*c)[i] = c->back();
+            c->pop_back();
+        }
+    }
+}
+
+void boxKalman::clear() {
+    for(int d=0; d<DIMS; d++)
+        for(std::vector<float> *c: { &pos[d], &vel[d], &p_pp[d], &p_pv[d], &p_vv[d] })
+            c->clear();
+}
+
+void boxKalman::reserve(const int n) {
+    for(int d=0; d<DIMS; d++)
+        for(std::vector<float> *c: { &pos[d], &vel[d], &p_pp[d], &p_pv[d], &p_vv[d] })
+            c->reserve(n);
+}
+
+void boxKalman::predict() {
+    const int n = count();
+    const float *h = pos[3].data();
+    // the height is the last one, so all the coordinates use the noise of the previous height
+    for(int d=0; d<DIMS; d++) {
+        float *x = pos[d].data(), *v = vel[d].data();
+        float *pp = p_pp[d].data(), *pv = p_pv[d].data(), *vv = p_vv[d].data();
+        for(int i=0; i<n; i++) {
+            const float qp = std_pos*h[i], qv = std_vel*h[i];
+            x[i] += v[i];
+            pp[i] += 2*pv[i] + vv[i] + qp*qp;
+            pv[i] += vv[i];
+            vv[i] += qv*qv;
+        }
+    }
+}
+
+void boxKalman::update(const int i, const float cx, const float cy, const float w, const float h) {
+    const float z[DIMS] = { cx, cy, w, h };
+    const float sr = std_pos*pos[3][i];
+    const float r = sr*sr;
+    for(int d=0; d<DIMS; d++) {
+        const float pp = p_pp[d][i], pv = p_pv[d][i];
+        const float s = pp + r;
+        const float k0 = pp / s, k1 = pv / s;
+        const float y = z[d] - pos[d][i];
+        pos[d][i] += k0*y;
+        vel[d][i] += k1*y;
+        p_pp[d][i] = (1 - k0)*pp;
+        p_pv[d][i] = (1 - k0)*pv;
+        p_vv[d][i] -= k1*pv;
+    }
+}
+
+BoxTracker::BoxTracker(const int reserve_tracks) {
+    kf.reserve(reserve_tracks);
+    id.reserve(reserve_tracks);
+    cl.reserve(reserve_tracks);
+    hits.reserve(reserve_tracks);
+    lost.reserve(reserve_tracks);
+    score.reserve(reserve_tracks);
+    state.reserve(reserve_tracks);
+    det_of.reserve(reserve_tracks);
+    tracked.reserve(reserve_tracks);
+
+    // per frame buffers, for as many detections as tracks
+    high.reserve(reserve_tracks);
+    low.reserve(reserve_tracks);
+    candidates.reserve(reserve_tracks);
+    det_used.reserve(reserve_tracks);
+    det_track.reserve(reserve_tracks);
+    track_det.reserve(reserve_tracks);
+    for(std::vector<float> *c: { &det_x0, &det_y0, &det_x1, &det_y1, &det_area })
+        c->reserve(reserve_tracks);
+    det_cl.reserve(reserve_tracks);
+    grid.reserve(reserve_tracks);
+    matcher.reserve(reserve_tracks, reserve_tracks, 8*reserve_tracks);
+}
+
+void BoxTracker::addTrack(const tk::dnn::box &d) {
+    kf.add(d.x + d.w*0.5f, d.y + d.h*0.5f, d.w, d.h);
+    id.push_back(next_id++);
+    cl.push_back(d.cl);
+    hits.push_back(1);
+    lost.push_back(0);
+    score.push_back(d.prob);
+    // the tracks of the first frame are confirmed, as there is nothing to confirm them
+    state.push_back(frame_id == 1 || minHits <= 1 ? TRACK_TRACKED : TRACK_NEW);
+    det_of.push_back(-1);
+}
+
+void BoxTracker::removeTrack(const int i) {
+    kf.remove(i);
+    const int last = count();
+    id[i] = id[last];           id.pop_back();
+    cl[i] = cl[last];           cl.pop_back();
+    hits[i] = hits[last];       hits.pop_back();
+    lost[i] = lost[last];       lost.pop_back();
+    score[i] = score[last];     score.pop_back();
+    state[i] = state[last];     state.pop_back();
+    det_of[i] = det_of[last];   det_of.pop_back();
+}
+
+void BoxTracker::clear() {
+    kf.clear();
+    id.clear();
+    cl.clear();
+    hits.clear();
+    lost.clear();
+    score.clear();
+    state.clear();
+    det_of.clear();
+    tracked.clear();
+}
+
+void BoxTracker::associate(const std::vector<tk::dnn::box> &dets, const std::vector<int> &det_idx,
+                           const bool low_tier, const float min_iou) {
+    const int n_dets = det_idx.size();
+    if(n_dets == 0)
+        return;
+
+    candidates.clear();
+    for(int t=0; t<count(); t++)
+        if(det_of[t] == -1 && (!low_tier || state[t] == TRACK_TRACKED))
+            candidates.push_back(t);
+    if(candidates.empty())
+        return;
+
+    // corners, area and class of the detections, in the order of det_idx
+    det_x0.resize(n_dets);
+    det_y0.resize(n_dets);
+    det_x1.resize(n_dets);
+    det_y1.resize(n_dets);
+    det_area.resize(n_dets);
+    det_cl.resize(n_dets);
+    float size = 0, max_half_w = 0, max_half_h = 0;
+    for(int k=0; k<n_dets; k++) {
+        const tk::dnn::box &d = dets[det_idx[k]];
+        det_x0[k] = d.x;
+        det_y0[k] = d.y;
+        det_x1[k] = d.x + d.w;
+        det_y1[k] = d.y + d.h;
+        det_area[k] = d.w*d.h;
+        det_cl[k] = d.cl;
+        size += d.w + d.h;
+        max_half_w = std::max(max_half_w, d.w*0.5f);
+        max_half_h = std::max(max_half_h, d.h*0.5f);
+    }
+    grid.clear(size / (2*n_dets));
+    for(int k=0; k<n_dets; k++)
+        grid.add((det_x0[k] + det_x1[k])*0.5f, (det_y0[k] + det_y1[k])*0.5f);
+    grid.build();
+
+    // overlapping boxes have the centers closer than the sum of the half
+    // sizes on both axes, the other detections are not even visited
+    const float cost_limit = 1 - min_iou;
+    matcher.clear(candidates.size(), n_dets);
+    for(size_t c=0; c<candidates.size(); c++) {
+        const int t = candidates[c];
+        const int t_cl = cl[t];
+        const float cx = kf.pos[0][t], cy = kf.pos[1][t];
+        const float w = std::max(kf.pos[2][t], 0.0f), h = std::max(kf.pos[3][t], 0.0f);
+        const float x0 = cx - w*0.5f, y0 = cy - h*0.5f, x1 = cx + w*0.5f, y1 = cy + h*0.5f;
+        const float area = w*h;
+
+        grid.queryBox(cx, cy, w*0.5f + max_half_w, h*0.5f + max_half_h, [&](const int k) {
+            if(perClass && det_cl[k] != t_cl)
+                return;
+            const float iw = std::min(x1, det_x1[k]) - std::max(x0, det_x0[k]);
+            const float ih = std::min(y1, det_y1[k]) - std::max(y0, det_y0[k]);
+            if(iw <= 0 || ih <= 0)
+                return;
+            const float inter = iw*ih;
+            const float cost = 1 - inter / (area + det_area[k] - inter);
+            if(cost < cost_limit)
+                matcher.addPair(c, k, cost);
+        });
+    }
+    matcher.solve(matchMode, cost_limit, det_track, track_det);
+
+    for(int k=0; k<n_dets; k++) {
+        if(det_track[k] == -1)
+            continue;
+        const int t = candidates[det_track[k]];
+        const tk::dnn::box &d = dets[det_idx[k]];
+        kf.update(t, d.x + d.w*0.5f, d.y + d.h*0.5f, d.w, d.h);
+        det_of[t] = det_idx[k];
+        score[t] = d.prob;
+        det_used[det_idx[k]] = 1;
+    }
+}
+
+void BoxTracker::update(const std::vector<tk::dnn::box> &dets) {
+    frame_id++;
+    kf.predict();
+    std::fill(det_of.begin(), det_of.end(), -1);
+
+    high.clear();
+    low.clear();
+    for(size_t i=0; i<dets.size(); i++) {
+        if(dets[i].prob >= highThresh)
+            high.push_back(i);
+        else if(dets[i].prob >= lowThresh)
+            low.push_back(i);
+    }
+    det_used.assign(dets.size(), 0);
+
+    associate(dets, high, false, matchIoU);
+    associate(dets, low, true, lowMatchIoU);
+
+    // lifecycle, the rows moved from the end are already checked
+    for(int t=count()-1; t>=0; t--) {
+        if(det_of[t] != -1) {
+            hits[t]++;
+            lost[t] = 0;
+            if(state[t] == TRACK_LOST || hits[t] >= minHits)
+                state[t] = TRACK_TRACKED;
+        } else if(state[t] == TRACK_NEW || ++lost[t] > maxLost) {
+            removeTrack(t);
+        } else {
+            state[t] = TRACK_LOST;
+        }
+    }
+
+    for(int i: high)
+        if(!det_used[i] && dets[i].prob >= newThresh)
+            addTrack(dets[i]);
+
+    fillTracked(false);
+}
+
+void BoxTracker::predict(const bool unconfirmed) {
+    frame_id++;
+    kf.predict();
+    fillTracked(unconfirmed);
+}
+
+void BoxTracker::fillTracked(const bool unconfirmed) {
+    tracked.clear();
+    for(int t=0; t<count(); t++) {
+        if(lost[t] != 0 || (state[t] == TRACK_NEW && !unconfirmed))
+            continue;
+        const float w = kf.pos[2][t], h = kf.pos[3][t];
+        tracked.push_back(trackedBox{ id[t], cl[t], score[t],
+                                      kf.pos[0][t] - w*0.5f, kf.pos[1][t] - h*0.5f, w, h,
+                                      kf.vel[0][t], kf.vel[1][t] });
+    }
+}
+
+float BoxTracker::uncertainty() const {
+    float res = 0;
+    for(int t=0; t<count(); t++) {
+        if(state[t] != TRACK_TRACKED || lost[t] != 0 || kf.pos[3][t] <= 0)
+            continue;
+        const float var = std::max(kf.p_pp[0][t], kf.p_pp[1][t]);
+        res = std::max(res, std::sqrt(var) / kf.pos[3][t]);
+    }
+    return res;
+}
+
+}}
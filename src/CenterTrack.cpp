@@ -64,6 +64,19 @@ bool CenterTrack::init_preprocessing(){
 }
 
 bool CenterTrack::init_pre_inf(){
+    preHm.resize(nBatches);
+    for(auto &r: preHm)
+        r.init(dim.w, dim.h);
+    hmStream = -1;
+
+    // the engine contains the pre-phase convolutions, only its inputs are filled
+    if(netRT->input_dim.c == 7) {
+        fusedPre = true;
+        hasPrevImg.assign(nBatches, 0);
+        checkCuda( cudaMemset(input_d, 0, sizeof(dnnType)*netRT->input_dim.tot() * nBatches) );
+        return true;
+    }
+
     // initial steps: the first part of the network
     const char *pre_img_conv1_bin = "dla34_ctrack/layers/base-pre_img_layer-0.bin";
     const char *pre_hm_conv1_bin  = "dla34_ctrack/layers/base-pre_hm_layer-0.bin";
@@ -202,8 +215,11 @@ bool CenterTrack::init_postprocessing(){
     checkCuda( cudaMalloc(&ids_out, K *sizeof(int)) );
 
     trRes.resize(nBatches);
-    countTr.resize(nBatches, 0);
-    trackId.resize(nBatches, 0);
+    for(auto &t: trRes)
+        t.reserve(K);
+    detRes.reserve(K);
+    detTrack.reserve(K);
+    trackDet.reserve(K);
     return true;
 }
 
@@ -249,28 +265,7 @@ bool CenterTrack::init_visualization(const int n_classes){
         trColors[c] = cv::Scalar(int(255.0*b), int(255.0*g), int(255.0*r));
     }
 
-    r = cv::Mat(cv::Size(3,3), CV_32F);
-    r.at<float>(0,1) = 0.0;
-    r.at<float>(1,0) = 0.0;
-    r.at<float>(1,1) = 1.0;
-    r.at<float>(1,2) = 0.0;
-    r.at<float>(2,1) = 0.0;
-                        
-    corners = cv::Mat(cv::Size(8,3), CV_32F);
-    corners.at<float>(1,0) = 0.0;
-    corners.at<float>(1,1) = 0.0;
-    corners.at<float>(1,2) = 0.0;
-    corners.at<float>(1,3) = 0.0;
-
-    pts3DHomo = cv::Mat(cv::Size(8,4), CV_32F);
-    pts3DHomo.at<float>(3,0) = 1.0;
-    pts3DHomo.at<float>(3,1) = 1.0;
-    pts3DHomo.at<float>(3,2) = 1.0;
-    pts3DHomo.at<float>(3,3) = 1.0;
-    pts3DHomo.at<float>(3,4) = 1.0;
-    pts3DHomo.at<float>(3,5) = 1.0;
-    pts3DHomo.at<float>(3,6) = 1.0;
-    pts3DHomo.at<float>(3,7) = 1.0;
+    proj.reserve(K);
 
     faceId.push_back({0,1,5,4});
     faceId.push_back({1,2,6, 5});
@@ -295,6 +290,30 @@ void CenterTrack::pre_inf(const int bi){
     checkCuda( cudaDeviceSynchronize() );
 }
 
+void CenterTrack::renderPreHm(const int bi){
+    // peaks of the tracks of the previous frame, in input coordinates
+    HeatmapRenderer &r = preHm[bi];
+    r.begin();
+    const trackTable &tr = trRes[bi];
+    for(int i=0; i<tr.count(); i++) {
+        const detectionRes &d = tr.det[i];
+        if(d.score > preThresh)
+            r.splat((d.bb0[0] + d.bb1[0]) / 2, (d.bb0[1] + d.bb1[1]) / 2, d.bb1[0] - d.bb0[0], d.bb1[1] - d.bb0[1]);
+    }
+
+    // only the changed rows are uploaded, unless hm_d holds another stream
+    int y0 = 0, y1 = dim.h;
+    dnnType *hm = fusedPre ? input_d + netRT->input_dim.tot()*bi + 6*dim.h*dim.w : hm_d;
+    if((fusedPre || hmStream == bi) && !r.changedRows(y0, y1))
+        return;
+    if(!fusedPre && hmStream != bi) {
+        y0 = 0;
+        y1 = dim.h;
+        hmStream = bi;
+    }
+    checkCuda( cudaMemcpy(hm + y0*dim.w, r.data() + y0*dim.w, (y1 - y0)*dim.w*sizeof(dnnType), cudaMemcpyHostToDevice) );
+}
+
 void CenterTrack::preprocess(cv::Mat &frame, const int bi){
     cv::Size sz = originalSize[bi];
     // float scale = 1.0;
@@ -398,6 +417,17 @@ void CenterTrack::preprocess(cv::Mat &frame, const int bi){
 
 #endif
 
+    renderPreHm(bi);
+    if(fusedPre) {
+        // input channels: image, previous image (the same on the first frame), previous heatmap
+        const int hw = dim.h * dim.w;
+        dnnType *in = input_d + netRT->input_dim.tot()*bi;
+        checkCuda( cudaMemcpy(in + 3*hw, hasPrevImg[bi] ? in : input_pre_inf_d, 3*hw*sizeof(dnnType), cudaMemcpyDeviceToDevice) );
+        checkCuda( cudaMemcpy(in, input_pre_inf_d, 3*hw*sizeof(dnnType), cudaMemcpyDeviceToDevice) );
+        hasPrevImg[bi] = 1;
+        return;
+    }
+
     if(iter0) {
         checkCuda( cudaMemcpy(img_d, input_pre_inf_d, dim.tot()*sizeof(dnnType), cudaMemcpyDeviceToDevice) );
         checkCuda( cudaDeviceSynchronize() );
@@ -409,201 +439,125 @@ void CenterTrack::preprocess(cv::Mat &frame, const int bi){
     checkCuda( cudaDeviceSynchronize() );
 }
 
-cv::Mat CenterTrack::transform_preds_with_trans(float x1, float x2){
-    cv::Mat target_coords(cv::Size(1,3), CV_32F);
-    target_coords.at<float>(0,0) = x1;
-    target_coords.at<float>(0,1) = x2;
-    target_coords.at<float>(0,2) = 1.0;
-    return transOut * target_coords;
+void CenterTrack::transform_preds_with_trans(float x1, float x2, float *out){
+    const float *t = transOut.ptr<float>(0);
+    out[0] = t[0]*x1 + t[1]*x2 + t[2];
+    out[1] = t[3]*x1 + t[4]*x2 + t[5];
 }
 
-void CenterTrack::tracking(const int bi) {
-    std::vector<float> item_size(countDet);
-    std::vector<int> item_cl(countDet);
-    std::vector<float> dets(2*countDet);
-    for(int i=0; i<countDet; i++){
-        item_size[i] = (detRes[i].bb1.at<float>(0,0) - detRes[i].bb0.at<float>(0,0)) * 
-                       (detRes[i].bb1.at<float>(0,1) - detRes[i].bb0.at<float>(0,1));
-        item_cl[i]   =  detRes[i].cl;
-        dets[i*2]    =  detRes[i].ct.at<float>(0,0);
-        dets[i*2+1]  =  detRes[i].ct.at<float>(0,1);
-    }
-    
-    std::vector<float> track_size(countTr[bi]);
-    std::vector<int> track_cl(countTr[bi]);
-    std::vector<float> tracks(2*countTr[bi]);
-    for(int i=0; i<countTr[bi]; i++){
-        track_size[i] = (trRes[bi][i].det_res.bb1.at<float>(0,0) - trRes[bi][i].det_res.bb0.at<float>(0,0)) * 
-                        (trRes[bi][i].det_res.bb1.at<float>(0,1) - trRes[bi][i].det_res.bb0.at<float>(0,1));
-        track_cl[i]   =  trRes[bi][i].det_res.cl;
-        tracks[i*2]   =  trRes[bi][i].det_res.ct.at<float>(0,0);
-        tracks[i*2+1] =  trRes[bi][i].det_res.ct.at<float>(0,1);
-    } 
-    std::vector<float> dist(countTr[bi]*countDet);
-    bool invalid;
-    for(int i=0; i<countTr[bi]; i++){
-        for(int j=0; j<countDet; j++){
-            dist[j*countTr[bi]+i] =  pow((tracks[i*2] - dets[j*2]), 2) + 
-                                     pow((tracks[i*2+1] - dets[j*2+1]), 2);
-            invalid               =  dist[j*countTr[bi]+i] > track_size[i] || 
-                                     dist[j*countTr[bi]+i] > item_size[j] || 
-                                     item_cl[j] != track_cl[i];
-            dist[j*countTr[bi]+i] = dist[j*countTr[bi]+i] + invalid * (1 << 18);
-        }
-    }
-    std::vector<int> matched_indices(2*countTr[bi]);
-    float min_tr;
-    int min_idtr = -1;
-    for(int i=0; i<countTr[bi]; i++) {
-        matched_indices[i*2]    = -1;
-        matched_indices[i*2+1]  = -1;
-    }
-    for(int i=0; i<countDet; i++){
-        min_tr=(1 << 18);
-        for(int j=0; j<countTr[bi]; j++){
-            if(dist[i*countTr[bi]+j]<min_tr) {
-                min_tr   = dist[i*countTr[bi]+j];
-                min_idtr = j;
-            }
-        }
-        if(min_tr < (1<<16)) {
-            for(int j=0; j<countDet; j++)
-                dist[j*countTr[bi]+min_idtr] = (1 << 18);
-            matched_indices[2*min_idtr]   = min_idtr;
-            matched_indices[2*min_idtr+1] = i;
-        }
+void trackTable::add(const detectionRes &d, const int color) {
+    ct_x.push_back(d.ct[0]);
+    ct_y.push_back(d.ct[1]);
+    area.push_back(d.area());
+    cl.push_back(d.cl);
+    det.push_back(d);
+    tracking_id.push_back(next_id++);
+    age.push_back(1);
+    active.push_back(1);
+    this->color.push_back(color);
+}
+
+void trackTable::update(const int i, const detectionRes &d) {
+    ct_x[i] = d.ct[0];
+    ct_y[i] = d.ct[1];
+    area[i] = d.area();
+    cl[i]   = d.cl;
+    det[i]  = d;
+    // tracking_id and color are the same
+    age[i]  = 1;
+    active[i]++;
+}
+
+void trackTable::remove(const int i) {
+    const int last = count() - 1;
+    if(i != last) {
+        ct_x[i]        = ct_x[last];
+        ct_y[i]        = ct_y[last];
+        area[i]        = area[last];
+        cl[i]          = cl[last];
+        det[i]         = det[last];
+        tracking_id[i] = tracking_id[last];
+        age[i]         = age[last];
+        active[i]      = active[last];
+        color[i]       = color[last];
     }
-    
-    std::vector<bool> unmatched_dets(countDet);
+    ct_x.pop_back();
+    ct_y.pop_back();
+    area.pop_back();
+    cl.pop_back();
+    det.pop_back();
+    tracking_id.pop_back();
+    age.pop_back();
+    active.pop_back();
+    color.pop_back();
+}
+
+void trackTable::clear() {
+    ct_x.clear();
+    ct_y.clear();
+    area.clear();
+    cl.clear();
+    det.clear();
+    tracking_id.clear();
+    age.clear();
+    active.clear();
+    color.clear();
+}
+
+void trackTable::reserve(const int n) {
+    ct_x.reserve(n);
+    ct_y.reserve(n);
+    area.reserve(n);
+    cl.reserve(n);
+    det.reserve(n);
+    tracking_id.reserve(n);
+    age.reserve(n);
+    active.reserve(n);
+    color.reserve(n);
+}
+
+void CenterTrack::tracking(const int bi) {
+    trackTable &tr = trRes[bi];
+    const int countTr = tr.count();
+
+    // a track and a detection can be matched if they have the same class and
+    // their squared distance is within the area of both, the cost is the distance.
+    // The detections are indexed in a grid with cells of their mean radius,
+    // so each track only visits the near ones
+    float mean_radius = 0;
+    for(int i=0; i<countDet; i++)
+        mean_radius += sqrt(detRes[i].area());
+    grid.clear(countDet > 0 ? mean_radius / countDet : 1);
     for(int i=0; i<countDet; i++)
-        unmatched_dets[i] = false;
-    std::vector<bool> unmatched_tracks(countTr[bi]);
-    for(int i=0; i<countTr[bi]; i++) 
-        unmatched_tracks[i] = false;
-    for(int i=0; i<countTr[bi]; i++) {
-        if(matched_indices[2*i] != -1)
-            unmatched_tracks[matched_indices[2*i]]=true;
-        if(matched_indices[2*i+1] != -1)
-            unmatched_dets[matched_indices[2*i+1]]=true;        
+        grid.add(detRes[i].ct[0], detRes[i].ct[1]);
+    grid.build();
+
+    matcher.clear(countTr, countDet);
+    for(int j=0; j<countTr; j++){
+        grid.query(tr.ct_x[j], tr.ct_y[j], sqrt(tr.area[j]), [&](const int i, const float dist) {
+            const detectionRes &d = detRes[i];
+            if(tr.cl[j] == d.cl && dist <= tr.area[j] && dist <= d.area())
+                matcher.addPair(j, i, dist);
+        });
     }
+    matcher.solve(matchMode, (1 << 16), detTrack, trackDet);
 
     //match
-    for(int i=0; i<countTr[bi]; i++) {
-        if(matched_indices[2*i+1] != -1 && matched_indices[2*i] != -1) { //second condition is optional
-            int tr_id = matched_indices[2*i];
-            int d_id  = matched_indices[2*i+1];
-            
-            // trRes[tr_id].det_res = detRes[d_id];
-            trRes[bi][tr_id].det_res.score  = detRes[d_id].score;
-            trRes[bi][tr_id].det_res.cl     = detRes[d_id].cl;
-            trRes[bi][tr_id].det_res.ct     = detRes[d_id].ct;
-            trRes[bi][tr_id].det_res.tr     = detRes[d_id].tr;
-            trRes[bi][tr_id].det_res.bb0    = detRes[d_id].bb0;
-            trRes[bi][tr_id].det_res.bb1    = detRes[d_id].bb1;
-            trRes[bi][tr_id].det_res.dep    = detRes[d_id].dep;
-            trRes[bi][tr_id].det_res.dim[0] = detRes[d_id].dim[0];
-            trRes[bi][tr_id].det_res.dim[1] = detRes[d_id].dim[1];
-            trRes[bi][tr_id].det_res.dim[2] = detRes[d_id].dim[2];
-            trRes[bi][tr_id].det_res.alpha  = detRes[d_id].alpha;
-            trRes[bi][tr_id].det_res.x      = detRes[d_id].x;
-            trRes[bi][tr_id].det_res.y      = detRes[d_id].y;
-            trRes[bi][tr_id].det_res.z      = detRes[d_id].z;
-            trRes[bi][tr_id].det_res.rot_y  = detRes[d_id].rot_y;
-            // trRes[bi][matched_indices[2*i]].tracking_id = ; is the same 
-            // trRes[bi][matched_indices[2*i]].color = ; is the same
-            trRes[bi][tr_id].age            = 1; 
-            trRes[bi][tr_id].active         = trRes[bi][tr_id].active+1;
-        }
-    }
-    //delete target umatched track
-    int new_count_tr = 0;
-    for(int i=0; i<countTr[bi]; i++) {
-        if(unmatched_tracks[i]) 
-            new_count_tr++;
-    }
-    if(new_count_tr == 0 && countTr[bi] != 0) {        //reset
-        trRes[bi].clear();
-        countTr[bi] = 0;
-    }
-    int old_count_tr = countTr[bi];
-    if(countTr[bi] != 0 && new_count_tr != countTr[bi]) {
-        std::vector<struct trackingRes> new_tr_res;
-        int id_new_tr=0;
-        for(int i=0; i<countTr[bi]; i++) {
-            if(unmatched_tracks[i]) {
-                struct trackingRes new_tr_res_;
-                // new_tr_res_new_det_res.det_res = trRes[i].det_res;
-                new_tr_res_.det_res.score   = trRes[bi][i].det_res.score;
-                new_tr_res_.det_res.cl      = trRes[bi][i].det_res.cl;
-                new_tr_res_.det_res.ct      = trRes[bi][i].det_res.ct;
-                new_tr_res_.det_res.tr      = trRes[bi][i].det_res.tr;
-                new_tr_res_.det_res.bb0     = trRes[bi][i].det_res.bb0;
-                new_tr_res_.det_res.bb1     = trRes[bi][i].det_res.bb1;
-                new_tr_res_.det_res.dep     = trRes[bi][i].det_res.dep;
-                new_tr_res_.det_res.dim[0]  = trRes[bi][i].det_res.dim[0];
-                new_tr_res_.det_res.dim[1]  = trRes[bi][i].det_res.dim[1];
-                new_tr_res_.det_res.dim[2]  = trRes[bi][i].det_res.dim[2];
-                new_tr_res_.det_res.alpha   = trRes[bi][i].det_res.alpha;
-                new_tr_res_.det_res.x       = trRes[bi][i].det_res.x;
-                new_tr_res_.det_res.y       = trRes[bi][i].det_res.y;
-                new_tr_res_.det_res.z       = trRes[bi][i].det_res.z;
-                new_tr_res_.det_res.rot_y   = trRes[bi][i].det_res.rot_y;
-                new_tr_res_.tracking_id     = trRes[bi][i].tracking_id;
-                new_tr_res_.age             = trRes[bi][i].age;
-                new_tr_res_.active          = trRes[bi][i].active;
-                new_tr_res_.color           = trRes[bi][i].color;
-                id_new_tr ++;
-                new_tr_res.push_back(new_tr_res_);
-            }
-        }
-        
-        if(countTr[bi]) {
-            trRes[bi].clear();
-        }
-        countTr[bi] = new_count_tr;
-        trRes[bi] = new_tr_res;
-    }
-    
-    int count_tr_ = countTr[bi];
-    for(int i=0; i<countDet; i++) {
-        if((!unmatched_dets[i]) && detRes[i].score > newThresh) {
-            count_tr_ ++;
-            struct trackingRes new_tr_res_;
-            new_tr_res_.det_res.score   = detRes[i].score;
-            new_tr_res_.det_res.cl      = detRes[i].cl;
-            new_tr_res_.det_res.ct      = detRes[i].ct;
-            new_tr_res_.det_res.tr      = detRes[i].tr;
-            new_tr_res_.det_res.bb0     = detRes[i].bb0;
-            new_tr_res_.det_res.bb1     = detRes[i].bb1;
-            new_tr_res_.det_res.dep     = detRes[i].dep;
-            new_tr_res_.det_res.dim[0]  = detRes[i].dim[0];
-            new_tr_res_.det_res.dim[1]  = detRes[i].dim[1];
-            new_tr_res_.det_res.dim[2]  = detRes[i].dim[2];
-            new_tr_res_.det_res.alpha   = detRes[i].alpha;
-            new_tr_res_.det_res.x       = detRes[i].x;
-            new_tr_res_.det_res.y       = detRes[i].y;
-            new_tr_res_.det_res.z       = detRes[i].z;
-            new_tr_res_.det_res.rot_y   = detRes[i].rot_y;
-            new_tr_res_.tracking_id     = trackId[bi]++; 
-            new_tr_res_.age             = 1; 
-            new_tr_res_.active          = 1;
-            new_tr_res_.color           = rand() % 256;
-            if(trRes.size() <= bi) {
-                std::vector<struct trackingRes> v_new_tr_res_;
-                v_new_tr_res_.push_back(new_tr_res_);    
-                trRes.push_back(v_new_tr_res_);
-            }
-            else
-                trRes[bi].push_back(new_tr_res_);
-        }
-    }
+    for(int i=0; i<countDet; i++)
+        if(detTrack[i] != -1)
+            tr.update(detTrack[i], detRes[i]);
+
+    //delete unmatched tracks, the rows moved from the end are already checked
+    for(int j=countTr-1; j>=0; j--)
+        if(trackDet[j] == -1)
+            tr.remove(j);
+
+    //new tracks
+    for(int i=0; i<countDet; i++)
+        if(detTrack[i] == -1 && detRes[i].score > newThresh)
+            tr.add(detRes[i], rand() % 256);
 
-    countTr[bi] = count_tr_;
-    //reset the tracker id
-    if(trackId[bi] == 1000)
-        trackId[bi] = 0;
     detRes.clear();
-    
 }
 
 void CenterTrack::postprocess(const int bi, const bool mAP) {
@@ -704,13 +658,14 @@ void CenterTrack::postprocess(const int bi, const bool mAP) {
         new_det_res.cl = clses[i]+1; 
         // ret_s=scores[i];
         // ret_c=clses[i]+1;
-        new_det_res.ct     = transform_preds_with_trans(intxs[i], intys[i]);
-        new_det_res.tr     = transform_preds_with_trans(intxs[i] + track[i], intys[i] + track[i+K]);
-        new_det_res.tr     = new_det_res.tr -new_det_res.ct;
-        new_det_res.bb0    = transform_preds_with_trans(bbx0[i], bby0[i]);
-        new_det_res.bb1    = transform_preds_with_trans(bbx1[i], bby1[i]);
-        new_det_res.ct     = transform_preds_with_trans(((bbx0[i]+bbx1[i])/2 + amodel_offset[i]), 
-                                        ((bby0[i]+bby1[i])/2 + amodel_offset[i+K]));
+        transform_preds_with_trans(intxs[i], intys[i], new_det_res.ct);
+        transform_preds_with_trans(intxs[i] + track[i], intys[i] + track[i+K], new_det_res.tr);
+        new_det_res.tr[0]  = new_det_res.tr[0] - new_det_res.ct[0];
+        new_det_res.tr[1]  = new_det_res.tr[1] - new_det_res.ct[1];
+        transform_preds_with_trans(bbx0[i], bby0[i], new_det_res.bb0);
+        transform_preds_with_trans(bbx1[i], bby1[i], new_det_res.bb1);
+        transform_preds_with_trans(((bbx0[i]+bbx1[i])/2 + amodel_offset[i]), 
+                                   ((bby0[i]+bby1[i])/2 + amodel_offset[i+K]), new_det_res.ct);
         new_det_res.dep    = dep[i]; 
         new_det_res.dim[0] = dim_[i];
         new_det_res.dim[1] = dim_[i+K];
@@ -718,9 +673,9 @@ void CenterTrack::postprocess(const int bi, const bool mAP) {
         
         // unproject_2d_to_3d
         new_det_res.z = dep[i] - calibs[bi].at<float>(2,3);
-        new_det_res.x = ((float)new_det_res.ct.at<float>(0,0) * dep[i] - calibs[bi].at<float>(0,3) - 
+        new_det_res.x = ((float)new_det_res.ct[0] * dep[i] - calibs[bi].at<float>(0,3) - 
                         calibs[bi].at<float>(0,2) * new_det_res.z) / calibs[bi].at<float>(0,0);
-        new_det_res.y = ((float)new_det_res.ct.at<float>(0,1) * dep[i] - calibs[bi].at<float>(1,3) - 
+        new_det_res.y = ((float)new_det_res.ct[1] * dep[i] - calibs[bi].at<float>(1,3) - 
                         calibs[bi].at<float>(1,2) * new_det_res.z) / calibs[bi].at<float>(1,1) + (dim_[i] / 2);
         
         // alpha2rot_y
@@ -732,8 +687,9 @@ void CenterTrack::postprocess(const int bi, const bool mAP) {
             new_det_res.alpha = std::atan2(rot[2*K + i], rot[3*K + i]) -0.5 * M_PI;
         else
             new_det_res.alpha = std::atan2(rot[6*K + i], rot[7*K + i]) +0.5 * M_PI;
-        new_det_res.rot_y = (new_det_res.alpha + std::atan2((float)new_det_res.ct.at<float>(0,0) - calibs[bi].at<float>(0,2), calibs[bi].at<float>(0,0)));
-        new_det_res.ct    = new_det_res.ct + new_det_res.tr;   //dest  
+        new_det_res.rot_y = (new_det_res.alpha + std::atan2((float)new_det_res.ct[0] - calibs[bi].at<float>(0,2), calibs[bi].at<float>(0,0)));
+        new_det_res.ct[0] = new_det_res.ct[0] + new_det_res.tr[0];   //dest  
+        new_det_res.ct[1] = new_det_res.ct[1] + new_det_res.tr[1];
         detRes.push_back(new_det_res);    
     }    
     // track step
@@ -741,98 +697,62 @@ void CenterTrack::postprocess(const int bi, const bool mAP) {
 }
 
 void CenterTrack::draw(std::vector<cv::Mat>& frames) {
-    struct trackingRes t;
-    float sc;
-    int id;
+    int64_t id;
     std::string txt;
     int baseline = 0;
     float font_scale = 0.8;
     int thickness = 2;
+    std::vector<float> res_corners;
     
     for(int bi=0; bi<frames.size(); ++bi) {
         float scale_x = float(originalSize[bi].width)/dim.w;
         float scale_y = float(originalSize[bi].height)/dim.h;
         resize(frames[bi], frames[bi], originalSize[bi]);
+        // 3D boxes of all the drawn tracks, projected in one pass
+        projRow.assign(trRes.size() != 0 ? trRes[bi].count() : 0, -1);
+        if(mode3D && trRes.size() != 0) {
+            proj.clear();
+            for(int i=0; i<trRes[bi].count(); i++) {
+                const detectionRes &t = trRes[bi].det[i];
+                if(t.score > confThreshold && t.z > 1) {
+                    projRow[i] = proj.count();
+                    proj.add(t.dim[0], t.dim[1], t.dim[2], t.x, t.y, t.z, t.rot_y);
+                }
+            }
+            proj.project(calibs[bi].ptr<float>());
+        }
         // draw dets
-        for(int i=0; trRes.size() != 0 && i<trRes[bi].size(); i++) {
-            t = trRes[bi][i];
-            id = t.tracking_id;
-            txt = classesNames[t.det_res.cl-1]+'-'+std::to_string(id); //forse ha bisogno di cl-1
+        for(int i=0; trRes.size() != 0 && i<trRes[bi].count(); i++) {
+            const detectionRes &t = trRes[bi].det[i];
+            const int color = trRes[bi].color[i];
+            id = trRes[bi].tracking_id[i];
+            txt = classesNames[t.cl-1]+'-'+std::to_string(id); //forse ha bisogno di cl-1
             cv::Size text_size = getTextSize(txt, cv::FONT_HERSHEY_SIMPLEX, font_scale, thickness, &baseline);
             
-            if(t.det_res.score > confThreshold){// && t.active!=0) {
+            if(t.score > confThreshold){// && t.active!=0) {
                 if(!mode3D) {
                     cv::rectangle(frames[bi],  
-                                    cv::Point(t.det_res.bb0.at<float>(0,0) * scale_x, t.det_res.bb0.at<float>(0,1) * scale_y), 
-                                    cv::Point(t.det_res.bb1.at<float>(0,0) * scale_x, t.det_res.bb1.at<float>(0,1) * scale_y), 
-                                    trColors[t.color], thickness);                      
+                                    cv::Point(t.bb0[0] * scale_x, t.bb0[1] * scale_y), 
+                                    cv::Point(t.bb1[0] * scale_x, t.bb1[1] * scale_y), 
+                                    trColors[color], thickness);                      
                     cv::rectangle(frames[bi],  
-                                    cv::Point(t.det_res.bb0.at<float>(0,0) * scale_x, t.det_res.bb0.at<float>(0,1) * scale_y - text_size.height - thickness), 
-                                    cv::Point(t.det_res.bb0.at<float>(0,0) * scale_x + text_size.width, t.det_res.bb0.at<float>(0,1) * scale_y), 
-                                    trColors[t.color], -1);                      
+                                    cv::Point(t.bb0[0] * scale_x, t.bb0[1] * scale_y - text_size.height - thickness), 
+                                    cv::Point(t.bb0[0] * scale_x + text_size.width, t.bb0[1] * scale_y), 
+                                    trColors[color], -1);                      
                                         
                     cv::putText(frames[bi], txt, 
-                                    cv::Point(t.det_res.bb0.at<float>(0,0) * scale_x, t.det_res.bb0.at<float>(0,1) * scale_y - thickness -1), 
+                                    cv::Point(t.bb0[0] * scale_x, t.bb0[1] * scale_y - thickness -1), 
                                     cv::FONT_HERSHEY_SIMPLEX, font_scale, cv::Scalar(255, 255, 255), 1);
 
                     cv::arrowedLine(frames[bi], 
-                                    cv::Point((int)t.det_res.ct.at<float>(0,0) * scale_x, (int)t.det_res.ct.at<float>(0,1) * scale_y), 
-                                    cv::Point((int)(t.det_res.ct.at<float>(0,0) * scale_x + t.det_res.tr.at<float>(0,0) * scale_x),
-                                              (int)(t.det_res.ct.at<float>(0,1) * scale_y + t.det_res.tr.at<float>(0,1) * scale_y)),
+                                    cv::Point((int)t.ct[0] * scale_x, (int)t.ct[1] * scale_y), 
+                                    cv::Point((int)(t.ct[0] * scale_x + t.tr[0] * scale_x),
+                                              (int)(t.ct[1] * scale_y + t.tr[1] * scale_y)),
                                     cv::Scalar(255, 0, 255), 2);
                 }
                 //3d
-                if(mode3D && t.det_res.z > 1){
-                    r.at<float>(0,0) = std::cos(t.det_res.rot_y);
-                    r.at<float>(0,2) = std::sin(t.det_res.rot_y);
-                    r.at<float>(2,0) = -std::sin(t.det_res.rot_y);
-                    r.at<float>(2,2) = std::cos(t.det_res.rot_y);
-
-                    corners.at<float>(0,0) = t.det_res.dim[2]/2;
-                    corners.at<float>(0,1) = t.det_res.dim[2]/2;
-                    corners.at<float>(0,2) = -t.det_res.dim[2]/2;
-                    corners.at<float>(0,3) = -t.det_res.dim[2]/2;
-                    corners.at<float>(0,4) = t.det_res.dim[2]/2;
-                    corners.at<float>(0,5) = t.det_res.dim[2]/2;
-                    corners.at<float>(0,6) = -t.det_res.dim[2]/2;
-                    corners.at<float>(0,7) = -t.det_res.dim[2]/2;
-
-                    corners.at<float>(1,4) = -t.det_res.dim[0];
-                    corners.at<float>(1,5) = -t.det_res.dim[0];
-                    corners.at<float>(1,6) = -t.det_res.dim[0];
-                    corners.at<float>(1,7) = -t.det_res.dim[0];
-                    
-                    corners.at<float>(2,0) = t.det_res.dim[1]/2;
-                    corners.at<float>(2,1) = -t.det_res.dim[1]/2;
-                    corners.at<float>(2,2) = -t.det_res.dim[1]/2;
-                    corners.at<float>(2,3) = t.det_res.dim[1]/2;
-                    corners.at<float>(2,4) = t.det_res.dim[1]/2;
-                    corners.at<float>(2,5) = -t.det_res.dim[1]/2;
-                    corners.at<float>(2,6) = -t.det_res.dim[1]/2;
-                    corners.at<float>(2,7) = t.det_res.dim[1]/2;
-                    
-                    cv::Mat aus = r * corners;
-
-                    for(int k=0; k<8; k++) {
-                        aus.at<float>(0,k) += t.det_res.x;
-                        aus.at<float>(1,k) += t.det_res.y;
-                        aus.at<float>(2,k) += t.det_res.z;
-                    }
-                    
-                    // corners.copyTo(pts3DHomo(cv::Rect(0, 0, 8, 3)));
-                    for(int k1=0; k1<3; k1++) {
-                        for(int k2=0; k2<8; k2++)
-                            pts3DHomo.at<float>(k1,k2) = aus.at<float>(k1,k2); 
-                    }
-                    
-                    aus.release();
-                    aus = calibs[bi] * pts3DHomo;
-                    std::vector<float> res_corners;
-                    for(int k=0; k<8; k++) {
-                        res_corners.push_back(aus.at<float>(0,k) / aus.at<float>(2,k));
-                        res_corners.push_back(aus.at<float>(1,k) / aus.at<float>(2,k));
-                    }
-                    aus.release();
+                if(mode3D && t.z > 1){
+                    proj.corners(projRow[i], res_corners);
                     for(int ind_f=3; ind_f>=0; ind_f--) {
                         for(int j=0; j<4; j++) {
                             cv::line(frames[bi], 
@@ -840,18 +760,18 @@ void CenterTrack::draw(std::vector<cv::Mat>& frames) {
                                               (int)res_corners.at(faceId.at(ind_f).at(j) * 2 + 1) * scale_y),
                                     cv::Point((int)res_corners.at(faceId.at(ind_f).at((j+1)%4) * 2) * scale_x, 
                                               (int)res_corners.at(faceId.at(ind_f).at((j+1)%4) * 2 + 1) * scale_y), 
-                                     trColors[t.color], 2);
+                                     trColors[color], 2);
                             if(ind_f == 0 && j==3) {
                                 cv::line(frames[bi], 
                                         cv::Point((int)res_corners.at(faceId.at(ind_f).at(0) * 2) * scale_x, 
                                                   (int)res_corners.at(faceId.at(ind_f).at(0) * 2 + 1) * scale_y),
                                         cv::Point((int)res_corners.at(faceId.at(ind_f).at(2) * 2) * scale_x, 
-                                                  (int)res_corners.at(faceId.at(ind_f).at(2) * 2 + 1) * scale_y), trColors[t.color], 2);
+                                                  (int)res_corners.at(faceId.at(ind_f).at(2) * 2 + 1) * scale_y), trColors[color], 2);
                                 cv::line(frames[bi], 
                                         cv::Point((int)res_corners.at(faceId.at(ind_f).at(1) * 2) * scale_x, 
                                                   (int)res_corners.at(faceId.at(ind_f).at(1) * 2 + 1) * scale_y),
                                         cv::Point((int)res_corners.at(faceId.at(ind_f).at(3) * 2) * scale_x, 
-                                                  (int)res_corners.at(faceId.at(ind_f).at(3) * 2 + 1) * scale_y), trColors[t.color], 2);
+                                                  (int)res_corners.at(faceId.at(ind_f).at(3) * 2 + 1) * scale_y), trColors[color], 2);
                             }
                         }
                     }
@@ -871,11 +791,11 @@ void CenterTrack::draw(std::vector<cv::Mat>& frames) {
                     // cv::rectangle(frame,  
                     //             cv::Point(bb0, bb2), 
                     //             cv::Point(bb1, bb3), 
-                    //             trColors[t.color], thickness);                      
+                    //             trColors[color], thickness);                      
                     cv::rectangle(frames[bi],  
                                 cv::Point(bb0 * scale_x, bb2 * scale_y - text_size.height - thickness), 
                                 cv::Point(bb0 * scale_x + text_size.width, bb2 * scale_y), 
-                                trColors[t.color], -1);                      
+                                trColors[color], -1);                      
                                         
                     cv::putText(frames[bi], txt, 
                                 cv::Point(bb0 * scale_x, bb2 * scale_y - thickness -1), 
@@ -883,8 +803,8 @@ void CenterTrack::draw(std::vector<cv::Mat>& frames) {
 
                     cv::arrowedLine(frames[bi], 
                                 cv::Point((int)((bb0 + bb1)/2) * scale_x, (int)((bb2 + bb3)/2) * scale_y), 
-                                cv::Point((int)((bb0 + bb1)/2 + t.det_res.tr.at<float>(0,0)) * scale_x,
-                                          (int)((bb2 + bb3)/2 + t.det_res.tr.at<float>(0,1)) * scale_y),
+                                cv::Point((int)((bb0 + bb1)/2 + t.tr[0]) * scale_x,
+                                          (int)((bb2 + bb3)/2 + t.tr[1]) * scale_y),
                                 cv::Scalar(255, 0, 255), 2);
                 }
             }
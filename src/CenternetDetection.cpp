@@ -27,7 +27,11 @@ bool CenternetDetection::init(const std::string& tensor_path, const int n_classe
             "oven", "toaster", "sink", "refrigerator", "book", "clock", "vase",
             "scissors", "teddy bear", "hair drier", "toothbrush"
             };
-    classesNames = std::vector<std::string>(coco_class_name, std::end( coco_class_name));
+    // class names from the engine sidecar, coco otherwise
+    if(!netRT->meta.classesNames.empty())
+        classesNames = netRT->meta.classesNames;
+    else
+        classesNames = std::vector<std::string>(coco_class_name, std::end( coco_class_name));
     
     for(int c=0; c<classes; c++) {
         int offset = c*123457 % classes;
@@ -15,7 +15,10 @@ bool CenternetDetection3D::init(const std::string& tensor_path, const int n_clas
 
     const char *kitti_class_name[] = {
             "person", "car", "bicycle"};
-    classesNames = std::vector<std::string>(kitti_class_name, std::end( kitti_class_name));
+    if(!netRT->meta.classesNames.empty())
+        classesNames = netRT->meta.classesNames;
+    else
+        classesNames = std::vector<std::string>(kitti_class_name, std::end( kitti_class_name));
     
     for(int c=0; c<classes; c++) {
         int offset = c*123457 % classes;
@@ -125,28 +128,9 @@ bool CenternetDetection3D::init(const std::string& tensor_path, const int n_clas
         calibs.push_back(calibs_);
     }
 
-    r = cv::Mat(cv::Size(3,3), CV_32F);
-    r.at<float>(0,1) = 0.0;
-    r.at<float>(1,0) = 0.0;
-    r.at<float>(1,1) = 1.0;
-    r.at<float>(1,2) = 0.0;
-    r.at<float>(2,1) = 0.0;
-                        
-    corners = cv::Mat(cv::Size(8,3), CV_32F);
-    corners.at<float>(1,0) = 0.0;
-    corners.at<float>(1,1) = 0.0;
-    corners.at<float>(1,2) = 0.0;
-    corners.at<float>(1,3) = 0.0;
-
-    pts3DHomo = cv::Mat(cv::Size(8,4), CV_32F);
-    pts3DHomo.at<float>(3,0) = 1.0;
-    pts3DHomo.at<float>(3,1) = 1.0;
-    pts3DHomo.at<float>(3,2) = 1.0;
-    pts3DHomo.at<float>(3,3) = 1.0;
-    pts3DHomo.at<float>(3,4) = 1.0;
-    pts3DHomo.at<float>(3,5) = 1.0;
-    pts3DHomo.at<float>(3,6) = 1.0;
-    pts3DHomo.at<float>(3,7) = 1.0;
+    proj.reserve(K);
+    projCl.reserve(K);
+    projProb.reserve(K);
     
     checkCuda( cudaMalloc(&d_ptrs, dim.c * dim.h*dim.w * sizeof(float)) );
 
@@ -403,6 +387,9 @@ void CenternetDetection3D::postprocess(const int bi, const bool mAP) {
     float alpha;
     float x, y, z, rot_y;
     detected3D.clear();
+    proj.clear();
+    projCl.clear();
+    projProb.clear();
     for(int i = 0; i<classes; i++){      
         for(int j=0; j<K; j++){
             if(clses[j] == i){
@@ -423,65 +410,24 @@ void CenternetDetection3D::postprocess(const int bi, const bool mAP) {
                 if(rot_y<M_PI)
                     rot_y += 2*M_PI;   
 
-                if(scores[j] > confThreshold) {
-                    if(z>0) {
-                        // compute_box_3d
-                        r.at<float>(0,0) = std::cos(rot_y);
-                        r.at<float>(0,2) = std::sin(rot_y);
-                        r.at<float>(2,0) = -std::sin(rot_y);
-                        r.at<float>(2,2) = std::cos(rot_y);
-
-                        corners.at<float>(0,0) = dim_[2*K+j]/2;
-                        corners.at<float>(0,1) = dim_[2*K+j]/2;
-                        corners.at<float>(0,2) = -dim_[2*K+j]/2;
-                        corners.at<float>(0,3) = -dim_[2*K+j]/2;
-                        corners.at<float>(0,4) = dim_[2*K+j]/2;
-                        corners.at<float>(0,5) = dim_[2*K+j]/2;
-                        corners.at<float>(0,6) = -dim_[2*K+j]/2;
-                        corners.at<float>(0,7) = -dim_[2*K+j]/2;
-
-                        corners.at<float>(1,4) = -dim_[j];
-                        corners.at<float>(1,5) = -dim_[j];
-                        corners.at<float>(1,6) = -dim_[j];
-                        corners.at<float>(1,7) = -dim_[j];
-                        
-                        corners.at<float>(2,0) = dim_[K+j]/2;
-                        corners.at<float>(2,1) = -dim_[K+j]/2;
-                        corners.at<float>(2,2) = -dim_[K+j]/2;
-                        corners.at<float>(2,3) = dim_[K+j]/2;
-                        corners.at<float>(2,4) = dim_[K+j]/2;
-                        corners.at<float>(2,5) = -dim_[K+j]/2;
-                        corners.at<float>(2,6) = -dim_[K+j]/2;
-                        corners.at<float>(2,7) = dim_[K+j]/2;
-                        cv::Mat aus = r * corners;
-
-                        for(int k=0; k<8; k++) {
-                            aus.at<float>(0,k) += x;
-                            aus.at<float>(1,k) += y;
-                            aus.at<float>(2,k) += z;
-                        }
-                        // corners.copyTo(pts3DHomo(cv::Rect(0, 0, 8, 3)));
-                        for(int k1=0; k1<3; k1++) {
-                            for(int k2=0; k2<8; k2++)
-                                pts3DHomo.at<float>(k1,k2) = aus.at<float>(k1,k2); 
-                        }
-                        aus.release();
-                        aus = calibs[bi] * pts3DHomo;
-                        
-                        tk::dnn::box3D res;
-                        for(int k=0; k<8; k++) {
-                            res.corners.push_back(aus.at<float>(0,k) / aus.at<float>(2,k));
-                            res.corners.push_back(aus.at<float>(1,k) / aus.at<float>(2,k));
-                        }
-                        res.cl = i;
-                        res.prob = scores[j];
-                        //res.print();
-                        detected3D.push_back(res);  
-                    }
+                if(scores[j] > confThreshold && z>0) {
+                    // compute_box_3d, the corners are projected below for all the boxes at once
+                    proj.add(dim_[j], dim_[K+j], dim_[2*K+j], x, y, z, rot_y);
+                    projCl.push_back(i);
+                    projProb.push_back(scores[j]);
                 }
             }
         }
     }
+    proj.project(calibs[bi].ptr<float>());
+    for(int p=0; p<proj.count(); p++) {
+        tk::dnn::box3D res;
+        proj.corners(p, res.corners);
+        res.cl = projCl[p];
+        res.prob = projProb[p];
+        //res.print();
+        detected3D.push_back(res);
+    }
     batchDetected.push_back(detected3D);
 }
 
@@ -0,0 +1,565 @@
+#include "CocoEvaluator.h"
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <numeric>
+#include <float.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sstream>
+
+#include "MappedFile.h"
+
+namespace tk { namespace dnn {
+
+/**
+ * Pull parser over a json document in memory, values not needed are skipped
+ * without being stored
+ */
+struct cocoJson_t {
+    const char *begin, *p, *end;
+    std::string path;
+
+    void error(const std::string &what) {
+        FatalError("json " + path + ": " + what + " at byte " + std::to_string(p - begin));
+    }
+    char peek() {
+        while(p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t'))
+            p++;
+        return p < end ? *p : 0;
+    }
+    void expect(char c) {
+        if(peek() != c)
+            error(std::string("expected '") + c + "'");
+        p++;
+    }
+    bool comma() {
+        if(peek() != ',')
+            return false;
+        p++;
+        return true;
+    }
+    std::string string() {
+        expect('"');
+        std::string s;
+        for(; p < end && *p != '"'; p++) {
+            if(*p != '\\') {
+                s += *p;
+                continue;
+            }
+            if(++p >= end)
+                break;
+            switch(*p) {
+                case 'n': s += '\n'; break;
+                case 't': s += '\t'; break;
+                case 'r': s += '\r'; break;
+                case 'b': s += '\b'; break;
+                case 'f': s += '\f'; break;
+                case 'u': s += '?'; p += 4; break;   // only ids and numbers are used
+                default:  s += *p;
+            }
+        }
+        expect('"');
+        return s;
+    }
+    double number() {
+        peek();
+        char *num_end;
+        double v = strtod(p, &num_end);
+        if(num_end == p)
+            error("expected a number");
+        p = num_end;
+        return v;
+    }
+    template<typename F> void object(F field) {
+        expect('{');
+        if(peek() == '}') {
+            p++;
+            return;
+        }
+        do {
+            std::string key = string();
+            expect(':');
+            field(key);
+        } while(comma());
+        expect('}');
+    }
+    template<typename F> void array(F element) {
+        expect('[');
+        if(peek() == ']') {
+            p++;
+            return;
+        }
+        do {
+            element();
+        } while(comma());
+        expect(']');
+    }
+    void skip() {
+        switch(peek()) {
+            case '{': object([this](const std::string&) { skip(); }); break;
+            case '[': array([this]() { skip(); });                    break;
+            case '"': string();                                       break;
+            case 't': p += 4;                                         break;
+            case 'f': p += 5;                                         break;
+            case 'n': p += 4;                                         break;
+            default:  number();
+        }
+    }
+    bool boolean() {
+        char c = peek();
+        if(c == 't' || c == 'f') {
+            p += c == 't' ? 4 : 5;
+            return c == 't';
+        }
+        return number() != 0;
+    }
+    // a COCO annotation or result object
+    CocoAnnotation annotation() {
+        CocoAnnotation a;
+        bool has_area = false;
+        object([&](const std::string &key) {
+            if(key == "image_id")           a.image_id = int64_t(number());
+            else if(key == "category_id")   a.category_id = int(number());
+            else if(key == "score")         a.score = number();
+            else if(key == "iscrowd")       a.iscrowd = boolean();
+            else if(key == "area")          { a.area = number(); has_area = true; }
+            else if(key == "bbox") {
+                std::vector<double> b;
+                array([&]() { b.push_back(number()); });
+                if(b.size() != 4)
+                    error("bbox must have 4 values");
+                a.x = b[0]; a.y = b[1]; a.w = b[2]; a.h = b[3];
+            }
+            else skip();
+        });
+        if(!has_area)
+            a.area = a.w*a.h;
+        return a;
+    }
+};
+
+int64_t cocoImageId(const std::string &image_path) {
+    std::string id = image_path.substr(image_path.find("images/")+7, image_path.find(".jpg") - image_path.find("images/") -7);
+    return std::stoll(id);
+}
+
+int cocoCategoryId(const int cl) {
+    static const int coco_ids[] = { 1,2,3,4,5,6,7,8,9,10,11,13,14,15,16,17,18,19,20,21,22,23,24,25,27,28,31,32,33,34,35,36,37,38,39,40,41,42,43,44,46,47,48,49,50,51,52,53,54,55,56,57,58,59,60,61,62,63,64,65,67,70,72,73,74,75,76,77,78,79,80,81,82,84,85,86,87,88,89,90 };
+    if(cl < 0 || cl >= int(sizeof(coco_ids)/sizeof(int)))
+        FatalError("class " + std::to_string(cl) + " has no COCO category");
+    return coco_ids[cl];
+}
+
+std::vector<CocoAnnotation> cocoResults(const std::string &image_path, const std::vector<tk::dnn::box> &bbox,
+                                        const int classes, const int w, const int h) {
+    std::vector<CocoAnnotation> res;
+    int64_t image_id = cocoImageId(image_path);
+    for (size_t i = 0; i < bbox.size(); ++i) {
+        float xmin = bbox[i].x ;
+        float xmax = bbox[i].x + float(bbox[i].w);
+        float ymin = bbox[i].y;
+        float ymax = bbox[i].y + float(bbox[i].h);
+
+        //limit to image borders
+        if (xmin < 0) xmin = 0;
+        if (ymin < 0) ymin = 0;
+        if (xmax > w) xmax = w;
+        if (ymax > h) ymax = h;
+
+        CocoAnnotation r;
+        r.image_id = image_id;
+        r.x = xmin;
+        r.y = ymin;
+        r.w = float(xmax - xmin);
+        r.h = float(ymax - ymin);
+        r.area = r.w*r.h;
+
+        if(bbox[i].probs.size() == classes) {
+            for (int j = 0; j < classes; ++j) {
+                //min threshold confidence is set in DetectionNN.h
+                if (bbox[i].probs[j] > 0) {
+                    r.category_id = cocoCategoryId(j);
+                    r.score = bbox[i].probs[j];
+                    res.push_back(r);
+                }
+            }
+        } else {
+            r.category_id = cocoCategoryId(bbox[i].cl);
+            r.score = bbox[i].prob;
+            res.push_back(r);
+        }
+    }
+    return res;
+}
+
+void printCocoResult(std::ostream &out, const CocoAnnotation &r) {
+    out <<  "{\"image_id\":" << r.image_id <<
+            ", \"category_id\":" << r.category_id <<
+            ", \"bbox\":[" << r.x << ", " << r.y << ", " << r.w << ", " << r.h <<
+            "], \"score\":" << r.score << "},\n";
+}
+
+void CocoEvaluator::readGroundtruth(const std::string &json_file) {
+    MappedFile file;
+    if(!file.open(json_file))
+        FatalError("could not open COCO annotations " + json_file);
+    cocoJson_t json = { file.data(), file.data(), file.data() + file.size, json_file };
+
+    json.object([&](const std::string &key) {
+        if(key == "images") {
+            json.array([&]() {
+                json.object([&](const std::string &k) {
+                    if(k == "id") addImage(int64_t(json.number()));
+                    else json.skip();
+                });
+            });
+        } else if(key == "categories") {
+            json.array([&]() {
+                json.object([&](const std::string &k) {
+                    if(k == "id") addCategory(int(json.number()));
+                    else json.skip();
+                });
+            });
+        } else if(key == "annotations") {
+            json.array([&]() { groundtruths.push_back(json.annotation()); });
+        } else {
+            json.skip();
+        }
+    });
+    std::cout<<"COCO groundtruth "<<json_file<<": "<<images.size()<<" images, "<<categories.size()
+             <<" categories, "<<groundtruths.size()<<" annotations\n";
+}
+
+void CocoEvaluator::readResults(const std::string &json_file) {
+    MappedFile file;
+    if(!file.open(json_file))
+        FatalError("could not open COCO results " + json_file);
+    cocoJson_t json = { file.data(), file.data(), file.data() + file.size, json_file };
+    size_t n = results.size();
+    json.array([&]() { addResult(json.annotation()); });
+    std::cout<<"COCO results "<<json_file<<": "<<results.size() - n<<" detections\n";
+}
+
+void CocoEvaluator::writeResults(const std::string &json_file) const {
+    std::ofstream out(json_file);
+    out << "[\n";
+    for(size_t i=0; i<results.size(); i++) {
+        std::stringstream line;
+        printCocoResult(line, results[i]);
+        std::string s = line.str();
+        // no comma after the last one
+        out << (i + 1 < results.size() ? s : s.substr(0, s.size() - 2) + "\n");
+    }
+    out << "]\n";
+}
+
+void CocoEvaluator::addImage(const int64_t image_id) {
+    images.push_back(image_id);
+}
+
+void CocoEvaluator::addCategory(const int category_id) {
+    categories.push_back(category_id);
+}
+
+void CocoEvaluator::addGroundtruth(const CocoAnnotation &gt) {
+    groundtruths.push_back(gt);
+}
+
+void CocoEvaluator::addResult(const CocoAnnotation &det) {
+    CocoAnnotation r = det;
+    r.area = r.w*r.h;
+    r.iscrowd = false;
+    results.push_back(r);
+}
+
+void CocoEvaluator::addFrame(const int64_t image_id, const Frame &frame, const int classes) {
+    addImage(image_id);
+    if(categories.empty())
+        for(int c=0; c<classes; c++)
+            addCategory(cocoCategoryId(c));
+
+    // normalized center boxes to pixels
+    auto toCoco = [&](const BoundingBox &b) {
+        CocoAnnotation a;
+        a.image_id = image_id;
+        a.category_id = cocoCategoryId(b.cl);
+        a.w = b.w*frame.width;
+        a.h = b.h*frame.height;
+        a.x = b.x*frame.width - a.w/2;
+        a.y = b.y*frame.height - a.h/2;
+        a.area = a.w*a.h;
+        a.score = b.prob;
+        return a;
+    };
+    for(const auto &g: frame.gt)
+        addGroundtruth(toCoco(g));
+    for(const auto &d: frame.det)
+        addResult(toCoco(d));
+}
+
+void CocoEvaluator::clearResults() {
+    results.clear();
+}
+
+// evaluation of the detections of an image, category and area range (pycocotools evaluateImg)
+struct cocoEvalImg_t {
+    bool valid = false;
+    std::vector<double> scores;             // sorted, at most maxDets
+    std::vector<char> matched, ignored;     // iou thresholds x detections
+    int npig = 0;                           // groundtruths not ignored
+};
+
+// IoU of two boxes, over the detection area for crowd groundtruths (maskApi bbIou)
+static double cocoIoU(const CocoAnnotation &d, const CocoAnnotation &g) {
+    double w = std::min(d.x + d.w, g.x + g.w) - std::max(d.x, g.x);
+    if(w <= 0)
+        return 0;
+    double h = std::min(d.y + d.h, g.y + g.h) - std::max(d.y, g.y);
+    if(h <= 0)
+        return 0;
+    double i = w*h;
+    double u = g.iscrowd ? d.w*d.h : d.w*d.h + g.w*g.h - i;
+    return i / u;
+}
+
+double CocoEvaluator::evaluate(const float min_score, const bool verbose) {
+    // thresholds computed as np.linspace does, so that they are the same doubles
+    const int T = 10, R = 101, A = 4;
+    std::vector<double> iou_thrs(T), rec_thrs(R);
+    for(int t=0; t<T; t++)
+        iou_thrs[t] = t < T - 1 ? t*((0.95 - 0.5)/(T - 1)) + 0.5 : 0.95;
+    for(int r=0; r<R; r++)
+        rec_thrs[r] = r < R - 1 ? r*(1.0/(R - 1)) : 1.0;
+    const std::vector<int> max_dets = { 1, 10, 100 };
+    const double area_rng[4][2] = { {0, 1e10}, {0, 32*32}, {32*32, 96*96}, {96*96, 1e10} };
+    const int M = max_dets.size();
+
+    std::vector<int64_t> img_ids = images;
+    std::vector<int> cat_ids = categories;
+    std::sort(img_ids.begin(), img_ids.end());
+    img_ids.erase(std::unique(img_ids.begin(), img_ids.end()), img_ids.end());
+    std::sort(cat_ids.begin(), cat_ids.end());
+    cat_ids.erase(std::unique(cat_ids.begin(), cat_ids.end()), cat_ids.end());
+    const int I = img_ids.size(), K = cat_ids.size();
+
+    // annotations of every (category, image), in input order
+    std::map<int64_t, int> img_index;
+    std::map<int, int> cat_index;
+    for(int i=0; i<I; i++) img_index[img_ids[i]] = i;
+    for(int k=0; k<K; k++) cat_index[cat_ids[k]] = k;
+    std::vector<std::vector<int>> gts(K*I), dts(K*I);
+    int skipped = 0;
+    for(size_t n=0; n<groundtruths.size(); n++) {
+        auto i = img_index.find(groundtruths[n].image_id);
+        auto k = cat_index.find(groundtruths[n].category_id);
+        if(i != img_index.end() && k != cat_index.end())
+            gts[k->second*I + i->second].push_back(n);
+    }
+    for(size_t n=0; n<results.size(); n++) {
+        if(results[n].score < min_score)
+            continue;
+        auto i = img_index.find(results[n].image_id);
+        auto k = cat_index.find(results[n].category_id);
+        if(i != img_index.end() && k != cat_index.end())
+            dts[k->second*I + i->second].push_back(n);
+        else
+            skipped++;
+    }
+    if(skipped > 0)
+        std::cout<<COL_ORANGEB<<skipped<<" results of images or categories not in the groundtruth"<<COL_END<<"\n";
+
+    // match detections and groundtruths of every image
+    std::vector<cocoEvalImg_t> evals(K*A*I);
+    parallelFor(K*I, [&](int begin, int end) {
+        for(int ki=begin; ki<end; ki++) {
+            const std::vector<int> &g = gts[ki], &d0 = dts[ki];
+            if(g.empty() && d0.empty())
+                continue;
+
+            // detections by descending score, at most the largest maxDets
+            std::vector<int> d = d0;
+            std::stable_sort(d.begin(), d.end(), [&](int a, int b) { return results[a].score > results[b].score; });
+            if(d.size() > max_dets.back())
+                d.resize(max_dets.back());
+            const int G = g.size(), D = d.size();
+
+            std::vector<std::vector<double>> ious(D, std::vector<double>(G));
+            for(int j=0; j<D; j++)
+                for(int n=0; n<G; n++)
+                    ious[j][n] = cocoIoU(results[d[j]], groundtruths[g[n]]);
+
+            for(int a=0; a<A; a++) {
+                // groundtruths out of the area range or crowd are ignored, and go last
+                std::vector<char> g_ignore(G);
+                for(int n=0; n<G; n++) {
+                    const CocoAnnotation &gt = groundtruths[g[n]];
+                    g_ignore[n] = gt.iscrowd || gt.area < area_rng[a][0] || gt.area > area_rng[a][1];
+                }
+                std::vector<int> g_order(G);
+                std::iota(g_order.begin(), g_order.end(), 0);
+                std::stable_sort(g_order.begin(), g_order.end(), [&](int x, int y) { return g_ignore[x] < g_ignore[y]; });
+
+                cocoEvalImg_t &e = evals[(ki/I*A + a)*I + ki%I];
+                e.valid = true;
+                e.scores.resize(D);
+                for(int j=0; j<D; j++)
+                    e.scores[j] = results[d[j]].score;
+                e.matched.assign(T*D, 0);
+                e.ignored.assign(T*D, 0);
+                e.npig = std::count(g_ignore.begin(), g_ignore.end(), 0);
+
+                std::vector<char> g_matched(G);
+                for(int t=0; t<T; t++) {
+                    std::fill(g_matched.begin(), g_matched.end(), 0);
+                    for(int j=0; j<D; j++) {
+                        double iou = std::min(iou_thrs[t], 1 - 1e-10);
+                        int m = -1;
+                        for(int gi: g_order) {
+                            // already matched and not a crowd
+                            if(g_matched[gi] && !groundtruths[g[gi]].iscrowd)
+                                continue;
+                            // a regular match was found, the rest are ignored groundtruths
+                            if(m > -1 && !g_ignore[m] && g_ignore[gi])
+                                break;
+                            if(ious[j][gi] < iou)
+                                continue;
+                            iou = ious[j][gi];
+                            m = gi;
+                        }
+                        if(m == -1) {
+                            // unmatched detections out of the area range are ignored
+                            double area = results[d[j]].area;
+                            e.ignored[t*D + j] = area < area_rng[a][0] || area > area_rng[a][1];
+                            continue;
+                        }
+                        e.ignored[t*D + j] = g_ignore[m];
+                        e.matched[t*D + j] = 1;
+                        g_matched[m] = 1;
+                    }
+                }
+            }
+        }
+    });
+
+    // precision (T x R) and recall (T) of every category, area range and maxDets
+    std::vector<double> precision(size_t(K)*A*M*T*R, -1), recall(size_t(K)*A*M*T, -1);
+    parallelFor(K, [&](int begin, int end) {
+        for(int k=begin; k<end; k++)
+        for(int a=0; a<A; a++)
+        for(int m=0; m<M; m++) {
+            // detections of all the images, by descending score (stable on image order)
+            std::vector<double> scores;
+            std::vector<std::pair<int, int>> src;   // image, detection
+            int npig = 0;
+            for(int i=0; i<I; i++) {
+                const cocoEvalImg_t &e = evals[(k*A + a)*I + i];
+                if(!e.valid)
+                    continue;
+                npig += e.npig;
+                for(int j=0; j<std::min<int>(max_dets[m], e.scores.size()); j++) {
+                    scores.push_back(e.scores[j]);
+                    src.push_back({i, j});
+                }
+            }
+            if(npig == 0)
+                continue;
+            std::vector<int> order(scores.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&](int x, int y) { return scores[x] > scores[y]; });
+            const int nd = order.size();
+
+            size_t base = ((size_t(k)*A + a)*M + m)*T;
+            std::vector<double> rc(nd), pr(nd);
+            for(int t=0; t<T; t++) {
+                double tp = 0, fp = 0;
+                for(int n=0; n<nd; n++) {
+                    const cocoEvalImg_t &e = evals[(k*A + a)*I + src[order[n]].first];
+                    int D = e.scores.size(), j = src[order[n]].second;
+                    if(!e.ignored[t*D + j]) {
+                        if(e.matched[t*D + j]) tp++;
+                        else fp++;
+                    }
+                    rc[n] = tp / npig;
+                    pr[n] = tp / (fp + tp + DBL_EPSILON);
+                }
+                recall[base + t] = nd ? rc[nd - 1] : 0;
+
+                // precision envelope, then the first rank reaching each recall point
+                for(int n=nd-1; n>0; n--)
+                    if(pr[n] > pr[n - 1])
+                        pr[n - 1] = pr[n];
+                double *q = &precision[(base + t)*R];
+                for(int r=0; r<R; r++) {
+                    int n = std::lower_bound(rc.begin(), rc.end(), rec_thrs[r]) - rc.begin();
+                    q[r] = n < nd ? pr[n] : 0;
+                }
+            }
+        }
+    });
+
+    // mean over the available values (-1 if none)
+    auto mean = [](double sum, int n) { return n > 0 ? sum / n : -1; };
+    auto ap = [&](int t_only, int a, int m, int k_only) {
+        double sum = 0;
+        int n = 0;
+        for(int k=0; k<K; k++) {
+            if(k_only >= 0 && k != k_only)
+                continue;
+            for(int t=0; t<T; t++) {
+                if(t_only >= 0 && t != t_only)
+                    continue;
+                const double *q = &precision[(((size_t(k)*A + a)*M + m)*T + t)*R];
+                for(int r=0; r<R; r++)
+                    if(q[r] > -1) { sum += q[r]; n++; }
+            }
+        }
+        return mean(sum, n);
+    };
+    auto ar = [&](int a, int m, int k_only) {
+        double sum = 0;
+        int n = 0;
+        for(int k=0; k<K; k++) {
+            if(k_only >= 0 && k != k_only)
+                continue;
+            for(int t=0; t<T; t++) {
+                double v = recall[((size_t(k)*A + a)*M + m)*T + t];
+                if(v > -1) { sum += v; n++; }
+            }
+        }
+        return mean(sum, n);
+    };
+
+    stats = { ap(-1, 0, 2, -1), ap(0, 0, 2, -1), ap(5, 0, 2, -1),
+              ap(-1, 1, 2, -1), ap(-1, 2, 2, -1), ap(-1, 3, 2, -1),
+              ar(0, 0, -1), ar(0, 1, -1), ar(0, 2, -1),
+              ar(1, 2, -1), ar(2, 2, -1), ar(3, 2, -1) };
+    categoryAP.clear();
+    categoryAR.clear();
+    for(int k=0; k<K; k++) {
+        categoryAP[cat_ids[k]] = ap(-1, 0, 2, k);
+        categoryAR[cat_ids[k]] = ar(0, 2, k);
+        if(verbose)
+            std::cout<<"category "<<cat_ids[k]<<"\tAP: "<<categoryAP[cat_ids[k]]<<"\tAR: "<<categoryAR[cat_ids[k]]<<"\n";
+    }
+    return stats[0];
+}
+
+void CocoEvaluator::summarize() const {
+    if(stats.size() != 12)
+        FatalError("evaluate before summarize");
+    const char *names[12][4] = {
+        { "Precision", "(AP)", "0.50:0.95", "   all" }, { "Precision", "(AP)", "0.50     ", "   all" },
+        { "Precision", "(AP)", "0.75     ", "   all" }, { "Precision", "(AP)", "0.50:0.95", " small" },
+        { "Precision", "(AP)", "0.50:0.95", "medium" }, { "Precision", "(AP)", "0.50:0.95", " large" },
+        { "Recall   ", "(AR)", "0.50:0.95", "   all" }, { "Recall   ", "(AR)", "0.50:0.95", "   all" },
+        { "Recall   ", "(AR)", "0.50:0.95", "   all" }, { "Recall   ", "(AR)", "0.50:0.95", " small" },
+        { "Recall   ", "(AR)", "0.50:0.95", "medium" }, { "Recall   ", "(AR)", "0.50:0.95", " large" } };
+    const int max_dets[12] = { 100, 100, 100, 100, 100, 100, 1, 10, 100, 100, 100, 100 };
+    for(int i=0; i<12; i++)
+        printf(" Average %s %s @[ IoU=%s | area=%s | maxDets=%3d ] = %0.3f\n",
+               names[i][0], names[i][1], names[i][2], names[i][3], max_dets[i], stats[i]);
+}
+
+}}
@@ -1,4 +1,10 @@
 #include "tkDNN/DarknetParser.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <sys/stat.h>
+#include "tkDNN/WeightsLoader.h"
 
 namespace tk { namespace dnn {
 
@@ -42,75 +48,165 @@ namespace tk { namespace dnn {
         return values;
     }
 
+    std::string darknetTrim(const std::string& str) {
+        size_t start = str.find_first_not_of(" \t\r\n");
+        if(start == std::string::npos)
+            return "";
+        size_t end = str.find_last_not_of(" \t\r\n");
+        return str.substr(start, end - start + 1);
+    }
+
+    typedef void (*darknetFieldSetter_t)(darknetFields_t& f, const std::string& v);
+
+    // one entry for every supported key, keys are matched exactly
+    static const std::unordered_map<std::string, darknetFieldSetter_t>& darknetFieldSetters() {
+        static const std::unordered_map<std::string, darknetFieldSetter_t> setters = {
+            { "width",           [](darknetFields_t& f, const std::string& v) { f.width = std::stoi(v); } },
+            { "height",          [](darknetFields_t& f, const std::string& v) { f.height = std::stoi(v); } },
+            { "channels",        [](darknetFields_t& f, const std::string& v) { f.channels = std::stoi(v); } },
+            { "batch_normalize", [](darknetFields_t& f, const std::string& v) { f.batch_normalize = std::stoi(v); } },
+            { "filters",         [](darknetFields_t& f, const std::string& v) { f.filters = std::stoi(v); } },
+            { "activation",      [](darknetFields_t& f, const std::string& v) { f.activation = v; } },
+            { "size",            [](darknetFields_t& f, const std::string& v) { f.size_x = f.size_y = std::stoi(v); } },
+            { "size_x",          [](darknetFields_t& f, const std::string& v) { f.size_x = std::stoi(v); } },
+            { "size_y",          [](darknetFields_t& f, const std::string& v) { f.size_y = std::stoi(v); } },
+            { "stride",          [](darknetFields_t& f, const std::string& v) { f.stride_x = f.stride_y = std::stoi(v); } },
+            { "stride_x",        [](darknetFields_t& f, const std::string& v) { f.stride_x = std::stoi(v); } },
+            { "stride_y",        [](darknetFields_t& f, const std::string& v) { f.stride_y = std::stoi(v); } },
+            { "pad",             [](darknetFields_t& f, const std::string& v) { f.pad = std::stoi(v); } },
+            { "padding",         [](darknetFields_t& f, const std::string& v) { f.padding_x = f.padding_y = std::stoi(v); } },
+            { "classes",         [](darknetFields_t& f, const std::string& v) { f.classes = std::stoi(v); } },
+            { "num",             [](darknetFields_t& f, const std::string& v) { f.num = std::stoi(v); } },
+            { "coords",          [](darknetFields_t& f, const std::string& v) { f.coords = std::stoi(v); } },
+            { "new_coords",      [](darknetFields_t& f, const std::string& v) { f.new_coords = std::stoi(v); } },
+            { "groups",          [](darknetFields_t& f, const std::string& v) { f.groups = std::stoi(v); } },
+            { "group_id",        [](darknetFields_t& f, const std::string& v) { f.group_id = std::stoi(v); } },
+            { "scale_x_y",       [](darknetFields_t& f, const std::string& v) { f.scale_xy = std::stof(v); } },
+            { "beta_nms",        [](darknetFields_t& f, const std::string& v) { f.nms_thresh = std::stof(v); } },
+            { "nms_kind",        [](darknetFields_t& f, const std::string& v) {
+                if(v == "greedynms") f.nms_kind = 0;
+                else if(v == "diounms") f.nms_kind = 1;
+                else std::cout<<"Not supported nms_kind "<<v<<", setting to greedynms"<<std::endl;
+            } },
+            { "from",            [](darknetFields_t& f, const std::string& v) {
+                std::vector<int> from = fromStringToIntVec(v, ',');
+                f.layers.insert(f.layers.end(), from.begin(), from.end());
+            } },
+            { "layers",          [](darknetFields_t& f, const std::string& v) { f.layers = fromStringToIntVec(v, ','); } },
+            { "mask",            [](darknetFields_t& f, const std::string& v) {
+                f.mask = fromStringToFloatVec(v, ',');
+                f.n_mask = f.mask.size();
+            } },
+            { "anchors",         [](darknetFields_t& f, const std::string& v) { f.anchors = fromStringToFloatVec(v, ','); } },
+            { "output",          [](darknetFields_t& f, const std::string& v) { f.output = std::stoi(v); } },
+            { "scale_wh",        [](darknetFields_t& f, const std::string& v) { f.scale_wh = std::stoi(v); } },
+            { "weights_type",    [](darknetFields_t& f, const std::string& v) {
+                if(v == "none") f.weights_type = tk::dnn::SHORTCUT_WEIGHTS_NONE;
+                else if(v == "per_feature" || v == "per_layer") f.weights_type = tk::dnn::SHORTCUT_WEIGHTS_PER_FEATURE;
+                else if(v == "per_channel") f.weights_type = tk::dnn::SHORTCUT_WEIGHTS_PER_CHANNEL;
+                else FatalError("Not supported weights_type " + v);
+            } },
+            { "weights_normalization", [](darknetFields_t& f, const std::string& v) {
+                if(v == "none") f.weights_normalization = tk::dnn::SHORTCUT_NORM_NONE;
+                else if(v == "relu" || v == "avg_relu") f.weights_normalization = tk::dnn::SHORTCUT_NORM_RELU;
+                else if(v == "softmax") f.weights_normalization = tk::dnn::SHORTCUT_NORM_SOFTMAX;
+                else FatalError("Not supported weights_normalization " + v);
+            } },
+        };
+        return setters;
+    }
+
+    // training parameters, not needed for inference
+    static const std::unordered_set<std::string>& darknetIgnoredFields() {
+        static const std::unordered_set<std::string> ignored = {
+            "batch", "subdivisions", "momentum", "decay", "angle", "saturation", "exposure", "hue",
+            "learning_rate", "burn_in", "max_batches", "policy", "steps", "scales", "mosaic",
+            "jitter", "ignore_thresh", "truth_thresh", "random", "iou_thresh", "iou_loss",
+            "iou_normalizer", "cls_normalizer", "obj_normalizer", "max_delta", "resize",
+            "stopbackward", "letter_box", "counters_per_class", "label_smooth_eps", "ema_alpha",
+            "objectness_smooth", "absolute", "bias_match", "class_scale", "coord_scale",
+            "noobject_scale", "object_scale", "rescore", "softmax", "thresh", "probability",
+            "dropblock", "dropblock_size_abs", "dropblock_size_rel", "uc_normalizer", "yolo_point"
+        };
+        return ignored;
+    }
+
     bool darknetParseFields(const std::string& line, darknetFields_t& fields){
 
         std::string name,value;
         if(!divideNameAndValue(line, name, value))
             return false;
+        name = darknetTrim(name);
+        value = darknetTrim(value);
+
+        auto &setters = darknetFieldSetters();
+        auto it = setters.find(name);
+        if(it != setters.end())
+            it->second(fields, value);
+        else if(darknetIgnoredFields().count(name) == 0)
+            std::cout<<"Not supported field: "<<line<<std::endl;
+        return true;
+    }
 
-        if(name.find("new_coords") !=  std::string::npos)
-            fields.new_coords = std::stoi(value);
-        else if(name.find("width") !=  std::string::npos)
-            fields.width = std::stoi(value);
-        else if(name.find("height") !=  std::string::npos)
-            fields.height = std::stoi(value);
-        else if(name.find("channels") !=  std::string::npos)
-            fields.channels = std::stoi(value);
-        else if(name.find("batch_normalize") !=  std::string::npos)
-            fields.batch_normalize = std::stoi(value);
-        else if(name.find("filters") !=  std::string::npos)
-            fields.filters = std::stoi(value);
-        else if(name.find("activation") !=  std::string::npos)
-            fields.activation = value;
-        else if(name.find("size") !=  std::string::npos){
-            fields.size_x = std::stoi(value);
-            fields.size_y = std::stoi(value);
-        }
-        else if(name.find("size_x") !=  std::string::npos)
-            fields.size_x = std::stoi(value);
-        else if(name.find("size_y") !=  std::string::npos)
-            fields.size_y = std::stoi(value);
-        else if(name.find("stride") !=  std::string::npos){
-            fields.stride_x = std::stoi(value);
-            fields.stride_y = std::stoi(value);
-        }
-        else if(name.find("stride_x") !=  std::string::npos)
-            fields.stride_x = std::stoi(value);
-        else if(name.find("stride_y") !=  std::string::npos)
-            fields.stride_y = std::stoi(value);
-        else if(name.find("pad") !=  std::string::npos)
-            fields.pad = std::stoi(value);
-        else if(name.find("classes") !=  std::string::npos)
-            fields.classes = std::stoi(value);
-        else if(name.find("num") !=  std::string::npos)
-            fields.num = std::stoi(value);
-        else if(name.find("coords") !=  std::string::npos)
-            fields.coords = std::stoi(value);
-        else if(name.find("groups") !=  std::string::npos)
-            fields.groups = std::stoi(value);
-        else if(name.find("group_id") !=  std::string::npos)
-            fields.group_id = std::stoi(value);
-        else if(name.find("scale_x_y") !=  std::string::npos)
-            fields.scale_xy = std::stof(value);
-        else if(name.find("beta_nms") !=  std::string::npos)
-            fields.nms_thresh = std::stof(value);
-        else if(name.find("nms_kind") !=  std::string::npos){
-            if(value == "greedynms") fields.nms_kind = 0;
-            else if(value == "diounms") fields.nms_kind = 1;
-            else std::cout<<"Not supported nms_kind "<<value<<", setting to greedynms"<<std::endl;
-        }
-        else if(name.find("from") !=  std::string::npos)
-            fields.layers.push_back(std::stof(value));
-        else if(name.find("mask") !=  std::string::npos){
-            auto vec = fromStringToIntVec(value, ',');
-            fields.n_mask = vec.size();
+    std::shared_ptr<const darknetCfg_t> darknetReadCfg(const std::string& cfg_file) {
+        static std::mutex mtx;
+        static std::map<std::string, std::shared_ptr<const darknetCfg_t>> cache;
+
+        struct stat st;
+        if(stat(cfg_file.c_str(), &st) != 0)
+            FatalError("cloud not open cfg file: " + cfg_file);
+
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = cache.find(cfg_file);
+        if(it != cache.end() && it->second->mtime == st.st_mtime)
+            return it->second;
+
+        std::ifstream if_cfg(cfg_file);
+        if(!if_cfg.is_open())
+            FatalError("cloud not open cfg file: " + cfg_file);
+
+        std::shared_ptr<darknetCfg_t> cfg = std::make_shared<darknetCfg_t>();
+        cfg->path = cfg_file;
+        cfg->mtime = st.st_mtime;
+
+        darknetFields_t fields; // will be filled with layers fields
+        std::string line;
+        int count = 0;
+        while(std::getline(if_cfg, line)) {
+            // remove comments
+            std::size_t found = line.find("#");
+            if ( found != std::string::npos ) {
+                line = line.substr(0, found);
+            }
+            line = darknetTrim(line);
+
+            // skip empty lines
+            if(line.empty())
+                continue;
+            
+            if(line[0] == '[') {
+                // end of filled type
+                if(fields.type != "")
+                    cfg->sections.push_back(fields);
+
+                // new type
+                fields = darknetFields_t(); // reset to default
+                fields.type = darknetParseType(line);
+                fields.line = count++;
+                continue;
+            }
+            count++;
+
+            if(!darknetParseFields(line, fields))
+                FatalError("could not parse line: " + line);
         }
-        else if(name.find("layers") !=  std::string::npos)
-            fields.layers = fromStringToIntVec(value, ',');
 
-        else
-            std::cout<<"Not supported field: "<<line<<std::endl;
-        return true;
+        // end of filled type
+        if(fields.type != "")
+            cfg->sections.push_back(fields);
+
+        cache[cfg_file] = cfg;
+        return cfg;
     }
 
     tk::dnn::Network *darknetAddNet(darknetFields_t &fields) {
@@ -147,14 +243,49 @@ namespace tk { namespace dnn {
             netLayers.push_back(new tk::dnn::Pooling(net, f.size_x, f.size_y, f.stride_x, f.stride_y, 
                 f.padding_x, f.padding_y, tk::dnn::POOLING_AVERAGE));
 
+        } else if(f.type == "local_avgpool") {
+            netLayers.push_back(new tk::dnn::Pooling(net, f.size_x, f.size_y, f.stride_x, f.stride_y, 
+                f.padding_x, f.padding_y, tk::dnn::POOLING_AVERAGE_FIXEDSIZE));
+
+        } else if(f.type == "connected") {
+            std::string wgs = wgs_path + "/c" + std::to_string(netLayers.size()) + ".bin";
+            netLayers.push_back(new tk::dnn::Dense(net, f.output, wgs, f.batch_normalize));
+
+        } else if(f.type == "dropout") {
+            // identity at inference, the id points to the previous layer
+            if(netLayers.size() == 0) FatalError("dropout without a previous layer\n");
+            netLayers.push_back(netLayers.back());
+
         } else if(f.type == "shortcut") {
-            if(f.layers.size() != 1) FatalError("no layers to shortcut\n");
+            if(f.layers.size() == 0) FatalError("no layers to shortcut\n");
+            std::vector<tk::dnn::Layer*> layers;
+            for(int i=0; i<f.layers.size(); i++) {
+                int layerIdx = f.layers[i];
+                if(layerIdx < 0)
+                    layerIdx = netLayers.size() + layerIdx; 
+                if(layerIdx < 0 || layerIdx >= netLayers.size()) FatalError("impossible to shortcut\n");
+                //std::cout<<"shortcut to "<<layerIdx<<" "<<netLayers[layerIdx]->getLayerName()<<"\n";
+                layers.push_back(netLayers[layerIdx]);
+            }
+            if(layers.size() == 1 && f.weights_type == tk::dnn::SHORTCUT_WEIGHTS_NONE) {
+                netLayers.push_back(new tk::dnn::Shortcut(net, layers[0]));
+            } else {
+                std::string wgs = f.weights_type == tk::dnn::SHORTCUT_WEIGHTS_NONE ? "" :
+                                  wgs_path + "/s" + std::to_string(netLayers.size()) + ".bin";
+                netLayers.push_back(new tk::dnn::Shortcut(net, layers, wgs, 
+                    (tk::dnn::tkdnnShortcutWeights_t) f.weights_type, (tk::dnn::tkdnnShortcutNormalization_t) f.weights_normalization));
+            }
+
+        } else if(f.type == "sam" || f.type == "scale_channels") {
+            if(f.layers.size() != 1) FatalError("no layer to " + f.type + "\n");
             int layerIdx = f.layers[0];
             if(layerIdx < 0)
                 layerIdx = netLayers.size() + layerIdx; 
-            if(layerIdx < 0 || layerIdx >= netLayers.size()) FatalError("impossible to shortcut\n");
-            //std::cout<<"shortcut to "<<layerIdx<<" "<<netLayers[layerIdx]->getLayerName()<<"\n";
-            netLayers.push_back(new tk::dnn::Shortcut(net, netLayers[layerIdx]));
+            if(layerIdx < 0 || layerIdx >= netLayers.size()) FatalError("impossible to " + f.type + "\n");
+            if(f.type == "sam")
+                netLayers.push_back(new tk::dnn::Sam(net, netLayers[layerIdx]));
+            else
+                netLayers.push_back(new tk::dnn::ScaleChannels(net, netLayers[layerIdx], f.scale_wh));
 
         } else if(f.type == "upsample") {
             netLayers.push_back(new tk::dnn::Upsample(net, f.stride_x));
@@ -178,10 +309,11 @@ namespace tk { namespace dnn {
         } else if(f.type == "region") {
             netLayers.push_back(new tk::dnn::Region(net, f.classes, f.coords, f.num));
 
-        } else if(f.type == "yolo") {
+        } else if(f.type == "yolo" || f.type == "gaussian_yolo") {
             std::string wgs = wgs_path + "/g" + std::to_string(netLayers.size()) + ".bin";
             //printf("%d %d %s %d %f\n", f.classes, f.num/f.n_mask, wgs.c_str(), f.n_mask, f.scale_xy);
-            tk::dnn::Yolo *l = new tk::dnn::Yolo(net, f.classes, f.num/f.n_mask, wgs, f.n_mask, f.scale_xy, f.nms_thresh, (tk::dnn::Yolo::nmsKind_t) f.nms_kind, f.new_coords);
+            tk::dnn::Yolo *l = new tk::dnn::Yolo(net, f.classes, f.num/f.n_mask, wgs, f.n_mask, f.scale_xy, f.nms_thresh, 
+                                                 (tk::dnn::Yolo::nmsKind_t) f.nms_kind, f.new_coords, f.type == "gaussian_yolo");
             if(names.size() != f.classes)
                 FatalError("Mismatch between number of classes and names");
             l->classesNames = names;
@@ -218,6 +350,129 @@ namespace tk { namespace dnn {
         return names;
     }
 
+    void darknetStreamWeights(tk::dnn::Network *net, const std::string& weights_file, 
+                              const std::vector<darknetFields_t> &sections) {
+
+        std::vector<darknetConvWgs_t> convs;
+        tk::dnn::WeightsLoader *loader = net->getWeightsLoader();
+
+        // output dims of every layer (as built by darknetAddLayer), needed to size the weights before the layers are built
+        struct dims_t { int c, h, w; };
+        std::vector<dims_t> dims;
+        dims_t d = { net->input_dim.c, net->input_dim.h, net->input_dim.w };
+        auto layerIdx = [&dims](int l) {
+            int idx = l < 0 ? int(dims.size()) + l : l;
+            if(idx < 0 || idx >= dims.size()) FatalError("impossible to reference layer " + std::to_string(l) + "\n");
+            return idx;
+        };
+        for(auto &f: sections) {
+            if(f.type == "net")
+                continue;
+            std::string prefix = f.type == "yolo" || f.type == "gaussian_yolo" ? "g" : f.type == "shortcut" ? "s" : "c";
+            std::string name = weights_file + "/" + prefix + std::to_string(dims.size()) + ".bin";
+            int pad_x = f.pad == 1 ? f.size_x/2 : f.padding_x;
+            int pad_y = f.pad == 1 ? f.size_x/2 : f.padding_y;
+            if(f.type == "convolutional") {
+                convs.push_back({ name, f.filters, f.filters*(d.c/f.groups)*f.size_x*f.size_y, f.batch_normalize != 0 });
+                d = { f.filters, (d.h + 2*pad_x - f.size_x)/f.stride_x + 1, (d.w + 2*pad_y - f.size_y)/f.stride_y + 1 };
+            } else if(f.type == "connected") {
+                convs.push_back({ name, f.output, f.output*d.c*d.h*d.w, f.batch_normalize != 0, true });
+                d = { f.output, 1, 1 };
+            } else if((f.type == "maxpool" && f.stride_x == 1 && f.stride_y == 1) || f.type == "local_avgpool") {
+                int pad_h = pad_x == 0 ? f.size_x - 1 : pad_x;
+                int pad_w = pad_y == 0 ? f.size_y - 1 : pad_y;
+                d = { d.c, (d.h + pad_h - f.size_x)/f.stride_x + 1, (d.w + pad_w - f.size_y)/f.stride_y + 1 };
+            } else if(f.type == "maxpool" || f.type == "avgpool") {
+                d = { d.c, (d.h + 2*pad_x - f.size_x)/f.stride_x + 1, (d.w + 2*pad_y - f.size_y)/f.stride_y + 1 };
+            } else if(f.type == "upsample") {
+                d = { d.c, d.h*f.stride_x, d.w*f.stride_x };
+            } else if(f.type == "route") {
+                dims_t first = dims[layerIdx(f.layers[0])];
+                d = { 0, first.h, first.w };
+                for(int l: f.layers)
+                    d.c += dims[layerIdx(l)].c;
+                d.c /= f.groups;
+            } else if(f.type == "reorg") {
+                d = { d.c*f.stride_x*f.stride_x, d.h/f.stride_x, d.w/f.stride_x };
+            } else if(f.type == "sam" || f.type == "scale_channels") {
+                d = dims[layerIdx(f.layers[0])];
+            } else if(f.type == "shortcut") {
+                if(f.weights_type != tk::dnn::SHORTCUT_WEIGHTS_NONE)
+                    convs.push_back({ name, 0, tk::dnn::Shortcut::nWeights(f.layers.size(), d.c, 
+                                      (tk::dnn::tkdnnShortcutWeights_t) f.weights_type), false });
+            } else if(f.type == "yolo" || f.type == "gaussian_yolo") {
+                // mask and anchors are not in the weights file, they come from the cfg
+                std::vector<dnnType> data(f.mask.begin(), f.mask.end());
+                data.insert(data.end(), f.anchors.begin(), f.anchors.end());
+                if(f.anchors.size() != f.num*2)
+                    FatalError("Mismatch between number of anchors and num in yolo layer " + std::to_string(dims.size()));
+                loader->expect(name);
+                loader->provide(name, std::move(data));
+            }
+            dims.push_back(d);
+        }
+        darknetStreamConvWeights(net, weights_file, convs);
+    }
+
+    void darknetStreamConvWeights(tk::dnn::Network *net, const std::string& weights_file, 
+                                  const std::vector<darknetConvWgs_t> &convs) {
+
+        tk::dnn::WeightsLoader *loader = net->getWeightsLoader();
+        for(auto &cw: convs)
+            loader->expect(cw.name);
+
+        // a single task reads the file front to back, layers block only on their own tensor
+        loader->submit([loader, weights_file, convs]() {
+            size_t next = 0;
+            auto failAll = [&](const std::string &error) {
+                for(; next < convs.size(); next++)
+                    loader->fail(convs[next].name, error);
+            };
+
+            std::ifstream file(weights_file, std::ios::in | std::ios::binary);
+            if(!file) {
+                failAll("Error opening weights file " + weights_file);
+                return;
+            }
+            int32_t major = 0, minor = 0, revision = 0;
+            file.read((char*) &major, sizeof(int32_t));
+            file.read((char*) &minor, sizeof(int32_t));
+            file.read((char*) &revision, sizeof(int32_t));
+            if((major*10 + minor) >= 2 && major < 1000 && minor < 1000) {
+                uint64_t seen;
+                file.read((char*) &seen, sizeof(uint64_t));
+            } else {
+                int32_t seen;
+                file.read((char*) &seen, sizeof(int32_t));
+            }
+
+            for(; next < convs.size(); next++) {
+                const darknetConvWgs_t &cw = convs[next];
+                auto start = std::chrono::steady_clock::now();
+
+                // darknet order: bias, [scales, mean, variance], weights
+                int head = cw.outputs * (cw.batchnorm ? 4 : 1);
+                std::vector<dnnType> data(head + cw.weights);
+                if(!file.read((char*) data.data(), data.size()*sizeof(dnnType))) {
+                    failAll("Weights file " + weights_file + " is too short for " + cw.name);
+                    return;
+                }
+                // tkDNN order: weights, bias, [scales, mean, variance]
+                if(cw.connected)
+                    std::rotate(data.begin(), data.begin() + cw.outputs, data.begin() + cw.outputs + cw.weights);
+                else
+                    std::rotate(data.begin(), data.begin() + head, data.end());
+
+                auto end = std::chrono::steady_clock::now();
+                loader->provide(cw.name, std::move(data), std::chrono::duration<double, std::milli>(end - start).count());
+            }
+
+            char extra;
+            if(file.read(&extra, 1))
+                std::cout<<COL_ORANGEB<<"Weights file "<<weights_file<<" has more data than the cfg needs"<<COL_END<<"\n";
+        });
+    }
+
     tk::dnn::Network* darknetParser(const std::string& cfg_file, const std::string& wgs_path, const std::string& names_file) {
 
         tk::dnn::Network *net = nullptr;
@@ -225,186 +480,83 @@ namespace tk { namespace dnn {
         // layers without activations to retrieve correct id number
         std::vector<tk::dnn::Layer*> netLayers;
 
-        std::ifstream if_cfg(cfg_file);
-        if(!if_cfg.is_open())
-            FatalError("cloud not open cfg file: " + cfg_file);
-
         std::vector<std::string> names = darknetReadNames(names_file);
 
-        darknetFields_t fields; // will be filled with layers fields
-        std::string line;
-        while(std::getline(if_cfg, line)) {
-            // remove comments
-            std::size_t found = line.find("#");
-            if ( found != std::string::npos ) {
-                line = line.substr(0, found);
-            }
-
-            // skip empty lines
-            if(line.size() == 0)
-                continue;
-            
-            std::string type = darknetParseType(line);
-            if(type.size() > 0) {
-                // end of filled type
-                if(fields.type != "") {
-                    if(fields.type == "net")
-                        net = darknetAddNet(fields);
-                    else
-                        darknetAddLayer(net, fields, wgs_path, netLayers, names);
-                }
+        // every section is known before building, so that the weights files can be read in advance
+        std::shared_ptr<const darknetCfg_t> cfg = darknetReadCfg(cfg_file);
+        const std::vector<darknetFields_t> &sections = cfg->sections;
 
-                // new type
-                //std::cout<<"type: "<<type<<"\n";
-                fields = darknetFields_t(); // reset to default
-                fields.type = type;
+        // every section after [net] adds one entry to netLayers, this gives the weights ids
+        std::vector<std::string> wgs_files;
+        int layer_id = 0;
+        for(auto &f: sections) {
+            if(f.type == "net")
                 continue;
-            }
-
-            if(darknetParseFields(line, fields)) {
-                // already parsed do nothing
-            } else {
-                FatalError("could not parse line: " + line);
-            }
+            if(f.type == "convolutional" || f.type == "connected")
+                wgs_files.push_back(wgs_path + "/c" + std::to_string(layer_id) + ".bin");
+            else if(f.type == "yolo" || f.type == "gaussian_yolo")
+                wgs_files.push_back(wgs_path + "/g" + std::to_string(layer_id) + ".bin");
+            else if(f.type == "shortcut" && f.weights_type != tk::dnn::SHORTCUT_WEIGHTS_NONE)
+                wgs_files.push_back(wgs_path + "/s" + std::to_string(layer_id) + ".bin");
+            layer_id++;
         }
 
-        // end of filled type
-        if(fields.type != "") {
-            darknetAddLayer(net, fields, wgs_path, netLayers, names);
+        // wgs_path can be the original darknet .weights file instead of the exported layers folder
+        bool darknet_weights = wgs_path.size() > 8 && wgs_path.substr(wgs_path.size() - 8) == ".weights";
+
+        for(darknetFields_t f: sections) {
+            if(f.type == "net") {
+                net = darknetAddNet(f);
+                // reads go on in background while the layers are built
+                if(darknet_weights)
+                    darknetStreamWeights(net, wgs_path, sections);
+                else
+                    net->prefetchWeights(wgs_files);
+            }
+            else
+                darknetAddLayer(net, f, wgs_path, netLayers, names);
         }
 
         if(net == nullptr) {
             FatalError("net not found\n");
         }
+        net->finishWeightsPrefetch();
         return net;
     }
     std::vector<int> noYolosLine(const std::string &cfg_file){
-        std::ifstream if_cfg(cfg_file);
-        if(!if_cfg.is_open())
-            FatalError("cloud not open cfg file: " + cfg_file);
-        std::string line;
         std::vector<int> lineNo;
-        int count = 0;
-        while(std::getline(if_cfg,line)){
-            std::size_t found = line.find("#");
-            if ( found != std::string::npos ) {
-                line = line.substr(0, found);
-            }
-            // skip empty lines
-            if(line.empty())
-                continue;
-            if(line == "[yolo]"){
-                lineNo.push_back(count);
-
-
-            }
-            count++;
-        }
+        for(auto &f: darknetReadCfg(cfg_file)->sections)
+            if(f.type == "yolo" || f.type == "gaussian_yolo")
+                lineNo.push_back(f.line);
         return lineNo;
     }
-    void loadYoloInfo(const std::string &cfg_file,int lineNo,std::vector<float> &mask,std::vector<float> &anchors,int &num,int &classes,float &nms_thresh,int &nms_kind,int &coords){
-        std::vector<float> maskTemp,anchorsTemp;
-        int classesTemp,numTemp,nmsKindTemp;
-        int new_coordsTemp=0;
-        float nmsThreshTemp=0.45;
 
-        std::ifstream if_cfg(cfg_file);
-        if(!if_cfg.is_open())
-            FatalError("cloud not open cfg file: " + cfg_file);
-        std::string line;
-        int count = 0;
-        while(std::getline(if_cfg,line)){
-            std::string name,value;
-            std::size_t found = line.find("#");
-            if ( found != std::string::npos ) {
-                line = line.substr(0, found);
-            }
-            // skip empty lines
-            if(line.empty())
+    void loadYoloInfo(const std::string &cfg_file,int lineNo,std::vector<float> &mask,std::vector<float> &anchors,int &num,int &classes,float &nms_thresh,int &nms_kind,int &coords){
+        for(auto &f: darknetReadCfg(cfg_file)->sections) {
+            if((f.type != "yolo" && f.type != "gaussian_yolo") || f.line != lineNo)
                 continue;
-            if(count > lineNo && count <=lineNo+30){
-                    divideNameAndValue(line,name,value);
-                    if(name == "mask "){
-                        maskTemp = fromStringToFloatVec(value,',');
-                    }
-                    if(name == "anchors "){
-                        anchorsTemp = fromStringToFloatVec(value,',');
-                    }
-                    if(name == "classes"){
-                        classesTemp = std::stoi(value);
-                    }
-                    if(name == "num"){
-                        numTemp = std::stoi(value);
-                    }
-                    if(name == "nms_kind"){
-                        if(value == "greedynms"){
-                            nmsKindTemp = 0;
-                        }else if(value == "diounms"){
-                            nmsKindTemp=1;
-                        }
-                        else{
-                            std::cout<<"NMS NOT SUPPORTED DEFAULTING TO GREEDYNMS"<<std::endl;
-                            nmsKindTemp=0;
-                        }
-                    }
-                    if(name == "new_coords"){
-                        new_coordsTemp = std::stoi(value);
-                    }
-                    if(name == "beta_nms"){
-                        nmsThreshTemp = std::stof(value);
-                    }
-            }
-            count++;
+            mask = f.mask;
+            anchors = f.anchors;
+            num = f.num;
+            nms_kind = f.nms_kind;
+            nms_thresh = f.nms_thresh;
+            coords = f.new_coords;
+            classes = f.classes;
+            return;
         }
-        mask = maskTemp;
-        anchors = anchorsTemp;
-        num = numTemp;
-        nms_kind = nmsKindTemp;
-        nms_thresh = nmsThreshTemp;
-        coords = new_coordsTemp;
-        classes = classesTemp;
-
+        FatalError("no yolo layer at line " + std::to_string(lineNo) + " of " + cfg_file);
     }
-    void loadYoloInitInfo(int &channels,int &width,int &height,const std::string &cfg_file){
-        std::ifstream if_cfg(cfg_file);
-        if(!if_cfg.is_open())
-            FatalError("cloud not open cfg file: " + cfg_file);
-        std::string line;
-        int count = 0;
-
-        while(std::getline(if_cfg,line)){
-            if(count == 7){
-                std::string name,value;
-                divideNameAndValue(line,name,value);
-                if(name == "width"){
-                    width = std::stoi(value);
-                }
-            }
-
-            if(count == 8){
-                std::string name,value;
-                divideNameAndValue(line,name,value);
-                if(name == "height"){
-                    height = std::stoi(value);
-                }
-            }
-
-            if(count == 9){
-                std::string name,value;
-                divideNameAndValue(line,name,value);
-                if(name == "channels"){
-                    channels = std::stoi(value);
-                    break;
-                }
-                else{
-                    std::cerr<<"EXITING PROGRAM DUE TO INSUFFICENT DATA FROM CFG"<<std::endl;
-                    break;
-                }
-            }
 
-            count++;
+    void loadYoloInitInfo(int &channels,int &width,int &height,const std::string &cfg_file){
+        for(auto &f: darknetReadCfg(cfg_file)->sections) {
+            if(f.type != "net")
+                continue;
+            width = f.width;
+            height = f.height;
+            channels = f.channels;
+            return;
         }
-
+        FatalError("no net section in " + cfg_file);
     }
 
 }}
@@ -0,0 +1,259 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <sys/stat.h>
+
+#include "DatasetLoader.h"
+#include "ImageReader.h"
+
+namespace tk { namespace dnn {
+
+static const char DATASET_CACHE_MAGIC[4] = {'T', 'K', 'G', 'T'};
+static const int DATASET_CACHE_VERSION = 2;
+
+// size and modification time of a label file, a missing file is size -1
+static void labelStamp(const std::string &path, int64_t stamp[2]) {
+    struct stat st;
+    if(stat(path.c_str(), &st) != 0) {
+        stamp[0] = -1;
+        stamp[1] = 0;
+        return;
+    }
+    stamp[0] = st.st_size;
+    stamp[1] = st.st_mtime;
+}
+
+static void convertFilename(std::string &filename, const std::string l_folder, const std::string i_folder,
+                            const std::string l_ext, const std::string i_ext) {
+    size_t pos = filename.find(l_folder);
+    if(pos != std::string::npos)
+        filename.replace(pos, l_folder.length(), i_folder);
+    pos = filename.rfind(l_ext);
+    if(pos != std::string::npos)
+        filename.replace(pos, l_ext.length(), i_ext);
+}
+
+DatasetLoader::DatasetLoader(const std::string &labels_list, const int batch_size, const int max_images,
+                             const cv::Size decode_size, const int n_threads, const int prefetch_batches,
+                             const bool gt_cache) :
+    cache_file(labels_list + ".gt.bin"), batch_size(std::max(batch_size, 1)), decode_size(decode_size),
+    gt_cache(gt_cache) {
+    std::ifstream all_labels(labels_list);
+    if(!all_labels)
+        FatalError("Wrong labels file path.");
+    for(std::string line; std::getline(all_labels, line); ) {
+        if(max_images >= 0 && (int) label_files.size() >= max_images)
+            break;
+        if(!line.empty())
+            label_files.push_back(line);
+    }
+
+    if(gt_cache)
+        cache_hit = readCache();
+    if(!cache_hit)
+        gt.assign(label_files.size(), std::vector<BoundingBox>());
+
+    this->n_threads = n_threads > 0 ? n_threads : getCPUThreads();
+    ring.resize(this->batch_size * std::max(prefetch_batches, 1));
+    for(int i=0; i<this->n_threads; i++)
+        workers.emplace_back(&DatasetLoader::worker, this);
+}
+
+DatasetLoader::~DatasetLoader() {
+    stopWorkers();
+}
+
+void DatasetLoader::stopWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stop = true;
+    }
+    cv_free.notify_all();
+    for(auto &w: workers)
+        w.join();
+    workers.clear();
+}
+
+void DatasetLoader::load(const int index, sample_t &sample) {
+    Frame &f = sample.frame;
+    f.lFilename = label_files[index];
+    f.iFilename = label_files[index];
+    convertFilename(f.iFilename, "labels", "images", ".txt", ".jpg");
+
+    auto start = std::chrono::steady_clock::now();
+    cv::Size orig_size;
+    sample.image = imreadReduced(f.iFilename, decode_size.width, decode_size.height, &orig_size);
+    auto end = std::chrono::steady_clock::now();
+    if(!sample.image.data) {
+        sample.error = "Wrong image file path: " + f.iFilename;
+        return;
+    }
+    f.height = orig_size.height;
+    f.width = orig_size.width;
+    double decode = std::chrono::duration<double, std::milli>(end - start).count();
+
+    // labels: <class> <x_center> <y_center> <width> <height>, normalized
+    double parse = 0;
+    if(!cache_hit) {
+        start = std::chrono::steady_clock::now();
+        std::ifstream labels(f.lFilename);
+        for(std::string line; std::getline(labels, line); ) {
+            std::istringstream in(line);
+            BoundingBox b;
+            if(!(in >> b.cl >> b.x >> b.y >> b.w >> b.h))
+                continue;
+            b.prob = 1;
+            b.truthFlag = 1;
+            gt[index].push_back(b);
+        }
+        end = std::chrono::steady_clock::now();
+        parse = std::chrono::duration<double, std::milli>(end - start).count();
+    }
+    f.gt = gt[index];
+
+    std::lock_guard<std::mutex> lock(mtx);
+    decode_ms += decode;
+    parse_ms += parse;
+}
+
+void DatasetLoader::worker() {
+    while(true) {
+        int index;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            // a slot is free once the sample ring.size() positions before it has been read
+            cv_free.wait(lock, [this]{
+                return stop || next_load >= size() || next_load < next_read + (int) ring.size();
+            });
+            if(stop || next_load >= size())
+                return;
+            index = next_load++;
+        }
+
+        sample_t sample;
+        load(index, sample);
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            sample.ready = true;
+            ring[index % ring.size()] = std::move(sample);
+        }
+        cv_ready.notify_all();
+    }
+}
+
+bool DatasetLoader::nextBatch(std::vector<Frame> &frames, std::vector<cv::Mat> &images) {
+    frames.clear();
+    images.clear();
+    std::unique_lock<std::mutex> lock(mtx);
+    while((int) frames.size() < batch_size && next_read < size()) {
+        sample_t &sample = ring[next_read % ring.size()];
+        if(!sample.ready) {
+            auto start = std::chrono::steady_clock::now();
+            cv_ready.wait(lock, [&sample]{ return sample.ready; });
+            wait_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+        if(!sample.error.empty())
+            FatalError(sample.error);
+
+        frames.push_back(std::move(sample.frame));
+        images.push_back(sample.image);
+        sample = sample_t();
+        next_read++;
+        cv_free.notify_all();
+    }
+
+    bool done = next_read >= size();
+    lock.unlock();
+    if(done && gt_cache && !cache_hit && !frames.empty())
+        writeCache();
+    return !frames.empty();
+}
+
+bool DatasetLoader::readCache() {
+    std::ifstream in(cache_file, std::ios::in | std::ios::binary);
+    if(!in)
+        return false;
+
+    char magic[4];
+    int version = 0, n = 0;
+    in.read(magic, sizeof(magic));
+    in.read((char*) &version, sizeof(int));
+    in.read((char*) &n, sizeof(int));
+    if(!in || std::string(magic, 4) != std::string(DATASET_CACHE_MAGIC, 4) ||
+       version != DATASET_CACHE_VERSION || n != size())
+        return false;
+
+    // the cache is valid only for the same list of label files, unchanged
+    std::vector<std::vector<BoundingBox>> cached(n);
+    for(int i=0; i<n; i++) {
+        int len = 0, boxes = 0;
+        int64_t stamp[2], cur[2];
+        in.read((char*) &len, sizeof(int));
+        if(!in || len != (int) label_files[i].size())
+            return false;
+        std::string path(len, ' ');
+        in.read(&path[0], len);
+        in.read((char*) stamp, sizeof(stamp));
+        in.read((char*) &boxes, sizeof(int));
+        if(!in || path != label_files[i] || boxes < 0)
+            return false;
+        labelStamp(label_files[i], cur);
+        if(cur[0] != stamp[0] || cur[1] != stamp[1]) {
+            std::cout<<"Groundtruth cache "<<cache_file<<" is stale ("<<label_files[i]<<" changed), rebuilding\n";
+            return false;
+        }
+
+        cached[i].resize(boxes);
+        for(auto &b: cached[i]) {
+            float v[4];
+            in.read((char*) &b.cl, sizeof(int));
+            in.read((char*) v, sizeof(v));
+            b.x = v[0]; b.y = v[1]; b.w = v[2]; b.h = v[3];
+            b.prob = 1;
+            b.truthFlag = 1;
+        }
+        if(!in)
+            return false;
+    }
+    gt = std::move(cached);
+    std::cout<<"Groundtruth read from "<<cache_file<<"\n";
+    return true;
+}
+
+void DatasetLoader::writeCache() {
+    std::ofstream out(cache_file, std::ios::out | std::ios::binary);
+    if(!out) {
+        std::cout<<"Can't write groundtruth cache "<<cache_file<<"\n";
+        return;
+    }
+    int n = size();
+    out.write(DATASET_CACHE_MAGIC, sizeof(DATASET_CACHE_MAGIC));
+    out.write((const char*) &DATASET_CACHE_VERSION, sizeof(int));
+    out.write((const char*) &n, sizeof(int));
+    for(int i=0; i<n; i++) {
+        int len = label_files[i].size(), boxes = gt[i].size();
+        int64_t stamp[2];
+        labelStamp(label_files[i], stamp);
+        out.write((const char*) &len, sizeof(int));
+        out.write(label_files[i].data(), len);
+        out.write((const char*) stamp, sizeof(stamp));
+        out.write((const char*) &boxes, sizeof(int));
+        for(const auto &b: gt[i]) {
+            float v[4] = { b.x, b.y, b.w, b.h };
+            out.write((const char*) &b.cl, sizeof(int));
+            out.write((const char*) v, sizeof(v));
+        }
+    }
+    cache_hit = true;
+}
+
+void DatasetLoader::printStats() {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::cout<<"Dataset loader: "<<next_read<<"/"<<size()<<" images, "<<n_threads<<" threads, prefetch "
+             <<ring.size()<<" images"<<(cache_hit ? ", cached groundtruth" : "")<<"\n";
+    std::cout<<"    decode "<<decode_ms<<" ms (sum), labels "<<parse_ms<<" ms (sum), consumer blocked "
+             <<wait_ms<<" ms\n";
+}
+
+}}
@@ -3,6 +3,7 @@
 #include "Layer.h"
 #include "kernels.h"
 #include <math.h>
+#include <algorithm>
 
 
 namespace tk { namespace dnn {
@@ -145,4 +146,172 @@ dnnType* DeformConv2d::infer(dataDim_t &dim, dnnType* srcData) {
 }
 
 
+
+/*
+    Host reference of the DCNv2 forward (same math as dcnV2CudaForward):
+        1. preconv (plain im2col + gemm) gives offsets and mask, mask goes through a sigmoid
+        2. bilinear taps (4 neighbours and weights premultiplied by the mask) are precomputed
+           once for each (deformable group, kernel tap, output pixel)
+        3. the sampled columns of every input channel are gathered with the precomputed taps
+        4. output = W * columns + bias2, then batchnorm or bias
+*/
+
+// columns (c*kh*kw) x (out_h*out_w) of a regular zero padded convolution
+static void im2colCPU(const dnnType *im, int c, int h, int w, int kh, int kw,
+                      int sh, int sw, int ph, int pw, int out_h, int out_w, dnnType *col) {
+    parallelFor(c, [&](int c_begin, int c_end) {
+        for(int ch=c_begin; ch<c_end; ch++) {
+            const dnnType *im_c = im + ch*h*w;
+            for(int i=0; i<kh; i++) {
+                for(int j=0; j<kw; j++) {
+                    dnnType *dst = col + ((ch*kh + i)*kw + j)*out_h*out_w;
+                    for(int y=0; y<out_h; y++) {
+                        int iy = y*sh - ph + i;
+                        for(int x=0; x<out_w; x++) {
+                            int ix = x*sw - pw + j;
+                            dst[y*out_w + x] = (iy >= 0 && iy < h && ix >= 0 && ix < w) ? im_c[iy*w + ix] : 0.0f;
+                        }
+                    }
+                }
+            }
+        }
+    });
+}
+
+// dst (M x N) = bias + W (M x K) * col (K x N), output rows are split among threads
+static void gemmBiasCPU(const dnnType *W, const dnnType *col, const dnnType *bias,
+                        dnnType *dst, int M, int N, int K) {
+    const int N_BLOCK = 1024; // keep a slice of the output row in cache while K is swept
+    parallelFor(M, [&](int m_begin, int m_end) {
+        for(int m=m_begin; m<m_end; m++) {
+            dnnType *out = dst + size_t(m)*N;
+            const dnnType *w_m = W + size_t(m)*K;
+            std::fill(out, out + N, bias != nullptr ? bias[m] : 0.0f);
+            for(int nb=0; nb<N; nb+=N_BLOCK) {
+                int ne = std::min(N, nb + N_BLOCK);
+                for(int k=0; k<K; k++) {
+                    const dnnType a = w_m[k];
+                    if(a == 0.0f)
+                        continue;
+                    const dnnType *col_k = col + size_t(k)*N;
+                    for(int n=nb; n<ne; n++)
+                        out[n] += a*col_k[n];
+                }
+            }
+        }
+    });
+}
+
+dnnType* DeformConv2d::inferCPU(dataDim_t &dim, dnnType* srcData_h) {
+
+    // host weights may have been released after the engine build
+    reloadHost();
+    preconv->reloadHost();
+    if(data_h == nullptr || bias2_h == nullptr || preconv->data_h == nullptr)
+        FatalError("DeformConv2d: inferCPU needs the host weights");
+
+    const int batches = dim.n;
+    const int in_c = input_dim.c, in_h = input_dim.h, in_w = input_dim.w;
+    const int out_c = output_dim.c, out_h = output_dim.h, out_w = output_dim.w;
+    const int kk = kernelH*kernelW;
+    const int N = out_h*out_w;
+    const int dg = deformableGroup;
+    const int om_c = preconv->output_dim.c;
+    if(om_c != 3*dg*kk)
+        FatalError("DeformConv2d: unexpected offset/mask channels");
+
+    offsetMask_h.resize(size_t(om_c)*N);
+    columns_h.resize(size_t(in_c)*kk*N);
+    sampleIdx_h.resize(size_t(dg)*kk*N*4);
+    sampleWgs_h.resize(size_t(dg)*kk*N*4);
+    dstData_h.resize(size_t(batches)*out_c*N);
+
+    for(int b=0; b<batches; b++) {
+        const dnnType *src = srcData_h + size_t(b)*in_c*in_h*in_w;
+        dnnType *dst = dstData_h.data() + size_t(b)*out_c*N;
+
+        // offsets and mask
+        im2colCPU(src, in_c, in_h, in_w, kernelH, kernelW, strideH, strideW,
+                  paddingH, paddingW, out_h, out_w, columns_h.data());
+        gemmBiasCPU(preconv->data_h, columns_h.data(), preconv->bias_h,
+                    offsetMask_h.data(), om_c, N, in_c*kk);
+
+        const dnnType *offset_h = offsetMask_h.data();
+        const dnnType *mask_h   = offsetMask_h.data() + size_t(2*dg*kk)*N;
+
+        // bilinear taps, shared by all the channels of a deformable group
+        parallelFor(dg*kk, [&](int t_begin, int t_end) {
+            for(int t=t_begin; t<t_end; t++) {
+                const int g = t / kk;
+                const int i = (t % kk) / kernelW;
+                const int j = (t % kk) % kernelW;
+                const dnnType *off = offset_h + size_t(g*2*kk + 2*(t % kk))*N;
+                const dnnType *msk = mask_h + size_t(t)*N;
+                int *idx = sampleIdx_h.data() + size_t(t)*N*4;
+                dnnType *wgs = sampleWgs_h.data() + size_t(t)*N*4;
+
+                for(int p=0; p<N; p++, idx+=4, wgs+=4) {
+                    const int y = p / out_w, x = p % out_w;
+                    const float h_im = y*strideH - paddingH + i + off[p];
+                    const float w_im = x*strideW - paddingW + j + off[N + p];
+                    const float m = 1.0f / (1.0f + expf(-msk[p]));
+
+                    idx[0] = idx[1] = idx[2] = idx[3] = 0;
+                    wgs[0] = wgs[1] = wgs[2] = wgs[3] = 0.0f;
+                    if(!(h_im > -1 && w_im > -1 && h_im < in_h && w_im < in_w))
+                        continue;
+
+                    const int h_low = floorf(h_im), w_low = floorf(w_im);
+                    const int h_high = h_low + 1, w_high = w_low + 1;
+                    const float lh = h_im - h_low, lw = w_im - w_low;
+                    const float hh = 1 - lh, hw = 1 - lw;
+
+                    if(h_low >= 0 && w_low >= 0)            { idx[0] = h_low*in_w + w_low;   wgs[0] = hh*hw*m; }
+                    if(h_low >= 0 && w_high <= in_w - 1)    { idx[1] = h_low*in_w + w_high;  wgs[1] = hh*lw*m; }
+                    if(h_high <= in_h - 1 && w_low >= 0)    { idx[2] = h_high*in_w + w_low;  wgs[2] = lh*hw*m; }
+                    if(h_high <= in_h - 1 && w_high <= in_w - 1) { idx[3] = h_high*in_w + w_high; wgs[3] = lh*lw*m; }
+                }
+            }
+        });
+
+        // deformable columns
+        const int ch_per_group = in_c / dg;
+        parallelFor(in_c, [&](int c_begin, int c_end) {
+            for(int c=c_begin; c<c_end; c++) {
+                const dnnType *im_c = src + size_t(c)*in_h*in_w;
+                const int g = c / ch_per_group;
+                for(int k=0; k<kk; k++) {
+                    dnnType *col = columns_h.data() + size_t(c*kk + k)*N;
+                    const int *idx = sampleIdx_h.data() + size_t(g*kk + k)*N*4;
+                    const dnnType *wgs = sampleWgs_h.data() + size_t(g*kk + k)*N*4;
+                    for(int p=0; p<N; p++, idx+=4, wgs+=4)
+                        col[p] = wgs[0]*im_c[idx[0]] + wgs[1]*im_c[idx[1]] +
+                                 wgs[2]*im_c[idx[2]] + wgs[3]*im_c[idx[3]];
+                }
+            }
+        });
+
+        gemmBiasCPU(data_h, columns_h.data(), bias2_h, dst, out_c, N, in_c*kk);
+
+        // batchnorm (mean_h and variance_h are already folded by LayerWgs) or bias
+        parallelFor(out_c, [&](int c_begin, int c_end) {
+            for(int c=c_begin; c<c_end; c++) {
+                dnnType *d = dst + size_t(c)*N;
+                if(batchnorm) {
+                    for(int p=0; p<N; p++)
+                        d[p] = (d[p]*variance_h[c] + mean_h[c])*scales_h[c] + bias_h[c];
+                } else {
+                    for(int p=0; p<N; p++)
+                        d[p] += bias_h[c];
+                }
+            }
+        });
+    }
+
+    //update data dimensions
+    dim = output_dim;
+    dim.n = batches;
+    return dstData_h.data();
+}
+
 }}
@@ -4,8 +4,8 @@
 
 namespace tk { namespace dnn {
 
-Dense::Dense(Network *net, int out_ch, std::string fname_weights) : 
-    LayerWgs(net, net->getOutputDim().tot(), out_ch, 1, 1, 1, fname_weights) {
+Dense::Dense(Network *net, int out_ch, std::string fname_weights, bool batchnorm) : 
+    LayerWgs(net, net->getOutputDim().tot(), out_ch, 1, 1, 1, fname_weights, batchnorm) {
 
     output_dim.n = 1;
     output_dim.c = out_ch;
@@ -15,10 +15,19 @@ Dense::Dense(Network *net, int out_ch, std::string fname_weights) :
 
     //allocate data for infer result
     checkCuda( cudaMalloc(&dstData, output_dim.tot()*sizeof(dnnType)) );
+
+    checkCUDNN( cudnnCreateTensorDescriptor(&bnTensorDesc) );
+    if(batchnorm) {
+        checkCUDNN( cudnnSetTensor4dDescriptor(dstTensorDesc,
+                    net->tensorFormat, net->dataType, 1, out_ch, 1, 1) );
+        checkCUDNN( cudnnSetTensor4dDescriptor(bnTensorDesc,
+                    net->tensorFormat, net->dataType, 1, out_ch, 1, 1) );
+    }
 }
 
 Dense::~Dense() {
 
+    checkCUDNN( cudnnDestroyTensorDescriptor(bnTensorDesc) );
     checkCuda( cudaFree(dstData) );
 }
 
@@ -34,8 +43,12 @@ dnnType* Dense::infer(dataDim_t &dim, dnnType* srcData) {
         FatalError("Input mismatch");
 
     dnnType alpha = dnnType(1), beta = dnnType(1);
-    // place bias into dstData
-    checkCuda( cudaMemcpy(dstData, bias_d, dim_y*sizeof(dnnType), cudaMemcpyDeviceToDevice) );
+    // place bias into dstData, with batchnorm the bias is added after the normalization
+    if(!batchnorm) {
+        checkCuda( cudaMemcpy(dstData, bias_d, dim_y*sizeof(dnnType), cudaMemcpyDeviceToDevice) );
+    } else {
+        beta = dnnType(0);
+    }
     
     //do matrix multiplication
     checkERROR( cublasSgemv(net->cublasHandle, CUBLAS_OP_T,
@@ -46,6 +59,16 @@ dnnType* Dense::infer(dataDim_t &dim, dnnType* srcData) {
                             &beta,
                             dstData, 1) );
 
+    if(batchnorm) {
+        beta = dnnType(0);
+        checkCUDNN( cudnnBatchNormalizationForwardInference(net->cudnnHandle,
+                                                CUDNN_BATCHNORM_SPATIAL, &alpha, &beta,
+                                                dstTensorDesc, dstData, dstTensorDesc,
+                                                dstData, bnTensorDesc,
+                                                scales_d, bias_d, mean_d, variance_d,
+                                                TKDNN_BN_MIN_EPSILON) );
+    }
+
     //update data dimensions    
     dim.h = 1;
     dim.w = 1;
@@ -0,0 +1,343 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <string.h>
+#include <limits.h>
+#include <stdlib.h>
+
+#ifdef __linux__
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+#include "EngineCache.h"
+#include "Layer.h"
+#include "NvInfer.h"
+#include "tkdnn.h"
+
+namespace tk { namespace dnn {
+
+/**
+    64 bit hash, a multiply-xorshift step per 8 bytes (the weights are hashed
+    on every start, it has to run at memory speed)
+*/
+struct engineHash_t {
+    uint64_t h = 0x9E3779B97F4A7C15ULL;
+
+    void add(uint64_t w) {
+        h ^= w + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2);
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 32;
+    }
+    void add(const void *data, size_t bytes) {
+        const char *p = (const char*) data;
+        add(bytes);
+        size_t i = 0;
+        for(; i + 8 <= bytes; i += 8) {
+            uint64_t w;
+            memcpy(&w, p + i, 8);
+            add(w);
+        }
+        uint64_t w = 0;
+        memcpy(&w, p + i, bytes - i);
+        add(w);
+    }
+    void add(const std::string &s) { add(s.data(), s.size()); }
+    void add(const dataDim_t &d) {
+        int v[] = { d.n, d.c, d.h, d.w, d.l };
+        add(v, sizeof(v));
+    }
+    void addTensor(const dnnType *data, int n) {
+        if(data != nullptr)
+            add((const void*) data, n*sizeof(dnnType));
+        else
+            add(uint64_t(0));
+    }
+};
+
+static std::string precisionName(Network *net) {
+    // TKDNN_MODE=DLA sets fp16 too
+    if(net->dla)  return "dla";
+    if(net->fp16) return "fp16";
+    if(net->int8) return "int8";
+    return "fp32";
+}
+
+static std::string trtVersion() {
+    return std::to_string(NV_TENSORRT_MAJOR) + "." + std::to_string(NV_TENSORRT_MINOR) + "." +
+           std::to_string(NV_TENSORRT_PATCH);
+}
+
+static std::string deviceName() {
+    int dev = 0;
+    cudaDeviceProp prop;
+    if(cudaGetDevice(&dev) != cudaSuccess || cudaGetDeviceProperties(&prop, dev) != cudaSuccess)
+        return "unknown";
+    return std::string(prop.name) + " sm_" + std::to_string(prop.major) + std::to_string(prop.minor);
+}
+
+engineMeta_t engineMetaFromNetwork(Network *net) {
+    engineMeta_t meta;
+    meta.precision    = precisionName(net);
+    meta.maxBatchSize = net->maxBatchSize;
+    meta.trtVersion   = trtVersion();
+    meta.cudnnVersion = std::to_string(cudnnGetVersion());
+    meta.tkdnnVersion = std::to_string(TKDNN_VERSION);
+    meta.device       = deviceName();
+    meta.input_dim    = net->input_dim;
+    meta.output_dim   = net->getOutputDim();
+    meta.classesNames = net->classesNames;
+
+    engineHash_t hash;
+    hash.add(meta.precision);
+    hash.add(uint64_t(net->fp16) | uint64_t(net->dla) << 1 | uint64_t(net->int8) << 2);
+    hash.add(uint64_t(meta.maxBatchSize));
+    hash.add(meta.trtVersion);
+    hash.add(meta.cudnnVersion);
+    hash.add(meta.tkdnnVersion);
+    hash.add(meta.device);
+    hash.add(net->fileImgList);     // int8 calibration set
+
+    for(int i=0; i<net->num_layers; i++) {
+        Layer *l = net->layers[i];
+        hash.add(uint64_t(l->getLayerType()));
+        hash.add(l->input_dim);
+        hash.add(l->output_dim);
+        hash.add(uint64_t(l->n_params));
+
+        LayerWgs *w = dynamic_cast<LayerWgs*>(l);
+        if(w != nullptr) {
+            // the engine is built from these, after the batchnorm folding
+            hash.addTensor(w->data_h, w->n_params);
+            hash.addTensor(w->bias_h, w->outputs);
+            hash.addTensor(w->bias2_h, w->outputs);
+            hash.addTensor(w->scales_h, w->outputs);
+            hash.addTensor(w->mean_h, w->outputs);
+            hash.addTensor(w->variance_h, w->outputs);
+        }
+
+        if(l->getLayerType() == LAYER_SHORTCUT) {
+            Shortcut *s = (Shortcut*) l;
+            int v[] = { s->mul, int(s->backLayers.size()), s->weights_type, s->weights_normalization };
+            hash.add(v, sizeof(v));
+            if(s->multiInput())
+                hash.addTensor(s->weights_h, (s->backLayers.size() + 1)*s->c);
+        } else if(l->getLayerType() == LAYER_SCALE_CHANNELS) {
+            hash.add(uint64_t(((ScaleChannels*) l)->scale_wh));
+        }
+
+        if(l->getLayerType() == LAYER_YOLO) {
+            Yolo *y = (Yolo*) l;
+            hash.addTensor(y->mask_h, y->n_masks);
+            hash.addTensor(y->bias_h, y->n_masks*y->num*2);
+            int v[] = { y->classes, y->num, y->n_masks, y->nsm_kind, y->new_coords, y->gaussian };
+            hash.add(v, sizeof(v));
+            hash.add(&y->scaleXY, sizeof(y->scaleXY));
+            if(meta.classesNames.empty())
+                meta.classesNames = y->classesNames;
+            engineHead_t head;
+            head.type = l->getLayerName();
+            head.classes = y->classes;
+            head.num = y->num;
+            head.n_masks = y->n_masks;
+            head.dim = l->output_dim;
+            meta.heads.push_back(head);
+        } else if(l->getLayerType() == LAYER_REGION) {
+            Region *r = (Region*) l;
+            int v[] = { r->classes, r->coords, r->num };
+            hash.add(v, sizeof(v));
+            engineHead_t head;
+            head.type = l->getLayerName();
+            head.classes = r->classes;
+            head.num = r->num;
+            head.dim = l->output_dim;
+            meta.heads.push_back(head);
+        } else if(l->final) {
+            engineHead_t head;
+            head.type = l->getLayerName();
+            head.dim = l->output_dim;
+            meta.heads.push_back(head);
+        }
+    }
+
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", (unsigned long long) hash.h);
+    meta.key = key;
+    return meta;
+}
+
+static std::vector<int> dimToVector(const dataDim_t &d) {
+    return { d.n, d.c, d.h, d.w, d.l };
+}
+
+static dataDim_t dimFromNode(const YAML::Node &node) {
+    std::vector<int> v = node.as<std::vector<int>>();
+    if(v.size() != 5)
+        throw std::runtime_error("invalid dim");
+    return dataDim_t(v[0], v[1], v[2], v[3], v[4]);
+}
+
+bool readEngineMeta(const std::string &engine, engineMeta_t &meta) {
+    std::string fname = engine + ".yaml";
+    if(!fileExist(fname.c_str()))
+        return false;
+    try {
+        YAML::Node conf = YAML::LoadFile(fname);
+        engineMeta_t m;
+        m.key          = conf["key"].as<std::string>();
+        m.precision    = YAMLgetConf<std::string>(conf, "precision", "");
+        m.maxBatchSize = YAMLgetConf<int>(conf, "max_batch_size", 1);
+        m.trtVersion   = YAMLgetConf<std::string>(conf, "tensorrt", "");
+        m.cudnnVersion = YAMLgetConf<std::string>(conf, "cudnn", "");
+        m.tkdnnVersion = YAMLgetConf<std::string>(conf, "tkdnn", "");
+        m.device       = YAMLgetConf<std::string>(conf, "device", "");
+        m.input_dim    = dimFromNode(conf["input_dim"]);
+        m.output_dim   = dimFromNode(conf["output_dim"]);
+        if(conf["classes"])
+            m.classesNames = conf["classes"].as<std::vector<std::string>>();
+        YAML::Node heads = conf["heads"];
+        for(size_t i=0; heads && i<heads.size(); i++) {
+            engineHead_t head;
+            head.type    = heads[i]["type"].as<std::string>();
+            head.classes = YAMLgetConf<int>(heads[i], "classes", 0);
+            head.num     = YAMLgetConf<int>(heads[i], "num", 0);
+            head.n_masks = YAMLgetConf<int>(heads[i], "n_masks", 0);
+            head.dim     = dimFromNode(heads[i]["dim"]);
+            m.heads.push_back(head);
+        }
+        meta = m;
+    } catch(const std::exception &e) {
+        std::cout<<COL_REDB<<"Invalid engine metadata "<<fname<<": "<<e.what()<<COL_END<<"\n";
+        return false;
+    }
+    return true;
+}
+
+bool writeEngineMeta(const std::string &engine, const engineMeta_t &meta) {
+    YAML::Emitter out;
+    out << YAML::BeginMap;
+    out << YAML::Key << "key"            << YAML::Value << meta.key;
+    out << YAML::Key << "precision"      << YAML::Value << meta.precision;
+    out << YAML::Key << "max_batch_size" << YAML::Value << meta.maxBatchSize;
+    out << YAML::Key << "tensorrt"       << YAML::Value << meta.trtVersion;
+    out << YAML::Key << "cudnn"          << YAML::Value << meta.cudnnVersion;
+    out << YAML::Key << "tkdnn"          << YAML::Value << meta.tkdnnVersion;
+    out << YAML::Key << "device"         << YAML::Value << meta.device;
+    out << YAML::Key << "input_dim"      << YAML::Value << YAML::Flow << dimToVector(meta.input_dim);
+    out << YAML::Key << "output_dim"     << YAML::Value << YAML::Flow << dimToVector(meta.output_dim);
+    out << YAML::Key << "classes"        << YAML::Value << YAML::Flow << meta.classesNames;
+    out << YAML::Key << "heads"          << YAML::Value << YAML::BeginSeq;
+    for(auto &h: meta.heads) {
+        out << YAML::Flow << YAML::BeginMap;
+        out << YAML::Key << "type"    << YAML::Value << h.type;
+        out << YAML::Key << "classes" << YAML::Value << h.classes;
+        out << YAML::Key << "num"     << YAML::Value << h.num;
+        out << YAML::Key << "n_masks" << YAML::Value << h.n_masks;
+        out << YAML::Key << "dim"     << YAML::Value << YAML::Flow << dimToVector(h.dim);
+        out << YAML::EndMap;
+    }
+    out << YAML::EndSeq;
+    out << YAML::EndMap;
+
+    std::ofstream file(engine + ".yaml");
+    if(!file || !(file << out.c_str() << "\n")) {
+        std::cout<<COL_REDB<<"Could not write engine metadata "<<engine<<".yaml"<<COL_END<<"\n";
+        return false;
+    }
+    return true;
+}
+
+bool engineMetaCompatible(const engineMeta_t &meta) {
+    std::string trt = trtVersion();
+    std::string device = deviceName();
+    bool ok = true;
+    if(meta.trtVersion != trt) {
+        std::cout<<COL_ORANGEB<<"Engine built with TensorRT "<<meta.trtVersion<<", running "<<trt<<COL_END<<"\n";
+        ok = false;
+    }
+    if(meta.device != device) {
+        std::cout<<COL_ORANGEB<<"Engine built for "<<meta.device<<", running on "<<device<<COL_END<<"\n";
+        ok = false;
+    }
+    return ok;
+}
+
+static std::string engineCacheFolder() {
+    if(const char* env_p = std::getenv("TKDNN_ENGINE_CACHE"))
+        return env_p;
+    return "";
+}
+
+std::string engineCachePath(const std::string &name, const std::string &key) {
+    std::string folder = engineCacheFolder();
+    if(folder.empty())
+        return name;
+#ifdef __linux__
+    mkdir(folder.c_str(), 0755);
+#endif
+    std::string base = name.substr(name.find_last_of("/\\") + 1);
+    if(base.size() > 3 && base.compare(base.size() - 3, 3, ".rt") == 0)
+        base = base.substr(0, base.size() - 3);
+    return folder + "/" + base + "_" + key + ".rt";
+}
+
+void engineCacheInsert(const std::string &name, const std::string &engine) {
+    if(name == engine)
+        return;
+#ifdef __linux__
+    // name (and its sidecar) become links to the cached engine
+    for(const std::string ext: { std::string(""), std::string(".yaml") }) {
+        std::string link = name + ext;
+        struct stat st;
+        if(lstat(link.c_str(), &st) == 0)
+            unlink(link.c_str());
+        char target[PATH_MAX];
+        if(realpath((engine + ext).c_str(), target) == nullptr || symlink(target, link.c_str()) != 0)
+            std::cout<<COL_ORANGEB<<"Could not link "<<link<<" to the engine cache"<<COL_END<<"\n";
+    }
+    utime(engine.c_str(), nullptr);
+
+    uint64_t limit = 4096;
+    if(const char* env_p = std::getenv("TKDNN_ENGINE_CACHE_SIZE"))
+        limit = atoll(env_p);
+    limit *= 1024*1024;
+
+    // least recently used first
+    struct entry_t { std::string path; time_t mtime; uint64_t size; };
+    std::vector<entry_t> entries;
+    uint64_t total = 0;
+    std::string folder = engineCacheFolder();
+    DIR *dir = opendir(folder.c_str());
+    if(dir == nullptr)
+        return;
+    while(struct dirent *ent = readdir(dir)) {
+        std::string fname = ent->d_name;
+        if(fname.size() < 3 || fname.compare(fname.size() - 3, 3, ".rt") != 0)
+            continue;
+        std::string path = folder + "/" + fname;
+        struct stat st;
+        if(stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+            continue;
+        entries.push_back({ path, st.st_mtime, uint64_t(st.st_size) });
+        total += st.st_size;
+    }
+    closedir(dir);
+    std::sort(entries.begin(), entries.end(),
+              [](const entry_t &a, const entry_t &b) { return a.mtime < b.mtime; });
+
+    for(auto &e: entries) {
+        if(total <= limit)
+            break;
+        if(e.path == engine)
+            continue;
+        std::cout<<"Engine cache: evict "<<e.path<<"\n";
+        unlink(e.path.c_str());
+        unlink((e.path + ".yaml").c_str());
+        total -= e.size;
+    }
+#endif
+}
+
+}}
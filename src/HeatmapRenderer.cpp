@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "HeatmapRenderer.h"
+
+namespace tk { namespace dnn {
+
+void HeatmapRenderer::init(const int width, const int height) {
+    this->width = width;
+    this->height = height;
+    map.assign(width*height, 0);
+    drawn.clear();
+    cleared.clear();
+}
+
+void HeatmapRenderer::begin() {
+    for(const rect_t &r: drawn)
+        for(int y=r.y0; y<r.y1; y++)
+            std::fill(&map[y*width + r.x0], &map[y*width + r.x1], 0.0f);
+    std::swap(drawn, cleared);
+    drawn.clear();
+}
+
+int HeatmapRenderer::gaussianRadius(const float h, const float w, const float min_overlap) {
+    const double b1 = h + w;
+    const double c1 = w * h * (1 - min_overlap) / (1 + min_overlap);
+    const double r1 = (b1 + std::sqrt(b1*b1 - 4*c1)) / 2;
+
+    const double b2 = 2 * (h + w);
+    const double c2 = (1 - min_overlap) * w * h;
+    const double r2 = (b2 + std::sqrt(b2*b2 - 16*c2)) / 2;
+
+    const double a3 = 4 * min_overlap;
+    const double b3 = -2 * min_overlap * (h + w);
+    const double c3 = (min_overlap - 1) * w * h;
+    const double r3 = (b3 + std::sqrt(b3*b3 - 4*a3*c3)) / 2;
+
+    const double r = std::min(r1, std::min(r2, r3));
+    return r > 0 ? int(r) : 0;
+}
+
+const std::vector<float> &HeatmapRenderer::kernel(const int radius) {
+    if((int) kernels.size() <= radius)
+        kernels.resize(radius + 1);
+    std::vector<float> &k = kernels[radius];
+    if(!k.empty())
+        return k;
+
+    const int d = 2*radius + 1;
+    const double sigma = d / 6.0;
+    const double min_val = std::numeric_limits<double>::epsilon();   // of the max, which is 1
+    k.resize(d*d);
+    for(int y=-radius; y<=radius; y++) {
+        for(int x=-radius; x<=radius; x++) {
+            double g = std::exp(-(x*x + y*y) / (2*sigma*sigma));
+            k[(y + radius)*d + x + radius] = g < min_val ? 0.0f : float(g);
+        }
+    }
+    return k;
+}
+
+void HeatmapRenderer::splat(const float cx, const float cy, const float w, const float h, const float peak) {
+    if(!(cx >= 0 && cy >= 0 && cx < width && cy < height))
+        return;
+    const int radius = std::min(gaussianRadius(std::ceil(h), std::ceil(w)), std::max(width, height));
+    splatRadius(int(cx), int(cy), radius, peak);
+}
+
+void HeatmapRenderer::splatRadius(const int cx, const int cy, const int radius, const float peak) {
+    if(cx < 0 || cy < 0 || cx >= width || cy >= height || radius < 0)
+        return;
+    const std::vector<float> &k = kernel(radius);
+    const int d = 2*radius + 1;
+    const int left = std::min(cx, radius), right = std::min(width - cx, radius + 1);
+    const int top = std::min(cy, radius), bottom = std::min(height - cy, radius + 1);
+
+    for(int y=-top; y<bottom; y++) {
+        float *row = &map[(cy + y)*width + cx];
+        const float *krow = &k[(radius + y)*d + radius];
+        for(int x=-left; x<right; x++)
+            row[x] = std::max(row[x], krow[x]*peak);
+    }
+    drawn.push_back(rect_t{ cx - left, cy - top, cx + right, cy + bottom });
+}
+
+bool HeatmapRenderer::changedRows(int &y0, int &y1) const {
+    y0 = height;
+    y1 = 0;
+    for(const std::vector<rect_t> *rects: { &drawn, &cleared }) {
+        for(const rect_t &r: *rects) {
+            y0 = std::min(y0, r.y0);
+            y1 = std::max(y1, r.y1);
+        }
+    }
+    return y0 < y1;
+}
+
+}}
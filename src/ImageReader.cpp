@@ -0,0 +1,87 @@
+#include <fstream>
+#include <algorithm>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include "ImageReader.h"
+
+namespace tk { namespace dnn {
+
+bool jpegSize(const std::string &fname, int &width, int &height) {
+    std::ifstream in(fname, std::ios::in | std::ios::binary);
+    unsigned char b[8];
+    if(!in.read((char*) b, 2) || b[0] != 0xFF || b[1] != 0xD8)
+        return false;
+
+    while(in.read((char*) b, 1)) {
+        if(b[0] != 0xFF)
+            return false;
+        // skip fill bytes
+        do {
+            if(!in.read((char*) b, 1))
+                return false;
+        } while(b[0] == 0xFF);
+
+        const unsigned char marker = b[0];
+        // markers without a segment
+        if(marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+            continue;
+        if(marker == 0xD9 || marker == 0xDA)   // end of image or start of scan before any frame
+            return false;
+
+        if(!in.read((char*) b, 2))
+            return false;
+        const int len = (b[0] << 8) | b[1];
+        if(len < 2)
+            return false;
+
+        // SOF0..SOF15, except DHT (C4), JPG (C8) and DAC (CC)
+        if(marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            if(len < 7 || !in.read((char*) b, 5))
+                return false;
+            height = (b[1] << 8) | b[2];
+            width  = (b[3] << 8) | b[4];
+            return width > 0 && height > 0;
+        }
+        in.seekg(len - 2, std::ios::cur);
+    }
+    return false;
+}
+
+int jpegReduction(const int width, const int height, const int min_width, const int min_height) {
+    const int min_side = std::max(min_width, min_height);
+    for(int factor = 8; factor > 1; factor /= 2) {
+        int w = (width + factor - 1) / factor;
+        int h = (height + factor - 1) / factor;
+        if(std::min(w, h) >= min_side)
+            return factor;
+    }
+    return 1;
+}
+
+cv::Mat imreadReduced(const std::string &fname, const int min_width, const int min_height,
+                      cv::Size *orig_size) {
+    int width = 0, height = 0, factor = 1;
+    if(min_width > 0 && min_height > 0 && jpegSize(fname, width, height))
+        factor = jpegReduction(width, height, min_width, min_height);
+
+    int flags = cv::IMREAD_COLOR;
+    switch(factor) {
+        case 2: flags = cv::IMREAD_REDUCED_COLOR_2; break;
+        case 4: flags = cv::IMREAD_REDUCED_COLOR_4; break;
+        case 8: flags = cv::IMREAD_REDUCED_COLOR_8; break;
+    }
+    cv::Mat image = cv::imread(fname, flags);
+
+    if(orig_size != nullptr) {
+        *orig_size = cv::Size(image.cols, image.rows);
+        if(factor > 1 && image.data) {
+            // the decoded image can be rotated by its EXIF orientation
+            bool rotated = image.cols != (width + factor - 1) / factor;
+            *orig_size = rotated ? cv::Size(height, width) : cv::Size(width, height);
+        }
+    }
+    return image;
+}
+
+}}
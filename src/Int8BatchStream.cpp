@@ -5,6 +5,8 @@
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include "ImageReader.h"
+
 BatchStream::BatchStream(tk::dnn::dataDim_t dim, int batchSize, int maxBatches, const std::string& fileimglist, const std::string& filelabellist) {
     mBatchSize = batchSize;
     mMaxBatches = maxBatches;
@@ -89,7 +91,12 @@ void BatchStream::readCVimage(std::string inputFileName, std::vector<float>& res
     cv::Mat m_OrigImage;
     // letterboxed DsImage given to the network as input
     cv::Mat m_LetterboxImage;
-    m_OrigImage = cv::imread(inputFileName, cv::IMREAD_COLOR);
+    // with a fixed shape the image is only resized to the network input, so a
+    // reduced JPEG decode is enough
+    if(fixshape)
+        m_OrigImage = tk::dnn::imreadReduced(inputFileName, mWidth, mHeight);
+    else
+        m_OrigImage = cv::imread(inputFileName, cv::IMREAD_COLOR);
 
     if (!m_OrigImage.data || m_OrigImage.cols <= 0 || m_OrigImage.rows <= 0)
         FatalError("Unable to open " + inputFileName);
@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <cmath>
+
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/video/tracking.hpp>
+
+#include "IntervalDetection.h"
+
+namespace tk { namespace dnn {
+
+IntervalDetection::IntervalDetection(tk::dnn::DetectionNN *detNN, const int n_streams) :
+    trackers(n_streams), detNN(detNN), prev_gray(n_streams), gray(n_streams) {
+}
+
+void IntervalDetection::reset() {
+    for(auto &t: trackers)
+        t.clear();
+    batchDetected.clear();
+    since_detection = 0;
+    detect_next = true;
+    processed = detected = 0;
+}
+
+bool IntervalDetection::needDetection() const {
+    if(since_detection + 1 >= interval)
+        return true;
+    if(!adaptive)
+        return false;
+    for(const auto &tr: trackers) {
+        if(tr.uncertainty() > maxUncertainty)
+            return true;
+        // the prediction drifts with the distance travelled without detections
+        for(const auto &t: tr.tracked)
+            if(t.h > 0 && std::sqrt(t.vx*t.vx + t.vy*t.vy) * (since_detection + 1) > maxDisplacement * t.h)
+                return true;
+    }
+    return false;
+}
+
+bool IntervalDetection::update(std::vector<cv::Mat> &frames, const int cur_batches) {
+    if(cur_batches > (int) trackers.size())
+        FatalError("More streams than trackers");
+
+    if(opticalFlow)
+        for(int bi=0; bi<cur_batches; ++bi)
+            cv::cvtColor(frames[bi], gray[bi], cv::COLOR_BGR2GRAY);
+
+    const bool detect = detect_next;
+    batchDetected.resize(cur_batches);
+    if(detect) {
+        detNN->update(frames, cur_batches);
+        for(int bi=0; bi<cur_batches; ++bi) {
+            batchDetected[bi] = detNN->batchDetected[bi];
+            trackers[bi].update(detNN->batchDetected[bi]);
+        }
+        since_detection = 0;
+        detected++;
+    } else {
+        for(int bi=0; bi<cur_batches; ++bi) {
+            // the new tracks too: an object detected once would vanish
+            // on the skipped frames until its track is confirmed
+            trackers[bi].predict(true);
+            if(opticalFlow) {
+                propagateFlow(bi);
+                continue;
+            }
+            std::vector<tk::dnn::box> &out = batchDetected[bi];
+            out.resize(trackers[bi].tracked.size());
+            for(size_t i=0; i<out.size(); i++) {
+                const tk::dnn::trackedBox &t = trackers[bi].tracked[i];
+                out[i].cl = t.cl;
+                out[i].prob = t.prob;
+                out[i].x = t.x;
+                out[i].y = t.y;
+                out[i].w = t.w;
+                out[i].h = t.h;
+                out[i].probs.clear();
+            }
+        }
+        since_detection++;
+    }
+
+    if(opticalFlow)
+        for(int bi=0; bi<cur_batches; ++bi)
+            std::swap(prev_gray[bi], gray[bi]);
+
+    processed++;
+    detect_next = needDetection();
+    return detect;
+}
+
+void IntervalDetection::propagateFlow(const int bi) {
+    std::vector<tk::dnn::box> &boxes = batchDetected[bi];
+    if(boxes.empty() || prev_gray[bi].empty())
+        return;
+    const int P = 5;
+    pts.clear();
+    for(const auto &b: boxes) {
+        // the corners of the inner half of the box and the center, the
+        // real corners are often on the background
+        pts.push_back(cv::Point2f(b.x + b.w*0.25f, b.y + b.h*0.25f));
+        pts.push_back(cv::Point2f(b.x + b.w*0.75f, b.y + b.h*0.25f));
+        pts.push_back(cv::Point2f(b.x + b.w*0.25f, b.y + b.h*0.75f));
+        pts.push_back(cv::Point2f(b.x + b.w*0.75f, b.y + b.h*0.75f));
+        pts.push_back(cv::Point2f(b.x + b.w*0.5f, b.y + b.h*0.5f));
+    }
+    cv::calcOpticalFlowPyrLK(prev_gray[bi], gray[bi], pts, next_pts, status, err);
+
+    for(size_t i=0; i<boxes.size(); i++) {
+        dx.clear();
+        dy.clear();
+        for(int k=0; k<P; k++) {
+            const size_t p = i*P + k;
+            if(status[p]) {
+                dx.push_back(next_pts[p].x - pts[p].x);
+                dy.push_back(next_pts[p].y - pts[p].y);
+            }
+        }
+        if(dx.empty())
+            continue;
+        std::nth_element(dx.begin(), dx.begin() + dx.size()/2, dx.end());
+        std::nth_element(dy.begin(), dy.begin() + dy.size()/2, dy.end());
+        boxes[i].x += dx[dx.size()/2];
+        boxes[i].y += dy[dy.size()/2];
+    }
+}
+
+}}
@@ -17,39 +17,31 @@ LayerWgs::LayerWgs(Network *net, int inputs, int outputs,
 
     std::cout<<"Reading weights: I="<<inputs<<" O="<<outputs<<" KERNEL="<<kh<<"x"<<kw<<"x"<<kl<<"\n";
     int seek = 0;
-    readBinaryFile(weights_path.c_str(), inputs*outputs*kh*kw*kl, &data_h, &data_d, seek);
+    hostView = net->readWeights(weights_path, inputs*outputs*kh*kw*kl, &data_h, &data_d, seek, true);
     seek += inputs*outputs*kh*kw*kl;
     n_params = seek;
     
     this->additional_bias = additional_bias;
     if(additional_bias) {
-        readBinaryFile(weights_path.c_str(), outputs, &bias2_h, &bias2_d, seek);
+        net->readWeights(weights_path, outputs, &bias2_h, &bias2_d, seek, hostView);
         seek += outputs;   
     }
     
-    readBinaryFile(weights_path.c_str(), outputs, &bias_h, &bias_d, seek);
+    net->readWeights(weights_path, outputs, &bias_h, &bias_d, seek, hostView);
     seek += outputs;
 
     this->batchnorm = batchnorm;
     if(batchnorm) {
         
-        readBinaryFile(weights_path.c_str(), outputs, &scales_h, &scales_d, seek);
+        net->readWeights(weights_path, outputs, &scales_h, &scales_d, seek, hostView);
         seek += outputs;
-        readBinaryFile(weights_path.c_str(), outputs, &mean_h, &mean_d, seek);
+        // mean and variance are folded below, always a copy
+        net->readWeights(weights_path, outputs, &mean_h, &mean_d, seek);
         seek += outputs;
-        readBinaryFile(weights_path.c_str(), outputs, &variance_h, &variance_d, seek);
+        net->readWeights(weights_path, outputs, &variance_h, &variance_d, seek);
         seek += outputs;
 
-        float eps = TKDNN_BN_MIN_EPSILON;
-
-        power_h = new dnnType[outputs];
-        for(int i=0; i<outputs; i++) power_h[i] = 1.0f;
-
-        for(int i=0; i<outputs; i++)
-            mean_h[i] = mean_h[i] / -sqrt(eps + variance_h[i]); 
-
-        for(int i=0; i<outputs; i++)
-            variance_h[i] = 1.0f / sqrt(eps + variance_h[i]);
+        foldBatchnorm();
     }
 
 
@@ -117,6 +109,91 @@ LayerWgs::LayerWgs(Network *net, int inputs, int outputs,
     }
 }
 
+void LayerWgs::foldBatchnorm() {
+    float eps = TKDNN_BN_MIN_EPSILON;
+
+    power_h = new dnnType[outputs];
+    for(int i=0; i<outputs; i++) power_h[i] = 1.0f;
+
+    for(int i=0; i<outputs; i++)
+        mean_h[i] = mean_h[i] / -sqrt(eps + variance_h[i]); 
+
+    for(int i=0; i<outputs; i++)
+        variance_h[i] = 1.0f / sqrt(eps + variance_h[i]);
+}
+
+void LayerWgs::reloadHost() {
+    if(data_h != nullptr)
+        return;
+    if(net->weightsResidency == WEIGHTS_DROP)
+        FatalError("Host weights of " + weights_path + " have been dropped");
+
+    int seek = 0;
+    hostView = net->readHostWeights(weights_path, n_params, &data_h, seek, true);
+    seek += n_params;
+    if(additional_bias) {
+        net->readHostWeights(weights_path, outputs, &bias2_h, seek, hostView);
+        seek += outputs;
+    }
+    net->readHostWeights(weights_path, outputs, &bias_h, seek, hostView);
+    seek += outputs;
+    if(batchnorm) {
+        net->readHostWeights(weights_path, outputs, &scales_h, seek, hostView);
+        seek += outputs;
+        net->readHostWeights(weights_path, outputs, &mean_h, seek);
+        seek += outputs;
+        net->readHostWeights(weights_path, outputs, &variance_h, seek);
+        seek += outputs;
+        foldBatchnorm();
+    }
+
+    if(!net->fp16)
+        return;
+
+    // the fp16 device buffers are never released, copy them back
+    auto download16 = [](__half **dst_h, __half *src_d, int size) {
+        if(src_d == nullptr)
+            return;
+        *dst_h = new __half[size];
+        checkCuda( cudaMemcpy(*dst_h, src_d, size*sizeof(__half), cudaMemcpyDeviceToHost) );
+    };
+    download16(&data16_h, data16_d, n_params);
+    download16(&bias16_h, bias16_d, outputs);
+    if(additional_bias)
+        download16(&bias216_h, bias216_d, outputs);
+    if(batchnorm) {
+        download16(&power16_h, power16_d, outputs);
+        download16(&mean16_h, mean16_d, outputs);
+        download16(&variance16_h, variance16_d, outputs);
+        download16(&scales16_h, scales16_d, outputs);
+    }
+}
+
+size_t LayerWgs::hostOwnedBytes() {
+    size_t bytes = 0;
+    if(!hostView) {
+        if(data_h   != nullptr) bytes += n_params*sizeof(dnnType);
+        if(bias_h   != nullptr) bytes += outputs*sizeof(dnnType);
+        if(bias2_h  != nullptr) bytes += outputs*sizeof(dnnType);
+        if(scales_h != nullptr) bytes += outputs*sizeof(dnnType);
+    }
+    if(mean_h     != nullptr) bytes += outputs*sizeof(dnnType);
+    if(variance_h != nullptr) bytes += outputs*sizeof(dnnType);
+    if(power_h    != nullptr) bytes += outputs*sizeof(dnnType);
+
+    if(data16_h != nullptr) bytes += n_params*sizeof(__half);
+    __half *b16[] = { bias16_h, bias216_h, power16_h, scales16_h, mean16_h, variance16_h };
+    for(__half *b: b16)
+        if(b != nullptr) bytes += outputs*sizeof(__half);
+    return bytes;
+}
+
+size_t LayerWgs::hostViewBytes() {
+    if(!hostView || data_h == nullptr)
+        return 0;
+    return (n_params + outputs*((bias2_h != nullptr) + (bias_h != nullptr) + (scales_h != nullptr)))*sizeof(dnnType);
+}
+
 LayerWgs::~LayerWgs() {
     releaseHost();
     releaseDevice();
@@ -0,0 +1,82 @@
+#include <fstream>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.h"
+
+namespace tk { namespace dnn {
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string &fname, bool sequential, bool populate) {
+    close();
+
+#ifdef __linux__
+    int fd = ::open(fname.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    size = st.st_size;
+    int flags = MAP_PRIVATE | (populate ? MAP_POPULATE : 0);
+    void *ptr = mmap(nullptr, size, PROT_READ, flags, fd, 0);
+    ::close(fd);
+    if(ptr == MAP_FAILED) {
+        size = 0;
+        return false;
+    }
+    if(sequential) {
+        madvise(ptr, size, MADV_SEQUENTIAL);
+        madvise(ptr, size, MADV_WILLNEED);
+    }
+    base = (char*) ptr;
+    mapped = true;
+#else
+    std::ifstream file(fname, std::ios::in | std::ios::binary);
+    if(!file)
+        return false;
+    file.seekg(0, file.end);
+    size = file.tellg();
+    file.seekg(0, file.beg);
+    if(size == 0)
+        return false;
+    // new[] of a 64 bit type keeps the content aligned to at least 8 bytes
+    base = (char*) new uint64_t[(size + 7)/8];
+    if(!file.read(base, size)) {
+        close();
+        return false;
+    }
+    mapped = false;
+#endif
+    path = fname;
+    return true;
+}
+
+void MappedFile::close() {
+    if(base != nullptr) {
+#ifdef __linux__
+        if(mapped)
+            munmap(base, size);
+        else
+            delete [] (uint64_t*) base;
+#else
+        delete [] (uint64_t*) base;
+#endif
+    }
+    base = nullptr;
+    mapped = false;
+    size = 0;
+    path = "";
+}
+
+}}
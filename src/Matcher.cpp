@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+#include "Matcher.h"
+
+namespace tk { namespace dnn {
+
+void Matcher::clear(const int n_tracks, const int n_dets) {
+    this->n_tracks = n_tracks;
+    this->n_dets = n_dets;
+    pair_track.clear();
+    pair_det.clear();
+    pair_cost.clear();
+}
+
+void Matcher::addPair(const int track, const int det, const float cost) {
+    pair_track.push_back(track);
+    pair_det.push_back(det);
+    pair_cost.push_back(cost);
+}
+
+void Matcher::reserve(const int n_tracks, const int n_dets, const int n_pairs) {
+    const int n_cols = n_dets + n_tracks;
+    pair_track.reserve(n_pairs);
+    pair_det.reserve(n_pairs);
+    pair_cost.reserve(n_pairs);
+    offsets.reserve(std::max(n_tracks, n_dets) + 1);
+    order.reserve(n_pairs);
+    u.reserve(n_tracks);
+    col4row.reserve(n_tracks);
+    scanned_row.reserve(n_tracks);
+    touched_rows.reserve(n_tracks);
+    det_degree.reserve(n_dets);
+    for(std::vector<double> *c: { &v, &shortest })
+        c->reserve(n_cols);
+    for(std::vector<int> *c: { &path, &row4col, &touched_cols })
+        c->reserve(n_cols);
+    scanned_col.reserve(n_cols);
+    // a scanned row pushes its pairs and its unmatched column
+    heap.reserve(n_pairs + n_tracks);
+}
+
+int Matcher::solve(const matchMode_t mode, const float cost_limit,
+                   std::vector<int> &det_track, std::vector<int> &track_det) {
+    det_track.assign(n_dets, -1);
+    track_det.assign(n_tracks, -1);
+    if(mode == MATCH_GREEDY)
+        greedy(cost_limit, det_track, track_det);
+    else
+        optimal(cost_limit, det_track, track_det);
+
+    int matches = 0;
+    for(int t: det_track)
+        matches += t != -1;
+    return matches;
+}
+
+// counting sort of the pairs under cost_limit by track (rows) or by detection
+static void groupPairs(const std::vector<int> &key, const int n_keys, const std::vector<float> &cost,
+                       const float cost_limit, std::vector<int> &offsets, std::vector<int> &order) {
+    offsets.assign(n_keys + 1, 0);
+    for(size_t p=0; p<key.size(); p++)
+        if(cost[p] < cost_limit)
+            offsets[key[p] + 1]++;
+    for(int k=0; k<n_keys; k++)
+        offsets[k + 1] += offsets[k];
+    order.resize(offsets[n_keys]);
+    for(size_t p=0; p<key.size(); p++)
+        if(cost[p] < cost_limit)
+            order[offsets[key[p]]++] = p;
+    for(int k=n_keys; k>0; k--)
+        offsets[k] = offsets[k - 1];
+    offsets[0] = 0;
+}
+
+void Matcher::greedy(const float cost_limit, std::vector<int> &det_track, std::vector<int> &track_det) {
+    groupPairs(pair_det, n_dets, pair_cost, cost_limit, offsets, order);
+    for(int d=0; d<n_dets; d++) {
+        float best = cost_limit;
+        int best_track = -1;
+        for(int k=offsets[d]; k<offsets[d + 1]; k++) {
+            const int p = order[k];
+            const int t = pair_track[p];
+            if(track_det[t] != -1)
+                continue;
+            if(pair_cost[p] < best || (pair_cost[p] == best && best_track != -1 && t < best_track)) {
+                best = pair_cost[p];
+                best_track = t;
+            }
+        }
+        if(best_track != -1) {
+            det_track[d] = best_track;
+            track_det[best_track] = d;
+        }
+    }
+}
+
+void Matcher::optimal(const float cost_limit, std::vector<int> &det_track, std::vector<int> &track_det) {
+    groupPairs(pair_track, n_tracks, pair_cost, cost_limit, offsets, order);
+
+    // columns: detections, then the unmatched column of each track
+    const int n_cols = n_dets + n_tracks;
+    const double inf = std::numeric_limits<double>::infinity();
+    u.assign(n_tracks, 0);
+    v.assign(n_cols, 0);
+    shortest.assign(n_cols, inf);
+    path.assign(n_cols, -1);
+    row4col.assign(n_cols, -1);
+    col4row.assign(n_tracks, -1);
+    scanned_row.assign(n_tracks, 0);
+    scanned_col.assign(n_cols, 0);
+
+    // a pair alone in its row and in its column is a component of its own,
+    // matched as it is cheaper than the unmatched column: no search needed
+    det_degree.assign(n_dets, 0);
+    for(int k=0; k<offsets[n_tracks]; k++)
+        det_degree[pair_det[order[k]]]++;
+    for(int t=0; t<n_tracks; t++) {
+        if(offsets[t + 1] - offsets[t] != 1)
+            continue;
+        const int d = pair_det[order[offsets[t]]];
+        if(det_degree[d] == 1) {
+            col4row[t] = d;
+            row4col[d] = t;
+        }
+    }
+
+    for(int cur=0; cur<n_tracks; cur++) {
+        if(col4row[cur] != -1)
+            continue;
+        double min_val = 0;
+        int i = cur, sink = -1;
+        heap.clear();
+        touched_rows.clear();
+        touched_cols.clear();
+
+        auto relax = [&](const int j, const double cost) {
+            if(scanned_col[j])
+                return;
+            double r = min_val + cost - u[i] - v[j];
+            if(r < shortest[j]) {
+                if(shortest[j] == inf)
+                    touched_cols.push_back(j);
+                shortest[j] = r;
+                path[j] = i;
+                heap.push_back(std::make_pair(r, j));
+                std::push_heap(heap.begin(), heap.end(), std::greater<std::pair<double, int>>());
+            }
+        };
+
+        // Dijkstra from the row until a free column is reached
+        while(sink == -1) {
+            scanned_row[i] = 1;
+            touched_rows.push_back(i);
+            for(int k=offsets[i]; k<offsets[i + 1]; k++)
+                relax(pair_det[order[k]], pair_cost[order[k]]);
+            relax(n_dets + i, cost_limit);
+
+            int j = -1;
+            while(!heap.empty()) {
+                std::pop_heap(heap.begin(), heap.end(), std::greater<std::pair<double, int>>());
+                std::pair<double, int> top = heap.back();
+                heap.pop_back();
+                if(!scanned_col[top.second] && top.first == shortest[top.second]) {
+                    j = top.second;
+                    break;
+                }
+            }
+            // the unmatched column of every scanned row is reachable, so j is always found
+            min_val = shortest[j];
+            scanned_col[j] = 1;
+            if(row4col[j] == -1)
+                sink = j;
+            else
+                i = row4col[j];
+        }
+
+        // update the potentials
+        u[cur] += min_val;
+        for(int r: touched_rows)
+            if(r != cur)
+                u[r] += min_val - shortest[col4row[r]];
+        for(int j: touched_cols)
+            if(scanned_col[j])
+                v[j] -= min_val - shortest[j];
+
+        // augment along the path
+        int j = sink;
+        while(true) {
+            const int r = path[j];
+            row4col[j] = r;
+            std::swap(col4row[r], j);
+            if(r == cur)
+                break;
+        }
+
+        for(int r: touched_rows)
+            scanned_row[r] = 0;
+        for(int c: touched_cols) {
+            shortest[c] = inf;
+            scanned_col[c] = 0;
+        }
+    }
+
+    for(int t=0; t<n_tracks; t++) {
+        if(col4row[t] < n_dets) {
+            track_det[t] = col4row[t];
+            det_track[col4row[t]] = t;
+        }
+    }
+}
+
+}}
@@ -4,6 +4,8 @@
 #include "tkdnn.h"
 #include "Network.h"
 #include "Layer.h"
+#include "WeightsArchive.h"
+#include "WeightsLoader.h"
 
 namespace tk { namespace dnn {
 
@@ -43,6 +45,22 @@ Network::Network(dataDim_t input_dim) {
     
     if(const char* env_p = std::getenv("TKDNN_CALIB_LABEL_PATH"))
         fileLabelList = env_p;
+
+    useWeightsArchive = true;
+    if(const char* env_p = std::getenv("TKDNN_WEIGHTS_ARCHIVE"))
+        useWeightsArchive = strcmp(env_p, "0") != 0;
+    prefetch = true;
+    if(const char* env_p = std::getenv("TKDNN_WEIGHTS_PREFETCH"))
+        prefetch = strcmp(env_p, "0") != 0;
+    weightsResidency = WEIGHTS_KEEP;
+    if(const char* env_p = std::getenv("TKDNN_WEIGHTS_RESIDENCY")) {
+        if(strcmp(env_p, "drop") == 0)
+            weightsResidency = WEIGHTS_DROP;
+        else if(strcmp(env_p, "reload") == 0)
+            weightsResidency = WEIGHTS_RELOAD;
+        else if(strcmp(env_p, "keep") != 0)
+            std::cout<<"Not supported weights residency "<<env_p<<", keeping host weights\n";
+    }
     
    
     if(fp16)
@@ -103,17 +121,19 @@ void Network::adjustFeatureMapSizeWithShortcuts(){
     for(int i=0; i<num_layers; i++) {
         layer_type = layers[i]->getLayerType();
         if(layer_type == LAYER_SHORTCUT){
-            shortcutted_idx = -1;
-            for(int j=0; j<num_layers; j++) {
-                if(static_cast<tk::dnn::Shortcut*>(layers[i])->backLayer == layers[j]){
-                    shortcutted_idx = j;
-                    break;
+            for(Layer *back: static_cast<tk::dnn::Shortcut*>(layers[i])->backLayers) {
+                shortcutted_idx = -1;
+                for(int j=0; j<num_layers; j++) {
+                    if(back == layers[j]){
+                        shortcutted_idx = j;
+                        break;
+                    }
                 }
+                if(shortcutted_idx == -1)
+                    FatalError("Problem when computing featuer_map_size with shortcuts");
+                for(int j=shortcutted_idx+1; j<i; ++j)
+                    layers[j]->feature_map_size += layers[shortcutted_idx]->output_dim.tot();
             }
-            if(shortcutted_idx == -1)
-                FatalError("Problem when computing featuer_map_size with shortcuts");
-            for(int j=shortcutted_idx+1; j<i; ++j)
-                layers[j]->feature_map_size += layers[shortcutted_idx]->output_dim.tot();
         }
     }
 }
@@ -166,6 +186,208 @@ void Network::print() {
     std::cout<<"N MACC: "<<tot_MACC<<std::endl<<std::endl;
     printCudaMemUsage();
 }
+WeightsArchive* Network::getWeightsArchive(const std::string &fname) {
+    if(!useWeightsArchive)
+        return nullptr;
+
+    size_t sep = fname.find_last_of("/\\");
+    if(sep == std::string::npos)
+        return nullptr;
+    std::string folder = fname.substr(0, sep);
+
+    auto it = weightsArchives.find(folder);
+    if(it == weightsArchives.end()) {
+        // missing archives are cached too, so the folder is probed only once
+        std::shared_ptr<WeightsArchive> wa = std::make_shared<WeightsArchive>();
+        if(wa->open(folder + ".tkw"))
+            std::cout<<"Weights archive: "<<wa->path<<" ("<<wa->names().size()<<" tensors)\n";
+        else
+            wa = nullptr;
+        it = weightsArchives.insert(std::make_pair(folder, wa)).first;
+    }
+    return it->second.get();
+}
+
+void Network::prefetchWeights(const std::vector<std::string> &fnames) {
+    if(!prefetch || dontLoadWeights)
+        return;
+
+    int n = 0;
+    for(auto &f: fnames) {
+        WeightsArchive *wa = getWeightsArchive(f);
+        if(wa != nullptr) {
+            std::string name;
+            removePathAndExtension(f, name);
+            if(wa->has(name))
+                continue;
+        }
+        if(!fileExist(f.c_str()))
+            continue;
+        getWeightsLoader()->enqueue(f);
+        n++;
+    }
+    if(n > 0)
+        std::cout<<"Prefetching "<<n<<" weights files with "<<weightsLoader->n_threads<<" threads\n";
+}
+
+WeightsLoader* Network::getWeightsLoader() {
+    if(weightsLoader == nullptr)
+        weightsLoader = std::make_shared<WeightsLoader>();
+    return weightsLoader.get();
+}
+
+void Network::finishWeightsPrefetch() {
+    if(weightsLoader == nullptr)
+        return;
+    weightsLoader->finish();
+    weightsLoader->printStats();
+}
+
+bool Network::readHostWeights(const std::string &fname, int size, dnnType** data_h, int seek, bool view) {
+
+    WeightsArchive *wa = getWeightsArchive(fname);
+    const dnnType *src = nullptr;
+    int count = 0;
+    std::string from;
+    if(wa != nullptr) {
+        std::string name;
+        removePathAndExtension(fname, name);
+        src = wa->getFloat(name, count);
+        from = wa->path;
+    }
+    if(src == nullptr && weightsLoader != nullptr) {
+        const std::vector<dnnType> *buf = weightsLoader->get(fname);
+        if(buf != nullptr) {
+            src = buf->data();
+            count = buf->size();
+            from = "prefetch buffer";
+        }
+    }
+    if(src == nullptr) {
+        std::ifstream file(fname, std::ios::in | std::ios::binary);
+        if(!file)
+            FatalError("Error opening file " + fname);
+        file.seekg(seek*sizeof(dnnType), file.beg);
+        *data_h = new dnnType[size];
+        if(!file.read((char*) *data_h, size*sizeof(dnnType))) {
+            std::stringstream error_s;
+            error_s << "Error reading file " << fname << " with n of float: "<<size;
+            error_s << " seek: "<<seek << " size: "<<size*sizeof(dnnType)<<"\n";
+            FatalError(error_s.str());
+        }
+        return false;
+    }
+
+    if(seek + size > count) {
+        std::stringstream error_s;
+        error_s << "Error reading " << fname << " from " << from << " with n of float: "<<size;
+        error_s << " seek: "<<seek << " available: "<<count<<"\n";
+        FatalError(error_s.str());
+    }
+    src += seek;
+
+    if(view) {
+        *data_h = const_cast<dnnType*>(src);
+    } else {
+        *data_h = new dnnType[size];
+        memcpy(*data_h, src, size*sizeof(dnnType));
+    }
+    return view;
+}
+
+bool Network::readWeights(const std::string &fname, int size, dnnType** data_h, dnnType** data_d, int seek, bool view) {
+    view = readHostWeights(fname, size, data_h, seek, view);
+    checkCuda( cudaMalloc(data_d, size*sizeof(dnnType)) );
+    checkCuda( cudaMemcpy(*data_d, *data_h, size*sizeof(dnnType), cudaMemcpyHostToDevice) );
+    return view;
+}
+
+size_t Network::printHostWeights(bool per_layer) {
+    size_t tot_owned = 0, tot_view = 0;
+    if(per_layer) {
+        std::cout.width(4); std::cout<<std::left<<"N.";
+        std::cout.width(17); std::cout<<std::left<<"Layer type";
+        std::cout.width(14); std::cout<<std::right<<"owned (B)";
+        std::cout.width(14); std::cout<<std::right<<"view (B)"<<"\n";
+    }
+    for(int i=0; i<num_layers; i++) {
+        LayerWgs *l = dynamic_cast<LayerWgs*>(layers[i]);
+        if(l == nullptr)
+            continue;
+        size_t owned = l->hostOwnedBytes(), view = l->hostViewBytes();
+        tot_owned += owned;
+        tot_view += view;
+        if(per_layer) {
+            std::cout.width(4); std::cout<<std::left<<i;
+            std::cout.width(17); std::cout<<std::left<<l->getLayerName();
+            std::cout.width(14); std::cout<<std::right<<owned;
+            std::cout.width(14); std::cout<<std::right<<view<<"\n";
+        }
+    }
+    // views point into these buffers, they are resident as a whole
+    size_t buffers = weightsLoader != nullptr ? weightsLoader->read_bytes : 0;
+    size_t mapped = 0;
+    for(auto &wa: weightsArchives)
+        if(wa.second != nullptr)
+            mapped += wa.second->size;
+
+    std::cout<<"Host weights: "<<double(tot_owned)/1e6<<" MB owned by layers, "
+             <<double(tot_view)/1e6<<" MB viewed, "
+             <<double(buffers)/1e6<<" MB loader buffers, "
+             <<double(mapped)/1e6<<" MB mapped archives\n";
+    return tot_owned + buffers;
+}
+
+void Network::applyWeightsResidency() {
+    if(weightsResidency == WEIGHTS_KEEP || hostWeightsReleased)
+        return;
+
+    std::cout<<"Releasing host weights ("<<(weightsResidency == WEIGHTS_DROP ? "drop" : "reload")<<")\n";
+    printHostWeights();
+
+    // streamed tensors (darknet .weights) can not be read again one by one
+    bool keepBuffers = false;
+    if(weightsResidency == WEIGHTS_RELOAD) {
+        for(int i=0; i<num_layers && !keepBuffers; i++) {
+            LayerWgs *l = dynamic_cast<LayerWgs*>(layers[i]);
+            if(l != nullptr && l->hostView && weightsLoader != nullptr && weightsLoader->has(l->weights_path) &&
+               !fileExist(l->weights_path.c_str()))
+                keepBuffers = true;
+        }
+        if(keepBuffers)
+            std::cout<<COL_ORANGEB<<"Weights were streamed, keeping the loader buffers to reload them"<<COL_END<<"\n";
+    }
+
+    for(int i=0; i<num_layers; i++) {
+        LayerWgs *l = dynamic_cast<LayerWgs*>(layers[i]);
+        if(l != nullptr)
+            l->releaseHost();
+    }
+    if(!keepBuffers)
+        weightsLoader = nullptr;
+    // mapped pages are clean and backed by the file, they are kept only to reload
+    if(weightsResidency == WEIGHTS_DROP)
+        weightsArchives.clear();
+
+    hostWeightsReleased = true;
+    printHostWeights();
+}
+
+void Network::reloadHostWeights() {
+    if(!hostWeightsReleased)
+        return;
+    if(weightsResidency != WEIGHTS_RELOAD)
+        FatalError("Host weights have been dropped, set TKDNN_WEIGHTS_RESIDENCY=reload to read them again");
+
+    std::cout<<"Reloading host weights\n";
+    for(int i=0; i<num_layers; i++) {
+        LayerWgs *l = dynamic_cast<LayerWgs*>(layers[i]);
+        if(l != nullptr)
+            l->reloadHost();
+    }
+    hostWeightsReleased = false;
+}
+
 const char *Network::getNetworkRTName(const char *network_name){
     networkName = network_name;
     int network_name_len = strlen(network_name);
@@ -11,6 +11,7 @@
 
 #include "NetworkRT.h"
 #include "Int8Calibrator.h"
+#include "MappedFile.h"
 
 
 using namespace nvinfer1;
@@ -54,7 +55,29 @@ NetworkRT::NetworkRT(Network *net, const char *name) {
         configRT = builderRT->createBuilderConfig();
 #endif
 
-    if(!fileExist(name)) {
+    // engines are keyed by what they are built from (see EngineCache.h):
+    // a missing or stale engine is rebuilt, a matching one is loaded
+    std::string rtName = name;
+    bool build = false;
+    if(net != nullptr) {
+        // the key and the builder read the host weights
+        net->reloadHostWeights();
+        meta = engineMetaFromNetwork(net);
+        rtName = engineCachePath(name, meta.key);
+        engineMeta_t cached;
+        if(!fileExist(rtName.c_str())) {
+            build = true;
+        } else if(!readEngineMeta(rtName, cached) || cached.key != meta.key) {
+            std::cout<<COL_ORANGEB<<"Stale engine "<<rtName<<", rebuilding (key "<<meta.key<<")"<<COL_END<<"\n";
+            build = true;
+        }
+    } else if(!readEngineMeta(name, meta)) {
+        std::cout<<COL_ORANGEB<<"No metadata for engine "<<name<<COL_END<<"\n";
+    } else {
+        engineMetaCompatible(meta);
+    }
+
+    if(build) {
 #if NV_TENSORRT_MAJOR >= 6
         // Calibrator life time needs to last until after the engine is built.
         std::unique_ptr<IInt8EntropyCalibrator> calibrator;
@@ -161,23 +184,29 @@ NetworkRT::NetworkRT(Network *net, const char *name) {
         //networkRT->destroy();
         std::cout<<"serialize net\n";
         builderActive = true;
-        serialize(name);
+        serialize(rtName.c_str());
 #else
         if(serializedEngineRT == nullptr){
             FatalError("could not build cuda engine");
         }
         std::cout<<"saving serialized network to file"<<std::endl;
         builderActive = true;
-        serialize(name,serializedEngineRT);
+        serialize(rtName.c_str(),serializedEngineRT);
         delete serializedEngineRT;
 #if NV_TENSORRT_MAJOR >= 8
-        deserialize(name);
+        deserialize(rtName.c_str());
 #endif
 
 #endif
     } else {
         builderActive = false;
-        deserialize(name);
+        deserialize(rtName.c_str());
+    }
+    if(net != nullptr) {
+        if(build)
+            writeEngineMeta(rtName, meta);
+        engineCacheInsert(name, rtName);
+        net->applyWeightsResidency();
     }
 
     std::cout<<"create execution context\n";
@@ -277,6 +306,10 @@ ILayer* NetworkRT::convert_layer(ITensor *input, Layer *l) {
         return convert_layer(input, (Region*) l);
     if(type == LAYER_SHORTCUT)
         return convert_layer(input, (Shortcut*) l);
+    if(type == LAYER_SAM)
+        return convert_layer(input, (Sam*) l);
+    if(type == LAYER_SCALE_CHANNELS)
+        return convert_layer(input, (ScaleChannels*) l);
     if(type == LAYER_YOLO)
         return convert_layer(input, (Yolo*) l);
     if(type == LAYER_UPSAMPLE)
@@ -295,20 +328,46 @@ ILayer* NetworkRT::convert_layer(ITensor *input, Layer *l) {
 
 ILayer* NetworkRT::convert_layer(ITensor *input, Dense *l) {
     //std::cout<<"convert Dense\n";
-    void *data_b, *bias_b;
+    void *data_b, *bias_b, *power_b, *mean_b, *variance_b, *scales_b;
     if(dtRT == DataType::kHALF) {
         data_b     = l->data16_h;
         bias_b     = l->bias16_h;
+        power_b    = l->power16_h;
+        mean_b     = l->mean16_h;
+        variance_b = l->variance16_h;
+        scales_b   = l->scales16_h;
     } else {
         data_b     = l->data_h;
         bias_b     = l->bias_h;
+        power_b    = l->power_h;
+        mean_b     = l->mean_h;
+        variance_b = l->variance_h;
+        scales_b   = l->scales_h;
     }
 
     Weights w { dtRT, data_b, l->inputs*l->outputs};
     Weights b = { dtRT, bias_b, l->outputs};
+    if(l->batchnorm)
+        b = { dtRT, nullptr, 0}; //on batchnorm bias are added later
     IFullyConnectedLayer *lRT = networkRT->addFullyConnected(*input, l->outputs, w, b);
 
     checkNULL(lRT);
+    if(l->batchnorm) {
+        // same as the convolution batchnorm
+        Weights power{dtRT, power_b, l->outputs};
+        Weights shift{dtRT, mean_b, l->outputs};
+        Weights scale{dtRT, variance_b, l->outputs};
+        IScaleLayer *lRT2 = networkRT->addScale(*lRT->getOutput(0), ScaleMode::kCHANNEL,
+                    shift, scale, power);
+        checkNULL(lRT2);
+
+        Weights shift2{dtRT, bias_b, l->outputs};
+        Weights scale2{dtRT, scales_b, l->outputs};
+        IScaleLayer *lRT3 = networkRT->addScale(*lRT2->getOutput(0), ScaleMode::kCHANNEL,
+                    shift2, scale2, power);
+        checkNULL(lRT3);
+        return lRT3;
+    }
     return lRT;
 }
 
@@ -499,6 +558,27 @@ ILayer* NetworkRT::convert_layer(ITensor *input, Pooling *l) {
     if(l->pool_mode == tkdnnPoolingMode_t::POOLING_AVERAGE) ptype = PoolingType::kAVERAGE;
     if(l->pool_mode == tkdnnPoolingMode_t::POOLING_AVERAGE_EXCLUDE_PADDING) ptype = PoolingType::kMAX_AVERAGE_BLEND;
 
+    if(l->pool_mode == tkdnnPoolingMode_t::POOLING_AVERAGE_FIXEDSIZE)
+    {
+        // darknet local_avgpool: asymmetric padding, padded values not counted
+        int pre = l->padding/2, post = l->padding - l->padding/2;
+#if NV_TENSORRT_MAJOR < 8
+        IPoolingLayer *lRT = networkRT->addPooling(*input, PoolingType::kAVERAGE, DimsHW{l->winH, l->winW});
+        checkNULL(lRT);
+        lRT->setStride(DimsHW{l->strideH, l->strideW});
+        lRT->setPrePadding(DimsHW{pre, pre});
+        lRT->setPostPadding(DimsHW{post, post});
+#else
+        IPoolingLayer *lRT = networkRT->addPoolingNd(*input, PoolingType::kAVERAGE, Dims2{l->winH, l->winW});
+        checkNULL(lRT);
+        lRT->setStrideNd(Dims2{l->strideH, l->strideW});
+        lRT->setPrePadding(Dims2{pre, pre});
+        lRT->setPostPadding(Dims2{post, post});
+#endif
+        lRT->setAverageCountExcludesPadding(true);
+        return lRT;
+    }
+
     if(l->pool_mode == tkdnnPoolingMode_t::POOLING_MAX_FIXEDSIZE)
     {
         auto creator = getPluginRegistry()->getPluginCreator("MaxPoolingFixedSizeRT_tkDNN","1");
@@ -788,6 +868,33 @@ ILayer* NetworkRT::convert_layer(ITensor *input, Shortcut *l) {
 
     ITensor *back_tens = tensors[l->backLayer];
 
+    if(l->multiInput())
+    {
+        // every input scaled by its (per channel) weights, then summed
+        ILayer *lRT = nullptr;
+        ITensor *sum = nullptr;
+        for(int i=0; i<=l->backLayers.size(); i++) {
+            ITensor *in = i == 0 ? input : tensors[l->backLayers[i-1]];
+            if(l->weights_type != SHORTCUT_WEIGHTS_NONE) {
+                Weights shift{DataType::kFLOAT, nullptr, 0};
+                Weights scale{DataType::kFLOAT, l->weights_h + i*l->c, l->c};
+                Weights power{DataType::kFLOAT, nullptr, 0};
+                IScaleLayer *lScale = networkRT->addScale(*in, ScaleMode::kCHANNEL, shift, scale, power);
+                checkNULL(lScale);
+                in = lScale->getOutput(0);
+                lRT = lScale;
+            }
+            if(sum != nullptr) {
+                IElementWiseLayer *lSum = networkRT->addElementWise(*sum, *in, ElementWiseOperation::kSUM);
+                checkNULL(lSum);
+                in = lSum->getOutput(0);
+                lRT = lSum;
+            }
+            sum = in;
+        }
+        return lRT;
+    }
+
     if(l->backLayer->output_dim.c == l->output_dim.c && !l->mul)
     {
         IElementWiseLayer *lRT = networkRT->addElementWise(*input, *back_tens, ElementWiseOperation::kSUM);
@@ -819,6 +926,49 @@ ILayer* NetworkRT::convert_layer(ITensor *input, Shortcut *l) {
     }
 }
 
+ILayer* NetworkRT::convert_layer(ITensor *input, Sam *l) {
+
+    IElementWiseLayer *lRT = networkRT->addElementWise(*tensors[l->backLayer], *input, ElementWiseOperation::kPROD);
+    checkNULL(lRT);
+    return lRT;
+}
+
+ILayer* NetworkRT::convert_layer(ITensor *input, ScaleChannels *l) {
+
+    ITensor *back_tens = tensors[l->backLayer];
+
+    if(l->scale_wh) {
+#if NV_TENSORRT_MAJOR >= 6
+        // the 1 channel input is broadcast over the channels
+        IElementWiseLayer *lRT = networkRT->addElementWise(*back_tens, *input, ElementWiseOperation::kPROD);
+        checkNULL(lRT);
+        return lRT;
+#else
+        FatalError("ScaleChannels with scale_wh needs tensorRT 6 or newer");
+#endif
+    }
+
+    // the shortcut plugin in mul mode scales every channel of the first input
+    auto creator = getPluginRegistry()->getPluginCreator("ShortcutRT_tkDNN","1");
+    std::vector<PluginField> mPluginAttributes;
+    PluginFieldCollection mFC{};
+    bool mul = true;
+    mPluginAttributes.emplace_back(PluginField("bc",&l->input_dim.c,PluginFieldType::kINT32,1));
+    mPluginAttributes.emplace_back(PluginField("bh",&l->input_dim.h,PluginFieldType::kINT32,1));
+    mPluginAttributes.emplace_back(PluginField("bw",&l->input_dim.w,PluginFieldType::kINT32,1));
+    mPluginAttributes.emplace_back(PluginField("mul",&mul,PluginFieldType::kUNKNOWN,1));
+    mPluginAttributes.emplace_back(PluginField("c",&l->output_dim.c,PluginFieldType::kINT32,1));
+    mPluginAttributes.emplace_back(PluginField("h",&l->output_dim.h,PluginFieldType::kINT32,1));
+    mPluginAttributes.emplace_back(PluginField("w",&l->output_dim.w,PluginFieldType::kINT32,1));
+    mFC.nbFields = mPluginAttributes.size();
+    mFC.fields = mPluginAttributes.data();
+    auto *plugin = creator->createPlugin(l->getLayerName().c_str(),&mFC);
+    ITensor *inputs[2] = { back_tens, input };
+    auto *lRT = networkRT->addPluginV2(inputs, 2, *plugin);
+    checkNULL(lRT);
+    return lRT;
+}
+
 IPluginV2Layer* NetworkRT::convert_layer(ITensor *input, Yolo *l) {
 
     auto creator = getPluginRegistry()->getPluginCreator("YoloRT_tkDNN","1");
@@ -839,6 +989,8 @@ IPluginV2Layer* NetworkRT::convert_layer(ITensor *input, Yolo *l) {
     for(int i=0; i<l->classes; i++) {
         mPluginAttributes.emplace_back(PluginField("class_name",l->classesNames[i].data(),PluginFieldType::kCHAR,l->classesNames[i].size()));
     }
+    int gaussian = l->gaussian;
+    mPluginAttributes.emplace_back(PluginField("gaussian",&gaussian,PluginFieldType::kINT32,1));
 
     mFC.nbFields = mPluginAttributes.size();
     mFC.fields = mPluginAttributes.data();
@@ -1002,30 +1154,31 @@ bool NetworkRT::serialize(const char *filename,nvinfer1::IHostMemory *ptr){
 
 bool NetworkRT::deserialize(const char *filename) {
 
-    char *gieModelStream{nullptr};
-    size_t size{0};
-    std::ifstream file(filename, std::ios::binary);
-    if (file.good()) {
-        file.seekg(0, file.end);
-        size = file.tellg();
-        file.seekg(0, file.beg);
-        gieModelStream = new char[size];
-        file.read(gieModelStream, size);
-        file.close();
-    }
+    // the plan is mapped and faulted in at once, the runtime copies what it
+    // needs so the mapping is released right after
+    auto start = std::chrono::steady_clock::now();
+    MappedFile file;
+    if(!file.open(filename, true, true))
+        FatalError(std::string("could not read engine file ") + filename);
+    auto loaded = std::chrono::steady_clock::now();
 
     runtimeRT = createInferRuntime(loggerRT);
 
     gYoloPlugins_mutex.lock();
     gYoloPlugins.clear();
-    engineRT = runtimeRT->deserializeCudaEngine(gieModelStream, size);
+    engineRT = runtimeRT->deserializeCudaEngine(file.data(), file.size);
     yolo_plugins = gYoloPlugins;
     gYoloPlugins.clear();
     gYoloPlugins_mutex.unlock();
-
-    std::cout<<size<<std::endl;
-    //if (gieModelStream) delete [] gieModelStream;
-
+    uint64_t size = file.size;
+    file.close();
+    if(engineRT == nullptr)
+        FatalError(std::string("could not deserialize engine ") + filename);
+
+    auto end = std::chrono::steady_clock::now();
+    std::cout<<"Engine "<<filename<<" ("<<size/(1024*1024)<<" MB): load "
+             <<std::chrono::duration<double, std::milli>(loaded - start).count()<<" ms, deserialize "
+             <<std::chrono::duration<double, std::milli>(end - loaded).count()<<" ms\n";
     return true;
 }
 
@@ -0,0 +1,321 @@
+#include <iostream>
+#include <fstream>
+#include <string.h>
+
+#include "NetworkSnapshot.h"
+#include "Layer.h"
+#include "MappedFile.h"
+#include "WeightsLoader.h"
+#include "DarknetParser.h"
+
+namespace tk { namespace dnn {
+
+static const char SN_MAGIC[8] = { 'T', 'K', 'D', 'N', 'N', 'S', 'N', '\0' };
+
+static void dimToArray(const dataDim_t &dim, int32_t *a) {
+    a[0] = dim.n; a[1] = dim.c; a[2] = dim.h; a[3] = dim.w; a[4] = dim.l;
+}
+
+static bool dimEqual(const dataDim_t &dim, const int32_t *a) {
+    return dim.n == a[0] && dim.c == a[1] && dim.h == a[2] && dim.w == a[3] && dim.l == a[4];
+}
+
+static uint64_t align8(uint64_t off) {
+    return (off + 7) & ~uint64_t(7);
+}
+
+void saveNetworkSnapshot(Network *net, const std::string &fname) {
+
+    std::vector<snapshot::layer_t> records(net->num_layers);
+    std::vector<int32_t> refs;
+    std::vector<float> data;
+    std::vector<int32_t> names;
+    std::string strings;
+    std::vector<std::string> classNames;
+
+    auto addString = [&strings](const std::string &str, int32_t &offset, int32_t &n) {
+        offset = strings.size();
+        n = str.size();
+        strings += str;
+    };
+
+    for(int i=0; i<net->num_layers; i++) {
+        Layer *l = net->layers[i];
+        snapshot::layer_t &r = records[i];
+        memset(&r, 0, sizeof(r));
+        r.type = l->getLayerType();
+        dimToArray(l->input_dim, r.input_dim);
+        dimToArray(l->output_dim, r.output_dim);
+        r.refs_offset = refs.size();
+        r.data_offset = data.size();
+
+        switch(l->getLayerType()) {
+        case LAYER_CONV2D: {
+            Conv2d *c = (Conv2d*) l;
+            int32_t p[] = { c->outputs, c->kernelH, c->kernelW, c->strideH, c->strideW,
+                            c->paddingH, c->paddingW, c->batchnorm, c->deConv, c->groups, c->additional_bias };
+            memcpy(r.i, p, sizeof(p));
+            addString(c->weights_path, r.str_offset, r.str_n);
+            break;
+        }
+        case LAYER_DENSE: {
+            Dense *d = (Dense*) l;
+            r.i[0] = d->outputs;
+            r.i[1] = d->batchnorm;
+            addString(d->weights_path, r.str_offset, r.str_n);
+            break;
+        }
+        case LAYER_POOLING: {
+            Pooling *p = (Pooling*) l;
+            int32_t v[] = { p->winH, p->winW, p->strideH, p->strideW, p->paddingH, p->paddingW, p->pool_mode };
+            memcpy(r.i, v, sizeof(v));
+            break;
+        }
+        case LAYER_ACTIVATION:
+        case LAYER_ACTIVATION_CRELU:
+        case LAYER_ACTIVATION_LEAKY:
+        case LAYER_ACTIVATION_MISH:
+        case LAYER_ACTIVATION_LOGISTIC: {
+            Activation *a = (Activation*) l;
+            r.i[0] = a->act_mode;
+            r.f[0] = a->ceiling;
+            r.f[1] = a->slope;
+            break;
+        }
+        case LAYER_SHORTCUT: {
+            Shortcut *s = (Shortcut*) l;
+            for(Layer *b: s->backLayers)
+                refs.push_back(b->id);
+            r.i[0] = s->mul;
+            r.i[1] = s->weights_type;
+            r.i[2] = s->weights_normalization;
+            addString(s->weights_path, r.str_offset, r.str_n);
+            break;
+        }
+        case LAYER_SAM:
+            refs.push_back(((Sam*) l)->backLayer->id);
+            break;
+        case LAYER_SCALE_CHANNELS: {
+            ScaleChannels *sc = (ScaleChannels*) l;
+            refs.push_back(sc->backLayer->id);
+            r.i[0] = sc->scale_wh;
+            break;
+        }
+        case LAYER_UPSAMPLE:
+            r.i[0] = ((Upsample*) l)->stride;
+            break;
+        case LAYER_ROUTE: {
+            Route *rt = (Route*) l;
+            for(int j=0; j<rt->layers_n; j++)
+                refs.push_back(rt->layers[j]->id);
+            r.i[0] = rt->groups;
+            r.i[1] = rt->group_id;
+            break;
+        }
+        case LAYER_REORG:
+            r.i[0] = ((Reorg*) l)->stride;
+            break;
+        case LAYER_REGION: {
+            Region *rg = (Region*) l;
+            r.i[0] = rg->classes;
+            r.i[1] = rg->coords;
+            r.i[2] = rg->num;
+            break;
+        }
+        case LAYER_YOLO: {
+            Yolo *y = (Yolo*) l;
+            int32_t v[] = { y->classes, y->num, y->n_masks, y->nsm_kind, y->new_coords, y->gaussian };
+            memcpy(r.i, v, sizeof(v));
+            r.f[0] = y->scaleXY;
+            r.f[1] = y->nms_thresh;
+            if(y->mask_h == nullptr || y->bias_h == nullptr)
+                FatalError("Network snapshot: yolo layer " + std::to_string(i) + " without masks and anchors");
+            data.insert(data.end(), y->mask_h, y->mask_h + y->n_masks);
+            data.insert(data.end(), y->bias_h, y->bias_h + y->n_masks*y->num*2);
+            if(classNames.empty())
+                classNames = y->classesNames;
+            break;
+        }
+        default:
+            FatalError("Network snapshot: layer not supported " + l->getLayerName());
+        }
+        r.refs_n = refs.size() - r.refs_offset;
+        r.data_n = data.size() - r.data_offset;
+    }
+
+    for(auto &n: classNames) {
+        int32_t offset, len;
+        addString(n, offset, len);
+        names.push_back(offset);
+        names.push_back(len);
+    }
+
+    snapshot::header_t h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SN_MAGIC, sizeof(SN_MAGIC));
+    h.version = snapshot::VERSION;
+    h.n_layers = records.size();
+    dimToArray(net->input_dim, h.input_dim);
+    h.n_names = classNames.size();
+    h.layers_offset  = align8(sizeof(h));
+    h.refs_offset    = align8(h.layers_offset + records.size()*sizeof(snapshot::layer_t));
+    h.data_offset    = align8(h.refs_offset + refs.size()*sizeof(int32_t));
+    h.names_offset   = align8(h.data_offset + data.size()*sizeof(float));
+    h.strings_offset = align8(h.names_offset + names.size()*sizeof(int32_t));
+    h.size           = h.strings_offset + strings.size();
+
+    std::vector<char> buf(h.size, 0);
+    memcpy(buf.data(), &h, sizeof(h));
+    memcpy(buf.data() + h.layers_offset, records.data(), records.size()*sizeof(snapshot::layer_t));
+    memcpy(buf.data() + h.refs_offset, refs.data(), refs.size()*sizeof(int32_t));
+    memcpy(buf.data() + h.data_offset, data.data(), data.size()*sizeof(float));
+    memcpy(buf.data() + h.names_offset, names.data(), names.size()*sizeof(int32_t));
+    memcpy(buf.data() + h.strings_offset, strings.data(), strings.size());
+
+    std::ofstream file(fname, std::ios::out | std::ios::binary);
+    if(!file || !file.write(buf.data(), buf.size()))
+        FatalError("Could not write network snapshot " + fname);
+    std::cout<<"Network snapshot saved: "<<fname<<" ("<<records.size()<<" layers, "<<buf.size()<<" bytes)\n";
+}
+
+Network* loadNetworkSnapshot(const std::string &fname) {
+
+    MappedFile file;
+    if(!file.open(fname) || file.size < sizeof(snapshot::header_t))
+        return nullptr;
+
+    const char *base = file.data();
+    const snapshot::header_t *h = (const snapshot::header_t*) base;
+    if(memcmp(h->magic, SN_MAGIC, sizeof(SN_MAGIC)) != 0 || h->version != snapshot::VERSION ||
+       h->size != file.size || h->layers_offset + h->n_layers*sizeof(snapshot::layer_t) > h->size ||
+       h->strings_offset > h->size) {
+        std::cout<<COL_REDB<<"Invalid network snapshot: "<<fname<<COL_END<<"\n";
+        return nullptr;
+    }
+    const snapshot::layer_t *records = (const snapshot::layer_t*) (base + h->layers_offset);
+    const int32_t *refs    = (const int32_t*) (base + h->refs_offset);
+    const float *data      = (const float*) (base + h->data_offset);
+    const int32_t *names   = (const int32_t*) (base + h->names_offset);
+    const char *strings    = base + h->strings_offset;
+    auto getString = [strings](int32_t offset, int32_t n) { return std::string(strings + offset, n); };
+
+    std::vector<std::string> classNames;
+    for(uint32_t i=0; i<h->n_names; i++)
+        classNames.push_back(getString(names[2*i], names[2*i + 1]));
+
+    dataDim_t input_dim(h->input_dim[0], h->input_dim[1], h->input_dim[2], h->input_dim[3], h->input_dim[4]);
+    Network *net = new Network(input_dim);
+
+    // start every weights read before building, like the darknet parser
+    std::vector<std::string> wgs_files;
+    std::map<std::string, std::vector<darknetConvWgs_t>> streams;
+    for(uint32_t i=0; i<h->n_layers; i++) {
+        const snapshot::layer_t &r = records[i];
+        if(r.type != LAYER_CONV2D && r.type != LAYER_DENSE && r.type != LAYER_SHORTCUT)
+            continue;
+        std::string path = getString(r.str_offset, r.str_n);
+        if(path.empty())
+            continue;
+        size_t sep = path.rfind(".weights/");
+        if(sep != std::string::npos) {
+            darknetConvWgs_t cw;
+            if(r.type == LAYER_CONV2D) {
+                int outputs = r.i[0], groups = r.i[9];
+                cw = { path, outputs, outputs*(r.input_dim[1]/groups)*r.i[1]*r.i[2], r.i[7] != 0 };
+            } else if(r.type == LAYER_DENSE) {
+                int inputs = r.input_dim[1]*r.input_dim[2]*r.input_dim[3]*r.input_dim[4];
+                cw = { path, r.i[0], r.i[0]*inputs, r.i[1] != 0, true };
+            } else {
+                cw = { path, 0, Shortcut::nWeights(r.refs_n, r.input_dim[1], (tkdnnShortcutWeights_t) r.i[1]), false };
+            }
+            streams[path.substr(0, sep + 8)].push_back(cw);
+        } else {
+            wgs_files.push_back(path);
+        }
+    }
+    for(auto &s: streams)
+        darknetStreamConvWeights(net, s.first, s.second);
+    net->prefetchWeights(wgs_files);
+
+    for(uint32_t i=0; i<h->n_layers; i++) {
+        const snapshot::layer_t &r = records[i];
+        std::vector<Layer*> refLayers;
+        for(int j=0; j<r.refs_n; j++) {
+            int id = refs[r.refs_offset + j];
+            if(id < 0 || id >= net->num_layers)
+                FatalError("Network snapshot: invalid layer reference in " + fname);
+            refLayers.push_back(net->layers[id]);
+        }
+
+        Layer *l = nullptr;
+        switch(r.type) {
+        case LAYER_CONV2D:
+            l = new Conv2d(net, r.i[0], r.i[1], r.i[2], r.i[3], r.i[4], r.i[5], r.i[6],
+                           getString(r.str_offset, r.str_n), r.i[7], r.i[8], r.i[9], r.i[10]);
+            break;
+        case LAYER_DENSE:
+            l = new Dense(net, r.i[0], getString(r.str_offset, r.str_n), r.i[1]);
+            break;
+        case LAYER_POOLING:
+            l = new Pooling(net, r.i[0], r.i[1], r.i[2], r.i[3], r.i[4], r.i[5], (tkdnnPoolingMode_t) r.i[6]);
+            break;
+        case LAYER_ACTIVATION:
+        case LAYER_ACTIVATION_CRELU:
+        case LAYER_ACTIVATION_LEAKY:
+        case LAYER_ACTIVATION_MISH:
+        case LAYER_ACTIVATION_LOGISTIC:
+            l = new Activation(net, r.i[0], r.f[0], r.f[1]);
+            break;
+        case LAYER_SHORTCUT:
+            if(refLayers.size() == 0) FatalError("Network snapshot: no layers to shortcut\n");
+            if(refLayers.size() == 1 && r.i[1] == SHORTCUT_WEIGHTS_NONE)
+                l = new Shortcut(net, refLayers[0], r.i[0]);
+            else
+                l = new Shortcut(net, refLayers, getString(r.str_offset, r.str_n),
+                                 (tkdnnShortcutWeights_t) r.i[1], (tkdnnShortcutNormalization_t) r.i[2]);
+            break;
+        case LAYER_SAM:
+            if(refLayers.size() != 1) FatalError("Network snapshot: no layer to sam\n");
+            l = new Sam(net, refLayers[0]);
+            break;
+        case LAYER_SCALE_CHANNELS:
+            if(refLayers.size() != 1) FatalError("Network snapshot: no layer to scale_channels\n");
+            l = new ScaleChannels(net, refLayers[0], r.i[0]);
+            break;
+        case LAYER_UPSAMPLE:
+            l = new Upsample(net, r.i[0]);
+            break;
+        case LAYER_ROUTE:
+            l = new Route(net, refLayers.data(), refLayers.size(), r.i[0], r.i[1]);
+            break;
+        case LAYER_REORG:
+            l = new Reorg(net, r.i[0]);
+            break;
+        case LAYER_REGION:
+            l = new Region(net, r.i[0], r.i[1], r.i[2]);
+            break;
+        case LAYER_YOLO: {
+            // masks and anchors are stored inline, the layer reads them from the loader
+            std::string wgs = fname + "/g" + std::to_string(i) + ".bin";
+            WeightsLoader *loader = net->getWeightsLoader();
+            loader->expect(wgs);
+            loader->provide(wgs, std::vector<dnnType>(data + r.data_offset, data + r.data_offset + r.data_n));
+            Yolo *y = new Yolo(net, r.i[0], r.i[1], wgs, r.i[2], r.f[0], r.f[1], (Yolo::nmsKind_t) r.i[3], r.i[4], r.i[5]);
+            if(classNames.size() != y->classes)
+                FatalError("Mismatch between number of classes and names");
+            y->classesNames = classNames;
+            l = y;
+            break;
+        }
+        default:
+            FatalError("Network snapshot: layer type not supported " + std::to_string(r.type));
+        }
+
+        if(!dimEqual(l->input_dim, r.input_dim) || !dimEqual(l->output_dim, r.output_dim))
+            FatalError("Network snapshot " + fname + " does not match layer " + std::to_string(i) + " " + l->getLayerName());
+    }
+    net->finishWeightsPrefetch();
+    return net;
+}
+
+}}
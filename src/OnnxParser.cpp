@@ -0,0 +1,792 @@
+#include <iostream>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include "tkDNN/OnnxParser.h"
+#include "tkDNN/MappedFile.h"
+#include "tkDNN/WeightsLoader.h"
+
+namespace tk { namespace dnn {
+
+    // onnx TensorProto.DataType
+    enum onnxDataType_t { ONNX_FLOAT = 1, ONNX_UINT8 = 2, ONNX_INT8 = 3, ONNX_INT32 = 6,
+                          ONNX_INT64 = 7, ONNX_FLOAT16 = 10, ONNX_DOUBLE = 11 };
+
+    /**
+        Protobuf wire format reader over a message (or a sub message) in memory.
+        Fields are (key, value) pairs, key = field number << 3 | wire type.
+    */
+    struct onnxWire_t {
+        const uint8_t *p, *end;
+        std::string what;   // message being decoded, for the errors
+
+        bool more() const { return p < end; }
+        void need(uint64_t n) {
+            if(uint64_t(end - p) < n)
+                FatalError("truncated onnx " + what);
+        }
+        uint64_t varint() {
+            uint64_t v = 0;
+            for(int shift = 0; shift < 64; shift += 7) {
+                need(1);
+                uint8_t b = *p++;
+                v |= uint64_t(b & 0x7f) << shift;
+                if(!(b & 0x80))
+                    return v;
+            }
+            FatalError("bad varint in onnx " + what);
+        }
+        void key(int &field, int &wire) {
+            uint64_t k = varint();
+            field = int(k >> 3);
+            wire  = int(k & 7);
+        }
+        onnxWire_t sub(const std::string &sub_what = "") {
+            uint64_t n = varint();
+            need(n);
+            onnxWire_t r = { p, p + n, sub_what.empty() ? what : sub_what };
+            p += n;
+            return r;
+        }
+        std::string string() {
+            onnxWire_t r = sub();
+            return std::string((const char*) r.p, r.end - r.p);
+        }
+        float f32() {
+            need(4);
+            float v;
+            memcpy(&v, p, 4);
+            p += 4;
+            return v;
+        }
+        double f64() {
+            need(8);
+            double v;
+            memcpy(&v, p, 8);
+            p += 8;
+            return v;
+        }
+        void skip(int wire) {
+            switch(wire) {
+                case 0: varint();       break;
+                case 1: need(8); p += 8; break;
+                case 2: sub();          break;
+                case 5: need(4); p += 4; break;
+                default: FatalError("unsupported protobuf wire type " + std::to_string(wire) + " in onnx " + what);
+            }
+        }
+
+        // repeated fields, packed (wire type 2) or one value per key
+        void ints(int wire, std::vector<int64_t> &v) {
+            if(wire != 2) {
+                v.push_back(int64_t(varint()));
+                return;
+            }
+            onnxWire_t r = sub();
+            while(r.more())
+                v.push_back(int64_t(r.varint()));
+        }
+        void floats(int wire, std::vector<float> &v) {
+            if(wire != 2) {
+                v.push_back(f32());
+                return;
+            }
+            onnxWire_t r = sub();
+            while(r.more())
+                v.push_back(r.f32());
+        }
+        void doubles(int wire, std::vector<float> &v) {
+            if(wire != 2) {
+                v.push_back(float(f64()));
+                return;
+            }
+            onnxWire_t r = sub();
+            while(r.more())
+                v.push_back(float(r.f64()));
+        }
+    };
+
+    float onnxHalfToFloat(uint16_t h) {
+        uint32_t sign = uint32_t(h & 0x8000) << 16;
+        uint32_t exp  = (h >> 10) & 0x1f;
+        uint32_t mant = h & 0x3ff;
+        uint32_t bits;
+        if(exp == 0 && mant == 0) {
+            bits = sign;
+        } else if(exp == 0) {
+            // subnormal, normalize it
+            exp = 127 - 15 + 1;
+            while(!(mant & 0x400)) {
+                mant <<= 1;
+                exp--;
+            }
+            bits = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+        } else if(exp == 31) {
+            bits = sign | 0x7f800000 | (mant << 13);
+        } else {
+            bits = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+        }
+        float f;
+        memcpy(&f, &bits, 4);
+        return f;
+    }
+
+    // i-th element of little endian raw data, not necessarily aligned
+    template<typename T> T onnxRaw(const uint8_t *raw, size_t i) {
+        T v;
+        memcpy(&v, raw + i*sizeof(T), sizeof(T));
+        return v;
+    }
+
+    onnxTensor_t onnxReadTensor(onnxWire_t m) {
+        onnxTensor_t t;
+        int type = ONNX_FLOAT;
+        onnxWire_t raw = { nullptr, nullptr, m.what };
+        std::vector<float> doubles;
+        while(m.more()) {
+            int field, wire;
+            m.key(field, wire);
+            switch(field) {
+                case 1:  m.ints(wire, t.dims);           break;
+                case 2:  type = int(m.varint());         break;
+                case 4:  m.floats(wire, t.data);         break;
+                case 5:  // int32_data, also holds int8, uint8 and float16 bits
+                case 7:  m.ints(wire, t.ints);           break;
+                case 8:  t.name = m.string();            break;
+                case 9:  raw = m.sub();                  break;
+                case 10: m.doubles(wire, doubles);       break;
+                case 14:
+                    if(m.varint() != 0)
+                        FatalError("onnx tensors with external data are not supported");
+                    break;
+                default: m.skip(wire);
+            }
+        }
+
+        size_t count = 1;
+        for(auto d: t.dims)
+            count *= d;
+
+        if(raw.p != nullptr) {
+            size_t size = raw.end - raw.p;
+            size_t elem = type == ONNX_DOUBLE || type == ONNX_INT64 ? 8 :
+                          type == ONNX_FLOAT  || type == ONNX_INT32 ? 4 : type == ONNX_FLOAT16 ? 2 : 1;
+            if(size > 0 && size < count*elem)
+                FatalError("onnx tensor " + t.name + ": raw data is too short");
+            t.data.resize(size > 0 ? count : 0);
+            for(size_t i=0; i<t.data.size(); i++) {
+                switch(type) {
+                    case ONNX_FLOAT:   t.data[i] = onnxRaw<float>(raw.p, i);    break;
+                    case ONNX_DOUBLE:  t.data[i] = onnxRaw<double>(raw.p, i);   break;
+                    case ONNX_INT64:   t.data[i] = onnxRaw<int64_t>(raw.p, i);  break;
+                    case ONNX_INT32:   t.data[i] = onnxRaw<int32_t>(raw.p, i);  break;
+                    case ONNX_INT8:    t.data[i] = onnxRaw<int8_t>(raw.p, i);   break;
+                    case ONNX_UINT8:   t.data[i] = onnxRaw<uint8_t>(raw.p, i);  break;
+                    case ONNX_FLOAT16: t.data[i] = onnxHalfToFloat(onnxRaw<uint16_t>(raw.p, i)); break;
+                    default: FatalError("onnx tensor " + t.name + ": data type " + std::to_string(type) + " not supported");
+                }
+            }
+            // int64 values (shapes) are kept exact
+            if(type == ONNX_INT64)
+                for(size_t i=0; i<t.data.size(); i++)
+                    t.ints.push_back(onnxRaw<int64_t>(raw.p, i));
+        } else if(!doubles.empty()) {
+            t.data = doubles;
+        } else if(!t.ints.empty()) {
+            t.data.resize(t.ints.size());
+            for(size_t i=0; i<t.ints.size(); i++)
+                t.data[i] = type == ONNX_FLOAT16 ? onnxHalfToFloat(uint16_t(t.ints[i])) : float(t.ints[i]);
+        }
+        if(t.ints.empty())
+            t.ints.assign(t.data.begin(), t.data.end());
+        if(!t.data.empty() && t.data.size() != count)
+            FatalError("onnx tensor " + t.name + ": " + std::to_string(t.data.size()) +
+                       " values for " + std::to_string(count) + " elements");
+        return t;
+    }
+
+    onnxAttribute_t onnxReadAttribute(onnxWire_t m) {
+        onnxAttribute_t a;
+        while(m.more()) {
+            int field, wire;
+            m.key(field, wire);
+            switch(field) {
+                case 1: a.name = m.string();                         break;
+                case 2: a.f = m.f32();                               break;
+                case 3: a.i = int64_t(m.varint());                   break;
+                case 4: a.s = m.string();                            break;
+                case 5: a.t = onnxReadTensor(m.sub("attribute tensor")); break;
+                case 7: m.floats(wire, a.floats);                    break;
+                case 8: m.ints(wire, a.ints);                        break;
+                default: m.skip(wire);
+            }
+        }
+        return a;
+    }
+
+    onnxNode_t onnxReadNode(onnxWire_t m) {
+        onnxNode_t n;
+        while(m.more()) {
+            int field, wire;
+            m.key(field, wire);
+            switch(field) {
+                case 1: n.inputs.push_back(m.string());  break;
+                case 2: n.outputs.push_back(m.string()); break;
+                case 3: n.name = m.string();             break;
+                case 4: n.op_type = m.string();          break;
+                case 5: {
+                    onnxAttribute_t a = onnxReadAttribute(m.sub("attribute"));
+                    n.attrs[a.name] = a;
+                    break;
+                }
+                default: m.skip(wire);
+            }
+        }
+        if(n.name.empty() && !n.outputs.empty())
+            n.name = n.outputs[0];
+        return n;
+    }
+
+    onnxValueInfo_t onnxReadValueInfo(onnxWire_t m) {
+        onnxValueInfo_t v;
+        while(m.more()) {
+            int field, wire;
+            m.key(field, wire);
+            if(field == 1) {
+                v.name = m.string();
+                continue;
+            }
+            if(field != 2) {
+                m.skip(wire);
+                continue;
+            }
+            // TypeProto.tensor_type.shape.dim[].dim_value
+            onnxWire_t type = m.sub("value info type");
+            while(type.more()) {
+                type.key(field, wire);
+                if(field != 1) { type.skip(wire); continue; }
+                onnxWire_t tensor = type.sub();
+                while(tensor.more()) {
+                    tensor.key(field, wire);
+                    if(field != 2) { tensor.skip(wire); continue; }
+                    onnxWire_t shape = tensor.sub();
+                    while(shape.more()) {
+                        shape.key(field, wire);
+                        if(field != 1) { shape.skip(wire); continue; }
+                        onnxWire_t dim = shape.sub();
+                        int64_t value = 0;
+                        while(dim.more()) {
+                            dim.key(field, wire);
+                            if(field == 1) value = int64_t(dim.varint());
+                            else dim.skip(wire);
+                        }
+                        v.dims.push_back(value);
+                    }
+                }
+            }
+        }
+        return v;
+    }
+
+    int64_t onnxNode_t::getInt(const std::string &attr, int64_t def) const {
+        auto a = attrs.find(attr);
+        return a == attrs.end() ? def : a->second.i;
+    }
+    float onnxNode_t::getFloat(const std::string &attr, float def) const {
+        auto a = attrs.find(attr);
+        return a == attrs.end() ? def : a->second.f;
+    }
+    std::string onnxNode_t::getString(const std::string &attr, const std::string &def) const {
+        auto a = attrs.find(attr);
+        return a == attrs.end() ? def : a->second.s;
+    }
+    std::vector<int64_t> onnxNode_t::getInts(const std::string &attr, const std::vector<int64_t> &def) const {
+        auto a = attrs.find(attr);
+        return a == attrs.end() ? def : a->second.ints;
+    }
+
+    onnxGraph_t onnxReadGraph(const std::string& onnx_file) {
+        tk::dnn::MappedFile file;
+        if(!file.open(onnx_file))
+            FatalError("cloud not open onnx file: " + onnx_file);
+
+        onnxGraph_t g;
+        g.path = onnx_file;
+        std::vector<onnxValueInfo_t> inputs;
+
+        onnxWire_t model = { (const uint8_t*) file.data(), (const uint8_t*) file.data() + file.size, "model" };
+        while(model.more()) {
+            int field, wire;
+            model.key(field, wire);
+            if(field == 8) {
+                // opset_import, the default domain is "" or "ai.onnx"
+                onnxWire_t opset = model.sub("opset");
+                std::string domain;
+                int64_t version = 0;
+                while(opset.more()) {
+                    opset.key(field, wire);
+                    if(field == 1)      domain = opset.string();
+                    else if(field == 2) version = int64_t(opset.varint());
+                    else opset.skip(wire);
+                }
+                if(domain.empty() || domain == "ai.onnx")
+                    g.opset = version;
+                continue;
+            }
+            if(field != 7) {
+                model.skip(wire);
+                continue;
+            }
+            onnxWire_t graph = model.sub("graph");
+            while(graph.more()) {
+                graph.key(field, wire);
+                switch(field) {
+                    case 1:  g.nodes.push_back(onnxReadNode(graph.sub("node")));         break;
+                    case 5: {
+                        onnxTensor_t t = onnxReadTensor(graph.sub("initializer"));
+                        g.initializers[t.name] = std::move(t);
+                        break;
+                    }
+                    case 11: inputs.push_back(onnxReadValueInfo(graph.sub("input")));    break;
+                    case 12: g.outputs.push_back(onnxReadValueInfo(graph.sub("output"))); break;
+                    default: graph.skip(wire);
+                }
+            }
+        }
+
+        // before IR version 4 initializers are listed among the inputs too
+        for(auto &i: inputs)
+            if(g.initializers.count(i.name) == 0)
+                g.inputs.push_back(i);
+
+        if(g.nodes.empty())
+            FatalError("no graph in onnx file: " + onnx_file);
+        std::cout<<"ONNX "<<onnx_file<<": opset "<<g.opset<<", "<<g.nodes.size()<<" nodes, "
+                 <<g.initializers.size()<<" initializers\n";
+        return g;
+    }
+
+    /**
+        State of the network being built from an onnx graph
+    */
+    struct onnxBuilder_t {
+        onnxGraph_t &g;
+        tk::dnn::Network *net;
+        std::map<std::string, tk::dnn::Layer*> tensors;    // onnx tensor -> producer layer, nullptr for the network input
+        std::map<std::string, int> consumers;               // onnx tensor -> number of nodes (and graph outputs) reading it
+
+        tk::dnn::Layer *last() {
+            return net->num_layers > 0 ? net->layers[net->num_layers - 1] : nullptr;
+        }
+        dataDim_t lastDim() {
+            return net->getOutputDim();
+        }
+        bool isTensor(const std::string &name) {
+            return tensors.count(name) > 0;
+        }
+        bool hasInit(const onnxNode_t &n, int i) {
+            return i < n.inputs.size() && !n.inputs[i].empty() && g.initializers.count(n.inputs[i]) > 0;
+        }
+        const onnxTensor_t &init(const onnxNode_t &n, int i) {
+            if(!hasInit(n, i))
+                FatalError("onnx node " + n.name + " (" + n.op_type + "): input " + std::to_string(i) +
+                           " must be an initializer or a constant");
+            return g.initializers[n.inputs[i]];
+        }
+        tk::dnn::Layer *layer(const onnxNode_t &n, const std::string &name) {
+            if(!isTensor(name))
+                FatalError("onnx node " + n.name + " (" + n.op_type + "): unknown input tensor " + name);
+            if(tensors[name] == nullptr)
+                FatalError("onnx node " + n.name + " (" + n.op_type + "): the network input can only be read by the first layer");
+            return tensors[name];
+        }
+        // make the given tensor the input of the next layer, with a route if needed
+        void use(const onnxNode_t &n, const std::string &name) {
+            if(!isTensor(name))
+                FatalError("onnx node " + n.name + " (" + n.op_type + "): unknown input tensor " + name);
+            tk::dnn::Layer *l = tensors[name];
+            if(l == last())
+                return;
+            l = layer(n, name);
+            new tk::dnn::Route(net, &l, 1);
+        }
+        // weights of the next layer, served by the loader
+        std::string provide(std::vector<dnnType> &&data) {
+            std::string name = g.path + "/" + std::to_string(net->num_layers) + ".bin";
+            tk::dnn::WeightsLoader *loader = net->getWeightsLoader();
+            loader->expect(name);
+            loader->provide(name, std::move(data));
+            return name;
+        }
+        // index of the only node reading the output of node i, if it is of the given type
+        int onlyConsumer(int i, const std::string &op_type) {
+            const std::string &out = g.nodes[i].outputs[0];
+            if(consumers[out] != 1)
+                return -1;
+            for(int j=i+1; j<g.nodes.size(); j++)
+                if(std::find(g.nodes[j].inputs.begin(), g.nodes[j].inputs.end(), out) != g.nodes[j].inputs.end())
+                    return g.nodes[j].op_type == op_type ? j : -1;
+            return -1;
+        }
+    };
+
+    // symmetric 2D paddings of a conv or pool node
+    void onnxPads(const onnxNode_t &n, const dataDim_t &in, int kh, int kw, int sh, int sw, int &ph, int &pw) {
+        std::string auto_pad = n.getString("auto_pad", "NOTSET");
+        std::vector<int64_t> pads = n.getInts("pads", {0, 0, 0, 0});
+        if(auto_pad == "SAME_UPPER" || auto_pad == "SAME_LOWER") {
+            int oh = (in.h + sh - 1)/sh, ow = (in.w + sw - 1)/sw;
+            int th = std::max((oh - 1)*sh + kh - in.h, 0), tw = std::max((ow - 1)*sw + kw - in.w, 0);
+            pads = { th/2, tw/2, th - th/2, tw - tw/2 };
+        } else if(auto_pad == "VALID") {
+            pads = { 0, 0, 0, 0 };
+        }
+        if(pads.size() != 4 || pads[0] != pads[2] || pads[1] != pads[3])
+            FatalError("onnx node " + n.name + " (" + n.op_type + "): only symmetric 2D paddings are supported");
+        ph = int(pads[0]);
+        pw = int(pads[1]);
+    }
+
+    // true if a nearest resize from in_len to out_len with these onnx modes
+    // picks in = floor(out * in_len / out_len) for every output
+    bool onnxNearestIsFloor(const std::string &coord, const std::string &nearest, int in_len, int out_len) {
+        const double scale = double(out_len) / in_len;
+        for(int o=0; o<out_len; o++) {
+            double x;
+            if(coord == "half_pixel" || (coord == "pytorch_half_pixel" && out_len > 1))
+                x = (o + 0.5) / scale - 0.5;
+            else if(coord == "pytorch_half_pixel")
+                x = 0;
+            else if(coord == "asymmetric")
+                x = o / scale;
+            else if(coord == "tf_half_pixel_for_nn")
+                x = (o + 0.5) / scale;
+            else if(coord == "align_corners")
+                x = out_len > 1 ? o * double(in_len - 1) / (out_len - 1) : 0;
+            else
+                FatalError("resize coordinate_transformation_mode " + coord + " not supported");
+
+            double i;
+            if(nearest == "round_prefer_floor")     i = ceil(x - 0.5);
+            else if(nearest == "round_prefer_ceil") i = floor(x + 0.5);
+            else if(nearest == "floor")             i = floor(x);
+            else if(nearest == "ceil")              i = ceil(x);
+            else FatalError("resize nearest_mode " + nearest + " not supported");
+            i = std::min(std::max(i, 0.0), double(in_len - 1));
+            if(int(i) != o * in_len / out_len)
+                return false;
+        }
+        return true;
+    }
+
+    // batchnorm (scales, bias, mean, variance, epsilon) as tkDNN bias, scales, mean, variance
+    void onnxBatchnorm(onnxBuilder_t &b, const onnxNode_t &n, std::vector<dnnType> &wgs, const std::vector<float> &conv_bias) {
+        const std::vector<float> &scales = b.init(n, 1).data, &bias = b.init(n, 2).data;
+        const std::vector<float> &mean = b.init(n, 3).data, &variance = b.init(n, 4).data;
+        float eps = n.getFloat("epsilon", 1e-5);
+        wgs.insert(wgs.end(), bias.begin(), bias.end());
+        wgs.insert(wgs.end(), scales.begin(), scales.end());
+        // the bias of the conv goes before the normalization: (x + b - mean) = (x - (mean - b))
+        for(int i=0; i<mean.size(); i++)
+            wgs.push_back(mean[i] - (conv_bias.empty() ? 0 : conv_bias[i]));
+        // tkDNN normalizes with TKDNN_BN_MIN_EPSILON
+        for(int i=0; i<variance.size(); i++)
+            wgs.push_back(variance[i] + eps - TKDNN_BN_MIN_EPSILON);
+    }
+
+    void onnxAddNode(onnxBuilder_t &b, int idx, std::vector<bool> &folded) {
+        onnxNode_t &n = b.g.nodes[idx];
+        const std::string &op = n.op_type;
+        tk::dnn::Network *net = b.net;
+        tk::dnn::Layer *l = nullptr;
+
+        if(op == "Constant") {
+            onnxTensor_t t;
+            if(n.has("value"))              t = n.attrs["value"].t;
+            else if(n.has("value_float"))   t.data = { n.attrs["value_float"].f };
+            else if(n.has("value_int"))     t.data = { float(n.attrs["value_int"].i) };
+            else if(n.has("value_floats"))  t.data = n.attrs["value_floats"].floats;
+            else if(n.has("value_ints"))    t.data.assign(n.attrs["value_ints"].ints.begin(), n.attrs["value_ints"].ints.end());
+            else FatalError("onnx node " + n.name + ": constant type not supported");
+            if(t.ints.empty())
+                t.ints.assign(t.data.begin(), t.data.end());
+            t.name = n.outputs[0];
+            b.g.initializers[t.name] = t;
+            return;
+        }
+        if(op == "Identity" || op == "Dropout") {
+            b.tensors[n.outputs[0]] = b.layer(n, n.inputs[0]);
+            return;
+        }
+
+        if(op == "Conv") {
+            const onnxTensor_t &W = b.init(n, 1);
+            if(W.dims.size() != 4)
+                FatalError("onnx node " + n.name + ": only 2D convolutions are supported");
+            for(auto d: n.getInts("dilations", {1, 1}))
+                if(d != 1) FatalError("onnx node " + n.name + ": dilated convolutions are not supported");
+            int out_ch = W.dims[0], kh = W.dims[2], kw = W.dims[3];
+            std::vector<int64_t> strides = n.getInts("strides", {1, 1});
+            b.use(n, n.inputs[0]);
+            int ph, pw;
+            onnxPads(n, b.lastDim(), kh, kw, strides[0], strides[1], ph, pw);
+
+            // tkDNN order: weights, bias, [scales, mean, variance]
+            std::vector<dnnType> wgs = W.data;
+            std::vector<float> conv_bias = b.hasInit(n, 2) ? b.init(n, 2).data : std::vector<float>();
+            int bn = b.onlyConsumer(idx, "BatchNormalization");
+            if(bn >= 0 && !(b.hasInit(b.g.nodes[bn], 1) && b.hasInit(b.g.nodes[bn], 2) &&
+                            b.hasInit(b.g.nodes[bn], 3) && b.hasInit(b.g.nodes[bn], 4)))
+                bn = -1;
+            if(bn >= 0) {
+                onnxBatchnorm(b, b.g.nodes[bn], wgs, conv_bias);
+                folded[bn] = true;
+            } else if(!conv_bias.empty()) {
+                wgs.insert(wgs.end(), conv_bias.begin(), conv_bias.end());
+            } else {
+                wgs.resize(wgs.size() + out_ch, 0);
+            }
+            std::string name = b.provide(std::move(wgs));
+            l = new tk::dnn::Conv2d(net, out_ch, kh, kw, strides[0], strides[1], ph, pw, name,
+                                    bn >= 0, false, n.getInt("group", 1));
+            if(bn >= 0)
+                b.tensors[b.g.nodes[bn].outputs[0]] = l;
+        }
+        else if(op == "BatchNormalization") {
+            if(folded[idx])
+                return;
+            // not after a conv: depthwise 1x1 convolution with unit weights
+            b.use(n, n.inputs[0]);
+            int c = b.lastDim().c;
+            std::vector<dnnType> wgs(c, 1);
+            onnxBatchnorm(b, n, wgs, {});
+            std::string name = b.provide(std::move(wgs));
+            l = new tk::dnn::Conv2d(net, c, 1, 1, 1, 1, 0, 0, name, true, false, c);
+        }
+        else if(op == "Relu" || op == "LeakyRelu" || op == "Sigmoid" || op == "Mish" || op == "Clip") {
+            b.use(n, n.inputs[0]);
+            if(op == "Relu")
+                l = new tk::dnn::Activation(net, CUDNN_ACTIVATION_RELU);
+            else if(op == "LeakyRelu")
+                l = new tk::dnn::Activation(net, tk::dnn::ACTIVATION_LEAKY, 0.0, n.getFloat("alpha", 0.01));
+            else if(op == "Sigmoid")
+                l = new tk::dnn::Activation(net, tk::dnn::ACTIVATION_LOGISTIC);
+            else if(op == "Mish")
+                l = new tk::dnn::Activation(net, tk::dnn::ACTIVATION_MISH);
+            else {
+                // min and max are attributes up to opset 10, optional inputs after
+                float min = n.getFloat("min", -INFINITY), max = n.getFloat("max", INFINITY);
+                if(b.hasInit(n, 1)) min = b.init(n, 1).data[0];
+                if(b.hasInit(n, 2)) max = b.init(n, 2).data[0];
+                if(min != 0)
+                    FatalError("onnx node " + n.name + ": only Clip with min 0 (relu, relu6) is supported");
+                if(std::isinf(max))
+                    l = new tk::dnn::Activation(net, CUDNN_ACTIVATION_RELU);
+                else
+                    l = new tk::dnn::Activation(net, CUDNN_ACTIVATION_CLIPPED_RELU, max);
+            }
+        }
+        else if(op == "MaxPool" || op == "AveragePool" || op == "GlobalAveragePool" || op == "GlobalMaxPool") {
+            b.use(n, n.inputs[0]);
+            dataDim_t in = b.lastDim();
+            tkdnnPoolingMode_t mode = op == "MaxPool" || op == "GlobalMaxPool" ? POOLING_MAX :
+                                      n.getInt("count_include_pad", 0) ? POOLING_AVERAGE : POOLING_AVERAGE_EXCLUDE_PADDING;
+            if(op == "GlobalAveragePool" || op == "GlobalMaxPool") {
+                l = new tk::dnn::Pooling(net, in.h, in.w, in.h, in.w, 0, 0, mode);
+            } else {
+                std::vector<int64_t> kernel = n.getInts("kernel_shape", {});
+                std::vector<int64_t> strides = n.getInts("strides", {1, 1});
+                if(kernel.size() != 2)
+                    FatalError("onnx node " + n.name + ": only 2D pooling is supported");
+                if(n.getInt("ceil_mode", 0) != 0)
+                    FatalError("onnx node " + n.name + ": ceil_mode pooling is not supported");
+                int ph, pw;
+                onnxPads(n, in, kernel[0], kernel[1], strides[0], strides[1], ph, pw);
+                l = new tk::dnn::Pooling(net, kernel[0], kernel[1], strides[0], strides[1], ph, pw, mode);
+            }
+        }
+        else if(op == "Concat") {
+            int axis = n.getInt("axis", 1);
+            if(axis != 1 && axis != -3)
+                FatalError("onnx node " + n.name + ": only concatenations along the channels are supported");
+            std::vector<tk::dnn::Layer*> layers;
+            for(auto &i: n.inputs)
+                layers.push_back(b.layer(n, i));
+            l = new tk::dnn::Route(net, layers.data(), layers.size());
+        }
+        else if(op == "Add" || op == "Mul" || op == "Sub" || op == "Div") {
+            bool t0 = b.isTensor(n.inputs[0]), t1 = b.isTensor(n.inputs[1]);
+            if(t0 && t1) {
+                if(op == "Sub" || op == "Div")
+                    FatalError("onnx node " + n.name + ": " + op + " between two tensors is not supported");
+                // the operand that is not the current output is the back layer of the shortcut
+                int cur = b.tensors[n.inputs[1]] == b.last() ? 1 : 0;
+                tk::dnn::Layer *back = b.layer(n, n.inputs[1 - cur]);
+                b.use(n, n.inputs[cur]);
+                dataDim_t in = b.lastDim();
+                if(back->output_dim.c != in.c || back->output_dim.h != in.h || back->output_dim.w != in.w)
+                    FatalError("onnx node " + n.name + ": broadcasting " + op + " is not supported");
+                l = new tk::dnn::Shortcut(net, back, op == "Mul");
+            } else {
+                // tensor and scalar constant
+                int c = t0 ? 1 : 0;
+                const onnxTensor_t &k = b.init(n, c);
+                if(k.data.size() != 1)
+                    FatalError("onnx node " + n.name + ": " + op + " with a constant is supported only for scalars");
+                float v = k.data[0], mul = 1, add = 0;
+                if(op == "Add")      add = v;
+                else if(op == "Mul") mul = v;
+                else if(op == "Sub") { mul = c == 0 ? -1 : 1; add = c == 0 ? v : -v; }
+                else if(c == 1)      mul = 1 / v;
+                else FatalError("onnx node " + n.name + ": division of a constant by a tensor is not supported");
+                b.use(n, n.inputs[1 - c]);
+                l = new tk::dnn::MulAdd(net, mul, add);
+            }
+        }
+        else if(op == "Resize" || op == "Upsample") {
+            std::vector<float> scales;
+            std::vector<int64_t> sizes;
+            if(op == "Upsample" && n.has("scales"))
+                scales = n.attrs["scales"].floats;
+            else if(op == "Upsample" || n.inputs.size() == 2)
+                scales = b.init(n, 1).data;                 // Upsample, Resize opset 10
+            else {
+                if(b.hasInit(n, 2)) scales = b.init(n, 2).data;
+                if(b.hasInit(n, 3)) sizes  = b.init(n, 3).ints;
+            }
+            b.use(n, n.inputs[0]);
+            dataDim_t in = b.lastDim();
+            int oh, ow;
+            if(sizes.size() == 4) {
+                if(sizes[0] != 1 || sizes[1] != in.c)
+                    FatalError("onnx node " + n.name + ": only spatial resizes are supported");
+                oh = sizes[2];
+                ow = sizes[3];
+            } else if(scales.size() == 4) {
+                if(scales[0] != 1 || scales[1] != 1)
+                    FatalError("onnx node " + n.name + ": only spatial resizes are supported");
+                oh = int(floor(in.h*scales[2]));
+                ow = int(floor(in.w*scales[3]));
+            } else {
+                FatalError("onnx node " + n.name + ": the output size must be constant (scales or sizes)");
+            }
+            // the cuDNN kernel and the tensorRT resize both compute the
+            // integer ratio nearest, in = floor(out / ratio)
+            std::string mode = n.getString("mode", "nearest");
+            if(mode != "nearest")
+                FatalError("onnx node " + n.name + ": resize mode " + mode + " not supported, only nearest");
+            if(oh < in.h || ow < in.w || oh % in.h != 0 || ow % in.w != 0)
+                FatalError("onnx node " + n.name + ": only nearest resizes by integer factors are supported");
+            std::string coord = n.getString("coordinate_transformation_mode", "half_pixel");
+            std::string nearest = n.getString("nearest_mode", "round_prefer_floor");
+            if(!onnxNearestIsFloor(coord, nearest, in.h, oh) || !onnxNearestIsFloor(coord, nearest, in.w, ow))
+                FatalError("onnx node " + n.name + ": resize with " + coord + " coordinates and " + nearest +
+                           " rounding does not pick the integer ratio nearest");
+            int stride = oh / in.h;
+            if(oh == in.h*stride && ow == in.w*stride)
+                l = new tk::dnn::Upsample(net, stride);
+            else
+                l = new tk::dnn::Resize(net, in.c, oh, ow, true, NEAREST);
+        }
+        else if(op == "Reshape" || op == "Flatten") {
+            b.use(n, n.inputs[0]);
+            dataDim_t in = b.lastDim();
+            std::vector<int64_t> src = { 1, in.c, in.h, in.w }, shape;
+            if(op == "Flatten") {
+                if(n.getInt("axis", 1) != 1)
+                    FatalError("onnx node " + n.name + ": only Flatten along axis 1 is supported");
+                shape = { 1, -1 };
+            } else {
+                shape = b.init(n, 1).ints;
+            }
+            if(shape.empty() || shape.size() > 4)
+                FatalError("onnx node " + n.name + ": reshape to rank " + std::to_string(shape.size()) + " not supported");
+            int64_t known = 1;
+            int infer = -1;
+            for(int i=0; i<shape.size(); i++) {
+                if(shape[i] == 0)  shape[i] = i < src.size() ? src[i] : 1;
+                if(shape[i] == -1) infer = i;
+                else               known *= shape[i];
+            }
+            if(infer >= 0)
+                shape[infer] = in.tot() / known;
+            shape.resize(4, 1);
+            if(shape[0] != 1)
+                FatalError("onnx node " + n.name + ": reshapes changing the batch are not supported");
+            dataDim_t out(1, shape[1], shape[2], shape[3]);
+            if(out.c == in.c && out.h == in.h && out.w == in.w) {
+                b.tensors[n.outputs[0]] = b.last();
+                return;
+            }
+            // Flatten would transpose to HWC, the memory layout of an onnx reshape is CHW
+            l = new tk::dnn::Reshape(net, out);
+        }
+        else if(op == "Gemm") {
+            if(n.getInt("transA", 0) != 0)
+                FatalError("onnx node " + n.name + ": Gemm with transA is not supported");
+            const onnxTensor_t &B = b.init(n, 1);
+            bool transB = n.getInt("transB", 0) != 0;
+            float alpha = n.getFloat("alpha", 1), beta = n.getFloat("beta", 1);
+            b.use(n, n.inputs[0]);
+            int inputs = b.lastDim().tot();
+            if(B.dims.size() != 2 || B.dims[transB ? 1 : 0] != inputs)
+                FatalError("onnx node " + n.name + ": Gemm weights do not match " + std::to_string(inputs) + " inputs");
+            int outputs = B.dims[transB ? 0 : 1];
+
+            // tkDNN dense weights are outputs x inputs, then the bias
+            std::vector<dnnType> wgs(outputs*inputs + outputs, 0);
+            for(int o=0; o<outputs; o++)
+                for(int i=0; i<inputs; i++)
+                    wgs[o*inputs + i] = alpha * B.data[transB ? o*inputs + i : i*outputs + o];
+            if(b.hasInit(n, 2)) {
+                const std::vector<float> &C = b.init(n, 2).data;
+                if(C.size() != outputs && C.size() != 1)
+                    FatalError("onnx node " + n.name + ": Gemm bias must be per output");
+                for(int o=0; o<outputs; o++)
+                    wgs[outputs*inputs + o] = beta * C[C.size() == 1 ? 0 : o];
+            }
+            std::string name = b.provide(std::move(wgs));
+            l = new tk::dnn::Dense(net, outputs, name);
+        }
+        else {
+            FatalError("onnx operator not supported: " + op + " (node " + n.name +
+                       "), shape computations can be folded with onnx-simplifier");
+        }
+        b.tensors[n.outputs[0]] = l;
+    }
+
+    tk::dnn::Network* onnxParser(const std::string& onnx_file) {
+
+        onnxGraph_t g = onnxReadGraph(onnx_file);
+        if(g.inputs.size() != 1)
+            FatalError("onnx networks with " + std::to_string(g.inputs.size()) + " inputs are not supported");
+        std::vector<int64_t> in = g.inputs[0].dims;
+        if(in.size() == 3)
+            in.insert(in.begin(), 1);
+        if(in.size() != 4 || in[1] <= 0 || in[2] <= 0 || in[3] <= 0)
+            FatalError("the onnx input " + g.inputs[0].name + " must be NCHW with a fixed size");
+
+        tk::dnn::dataDim_t dim(1, in[1], in[2], in[3]);
+        onnxBuilder_t b = { g, new tk::dnn::Network(dim) };
+        b.tensors[g.inputs[0].name] = nullptr;
+        for(auto &n: g.nodes)
+            for(auto &i: n.inputs)
+                b.consumers[i]++;
+        for(auto &o: g.outputs)
+            b.consumers[o.name]++;
+
+        std::vector<bool> folded(g.nodes.size(), false);
+        for(int i=0; i<g.nodes.size(); i++)
+            onnxAddNode(b, i, folded);
+
+        if(g.outputs.size() > 1) {
+            for(auto &o: g.outputs)
+                b.layer(g.nodes.back(), o.name)->setFinal();
+        } else if(!g.outputs.empty()) {
+            b.use(g.nodes.back(), g.outputs[0].name);
+        }
+
+        b.net->finishWeightsPrefetch();
+        return b.net;
+    }
+}}
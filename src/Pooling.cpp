@@ -18,6 +18,8 @@ Pooling::Pooling( Network *net, int winH, int winW, int strideH, int strideW,
     this->paddingH = paddingH;
     this->paddingW = paddingW;
     this->padding = winH -1;
+    if(pool_mode == POOLING_AVERAGE_FIXEDSIZE && paddingH != 0)
+        this->padding = paddingH;
 
     checkCUDNN( cudnnCreatePoolingDescriptor(&poolingDesc) );
 
@@ -42,6 +44,7 @@ Pooling::Pooling( Network *net, int winH, int winW, int strideH, int strideW,
 
     cudnnPoolingMode_t cudnn_pool_mode = cudnnPoolingMode_t(pool_mode);
     if(pool_mode == POOLING_MAX_FIXEDSIZE) cudnn_pool_mode = cudnnPoolingMode_t(tkdnnPoolingMode_t::POOLING_MAX);
+    if(pool_mode == POOLING_AVERAGE_FIXEDSIZE) cudnn_pool_mode = cudnnPoolingMode_t(tkdnnPoolingMode_t::POOLING_AVERAGE_EXCLUDE_PADDING);
 
     checkCUDNN( cudnnSetPooling2dDescriptor(poolingDesc, cudnn_pool_mode,
                 CUDNN_NOT_PROPAGATE_NAN, winH, winW, paddingH, paddingW, strideH, strideW) );
@@ -59,6 +62,10 @@ Pooling::Pooling( Network *net, int winH, int winW, int strideH, int strideW,
         h = (h + padH - winH)/strideH +1;
         w =  (w + padW - winW)/strideW +1;
     }
+    else if(pool_mode == tkdnnPoolingMode_t::POOLING_AVERAGE_FIXEDSIZE){
+        h = (h + padding - winH)/strideH +1;
+        w =  (w + padding - winW)/strideW +1;
+    }
     else{
         h = (h + 2*paddingH - winH)/strideH +1 ;
         w =  (w + 2*paddingW - winW)/strideW +1;
@@ -114,6 +121,9 @@ dnnType* Pooling::infer(dataDim_t &dim, dnnType* srcData) {
     if(pool_mode == tkdnnPoolingMode_t::POOLING_MAX_FIXEDSIZE){
         MaxPoolingForward(poolSrc, poolDst, dim.n, dim.c, dim.h, dim.w, this->strideH, this->strideW, this->winH, this->winH-1);
     }
+    else if(pool_mode == tkdnnPoolingMode_t::POOLING_AVERAGE_FIXEDSIZE){
+        AvgPoolingForward(poolSrc, poolDst, dim.n, dim.c, dim.h, dim.w, this->strideW, this->strideH, this->winH, this->padding);
+    }
     else{
         dnnType alpha = dnnType(1);
         dnnType beta = dnnType(0);
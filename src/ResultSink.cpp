@@ -0,0 +1,258 @@
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+
+#include "ResultSink.h"
+
+namespace tk { namespace dnn {
+
+static const char RESULT_BINARY_MAGIC[4] = {'T', 'K', 'R', 'S'};
+static const int RESULT_BINARY_VERSION = 1;
+
+ResultSink::ResultSink(const std::string &fname, const ResultFormat format, const int chunk_records,
+                       const int max_chunks) :
+    fname(fname), format(format), chunk_records(std::max(chunk_records, 1)), max_chunks(std::max(max_chunks, 1)) {
+    out.open(fname, std::ios::out | std::ios::binary);
+    if(!out)
+        FatalError("Can't open result file " + fname);
+    if(format == RESULT_COCO_JSON)
+        out << "[\n";
+    pending.reserve(this->chunk_records);
+    thread = std::thread(&ResultSink::writer, this);
+}
+
+ResultSink::~ResultSink() {
+    close();
+}
+
+void ResultSink::add(const ResultRecord &r) {
+    pending.push_back(r);
+    records++;
+    if((int) pending.size() >= chunk_records)
+        push();
+}
+
+void ResultSink::add(const int64_t frame, const std::vector<tk::dnn::box> &dets) {
+    for(const auto &d: dets)
+        add(ResultRecord{ frame, d.cl, d.prob, d.x, d.y, d.w, d.h });
+}
+
+void ResultSink::add(const std::vector<CocoAnnotation> &results) {
+    for(const auto &r: results)
+        add(ResultRecord{ r.image_id, r.category_id, float(r.score), float(r.x), float(r.y), float(r.w), float(r.h) });
+}
+
+void ResultSink::push() {
+    if(pending.empty())
+        return;
+    std::unique_lock<std::mutex> lock(mtx);
+    if((int) queue.size() >= max_chunks) {
+        auto start = std::chrono::steady_clock::now();
+        cv_free.wait(lock, [this]{ return (int) queue.size() < max_chunks; });
+        wait_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    queue.push_back(std::move(pending));
+    lock.unlock();
+    cv_queue.notify_one();
+
+    pending = std::vector<ResultRecord>();
+    pending.reserve(chunk_records);
+}
+
+void ResultSink::writer() {
+    std::string buffer;
+    while(true) {
+        std::vector<ResultRecord> chunk;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv_queue.wait(lock, [this]{ return stop || !queue.empty(); });
+            if(queue.empty())
+                return;
+            chunk = std::move(queue.front());
+            queue.pop_front();
+        }
+        cv_free.notify_one();
+
+        auto start = std::chrono::steady_clock::now();
+        buffer.clear();
+        encode(chunk, buffer);
+        out.write(buffer.data(), buffer.size());
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::lock_guard<std::mutex> lock(mtx);
+        write_ms += ms;
+        bytes += buffer.size();
+    }
+}
+
+void ResultSink::close() {
+    if(closed)
+        return;
+    push();
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stop = true;
+    }
+    cv_queue.notify_one();
+    thread.join();
+
+    if(format == RESULT_COCO_JSON)
+        out << (first ? "]\n" : "\n]\n");
+    out.close();
+    closed = true;
+}
+
+template<typename T> static void appendColumn(std::string &out, const std::vector<ResultRecord> &chunk,
+                                              T ResultRecord::*field) {
+    size_t pos = out.size();
+    out.resize(pos + chunk.size()*sizeof(T));
+    char *p = &out[pos];
+    for(const auto &r: chunk) {
+        memcpy(p, &(r.*field), sizeof(T));
+        p += sizeof(T);
+    }
+}
+
+void ResultSink::encode(const std::vector<ResultRecord> &chunk, std::string &out) {
+    if(format == RESULT_BINARY) {
+        int n = chunk.size();
+        out.append(RESULT_BINARY_MAGIC, sizeof(RESULT_BINARY_MAGIC));
+        out.append((const char*) &RESULT_BINARY_VERSION, sizeof(int));
+        out.append((const char*) &n, sizeof(int));
+        appendColumn(out, chunk, &ResultRecord::frame);
+        appendColumn(out, chunk, &ResultRecord::cl);
+        appendColumn(out, chunk, &ResultRecord::score);
+        appendColumn(out, chunk, &ResultRecord::x);
+        appendColumn(out, chunk, &ResultRecord::y);
+        appendColumn(out, chunk, &ResultRecord::w);
+        appendColumn(out, chunk, &ResultRecord::h);
+        return;
+    }
+
+    // a record never takes more than 256 characters
+    out.reserve(chunk.size() * 256);
+    char line[256];
+    for(const auto &r: chunk) {
+        char *p = line;
+        if(format == RESULT_JSONL) {
+            p += sprintf(p, "{\"frame\":%lld,\"class\":%d,\"score\":", (long long) r.frame, r.cl);
+            p = formatSignificant(p, r.score, 6);
+        } else {
+            if(!first) {
+                *p++ = ',';
+                *p++ = '\n';
+            }
+            first = false;
+            p += sprintf(p, "{\"image_id\":%lld, \"category_id\":%d", (long long) r.frame, r.cl);
+        }
+        memcpy(p, ", \"bbox\":[", 10); p += 10;
+        p = formatFloat(p, r.x, 3); *p++ = ','; *p++ = ' ';
+        p = formatFloat(p, r.y, 3); *p++ = ','; *p++ = ' ';
+        p = formatFloat(p, r.w, 3); *p++ = ','; *p++ = ' ';
+        p = formatFloat(p, r.h, 3); *p++ = ']';
+        if(format == RESULT_JSONL) {
+            memcpy(p, "}\n", 2); p += 2;
+        } else {
+            memcpy(p, ", \"score\":", 10); p += 10;
+            p = formatSignificant(p, r.score, 6);
+            *p++ = '}';
+        }
+        out.append(line, p - line);
+    }
+}
+
+char *ResultSink::formatFloat(char *p, const double v, const int decimals) {
+    static const int64_t pow10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+    const int d = std::min(std::max(decimals, 0), 9);
+    if(!std::isfinite(v) || std::fabs(v) * pow10[d] >= 1e15)
+        return p + sprintf(p, "%g", v);
+
+    int64_t scaled = std::llround(std::fabs(v) * pow10[d]);
+    if(v < 0 && scaled != 0)
+        *p++ = '-';
+    int64_t ip = scaled / pow10[d], fp = scaled % pow10[d];
+
+    char digits[24];
+    int n = 0;
+    do {
+        digits[n++] = '0' + ip % 10;
+        ip /= 10;
+    } while(ip > 0);
+    while(n > 0)
+        *p++ = digits[--n];
+
+    if(fp > 0) {
+        *p++ = '.';
+        int len = d;
+        while(fp % 10 == 0) {
+            fp /= 10;
+            len--;
+        }
+        for(int i=len-1; i>=0; i--) {
+            p[i] = '0' + fp % 10;
+            fp /= 10;
+        }
+        p += len;
+    }
+    return p;
+}
+
+char *ResultSink::formatSignificant(char *p, const double v, const int digits) {
+    if(v == 0) {
+        *p++ = '0';
+        return p;
+    }
+    // decimals giving the significant digits, the fixed formatter handles up to 9
+    const int decimals = digits - 1 - int(std::floor(std::log10(std::fabs(v))));
+    if(!std::isfinite(v) || decimals < 0 || decimals > 9)
+        return p + sprintf(p, "%.*g", digits, v);
+    return formatFloat(p, v, decimals);
+}
+
+std::vector<ResultRecord> ResultSink::readBinary(const std::string &fname) {
+    std::ifstream in(fname, std::ios::in | std::ios::binary);
+    if(!in)
+        FatalError("Can't open result file " + fname);
+
+    std::vector<ResultRecord> res;
+    char magic[4];
+    while(in.read(magic, sizeof(magic))) {
+        int version = 0, n = 0;
+        in.read((char*) &version, sizeof(int));
+        in.read((char*) &n, sizeof(int));
+        if(!in || memcmp(magic, RESULT_BINARY_MAGIC, 4) != 0 || version != RESULT_BINARY_VERSION || n < 0)
+            FatalError("Wrong result file " + fname);
+
+        size_t base = res.size();
+        res.resize(base + n);
+        auto column = [&](auto field) {
+            typedef typename std::remove_reference<decltype(res[0].*field)>::type T;
+            std::vector<T> col(n);
+            in.read((char*) col.data(), n*sizeof(T));
+            for(int i=0; i<n; i++)
+                res[base + i].*field = col[i];
+        };
+        column(&ResultRecord::frame);
+        column(&ResultRecord::cl);
+        column(&ResultRecord::score);
+        column(&ResultRecord::x);
+        column(&ResultRecord::y);
+        column(&ResultRecord::w);
+        column(&ResultRecord::h);
+        if(!in)
+            FatalError("Truncated result file " + fname);
+    }
+    return res;
+}
+
+void ResultSink::printStats() {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::cout<<"Result sink "<<fname<<": "<<records<<" records, "<<double(bytes)/1e6<<" MB\n";
+    std::cout<<"    encode and write "<<write_ms<<" ms (writer thread), producer blocked "<<wait_ms<<" ms\n";
+}
+
+}}
@@ -0,0 +1,33 @@
+#include <iostream>
+
+#include "Layer.h"
+#include "kernels.h"
+
+namespace tk { namespace dnn {
+
+Sam::Sam(Network *net, Layer *backLayer) : Layer(net) {
+
+    this->backLayer = backLayer;
+    output_dim = backLayer->output_dim;
+    checkCuda( cudaMalloc(&dstData, output_dim.tot()*sizeof(dnnType)) );
+
+    if(input_dim.tot() != output_dim.tot())
+        FatalError("Sam dim missmatch");
+}
+
+Sam::~Sam() {
+
+    checkCuda( cudaFree(dstData) );
+}
+
+dnnType* Sam::infer(dataDim_t &dim, dnnType* srcData) {
+
+    samForward(backLayer->dstData, srcData, dstData, dim.tot());
+
+    //update data dimensions    
+    dim = output_dim;
+
+    return dstData;
+}
+
+}}
@@ -0,0 +1,38 @@
+#include <iostream>
+
+#include "Layer.h"
+#include "kernels.h"
+
+namespace tk { namespace dnn {
+
+ScaleChannels::ScaleChannels(Network *net, Layer *backLayer, int scale_wh) : Layer(net) {
+
+    this->backLayer = backLayer;
+    this->scale_wh = scale_wh;
+    output_dim = backLayer->output_dim;
+    checkCuda( cudaMalloc(&dstData, output_dim.tot()*sizeof(dnnType)) );
+
+    if( ( !scale_wh && input_dim.c != output_dim.c ) ||
+        ( scale_wh && (input_dim.w != output_dim.w || input_dim.h != output_dim.h) ) )
+        FatalError("ScaleChannels dim missmatch");
+}
+
+ScaleChannels::~ScaleChannels() {
+
+    checkCuda( cudaFree(dstData) );
+}
+
+dnnType* ScaleChannels::infer(dataDim_t &dim, dnnType* srcData) {
+
+    int channel_size = output_dim.w*output_dim.h;
+    int batch_size = output_dim.c*channel_size;
+    scaleChannelsForward(backLayer->dstData, srcData, dstData, dim.n*batch_size, 
+                         channel_size, batch_size, scale_wh);
+
+    //update data dimensions    
+    dim = output_dim;
+
+    return dstData;
+}
+
+}}
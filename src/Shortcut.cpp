@@ -1,4 +1,6 @@
 #include <iostream>
+#include <math.h>
+#include <algorithm>
 
 #include "Layer.h"
 #include "kernels.h"
@@ -8,6 +10,7 @@ namespace tk { namespace dnn {
 Shortcut::Shortcut(Network *net, Layer *backLayer, bool mul) : Layer(net) {
 
     this->backLayer = backLayer;
+    this->backLayers.push_back(backLayer);
     this->mul = mul;
     this->c = input_dim.c;
     this->h = input_dim.h;
@@ -20,13 +23,89 @@ Shortcut::Shortcut(Network *net, Layer *backLayer, bool mul) : Layer(net) {
     
 }
 
+Shortcut::Shortcut(Network *net, const std::vector<Layer*> &backLayers, std::string fname_weights,
+                   tkdnnShortcutWeights_t weights_type, tkdnnShortcutNormalization_t weights_normalization) : Layer(net) {
+
+    if(backLayers.empty())
+        FatalError("no layers to shortcut");
+    this->backLayer = backLayers[0];
+    this->backLayers = backLayers;
+    this->weights_path = fname_weights;
+    this->weights_type = weights_type;
+    this->weights_normalization = weights_normalization;
+    this->c = input_dim.c;
+    this->h = input_dim.h;
+    this->w = input_dim.w;
+    checkCuda( cudaMalloc(&dstData, output_dim.tot()*sizeof(dnnType)) );
+
+    for(auto l: backLayers)
+        if(l->output_dim.c != input_dim.c || l->output_dim.w != input_dim.w || l->output_dim.h != input_dim.h)
+            FatalError("Shortcut dim missmatch");
+
+    // weights expanded to one per channel, input first
+    int n = backLayers.size() + 1;
+    weights_h = new dnnType[n*c];
+    for(int i=0; i<n*c; i++)
+        weights_h[i] = 1.0f;
+
+    if(weights_type != SHORTCUT_WEIGHTS_NONE) {
+        int nweights = nWeights(backLayers.size(), c, weights_type);
+        int step = nweights / n;
+        dnnType *wgs_h, *wgs_d;
+        net->readWeights(weights_path, nweights, &wgs_h, &wgs_d);
+        n_params = nweights;
+
+        // darknet normalization: across the inputs, for every channel
+        for(int k=0; k<step; k++) {
+            float max_val = -INFINITY, sum = 0.0001f;
+            for(int i=0; i<n; i++)
+                max_val = std::max(max_val, wgs_h[i*step + k]);
+            for(int i=0; i<n; i++) {
+                float v = wgs_h[i*step + k];
+                if(weights_normalization == SHORTCUT_NORM_RELU)         sum += std::max(v, 0.0f);
+                else if(weights_normalization == SHORTCUT_NORM_SOFTMAX) sum += expf(v - max_val);
+            }
+            for(int i=0; i<n; i++) {
+                float v = wgs_h[i*step + k];
+                if(weights_normalization == SHORTCUT_NORM_RELU)         v = std::max(v, 0.0f) / sum;
+                else if(weights_normalization == SHORTCUT_NORM_SOFTMAX) v = expf(v - max_val) / sum;
+                if(weights_type == SHORTCUT_WEIGHTS_PER_FEATURE)
+                    for(int ch=0; ch<c; ch++) weights_h[i*c + ch] = v;
+                else
+                    weights_h[i*c + k] = v;
+            }
+        }
+        delete [] wgs_h;
+        checkCuda( cudaFree(wgs_d) );
+    }
+    checkCuda( cudaMalloc(&weights_d, n*c*sizeof(dnnType)) );
+    checkCuda( cudaMemcpy(weights_d, weights_h, n*c*sizeof(dnnType), cudaMemcpyHostToDevice) );
+}
+
 Shortcut::~Shortcut() {
 
+    if(weights_d != nullptr)
+        checkCuda( cudaFree(weights_d) );
+    delete [] weights_h;
     checkCuda( cudaFree(dstData) );
 }
 
+int Shortcut::nWeights(int n_back, int c, tkdnnShortcutWeights_t weights_type) {
+    if(weights_type == SHORTCUT_WEIGHTS_PER_FEATURE) return n_back + 1;
+    if(weights_type == SHORTCUT_WEIGHTS_PER_CHANNEL) return (n_back + 1)*c;
+    return 0;
+}
+
 dnnType* Shortcut::infer(dataDim_t &dim, dnnType* srcData) {
 
+    if(multiInput()) {
+        shortcutWeightedForward(srcData, dstData, weights_d, dim.n, c, h*w, false);
+        for(int i=0; i<backLayers.size(); i++)
+            shortcutWeightedForward(backLayers[i]->dstData, dstData, weights_d + (i+1)*c, dim.n, c, h*w, true);
+        dim = output_dim;
+        return dstData;
+    }
+
     dataDim_t bdim = this->backLayer->output_dim;
 
     checkCuda(cudaMemcpy(dstData, srcData, dim.tot()*sizeof(dnnType), cudaMemcpyDeviceToDevice));
@@ -38,4 +117,4 @@ dnnType* Shortcut::infer(dataDim_t &dim, dnnType* srcData) {
     return dstData;
 }
 
-}}
\ No newline at end of file
+}}
@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <cmath>
+
+#include "SpatialGrid.h"
+
+namespace tk { namespace dnn {
+
+void SpatialGrid::clear(const float cell_size) {
+    this->cell_size = cell_size > 0 ? cell_size : 1.0f;
+    px.clear();
+    py.clear();
+}
+
+void SpatialGrid::reserve(const int n) {
+    for(std::vector<float> *c: { &px, &py, &sx, &sy })
+        c->reserve(n);
+    for(std::vector<int> *c: { &items, &cell })
+        c->reserve(n);
+    start.reserve(4*n + 17);
+}
+
+void SpatialGrid::build() {
+    const int n = px.size();
+    if(n == 0)
+        return;
+    min_x = max_x = px[0];
+    min_y = max_y = py[0];
+    for(int i=1; i<n; i++) {
+        min_x = std::min(min_x, px[i]);
+        max_x = std::max(max_x, px[i]);
+        min_y = std::min(min_y, py[i]);
+        max_y = std::max(max_y, py[i]);
+    }
+
+    // few points spread on a large area would need too many cells
+    float size = cell_size;
+    const double max_cells = 4.0*n + 16;
+    double area_cells = double((max_x - min_x) / size + 1) * ((max_y - min_y) / size + 1);
+    if(area_cells > max_cells)
+        size *= std::sqrt(area_cells / max_cells);
+    inv_cell = 1.0f / size;
+    cols = std::max(1, std::min((int) ((max_x - min_x) * inv_cell) + 1, (int) max_cells));
+    rows = std::max(1, std::min((int) ((max_y - min_y) * inv_cell) + 1, (int) max_cells / cols));
+
+    // counting sort of the points by cell
+    start.assign(cols*rows + 1, 0);
+    cell.resize(n);
+    for(int i=0; i<n; i++) {
+        cell[i] = cellOf(py[i] - min_y, rows)*cols + cellOf(px[i] - min_x, cols);
+        start[cell[i] + 1]++;
+    }
+    for(int c=0; c<cols*rows; c++)
+        start[c + 1] += start[c];
+
+    items.resize(n);
+    sx.resize(n);
+    sy.resize(n);
+    for(int i=0; i<n; i++) {
+        const int k = start[cell[i]]++;
+        items[k] = i;
+        sx[k] = px[i];
+        sy[k] = py[i];
+    }
+    for(int c=cols*rows; c>0; c--)
+        start[c] = start[c - 1];
+    start[0] = 0;
+}
+
+void SpatialGrid::candidates(const float x, const float y, const float radius, std::vector<int> &out) const {
+    out.clear();
+    query(x, y, radius, [&out](const int i, const float) { out.push_back(i); });
+}
+
+}}
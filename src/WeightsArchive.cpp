@@ -0,0 +1,107 @@
+#include <iostream>
+#include <string.h>
+
+#include "WeightsArchive.h"
+
+namespace tk { namespace dnn {
+
+static const char WA_MAGIC[8] = { 'T', 'K', 'D', 'N', 'N', 'W', 'A', '\0' };
+
+WeightsArchive::WeightsArchive() {}
+
+WeightsArchive::~WeightsArchive() {
+    close();
+}
+
+bool WeightsArchive::open(const std::string &fname, bool verify) {
+    close();
+    this->verify = verify;
+
+    // weights are read once, front to back
+    if(!file.open(fname, true) || file.size < sizeof(header_t)) {
+        file.close();
+        return false;
+    }
+    base = file.data();
+    size = file.size;
+
+    header = (const header_t*) base;
+    if(memcmp(header->magic, WA_MAGIC, sizeof(WA_MAGIC)) != 0 || header->version != VERSION ||
+       sizeof(header_t) + header->n_tensors*sizeof(entry_t) > size) {
+        std::cout<<COL_REDB<<"Invalid weights archive: "<<fname<<COL_END<<"\n";
+        close();
+        return false;
+    }
+
+    const entry_t *entries = (const entry_t*) (base + sizeof(header_t));
+    for(uint32_t i=0; i<header->n_tensors; i++) {
+        if(entries[i].offset + entries[i].bytes > size)
+            FatalError("Weights archive " + fname + " is truncated");
+        std::string name(entries[i].name, strnlen(entries[i].name, MAX_NAME));
+        index[name] = i;
+    }
+    checked.assign(header->n_tensors, false);
+    path = fname;
+    return true;
+}
+
+void WeightsArchive::close() {
+    file.close();
+    base = nullptr;
+    header = nullptr;
+    size = 0;
+    index.clear();
+    checked.clear();
+}
+
+const WeightsArchive::entry_t* WeightsArchive::getEntry(const std::string &name) {
+    auto it = index.find(name);
+    if(it == index.end())
+        return nullptr;
+
+    const entry_t *e = (const entry_t*) (base + sizeof(header_t)) + it->second;
+    if(verify && !checked[it->second]) {
+        if(crc32(base + e->offset, e->bytes) != e->crc32)
+            FatalError("Weights archive checksum mismatch on tensor " + name);
+        checked[it->second] = true;
+    }
+    return e;
+}
+
+const dnnType* WeightsArchive::getFloat(const std::string &name, int &count) {
+    const entry_t *e = getEntry(name);
+    if(e == nullptr)
+        return nullptr;
+    if(e->dtype != WA_FLOAT32)
+        FatalError("Weights archive tensor " + name + " is not float32");
+    count = e->bytes / sizeof(dnnType);
+    return (const dnnType*) (base + e->offset);
+}
+
+std::vector<std::string> WeightsArchive::names() {
+    std::vector<std::string> n;
+    for(auto &it: index)
+        n.push_back(it.first);
+    return n;
+}
+
+uint32_t WeightsArchive::crc32(const void *data, uint64_t len, uint32_t crc) {
+    static const std::vector<uint32_t> table = []() {
+        std::vector<uint32_t> t(256);
+        for(uint32_t i=0; i<256; i++) {
+            uint32_t c = i;
+            for(int k=0; k<8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    const uint8_t *p = (const uint8_t*) data;
+    crc = ~crc;
+    for(uint64_t i=0; i<len; i++)
+        crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+}}
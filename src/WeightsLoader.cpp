@@ -0,0 +1,164 @@
+#include <iostream>
+#include <fstream>
+
+#include "WeightsLoader.h"
+
+namespace tk { namespace dnn {
+
+WeightsLoader::WeightsLoader(int n_threads) {
+    if(n_threads <= 0)
+        n_threads = getCPUThreads();
+    this->n_threads = n_threads;
+    for(int i=0; i<n_threads; i++)
+        workers.emplace_back(&WeightsLoader::worker, this);
+}
+
+WeightsLoader::~WeightsLoader() {
+    stopWorkers();
+}
+
+void WeightsLoader::stopWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stop = true;
+        queue.clear();
+    }
+    cv_queue.notify_all();
+    for(auto &w: workers)
+        w.join();
+    workers.clear();
+}
+
+void WeightsLoader::expect(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if(jobs.empty())
+        first_enqueue = std::chrono::steady_clock::now();
+    if(jobs.find(name) == jobs.end())
+        jobs[name] = std::unique_ptr<job_t>(new job_t());
+}
+
+void WeightsLoader::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if(stop)
+            return;
+        queue.push_back(task);
+    }
+    cv_queue.notify_one();
+}
+
+void WeightsLoader::enqueue(const std::string &fname) {
+    if(has(fname))
+        return;
+    expect(fname);
+    submit([this, fname]() {
+        auto start = std::chrono::steady_clock::now();
+        std::ifstream file(fname, std::ios::in | std::ios::binary);
+        std::vector<dnnType> data;
+        bool failed = !file;
+        if(!failed) {
+            file.seekg(0, file.end);
+            size_t size = file.tellg();
+            file.seekg(0, file.beg);
+            data.resize(size / sizeof(dnnType));
+            failed = !file.read((char*) data.data(), data.size()*sizeof(dnnType));
+        }
+        auto end = std::chrono::steady_clock::now();
+        if(failed)
+            fail(fname, "Error reading file " + fname);
+        else
+            provide(fname, std::move(data), std::chrono::duration<double, std::milli>(end - start).count());
+    });
+}
+
+void WeightsLoader::provide(const std::string &name, std::vector<dnnType> &&data, double read_ms) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = jobs.find(name);
+        if(it == jobs.end())
+            FatalError("Weights loader: unexpected tensor " + name);
+        job_t *job = it->second.get();
+        job->data = std::move(data);
+        job->done = true;
+        this->read_ms += read_ms;
+        read_bytes += job->data.size()*sizeof(dnnType);
+        last_done = std::chrono::steady_clock::now();
+    }
+    cv_done.notify_all();
+}
+
+void WeightsLoader::fail(const std::string &name, const std::string &error) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = jobs.find(name);
+        if(it == jobs.end())
+            FatalError("Weights loader: unexpected tensor " + name);
+        it->second->error = error;
+        it->second->done = true;
+        last_done = std::chrono::steady_clock::now();
+    }
+    cv_done.notify_all();
+}
+
+bool WeightsLoader::has(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mtx);
+    return jobs.find(name) != jobs.end();
+}
+
+void WeightsLoader::worker() {
+    while(true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv_queue.wait(lock, [this]{ return stop || !queue.empty(); });
+            if(stop)
+                return;
+            task = queue.front();
+            queue.pop_front();
+        }
+        task();
+    }
+}
+
+const std::vector<dnnType>* WeightsLoader::get(const std::string &name) {
+    std::unique_lock<std::mutex> lock(mtx);
+    auto it = jobs.find(name);
+    if(it == jobs.end())
+        return nullptr;
+
+    job_t *job = it->second.get();
+    if(!job->done && workers.empty())
+        FatalError("Weights loader stopped before reading " + name);
+    if(!job->done) {
+        auto start = std::chrono::steady_clock::now();
+        cv_done.wait(lock, [job]{ return job->done; });
+        wait_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    if(!job->error.empty())
+        FatalError(job->error);
+    return &job->data;
+}
+
+void WeightsLoader::finish() {
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv_done.wait(lock, [this]{
+            for(auto &j: jobs)
+                if(!j.second->done)
+                    return false;
+            return true;
+        });
+    }
+    stopWorkers();
+}
+
+void WeightsLoader::printStats() {
+    std::lock_guard<std::mutex> lock(mtx);
+    double wall_ms = std::chrono::duration<double, std::milli>(last_done - first_enqueue).count();
+    std::cout<<"Weights loader: "<<jobs.size()<<" tensors, "<<double(read_bytes)/1e6<<" MB, "
+             <<n_threads<<" threads\n";
+    std::cout<<"    read "<<read_ms<<" ms (sum), "<<wall_ms<<" ms (wall), construction blocked "
+             <<wait_ms<<" ms\n";
+}
+
+}}
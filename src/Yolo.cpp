@@ -12,7 +12,7 @@
 
 namespace tk { namespace dnn {
 
-Yolo::Yolo(Network *net, int classes, int num, std::string fname_weights, int n_masks, float scale_xy, double nms_thresh, nmsKind_t nsm_kind, int new_coords) : 
+Yolo::Yolo(Network *net, int classes, int num, std::string fname_weights, int n_masks, float scale_xy, double nms_thresh, nmsKind_t nsm_kind, int new_coords, bool gaussian) : 
     Layer(net) {
     this->final = true;
 
@@ -23,13 +23,14 @@ Yolo::Yolo(Network *net, int classes, int num, std::string fname_weights, int n_
     this->nms_thresh = nms_thresh;
     this->nsm_kind = nsm_kind;
     this->new_coords = new_coords;
+    this->gaussian = gaussian;
 
     // load anchors
     if(fname_weights != "") {
         int seek = 0;
-        readBinaryFile(fname_weights, n_masks, &mask_h, &mask_d, seek);
+        net->readWeights(fname_weights, n_masks, &mask_h, &mask_d, seek);
         seek += n_masks;
-        readBinaryFile(fname_weights, n_masks*num*2, &bias_h, &bias_d, seek);
+        net->readWeights(fname_weights, n_masks*num*2, &bias_h, &bias_d, seek);
         //for(int i=0; i<n_masks*num*2; i++)
             //printf("%f\n", bias_h[i]);
     }
@@ -56,10 +57,11 @@ Yolo::~Yolo() {
 }
 
 int entry_index(int batch, int location, int entry, 
-            int classes, dataDim_t &input_dim, dataDim_t &output_dim) {
+            int classes, dataDim_t &input_dim, dataDim_t &output_dim, bool gaussian = false) {
     int n =   location / (input_dim.w*input_dim.h);
     int loc = location % (input_dim.w*input_dim.h);
-    return batch*output_dim.tot() + n*input_dim.w*input_dim.h*(4+classes+1) +
+    int coords = gaussian ? 8 : 4;
+    return batch*output_dim.tot() + n*input_dim.w*input_dim.h*(coords+classes+1) +
            entry*input_dim.w*input_dim.h + loc;
 }
 
@@ -81,14 +83,39 @@ Yolo::box get_yolo_box(float *x, float *biases, int n, int index, int i, int j,
     return b;
 }
 
+// gaussian yolo: x, y, w, h means are entries 0, 2, 4, 6
+Yolo::box get_gaussian_yolo_box(float *x, float *biases, int n, int index, int i, int j, int lw, int lh, int w, int h, int stride) {
+    Yolo::box b;
+    b.x = (i + x[index + 0*stride]) / lw;
+    b.y = (j + x[index + 2*stride]) / lh;
+    b.w = exp(x[index + 4*stride]) * biases[2*n]   / w;
+    b.h = exp(x[index + 6*stride]) * biases[2*n+1] / h;
+    return b;
+}
+
 dnnType* Yolo::infer(dataDim_t &dim, dnnType* srcData) {
 
     checkCuda( cudaMemcpy(dstData, srcData, dim.tot()*sizeof(dnnType), cudaMemcpyDeviceToDevice));
 
     for (int b = 0; b < dim.n; ++b){
         for(int n = 0; n < n_masks; ++n){
-            int index = entry_index(b, n*dim.w*dim.h, 0, classes, input_dim, output_dim);
-            if (new_coords == 1){
+            int index = entry_index(b, n*dim.w*dim.h, 0, classes, input_dim, output_dim, gaussian);
+            if (gaussian){
+                // x and y: mean and sigma
+                for(int e = 0; e <= 2; e += 2) {
+                    index = entry_index(b, n*dim.w*dim.h, e, classes, input_dim, output_dim, gaussian);
+                    activationLOGISTICForward(srcData + index, dstData + index, 2*dim.w*dim.h);
+                    if (this->scaleXY != 1) scalAdd(dstData + index, dim.w*dim.h, this->scaleXY, -0.5*(this->scaleXY - 1), 1);
+                }
+                // w and h: sigma
+                for(int e = 5; e <= 7; e += 2) {
+                    index = entry_index(b, n*dim.w*dim.h, e, classes, input_dim, output_dim, gaussian);
+                    activationLOGISTICForward(srcData + index, dstData + index, dim.w*dim.h);
+                }
+                index = entry_index(b, n*dim.w*dim.h, 8, classes, input_dim, output_dim, gaussian);
+                activationLOGISTICForward(srcData + index, dstData + index, (1+classes)*dim.w*dim.h);
+            }
+            else if (new_coords == 1){
                 if (this->scaleXY != 1) scalAdd(dstData + index, 2 * dim.w*dim.h, this->scaleXY, -0.5*(this->scaleXY - 1), 1);
             }
             else{
@@ -152,17 +179,27 @@ int Yolo::computeDetections(Yolo::detection *dets, int &ndets, int netw, int net
         int row = i / lw;
         int col = i % lw;
         for(n = 0; n < n_masks; ++n){
-            int obj_index  = entry_index(0, n*lw*lh + i, 4, classes, input_dim, output_dim);
+            int coords = gaussian ? 8 : 4;
+            int obj_index  = entry_index(0, n*lw*lh + i, coords, classes, input_dim, output_dim, gaussian);
             float objectness = predictions[obj_index];
             if(objectness <= thresh) continue;
-            int box_index  = entry_index(0, n*lw*lh + i, 0, classes, input_dim, output_dim);
+            int box_index  = entry_index(0, n*lw*lh + i, 0, classes, input_dim, output_dim, gaussian);
             
-            dets[count].bbox = get_yolo_box(predictions, bias_h, mask_h[n], box_index, col, row, lw, lh, netw, neth, lw*lh, newCoords);
+            // gaussian yolo scales the probabilities by the average certainty of the box
+            float certainty = 1;
+            if(gaussian) {
+                dets[count].bbox = get_gaussian_yolo_box(predictions, bias_h, mask_h[n], box_index, col, row, lw, lh, netw, neth, lw*lh);
+                float uc_aver = (predictions[box_index + 1*lw*lh] + predictions[box_index + 3*lw*lh] + 
+                                 predictions[box_index + 5*lw*lh] + predictions[box_index + 7*lw*lh]) / 4.0;
+                certainty = 1.0 - uc_aver;
+            } else {
+                dets[count].bbox = get_yolo_box(predictions, bias_h, mask_h[n], box_index, col, row, lw, lh, netw, neth, lw*lh, newCoords);
+            }
             dets[count].objectness = objectness;
             dets[count].classes = classes;
             for(j = 0; j < classes; ++j){
-                int class_index = entry_index(0, n*lw*lh + i, 4 + 1 + j, classes, input_dim, output_dim);
-                float prob = objectness*predictions[class_index];
+                int class_index = entry_index(0, n*lw*lh + i, coords + 1 + j, classes, input_dim, output_dim, gaussian);
+                float prob = objectness*predictions[class_index]*certainty;
                 dets[count].prob[j] = (prob > thresh) ? prob : 0;
             }
             
@@ -35,6 +35,7 @@ namespace tk { namespace dnn {
         yolo[i]->nms_thresh = yRT->nms_thresh;
         yolo[i]->nsm_kind = (tk::dnn::Yolo::nmsKind_t) yRT->nms_kind;
         yolo[i]->new_coords = yRT->new_coords;
+        yolo[i]->gaussian = yRT->gaussian;
     }
 
     dets = tk::dnn::Yolo::allocateDetections(tk::dnn::Yolo::MAX_DETECTIONS, classes);
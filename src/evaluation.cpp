@@ -1,5 +1,7 @@
 #include "evaluation.h"
+#include "CocoEvaluator.h"
 #include <fstream>
+#include <cmath>
 
 namespace tk { namespace dnn {
 
@@ -29,165 +31,159 @@ void readmAPParams( const char* config_filename, int& classes, int& map_points,
     verbose     = config["verbose"].as<bool>();
 }
 
-/* Credits to https://github.com/AlexeyAB/darknet/blob/master/src/detector.c*/
-double computeMap(  std::vector<Frame> &images,const int classes, 
-                    const float IoU_thresh, const float conf_thresh, 
-                    const int map_points, const bool verbose) {
-    if(verbose)
-        for(auto img:images)
-            img.print();
+// detection reduced to what the precision-recall curve needs
+struct rankedDet_t {
+    float prob;
+    int cl;
+    int truth;          // best groundtruth of the same class (global index), -1 if none
+    float maxIoU;       // its IoU, the match holds for thresholds below it
+    int truthFlag;
+    int uniqueTruthIndex;
+};
+
+static bool rankedComparison(const rankedDet_t& a, const rankedDet_t& b) {
+    return a.prob > b.prob;
+}
 
-    int detections_count = 0;
-    int groundtruths_count = 0;
-    int unique_truth_count = 0;
-    std::vector<int> truth_classes_count(classes,0);
-    std::vector<int> dets_classes_count(classes,0);
+double averagePrecision(const std::vector<double> &precision, const std::vector<double> &recall,
+                        const int map_points) {
+    const int n = precision.size();
+    if(n == 0)
+        return 0;
 
-    //count groundtruth and detections in total and for each class
-    for(auto i:images){
-        for(auto gt:i.gt)
-            truth_classes_count[gt.cl]++;
-        for(auto det:i.det)
-            dets_classes_count[det.cl]++;
-        detections_count += i.det.size();
-        groundtruths_count += i.gt.size();
-    }
+    double avg_precision = 0;
+    if (map_points == 0){ //mAP calculation: ImageNet, PascalVOC 2010-2012
+        double last_recall = recall[n - 1];
+        double last_precision = precision[n - 1];
+        for (int rank = n - 2; rank >= 0; --rank){
+            double delta_recall = last_recall - recall[rank];
+            last_recall = recall[rank];
 
-    if(verbose){
-        std::cout<<"gt_count: "<<groundtruths_count<<std::endl;
-        std::cout<<"det_count: "<<detections_count<<std::endl;
+            if (precision[rank] > last_precision) 
+                last_precision = precision[rank];
+
+            avg_precision += delta_recall * last_precision;
+        }
     }
+    else {//MSCOCO - 101 Recall-points, PascalVOC - 11 Recall-points
+        // best precision at each rank or after it, recall never decreases with the rank
+        std::vector<double> best_precision(n);
+        best_precision[n - 1] = std::max(precision[n - 1], 0.0);
+        for (int rank = n - 2; rank >= 0; --rank)
+            best_precision[rank] = std::max(precision[rank], best_precision[rank + 1]);
+
+        for (int point = 0; point < map_points; ++point) {
+            double cur_recall = point * 1.0 / ( map_points - 1 );
+            int rank = std::lower_bound(recall.begin(), recall.end(), cur_recall) - recall.begin();
+            avg_precision += rank < n ? best_precision[rank] : 0;
+        }
+        avg_precision = avg_precision / map_points;
+    }
+    return avg_precision;
+}
 
-    std::vector<BoundingBox> all_dets;
-    std::vector<BoundingBox> all_gts;
-    
-    int gt_checked = 0;
+/**
+ * Best groundtruth of the same class for every detection above conf_thresh, 
+ * frames are processed in parallel. The result lists the detections frame by 
+ * frame, groundtruth indices are global. The best groundtruth does not depend 
+ * on the IoU threshold, so it is shared by all the IoU levels.
+ */
+static std::vector<rankedDet_t> matchDetections(std::vector<Frame> &images, const float conf_thresh) {
+    std::vector<int> det_offset(images.size() + 1, 0), gt_offset(images.size() + 1, 0);
+    for(size_t f=0; f<images.size(); f++){
+        det_offset[f + 1] = det_offset[f] + images[f].det.size();
+        gt_offset[f + 1] = gt_offset[f] + images[f].gt.size();
+    }
 
-    // for each detection compute IoU with groundtruth and match detetcion and 
-    // groundtruth with IoU greater than IoU_thresh
-    for(auto &img:images){
-        for(size_t i=0; i<img.det.size(); i++){
-            if(img.det[i].prob > conf_thresh){
-                float maxIoU = 0;
-                int truth_index = -1;
+    std::vector<rankedDet_t> dets(det_offset.back());
+    parallelFor(images.size(), [&](int begin, int end) {
+        for(int f=begin; f<end; f++){
+            Frame &img = images[f];
+            for(size_t i=0; i<img.det.size(); i++){
+                rankedDet_t &r = dets[det_offset[f] + i];
+                r = { img.det[i].prob, img.det[i].cl, -1, 0, 0, -1 };
+                if(img.det[i].prob <= conf_thresh)
+                    continue;
                 for(size_t j=0; j<img.gt.size(); j++){
                     float currentIoU = img.det[i].IoU(img.gt[j]);
-                    if(currentIoU > maxIoU && img.det[i].cl == img.gt[j].cl){
-                        maxIoU = currentIoU;                    
-                        truth_index = j;
+                    if(currentIoU > r.maxIoU && img.det[i].cl == img.gt[j].cl){
+                        r.maxIoU = currentIoU;
+                        r.truth = j + gt_offset[f];
                     }
                 }
-                if(truth_index > -1 && maxIoU > IoU_thresh){
-                    img.det[i].uniqueTruthIndex = truth_index + gt_checked;
-                    img.det[i].truthFlag = 1;
-                    img.det[i].maxIoU = maxIoU;
-                }
-            }
-
-            all_dets.push_back(img.det[i]);
-        }
-        gt_checked += img.gt.size();
-    }
-
-    if(verbose){
-        for(auto img:images)
-            img.print();
-        std::cout<<"\n\n\n\n";
-    }
-
-    //sort all detections by descending value of confidence
-    std::sort(all_dets.begin(), all_dets.end(), boxComparison);
-    std::vector<int> truth_flags(groundtruths_count,0);
-
-    if(verbose)
-        for(auto d:all_dets)
-            std::cout<<d;
-
-    //compute precision-recall curve
-    std::vector<std::vector<PR>> pr( classes, std::vector<PR>(detections_count));
-    for(int rank = 0; rank< detections_count; ++rank){
-        if (rank > 0) {
-            for (int class_id = 0; class_id < classes; ++class_id) {
-                pr[class_id][rank].tp = pr[class_id][rank - 1].tp;
-                pr[class_id][rank].fp = pr[class_id][rank - 1].fp;
             }
-        }        
-
-        //if it was detected and never detected before
-        if (all_dets[rank].truthFlag == 1 && truth_flags[all_dets[rank].uniqueTruthIndex] == 0) {
-            truth_flags[all_dets[rank].uniqueTruthIndex] = 1;
-            pr[all_dets[rank].cl][rank].tp++;    // true-positive
-        }
-        else {
-            pr[all_dets[rank].cl][rank].fp++;    // false-positive
         }
+    });
+    return dets;
+}
 
-        for (int i = 0; i < classes; ++i){
-            const int tp = pr[i][rank].tp;
-            const int fp = pr[i][rank].fp;
-            const int fn = truth_classes_count[i] - tp;    // false-negative = objects - true-positive
-            pr[i][rank].fn = fn;
-
-            if ((tp + fp) > 0) 
-                pr[i][rank].precision = (double)tp / (double)(tp + fp);
-            else 
-                pr[i][rank].precision = 0;
-
-            if ((tp + fn) > 0) 
-                pr[i][rank].recall = (double)tp / (double)(tp + fn);
-            else 
-                pr[i][rank].recall = 0;
-
-            if (rank == (detections_count - 1) && dets_classes_count[i] != (tp + fp)) {    
-                // check for last rank
-                printf(" class_id: %d - detections = %d, tp+fp = %d, tp = %d, fp = %d \n", i, dets_classes_count[i], tp+fp, tp, fp);
+/**
+ * Mark the detections matching their groundtruth with IoU greater than 
+ * IoU_thresh, both in the frames and in the ranked detections (same order)
+ */
+static void applyMatches(std::vector<Frame> &images, std::vector<rankedDet_t> &dets, const float IoU_thresh) {
+    size_t k = 0;
+    for(auto &img:images){
+        for(auto &d:img.det){
+            rankedDet_t &r = dets[k++];
+            if(r.truth > -1 && r.maxIoU > IoU_thresh){
+                d.uniqueTruthIndex = r.truth;
+                d.truthFlag = 1;
+                d.maxIoU = r.maxIoU;
             }
+            r.truthFlag = d.truthFlag;
+            r.uniqueTruthIndex = d.uniqueTruthIndex;
         }
     }
+}
 
-    if(verbose){
-        for(int i=0; i < pr.size(); i++)   {
-            std::cout<<"---------Class "<<i<<std::endl;
-            for(auto r:pr[i])
-                r.print();
-        }
-    }
-
-    //compute average precision for each class. Two methods are available, 
-    //based on map_points required
+/**
+ * mAP from detections sorted by descending confidence, class_ranks lists the 
+ * ranks of the detections of each class in order
+ */
+static double rankedMap(const std::vector<rankedDet_t> &all_dets, const std::vector<std::vector<int>> &class_ranks,
+                        const std::vector<int> &truth_classes_count, const int groundtruths_count,
+                        const int classes, const float IoU_thresh, const int map_points, const bool verbose) {
+    const int detections_count = all_dets.size();
+
+    //compute precision-recall curve and average precision of each class in a
+    //single pass over its detections. Two methods are available, based on 
+    //map_points required
+    std::vector<char> truth_flags(groundtruths_count,0);
+    std::vector<double> precision, recall;
     double mean_average_precision = 0;
-    double last_recall, last_precision, delta_recall;
-    double cur_recall, cur_precision;
-    double avg_precision = 0;
     for (int i = 0; i < classes; ++i) {
-        avg_precision = 0;
-        
-        if (map_points == 0){ //mAP calculation: ImageNet, PascalVOC 2010-2012
-            last_recall = pr[i][detections_count - 1].recall;
-            last_precision = pr[i][detections_count - 1].precision;
-            for (int rank = detections_count - 2; rank >= 0; --rank){
-                delta_recall = last_recall - pr[i][rank].recall;
-                last_recall = pr[i][rank].recall;
-
-                if (pr[i][rank].precision > last_precision) 
-                    last_precision = pr[i][rank].precision;
-
-                avg_precision += delta_recall * last_precision;
-            }
+        precision.clear();
+        recall.clear();
+
+        // ranks of other classes before the first detection of this one are (0, 0) points
+        if(detections_count > 0 && (class_ranks[i].empty() || class_ranks[i][0] > 0)) {
+            precision.push_back(0);
+            recall.push_back(0);
         }
-        else {//MSCOCO - 101 Recall-points, PascalVOC - 11 Recall-points
-            for (int point = 0; point < map_points; ++point) {
-                cur_recall = point * 1.0 / ( map_points - 1 );
-                cur_precision = 0;
-                for (int rank = 0; rank < detections_count; ++rank)
-                    if (pr[i][rank].recall >= cur_recall && pr[i][rank].precision > cur_precision) 
-                        cur_precision = pr[i][rank].precision;
-
-                avg_precision += cur_precision;
+
+        int tp = 0, fp = 0;
+        for(int rank: class_ranks[i]) {
+            const rankedDet_t &d = all_dets[rank];
+            //if it was detected and never detected before
+            if (d.truthFlag == 1 && truth_flags[d.uniqueTruthIndex] == 0) {
+                truth_flags[d.uniqueTruthIndex] = 1;
+                tp++;    // true-positive
             }
-            avg_precision = avg_precision / map_points;
+            else {
+                fp++;    // false-positive
+            }
+
+            const int fn = truth_classes_count[i] - tp;    // false-negative = objects - true-positive
+            precision.push_back((tp + fp) > 0 ? (double)tp / (double)(tp + fp) : 0);
+            recall.push_back((tp + fn) > 0 ? (double)tp / (double)(tp + fn) : 0);
+
+            if(verbose)
+                std::cout<<"class "<<i<<" rank "<<rank<<" precision: "<<precision.back()<<" recall: "<<recall.back()
+                         <<" tp: "<<tp<<" fp:"<<fp<<" fn:"<<fn<<std::endl;
         }
 
+        double avg_precision = averagePrecision(precision, recall, map_points);
         if(verbose)
             std::cout<<"Class: "<<i<<" AP: "<< avg_precision<<std::endl;
         mean_average_precision += avg_precision;
@@ -199,6 +195,63 @@ double computeMap(  std::vector<Frame> &images,const int classes,
     return mean_average_precision;
 }
 
+// sort by descending confidence and group the ranks by class
+static void rankDetections(std::vector<rankedDet_t> &dets, const int classes, 
+                           std::vector<std::vector<int>> &class_ranks) {
+    std::sort(dets.begin(), dets.end(), rankedComparison);
+    class_ranks.assign(classes, std::vector<int>());
+    for(size_t rank = 0; rank < dets.size(); ++rank)
+        class_ranks[dets[rank].cl].push_back(rank);
+}
+
+static int countGroundtruths(const std::vector<Frame> &images, const int classes, 
+                             std::vector<int> &truth_classes_count, const bool verbose) {
+    int detections_count = 0;
+    int groundtruths_count = 0;
+    truth_classes_count.assign(classes, 0);
+    for(const auto &i:images){
+        for(const auto &gt:i.gt)
+            truth_classes_count[gt.cl]++;
+        detections_count += i.det.size();
+        groundtruths_count += i.gt.size();
+    }
+
+    if(verbose){
+        std::cout<<"gt_count: "<<groundtruths_count<<std::endl;
+        std::cout<<"det_count: "<<detections_count<<std::endl;
+    }
+    return groundtruths_count;
+}
+
+/* Credits to https://github.com/AlexeyAB/darknet/blob/master/src/detector.c*/
+double computeMap(  std::vector<Frame> &images,const int classes, 
+                    const float IoU_thresh, const float conf_thresh, 
+                    const int map_points, const bool verbose) {
+    if(verbose)
+        for(const auto &img:images)
+            img.print();
+
+    //count groundtruth and detections in total and for each class
+    std::vector<int> truth_classes_count;
+    int groundtruths_count = countGroundtruths(images, classes, truth_classes_count, verbose);
+
+    // for each detection compute IoU with groundtruth and match detetcion and 
+    // groundtruth with IoU greater than IoU_thresh
+    std::vector<rankedDet_t> all_dets = matchDetections(images, conf_thresh);
+    applyMatches(images, all_dets, IoU_thresh);
+
+    if(verbose){
+        for(const auto &img:images)
+            img.print();
+        std::cout<<"\n\n\n\n";
+    }
+
+    std::vector<std::vector<int>> class_ranks;
+    rankDetections(all_dets, classes, class_ranks);
+    return rankedMap(all_dets, class_ranks, truth_classes_count, groundtruths_count, 
+                     classes, IoU_thresh, map_points, verbose);
+}
+
 double computeMapNIoULevels(std::vector<Frame> &images,const int classes, 
                             const float i_IoU_thresh, const float conf_thresh, 
                             const int map_points, const float map_step, 
@@ -210,20 +263,44 @@ double computeMapNIoULevels(std::vector<Frame> &images,const int classes,
         out_file<<net<<";";
     }
 
-    double AP = 0, cur_AP = 0;
+    std::vector<float> IoU_threshs;
     float IoU_thresh = i_IoU_thresh;
+    for(int i=0; i<map_levels; ++i){
+        IoU_threshs.push_back(IoU_thresh);
+        IoU_thresh +=map_step;
+    }
+
+    //clear detection-grounthuth matching
+    for(auto& img:images)
+        for(auto & d:img.det)
+            d.clear();
+
+    std::vector<int> truth_classes_count;
+    int groundtruths_count = countGroundtruths(images, classes, truth_classes_count, verbose);
+
+    // the IoU search is done once, the frames keep the matching of the last level
+    std::vector<rankedDet_t> all_dets = matchDetections(images, conf_thresh);
+    if(map_levels > 0)
+        applyMatches(images, all_dets, IoU_threshs.back());
+    if(verbose)
+        for(const auto &img:images)
+            img.print();
+
+    std::vector<std::vector<int>> class_ranks;
+    rankDetections(all_dets, classes, class_ranks);
 
+    double AP = 0, cur_AP = 0;
     for(int i=0; i<map_levels; ++i){
-        //clear detection-grounthuth matching
-        for(auto& img:images)
-            for(auto & d:img.det)
-                d.clear();
+        for(auto &d:all_dets){
+            d.truthFlag = d.truth > -1 && d.maxIoU > IoU_threshs[i];
+            d.uniqueTruthIndex = d.truthFlag ? d.truth : -1;
+        }
         //compute mAP for the new IoU threshold
-        cur_AP = computeMap(images,classes,IoU_thresh,conf_thresh,map_points, verbose);
+        cur_AP = rankedMap(all_dets, class_ranks, truth_classes_count, groundtruths_count, 
+                           classes, IoU_threshs[i], map_points, verbose);
 	    if(write_on_file)
 	        out_file<<cur_AP<<";";
 	    AP += cur_AP;
-            IoU_thresh +=map_step;
     }
     AP/=map_levels;
 
@@ -315,45 +392,131 @@ void computeTPFPFN( std::vector<Frame> &images,const int classes,
     std::cout<<"avg precision: "<<avg_precision<<"\tavg recall: "<<avg_recall<<"\tavg f1 score:"<<f1_score<<std::endl;
 }
 
-void printJsonCOCOFormat(std::ofstream *out_file, const std::string image_path, std::vector<tk::dnn::box> bbox, const int classes, const int w, const int h)
-{
-    int coco_ids[] = { 1,2,3,4,5,6,7,8,9,10,11,13,14,15,16,17,18,19,20,21,22,23,24,25,27,28,31,32,33,34,35,36,37,38,39,40,41,42,43,44,46,47,48,49,50,51,52,53,54,55,56,57,58,59,60,61,62,63,64,65,67,70,72,73,74,75,76,77,78,79,80,81,82,84,85,86,87,88,89,90 };
-    std::string id = image_path.substr(image_path.find("images/")+7, image_path.find(".jpg") - image_path.find("images/") -7);
-    int image_id = std::stoi(id);
-    for (int i = 0; i < bbox.size(); ++i) {
-        float xmin = bbox[i].x ;
-        float xmax = bbox[i].x + float(bbox[i].w);
-        float ymin = bbox[i].y;
-        float ymax = bbox[i].y + float(bbox[i].h);
-
-        //limit to image borders
-        if (xmin < 0) xmin = 0;
-        if (ymin < 0) ymin = 0;
-        if (xmax > w) xmax = w;
-        if (ymax > h) ymax = h;
-
-        float bx = xmin;
-        float by = ymin;
-        float bw = xmax - xmin;
-        float bh = ymax - ymin;
-
-        if(bbox[i].probs.size() == classes)
-            for (int j = 0; j < classes; ++j) {
-                //min threshold confidence is set in DetectionNN.h
-                if (bbox[i].probs[j] > 0) {
-
-                    *out_file <<    "{\"image_id\":" << image_id <<
-                                    ", \"category_id\":" << coco_ids[j] << 
-                                    ", \"bbox\":[" << bx << ", " << by << ", " << bw << ", " << bh << 
-                                    "], \"score\":" << bbox[i].probs[j] << "},\n";
+MapAccumulator::MapAccumulator(const int classes, const float i_IoU_thresh, const float conf_thresh, 
+                               const int map_points, const float map_step, const int map_levels, 
+                               const int score_bins) : 
+    classes(classes), map_points(map_points), score_bins(score_bins), conf_thresh(conf_thresh) {
+    // same accumulation as computeMapNIoULevels
+    float IoU_thresh = i_IoU_thresh;
+    for(int i=0; i<map_levels; ++i){
+        IoU_threshs.push_back(IoU_thresh);
+        IoU_thresh +=map_step;
+    }
+    clear();
+}
+
+void MapAccumulator::clear() {
+    frames = detections = groundtruths = 0;
+    max_score = 0;
+    class_scores.assign(classes, scoreCounts_t());
+    truth_classes_count.assign(classes, 0);
+}
+
+float MapAccumulator::score(const float prob) const {
+    if(score_bins <= 0)
+        return prob;
+    return std::floor(std::min(std::max(prob, 0.0f), 1.0f) * score_bins) / score_bins;
+}
+
+void MapAccumulator::add(const std::vector<BoundingBox> &gt, const std::vector<BoundingBox> &det) {
+    const int levels = IoU_threshs.size();
+    for(const auto &g:gt)
+        truth_classes_count[g.cl]++;
+
+    // best groundtruth of the same class, as matchDetections
+    std::vector<int> truth(det.size(), -1);
+    std::vector<float> maxIoU(det.size(), 0);
+    for(size_t i=0; i<det.size(); i++){
+        if(det[i].prob <= conf_thresh)
+            continue;
+        BoundingBox d = det[i];
+        for(size_t j=0; j<gt.size(); j++){
+            float currentIoU = d.IoU(gt[j]);
+            if(currentIoU > maxIoU[i] && d.cl == gt[j].cl){
+                maxIoU[i] = currentIoU;
+                truth[i] = j;
+            }
+        }
+    }
+
+    // the highest confidence detection of each groundtruth is its true positive
+    std::vector<int> best(gt.size());
+    std::vector<std::vector<char>> tp(levels, std::vector<char>(det.size(), 0));
+    for(int l=0; l<levels; l++){
+        std::fill(best.begin(), best.end(), -1);
+        for(size_t i=0; i<det.size(); i++)
+            if(truth[i] > -1 && maxIoU[i] > IoU_threshs[l])
+                if(best[truth[i]] == -1 || det[i].prob > det[best[truth[i]]].prob)
+                    best[truth[i]] = i;
+        for(int b:best)
+            if(b > -1)
+                tp[l][b] = 1;
+    }
+
+    for(size_t i=0; i<det.size(); i++){
+        const float s = score(det[i].prob);
+        scoreCount_t &c = class_scores[det[i].cl][s];
+        if(c.tp.empty())
+            c.tp.resize(levels, 0);
+        c.dets++;
+        for(int l=0; l<levels; l++)
+            c.tp[l] += tp[l][i];
+        if(detections == 0 || s > max_score)
+            max_score = s;
+        detections++;
+    }
+    groundtruths += gt.size();
+    frames++;
+}
+
+double MapAccumulator::map(const int level) const {
+    // the curve of rankedMap with a point for each true positive and one for
+    // the last detection of each confidence: the points skipped are false 
+    // positives between them, with the same recall and a lower precision, 
+    // which do not change the AP
+    std::vector<double> precision, recall;
+    double mean_average_precision = 0;
+    for (int i = 0; i < classes; ++i) {
+        precision.clear();
+        recall.clear();
+
+        // detections of other classes ranked before the first of this one
+        if(detections > 0 && (class_scores[i].empty() || class_scores[i].begin()->first < max_score)) {
+            precision.push_back(0);
+            recall.push_back(0);
+        }
+
+        const int truths = truth_classes_count[i];
+        int tp = 0, ranked = 0;
+        for(const auto &s: class_scores[i]) {
+            const int score_tp = s.second.tp[level];
+            for(int k=0; k<score_tp + (s.second.dets > score_tp); k++) {
+                if(k < score_tp) {
+                    tp++;
+                    ranked++;
                 }
+                else
+                    ranked += s.second.dets - score_tp;
+                precision.push_back(ranked > 0 ? (double)tp / (double)ranked : 0);
+                recall.push_back(truths > 0 ? (double)tp / (double)truths : 0);
             }
-        else
-            *out_file <<    "{\"image_id\":" << image_id <<
-                            ", \"category_id\":" << coco_ids[bbox[i].cl] << 
-                            ", \"bbox\":[" << bx << ", " << by << ", " << bw << ", " << bh << 
-                            "], \"score\":" << bbox[i].prob << "},\n";
+        }
+        mean_average_precision += averagePrecision(precision, recall, map_points);
     }
+    return mean_average_precision / classes;
+}
+
+double MapAccumulator::mapNIoULevels() const {
+    double AP = 0;
+    for(size_t i=0; i<IoU_threshs.size(); ++i)
+        AP += map(i);
+    return IoU_threshs.empty() ? 0 : AP / IoU_threshs.size();
+}
+
+void printJsonCOCOFormat(std::ofstream *out_file, const std::string image_path, std::vector<tk::dnn::box> bbox, const int classes, const int w, const int h)
+{
+    for(const auto &r: cocoResults(image_path, bbox, classes, w, h))
+        printCocoResult(*out_file, r);
 }
 
 }}
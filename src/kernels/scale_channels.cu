@@ -0,0 +1,40 @@
+#include "kernels.h"
+
+__global__ void scale_channels_kernel(dnnType *in_w_h_c, int size, int channel_size, int batch_size, 
+                                      int scale_wh, dnnType *scales_c, dnnType *out)
+{
+    int index = (blockIdx.x + blockIdx.y*gridDim.x) * blockDim.x + threadIdx.x;
+    if (index >= size) return;
+
+    if (scale_wh) {
+        int osd_index = index % channel_size + (index / batch_size)*channel_size;
+        out[index] = in_w_h_c[index] * scales_c[osd_index];
+    }
+    else {
+        out[index] = in_w_h_c[index] * scales_c[index / channel_size];
+    }
+}
+
+void scaleChannelsForward(dnnType *srcData, dnnType *scales, dnnType *dstData, int size,
+                          int channel_size, int batch_size, bool scale_wh, cudaStream_t stream)
+{
+    int blocks = (size+255)/256;
+    int threads = 256;
+
+    scale_channels_kernel<<<blocks, threads, 0, stream>>>(srcData, size, channel_size, batch_size, 
+                                                          scale_wh, scales, dstData);
+}
+
+__global__ void sam_kernel(dnnType *in_w_h_c, int size, dnnType *scales_c, dnnType *out)
+{
+    int index = (blockIdx.x + blockIdx.y*gridDim.x) * blockDim.x + threadIdx.x;
+    if (index < size) out[index] = in_w_h_c[index] * scales_c[index];
+}
+
+void samForward(dnnType *srcData, dnnType *scales, dnnType *dstData, int size, cudaStream_t stream)
+{
+    int blocks = (size+255)/256;
+    int threads = 256;
+
+    sam_kernel<<<blocks, threads, 0, stream>>>(srcData, size, scales, dstData);
+}
@@ -78,3 +78,23 @@ void shortcutForward(dnnType* srcData, dnnType* dstData, int n1, int c1, int h1,
             w1, h1, c1, srcData, w2, h2, c2, s1, s2, dstData);  
     }
 }
+
+__global__ void shortcut_weighted_kernel(int size, int c, int hw, const dnnType *weights, 
+                                         dnnType *src, dnnType *out, bool accumulate)
+{
+    int id = (blockIdx.x + blockIdx.y*gridDim.x) * blockDim.x + threadIdx.x;
+    if (id >= size) return;
+    int k = (id / hw) % c;
+    float val = src[id] * weights[k];
+    out[id] = accumulate ? out[id] + val : val;
+}
+
+void shortcutWeightedForward(dnnType* srcData, dnnType* dstData, const dnnType *weights,
+                             int n, int c, int hw, bool accumulate, cudaStream_t stream)
+{
+    int size = n*c*hw;
+    int blocks = (size+255)/256;
+    int threads = 256;
+
+    shortcut_weighted_kernel<<<blocks, threads, 0, stream>>>(size, c, hw, weights, srcData, dstData, accumulate);
+}
@@ -21,7 +21,7 @@ static const char* YOLORT_PLUGIN_NAME{"YoloRT_tkDNN"};
 
 YoloRT::YoloRT(int classes, int num, int c,int h,int w,int n_masks, float scale_xy,
                float nms_thresh, int nms_kind,
-               int new_coords) {
+               int new_coords, int gaussian) {
     this->c = c;
     this->h = h;
     this->w = w;
@@ -32,6 +32,7 @@ YoloRT::YoloRT(int classes, int num, int c,int h,int w,int n_masks, float scale_
     this->nms_thresh = nms_thresh;
     this->nms_kind = nms_kind;
     this->new_coords = new_coords;
+    this->gaussian = gaussian;
 
     bias.clear();
     mask.clear();
@@ -66,6 +67,9 @@ YoloRT::YoloRT(const void *data, size_t length) {
             tmp[j] = readBUF<char>(buf);
         classesNames[i] = std::string(tmp);
     }
+    gaussian = 0;
+    if(buf < bufCheck + length)
+        gaussian = readBUF<int>(buf);
     assert(buf == bufCheck + length);
     gYoloPlugins.push_back(this);
 }
@@ -105,7 +109,20 @@ int YoloRT::enqueue(int batchSize, const void *const *inputs, void *const *outpu
     for (int b = 0; b < batchSize; ++b) {
         for (int n = 0; n < n_masks; ++n) {
             int index = entry_index(b, n * w * h, 0);
-            if (new_coords == 1) {
+            if (gaussian) {
+                for (int e = 0; e <= 2; e += 2) { // x,y mean and sigma
+                    index = entry_index(b, n * w * h, e);
+                    activationLOGISTICForward(srcData + index, dstData + index, 2 * w * h, stream);
+                    if (this->scaleXY != 1)
+                        scalAdd(dstData + index, w * h, this->scaleXY, -0.5 * (this->scaleXY - 1), 1, stream);
+                }
+                for (int e = 5; e <= 7; e += 2) { // w,h sigma
+                    index = entry_index(b, n * w * h, e);
+                    activationLOGISTICForward(srcData + index, dstData + index, w * h, stream);
+                }
+                index = entry_index(b, n * w * h, 8);
+                activationLOGISTICForward(srcData + index, dstData + index, (1 + classes) * w * h, stream);
+            } else if (new_coords == 1) {
                 if (this->scaleXY != 1)
                     scalAdd(dstData + index, 2 * w * h, this->scaleXY, -0.5 * (this->scaleXY - 1), 1);
             } else {
@@ -135,7 +152,20 @@ int32_t YoloRT::enqueue(int32_t batchSize, const void *const *inputs, void **out
     for (int b = 0; b < batchSize; ++b) {
         for (int n = 0; n < n_masks; ++n) {
             int index = entry_index(b, n * w * h, 0);
-            if (new_coords == 1) {
+            if (gaussian) {
+                for (int e = 0; e <= 2; e += 2) { // x,y mean and sigma
+                    index = entry_index(b, n * w * h, e);
+                    activationLOGISTICForward(srcData + index, dstData + index, 2 * w * h, stream);
+                    if (this->scaleXY != 1)
+                        scalAdd(dstData + index, w * h, this->scaleXY, -0.5 * (this->scaleXY - 1), 1, stream);
+                }
+                for (int e = 5; e <= 7; e += 2) { // w,h sigma
+                    index = entry_index(b, n * w * h, e);
+                    activationLOGISTICForward(srcData + index, dstData + index, w * h, stream);
+                }
+                index = entry_index(b, n * w * h, 8);
+                activationLOGISTICForward(srcData + index, dstData + index, (1 + classes) * w * h, stream);
+            } else if (new_coords == 1) {
                 if (this->scaleXY != 1)
                     scalAdd(dstData + index, 2 * w * h, this->scaleXY, -0.5 * (this->scaleXY - 1), 1);
             } else {
@@ -157,7 +187,7 @@ int32_t YoloRT::enqueue(int32_t batchSize, const void *const *inputs, void **out
 
 
 size_t YoloRT::getSerializationSize() const NOEXCEPT {
-    return 8 * sizeof(int) + 2 * sizeof(float) + n_masks*sizeof(dnnType) + num*n_masks*2*sizeof(dnnType) + YOLORT_CLASSNAME_W*classes*sizeof(char);
+    return 9 * sizeof(int) + 2 * sizeof(float) + n_masks*sizeof(dnnType) + num*n_masks*2*sizeof(dnnType) + YOLORT_CLASSNAME_W*classes*sizeof(char);
 }
 
 bool YoloRT::supportsFormat(DataType type, PluginFormat format) const NOEXCEPT {
@@ -189,6 +219,7 @@ void YoloRT::serialize(void *buffer) const NOEXCEPT {
             writeBUF(buf, tmp[j]);
         }
     }
+    writeBUF(buf, gaussian);
 
     assert(buf == a + getSerializationSize());
 }
@@ -214,7 +245,7 @@ void YoloRT::setPluginNamespace(const char *pluginNamespace) NOEXCEPT {
 }
 
 IPluginV2Ext *YoloRT::clone() const NOEXCEPT {
-    auto *p = new YoloRT(classes, num,c,h,w,n_masks, scaleXY, nms_thresh, nms_kind, new_coords);
+    auto *p = new YoloRT(classes, num,c,h,w,n_masks, scaleXY, nms_thresh, nms_kind, new_coords, gaussian);
     p->mask = mask;
     p->bias = bias;
     p->classesNames = classesNames;
@@ -293,6 +324,8 @@ IPluginV2Ext *YoloRTPluginCreator::createPlugin(const char *name, const PluginFi
         pluginObj->classesNames[i].resize(fields[12+i].length);
         memcpy(&pluginObj->classesNames[i][0], fields[12+i].data, fields[12+i].length*sizeof(char));
     }
+    if(fc->nbFields > 12 + classes)
+        pluginObj->gaussian = *(static_cast<const int*>(fields[12+classes].data));
     return pluginObj;
 }
 
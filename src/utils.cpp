@@ -1,5 +1,8 @@
 #include "utils.h"
 #include <string.h>
+#include <thread>
+#include <vector>
+#include <algorithm>
 
 void printCenteredTitle(const char *title, char fill, int dim) {
 
@@ -244,3 +247,32 @@ void removePathAndExtension(const std::string &full_string, std::string &name){
     
     // std::cout<<"full string: "<<full_string<<" name: "<<name<<std::endl;
 }
+
+
+int getCPUThreads() {
+    int n_threads = 0;
+    if(const char* env_p = std::getenv("TKDNN_CPU_THREADS"))
+        n_threads = atoi(env_p);
+    if(n_threads <= 0)
+        n_threads = std::thread::hardware_concurrency();
+    return std::max(n_threads, 1);
+}
+
+void parallelFor(int n, const std::function<void(int, int)> &body, int n_threads) {
+    if(n <= 0)
+        return;
+    if(n_threads <= 0)
+        n_threads = getCPUThreads();
+    n_threads = std::min(n_threads, n);
+    if(n_threads == 1) {
+        body(0, n);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    int chunk = (n + n_threads - 1) / n_threads;
+    for(int b=0; b<n; b+=chunk)
+        workers.emplace_back(body, b, std::min(n, b + chunk));
+    for(auto &w: workers)
+        w.join();
+}
@@ -1,5 +1,7 @@
 #include <iostream>
 #include "tkdnn.h"
+#include "DarknetParser.h"
+#include "test.h"
 
 const char *input_bin = "dla34_cnet/debug/input.bin";
 const char *conv1_bin = "dla34_cnet/layers/base-base_layer-0.bin";
@@ -492,6 +494,8 @@ int main()
 //    }
 
     //convert network to tensorRT
+    // stored in the engine sidecar, read by CenternetDetection
+    net.classesNames = tk::dnn::darknetReadNames("../tests/darknet/names/coco.names");
     tk::dnn::NetworkRT netRT(&net, net.getNetworkRTName("dla34_cnet"));
 
     tk::dnn::dataDim_t dim1 = dim; //input dim
@@ -504,6 +508,8 @@ int main()
         dim1.print();
     }
 
+    int ret_cpu = testDeformConv2dCPU(&net);
+
     tk::dnn::dataDim_t dim2 = dim;
     printCenteredTitle(" TENSORRT inference ", '=', 30);
     {
@@ -541,5 +547,5 @@ int main()
         ret_cudnn_tensorrt |= checkResult(odim, cudnn_out, rt_out) == 0 ? 0 : ERROR_CUDNNvsTENSORRT;
     }
     netRT.destroy();
-    return ret_cudnn | ret_tensorrt | ret_cudnn_tensorrt;
+    return ret_cudnn | ret_tensorrt | ret_cudnn_tensorrt | ret_cpu;
 }
@@ -1,5 +1,6 @@
 #include <iostream>
 #include "tkdnn.h"
+#include "test.h"
 
 const char *input_bin = "dla34_cnet3d/debug/input.bin";
 const char *conv1_bin = "dla34_cnet3d/layers/base-base_layer-0.bin";
@@ -510,6 +511,8 @@ int main()
     net.print();
 
     //convert network to tensorRT
+    // stored in the engine sidecar, read by CenternetDetection3D
+    net.classesNames = {"person", "car", "bicycle"};
     tk::dnn::NetworkRT netRT(&net, net.getNetworkRTName("dla34_cnet3d"));
 
     tk::dnn::dataDim_t dim1 = dim; //input dim
@@ -522,6 +525,8 @@ int main()
         dim1.print();
     }
 
+    int ret_cpu = testDeformConv2dCPU(&net);
+
     tk::dnn::dataDim_t dim2 = dim;
     printCenteredTitle(" TENSORRT inference ", '=', 30);
     {
@@ -559,5 +564,5 @@ int main()
         ret_cudnn_tensorrt |= checkResult(odim, cudnn_out, rt_out) == 0 ? 0 : ERROR_CUDNNvsTENSORRT;
     }
     netRT.destroy();
-    return ret_cudnn | ret_tensorrt | ret_cudnn_tensorrt;
+    return ret_cudnn | ret_tensorrt | ret_cudnn_tensorrt | ret_cpu;
 }
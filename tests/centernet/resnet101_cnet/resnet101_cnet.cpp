@@ -3,6 +3,7 @@
 #include "kernels.h"
 #include "Yolo3Detection.h"
 #include "tkdnn.h"
+#include "DarknetParser.h"
 #include <vector>
 #include <numeric>      // std::iota
 #include <algorithm>    // std::sort
@@ -366,6 +367,8 @@ int main()
 //    }
 
     //convert network to tensorRT
+    // stored in the engine sidecar, read by CenternetDetection
+    net.classesNames = tk::dnn::darknetReadNames("../tests/darknet/names/coco.names");
     tk::dnn::NetworkRT netRT(&net, net.getNetworkRTName("resnet101_cnet"));
 
     
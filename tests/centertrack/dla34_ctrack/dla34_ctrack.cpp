@@ -1,13 +1,19 @@
 #include <iostream>
+#include <fstream>
+#include <vector>
+#include <cstring>
 #include "tkdnn.h"
-const char *input_bin = "dla34_ctrack/debug/input_base-level0-0.bin";
-// const char *input_bin = "dla34_ctrack/debug/input.bin";
-// const char *pre_img_bin = "dla34_ctrack/debug/pre_imgages.bin";
-// const char *pre_hm_bin = "dla34_ctrack/debug/pre_hms.bin";
-// //pre
-// const char *pre_img_conv1_bin = "dla34_ctrack/layers/base-pre_img_layer-0.bin";
-// const char *pre_hm_conv1_bin = "dla34_ctrack/layers/base-pre_hm_layer-0.bin";
-// const char *conv1_bin = "dla34_ctrack/layers/base-base_layer-0.bin";
+#include "test.h"
+const char *input_bin = "dla34_ctrack/debug/input.bin";
+const char *pre_img_bin = "dla34_ctrack/debug/pre_imgages.bin";
+const char *pre_hm_bin = "dla34_ctrack/debug/pre_hms.bin";
+//pre
+const char *pre_img_conv1_bin = "dla34_ctrack/layers/base-pre_img_layer-0.bin";
+const char *pre_hm_conv1_bin = "dla34_ctrack/layers/base-pre_hm_layer-0.bin";
+const char *conv1_bin = "dla34_ctrack/layers/base-base_layer-0.bin";
+// pre-phase folded in the engine, written from the three above
+const char *pre_fused_bin = "dla34_ctrack/layers/base-pre_fused.bin";
+const char *pre_sum_bin = "dla34_ctrack/layers/base-pre_sum.bin";
 
 const char *conv2_bin = "dla34_ctrack/layers/base-level0-0.bin";
 const char *conv3_bin = "dla34_ctrack/layers/base-level1-0.bin";
@@ -121,49 +127,64 @@ const char *output_bin[]={
 "dla34_ctrack/debug/dim.bin",
 "dla34_ctrack/debug/amodel_offset.bin"};
 // const char *output_bin = "dla34_ctrack/debug/base-level0-2.bin";
+/*
+    The pre-phase is relu(conv1(image)) + relu(pre_img_conv1(pre_img)) + relu(pre_hm_conv1(pre_hm)),
+    three 7x7 convs with batchnorm. On the 7 channels input [image, pre_img, pre_hm] it is
+    one 7x7 conv with 48 outputs, block diagonal (each block sees only its input channels),
+    a relu and a 1x1 conv that sums the three blocks of 16 channels.
+*/
+void writePreFused() {
+    const char *bins[3] = { conv1_bin, pre_img_conv1_bin, pre_hm_conv1_bin };
+    const int in_ch[3] = { 3, 3, 1 }, in_start[3] = { 0, 3, 6 };
+    const int O = 16, C = 7, KK = 7*7;
+
+    std::vector<float> weights(3*O*C*KK, 0), bn[4];
+    for(int b=0; b<3; b++) {
+        const int n_w = O*in_ch[b]*KK;
+        std::vector<float> w(n_w + 4*O);
+        std::ifstream in(bins[b], std::ios::in | std::ios::binary);
+        if(!in.read((char*) w.data(), w.size()*sizeof(float)))
+            FatalError(std::string("Error reading file ") + bins[b]);
+        for(int o=0; o<O; o++)
+            for(int c=0; c<in_ch[b]; c++)
+                for(int k=0; k<KK; k++)
+                    weights[((b*O + o)*C + in_start[b] + c)*KK + k] = w[(o*in_ch[b] + c)*KK + k];
+        // bias, scales, mean, variance
+        for(int i=0; i<4; i++)
+            bn[i].insert(bn[i].end(), w.begin() + n_w + i*O, w.begin() + n_w + (i+1)*O);
+    }
+    std::ofstream out(pre_fused_bin, std::ios::out | std::ios::binary);
+    out.write((const char*) weights.data(), weights.size()*sizeof(float));
+    for(int i=0; i<4; i++)
+        out.write((const char*) bn[i].data(), bn[i].size()*sizeof(float));
+
+    std::vector<float> sum(O*3*O + O, 0);
+    for(int o=0; o<O; o++)
+        for(int b=0; b<3; b++)
+            sum[o*3*O + b*O + o] = 1;
+    std::ofstream out_sum(pre_sum_bin, std::ios::out | std::ios::binary);
+    out_sum.write((const char*) sum.data(), sum.size()*sizeof(float));
+}
+
 int main()
 {
 
     downloadWeightsifDoNotExist("dla34_ctrack/debug/input.bin", "dla34_ctrack", "https://cloud.hipert.unimore.it/s/rjNfgGL9FtAXLHp/download");
 
     // Network layout
-    // tk::dnn::dataDim_t dim_in0(1, 3, 512, 512, 1);
-    // tk::dnn::dataDim_t dim_in1(1, 1, 512, 512, 1);
-    tk::dnn::dataDim_t dim_in0(1, 16, 512, 512, 1);
-    // dnnType *i0_d, *i1_d, *i2_d;
-    // dnnType *i0_h, *i1_h, *i2_h;
-    // checkCuda( cudaMalloc(&i0_d, dim_in0.tot()*sizeof(dnnType)) );
-    // checkCuda( cudaMalloc(&i1_d, dim_in1.tot()*sizeof(dnnType)) );
-    // checkCuda( cudaMalloc(&i2_d, dim_in0.tot()*sizeof(dnnType)) );
+    // input: image (3), previous image (3), previous heatmap (1)
+    tk::dnn::dataDim_t dim_in0(1, 7, 512, 512, 1);
+    writePreFused();
 
     tk::dnn::Network net(dim_in0);
     tk::dnn::Layer *last1, *last2, *last3, *last4;
     tk::dnn::Layer *base1, *base2, *base3, *base4, *base5, *base6, *ida1, *ida2_1, *ida2_2, *ida3_1, *ida3_2, *ida3_3, *idaup_1, *idaup_2;
-    // tk::dnn::Layer *pre_img, *pre_hm;
-
-    // //pre-img
-    // readBinaryFile(pre_img_bin, dim_in0.tot(), &i0_h, &i0_d);
-    // tk::dnn::Input *in_pre_img = new tk::dnn::Input(&net, dim_in0, i0_d);
-    // tk::dnn::Conv2d     pre_img_conv1(&net, 16, 7, 7, 1, 1, 3, 3, pre_img_conv1_bin, true);
-    // tk::dnn::Activation pre_img_relu(&net, CUDNN_ACTIVATION_RELU);
-    // pre_img = &pre_img_relu;
-
-    // //pre-hm
-    // readBinaryFile(pre_hm_bin, dim_in1.tot(), &i1_h, &i1_d);
-    // tk::dnn::Input *in_pre_hm = new tk::dnn::Input(&net, dim_in1, i1_d);
-    // tk::dnn::Conv2d     pre_hm_conv1(&net, 16, 7, 7, 1, 1, 3, 3, pre_hm_conv1_bin, true);
-    // tk::dnn::Activation pre_hm_relu(&net, CUDNN_ACTIVATION_RELU);
-    // pre_hm = &pre_hm_relu;
-
-    // // image input
-    // readBinaryFile(input_bin, dim_in0.tot(), &i2_h, &i2_d);
-    // tk::dnn::Input *input_image = new tk::dnn::Input(&net, dim_in0, i2_d);
-    // tk::dnn::Conv2d *conv1 = new tk::dnn::Conv2d(&net, 16, 7, 7, 1, 1, 3, 3, conv1_bin, true);
-    // tk::dnn::Activation relu1(&net, CUDNN_ACTIVATION_RELU);
-
-    // tk::dnn::Shortcut s0_input(&net, pre_img);
-    // tk::dnn::Shortcut s1_input(&net, pre_hm);
-    
+
+    // pre-phase: base_layer, pre_img_layer and pre_hm_layer folded together
+    tk::dnn::Conv2d     pre_fused(&net, 48, 7, 7, 1, 1, 3, 3, pre_fused_bin, true);
+    tk::dnn::Activation pre_fused_relu(&net, CUDNN_ACTIVATION_RELU);
+    tk::dnn::Conv2d     pre_sum(&net, 16, 1, 1, 1, 1, 0, 0, pre_sum_bin, false);
+
     tk::dnn::Conv2d conv2(&net, 16, 3, 3, 1, 1, 1, 1, conv2_bin, true);
     tk::dnn::Activation relu2(&net, CUDNN_ACTIVATION_RELU);
     base1 = &relu2;
@@ -560,10 +581,18 @@ int main()
     a_off->setFinal();
 
 
-    // Load input
-    dnnType *data;
-    dnnType *input_h;
-    readBinaryFile(input_bin, dim_in0.tot(), &input_h, &data);
+    // Load input, the three inputs stacked by channel
+    const int hw = dim_in0.h*dim_in0.w;
+    dnnType *data, *input_h, *i0_d, *i0_h, *i1_d, *i1_h, *i2_d, *i2_h;
+    readBinaryFile(input_bin, 3*hw, &i0_h, &i0_d);
+    readBinaryFile(pre_img_bin, 3*hw, &i1_h, &i1_d);
+    readBinaryFile(pre_hm_bin, hw, &i2_h, &i2_d);
+    input_h = new dnnType[dim_in0.tot()];
+    memcpy(input_h, i0_h, 3*hw*sizeof(dnnType));
+    memcpy(input_h + 3*hw, i1_h, 3*hw*sizeof(dnnType));
+    memcpy(input_h + 6*hw, i2_h, hw*sizeof(dnnType));
+    checkCuda( cudaMalloc(&data, dim_in0.tot()*sizeof(dnnType)) );
+    checkCuda( cudaMemcpy(data, input_h, dim_in0.tot()*sizeof(dnnType), cudaMemcpyHostToDevice) );
     //printDeviceVector(64, data, true);
 
     //print network model
@@ -584,6 +613,8 @@ int main()
         dim1.print();
     }
         
+    int ret_cpu = testDeformConv2dCPU(&net);
+
     tk::dnn::dataDim_t dim2 = dim_in0;
     printCenteredTitle(" TENSORRT inference ", '=', 30);
     {
@@ -628,5 +659,5 @@ int main()
         std::cout<<"CUDNN vs TRT    "; 
         ret_cudnn_tensorrt |= checkResult(odim, cudnn_out, rt_out) == 0 ? 0 : ERROR_CUDNNvsTENSORRT;
     }
-    return ret_cudnn | ret_tensorrt | ret_cudnn_tensorrt;
+    return ret_cudnn | ret_tensorrt | ret_cudnn_tensorrt | ret_cpu;
 }
@@ -0,0 +1,225 @@
+#include<iostream>
+#include<vector>
+#include<fstream>
+#include<random>
+#include<math.h>
+#include<algorithm>
+#include "tkdnn.h"
+#include "DarknetParser.h"
+
+/*
+    Darknet layers without a published test model: sam, scale_channels, connected,
+    dropout, local_avgpool, gaussian_yolo and the weighted multi-input shortcut
+    (tests/darknet/cfg/darknet_layers.cfg).
+    The weights are random, written as a darknet .weights file, so the streaming
+    loader and its layouts are used. Every new layer is checked against a CPU
+    reference computed from the outputs of the layers it reads, then cuDNN
+    against tensorRT.
+*/
+
+std::mt19937 gen(42);
+
+std::vector<float> rnd(int n, float lo = -0.5f, float hi = 0.5f) {
+    std::uniform_real_distribution<float> dist(lo, hi);
+    std::vector<float> v(n);
+    for(auto &x: v)
+        x = dist(gen);
+    return v;
+}
+
+std::vector<float> hostData(tk::dnn::Layer *l) {
+    std::vector<float> v(l->output_dim.tot());
+    checkCuda( cudaDeviceSynchronize() );
+    checkCuda( cudaMemcpy(v.data(), l->dstData, v.size()*sizeof(dnnType), cudaMemcpyDeviceToHost) );
+    return v;
+}
+
+int checkLayer(const std::string &name, tk::dnn::Layer *l, std::vector<float> ref) {
+    std::vector<float> out = hostData(l);
+    std::cout<<name<<" CUDNN vs CPU";
+    return checkResult(ref.size(), out.data(), ref.data(), false) == 0 ? 0 : ERROR_CPUvsCUDNN;
+}
+
+int main() {
+    std::string bin_path  = "darknet_layers";
+    std::string cfg_path  = std::string(TKDNN_PATH) + "/tests/darknet/cfg/darknet_layers.cfg";
+    std::string name_path = std::string(TKDNN_PATH) + "/tests/darknet/names/coco.names";
+    std::string wgs_path  = bin_path + "/darknet_layers.weights";
+    system( (std::string("mkdir -p ") + bin_path).c_str() );
+
+    // darknet order, see the cfg
+    struct { std::vector<float> bias, weights, scales, mean, variance; } fc;
+    std::vector<float> sc_channel, sc_feature;
+    {
+        std::ofstream f(wgs_path, std::ios::out | std::ios::binary);
+        int32_t version[3] = { 0, 2, 0 };
+        uint64_t seen = 0;
+        f.write((char*) version, sizeof(version));
+        f.write((char*) &seen, sizeof(seen));
+        auto put = [&f](const std::vector<float> &v) { f.write((char*) v.data(), v.size()*sizeof(float)); };
+
+        // conv: bias, [scales, mean, variance], weights
+        put(rnd(16)); put(rnd(16*3*3*3));
+        put(rnd(16)); put(rnd(16, 0.5, 1.5)); put(rnd(16)); put(rnd(16, 0.5, 1.5)); put(rnd(16*16));
+        // connected: bias, weights, scales, mean, variance
+        fc.bias = rnd(16); fc.weights = rnd(16*16*32*32, -0.01, 0.01);
+        fc.scales = rnd(16, 0.5, 1.5); fc.mean = rnd(16); fc.variance = rnd(16, 0.5, 1.5);
+        put(fc.bias); put(fc.weights); put(fc.scales); put(fc.mean); put(fc.variance);
+        put(rnd(16)); put(rnd(16*16*3*3));
+        // shortcuts: (inputs+1) x channels, inputs+1
+        sc_channel = rnd(3*16, -1, 1); put(sc_channel);
+        sc_feature = rnd(2, -1, 1);    put(sc_feature);
+        put(rnd(267)); put(rnd(267*16));
+    }
+
+    // parse darknet network
+    tk::dnn::Network *net = tk::dnn::darknetParser(cfg_path, wgs_path, name_path);
+    net->print();
+
+    dnnType *data;
+    std::vector<float> input = rnd(net->input_dim.tot(), 0, 1);
+    checkCuda( cudaMalloc(&data, input.size()*sizeof(dnnType)) );
+    checkCuda( cudaMemcpy(data, input.data(), input.size()*sizeof(dnnType), cudaMemcpyHostToDevice) );
+
+    tk::dnn::dataDim_t dim1 = net->input_dim;
+    printCenteredTitle(" CUDNN inference ", '=', 30); {
+        dim1.print();
+        TKDNN_TSTART
+        net->infer(dim1, data);
+        TKDNN_TSTOP
+        dim1.print();
+    }
+
+    printCenteredTitle(" CPU REFERENCE CHECK ", '=', 30);
+    int ret = 0;
+    for(int i=1; i<net->num_layers; i++) {
+        tk::dnn::Layer *l = net->layers[i];
+        std::vector<float> in = hostData(net->layers[i-1]);
+        tk::dnn::dataDim_t idim = l->input_dim, odim = l->output_dim;
+        int wh = odim.w*odim.h;
+        std::vector<float> ref(odim.tot(), 0);
+
+        switch(l->getLayerType()) {
+        case tk::dnn::LAYER_POOLING: {
+            tk::dnn::Pooling *p = (tk::dnn::Pooling*) l;
+            if(p->pool_mode != tk::dnn::POOLING_AVERAGE_FIXEDSIZE)
+                continue;
+            int offset = -p->padding/2;
+            for(int c=0; c<odim.c; c++)
+            for(int y=0; y<odim.h; y++)
+            for(int x=0; x<odim.w; x++) {
+                float sum = 0;
+                int count = 0;
+                for(int m=0; m<p->winH; m++)
+                for(int n=0; n<p->winW; n++) {
+                    int iy = offset + y*p->strideH + m, ix = offset + x*p->strideW + n;
+                    if(iy < 0 || iy >= idim.h || ix < 0 || ix >= idim.w)
+                        continue;
+                    sum += in[(c*idim.h + iy)*idim.w + ix];
+                    count++;
+                }
+                ref[(c*odim.h + y)*odim.w + x] = sum / count;
+            }
+            ret |= checkLayer("local_avgpool ", l, ref);
+            break;
+        }
+        case tk::dnn::LAYER_SAM: {
+            std::vector<float> back = hostData(((tk::dnn::Sam*) l)->backLayer);
+            for(int j=0; j<ref.size(); j++)
+                ref[j] = back[j]*in[j];
+            ret |= checkLayer("sam           ", l, ref);
+            break;
+        }
+        case tk::dnn::LAYER_DENSE: {
+            int inputs = idim.tot();
+            for(int o=0; o<odim.c; o++) {
+                float v = 0;
+                for(int j=0; j<inputs; j++)
+                    v += fc.weights[o*inputs + j]*in[j];
+                v = (v - fc.mean[o]) / sqrt(fc.variance[o] + TKDNN_BN_MIN_EPSILON);
+                ref[o] = v*fc.scales[o] + fc.bias[o];
+            }
+            ret |= checkLayer("connected     ", l, ref);
+            break;
+        }
+        case tk::dnn::LAYER_SCALE_CHANNELS: {
+            std::vector<float> back = hostData(((tk::dnn::ScaleChannels*) l)->backLayer);
+            for(int j=0; j<ref.size(); j++)
+                ref[j] = back[j]*in[j / wh];
+            ret |= checkLayer("scale_channels", l, ref);
+            break;
+        }
+        case tk::dnn::LAYER_SHORTCUT: {
+            tk::dnn::Shortcut *s = (tk::dnn::Shortcut*) l;
+            std::vector<std::vector<float>> srcs = { in };
+            for(auto b: s->backLayers)
+                srcs.push_back(hostData(b));
+            bool per_channel = s->weights_type == tk::dnn::SHORTCUT_WEIGHTS_PER_CHANNEL;
+            const std::vector<float> &w = per_channel ? sc_channel : sc_feature;
+            int step = per_channel ? odim.c : 1;
+            for(int c=0; c<odim.c; c++) {
+                int k = per_channel ? c : 0;
+                float max_val = -INFINITY, sum = 0.0001f;
+                for(int n=0; n<srcs.size(); n++)
+                    max_val = std::max(max_val, w[n*step + k]);
+                for(int n=0; n<srcs.size(); n++)
+                    sum += per_channel ? expf(w[n*step + k] - max_val) : std::max(w[n*step + k], 0.0f);
+                for(int n=0; n<srcs.size(); n++) {
+                    float wn = per_channel ? expf(w[n*step + k] - max_val) / sum : std::max(w[n*step + k], 0.0f) / sum;
+                    for(int j=0; j<wh; j++)
+                        ref[c*wh + j] += wn*srcs[n][c*wh + j];
+                }
+            }
+            ret |= checkLayer(per_channel ? "shortcut ch   " : "shortcut feat ", l, ref);
+            break;
+        }
+        case tk::dnn::LAYER_YOLO: {
+            tk::dnn::Yolo *y = (tk::dnn::Yolo*) l;
+            int entries = 8 + 1 + y->classes;
+            for(int n=0; n<y->n_masks; n++)
+            for(int e=0; e<entries; e++)
+            for(int j=0; j<wh; j++) {
+                int idx = (n*entries + e)*wh + j;
+                float v = in[idx];
+                if(e != 4 && e != 6)
+                    v = 1.0f / (1.0f + expf(-v));
+                if(e == 0 || e == 2)
+                    v = v*y->scaleXY - 0.5f*(y->scaleXY - 1);
+                ref[idx] = v;
+            }
+            ret |= checkLayer("gaussian_yolo ", l, ref);
+            break;
+        }
+        default:
+            continue;
+        }
+    }
+
+    //convert network to tensorRT
+    tk::dnn::NetworkRT *netRT = new tk::dnn::NetworkRT(net, net->getNetworkRTName(bin_path.c_str()));
+    tk::dnn::dataDim_t dim2 = net->input_dim;
+    printCenteredTitle(" TENSORRT inference ", '=', 30); {
+        dim2.print();
+        TKDNN_TSTART
+        netRT->infer(dim2, data);
+        TKDNN_TSTOP
+        dim2.print();
+    }
+
+    int out = 0;
+    for(int i=0; i<net->num_layers; i++) {
+        if(!net->layers[i]->final)
+            continue;
+        std::cout<<"CUDNN vs TRT    ";
+        ret |= checkResult(net->layers[i]->output_dim.tot(), net->layers[i]->dstData,
+                           (dnnType*) netRT->buffersRT[++out]) == 0 ? 0 : ERROR_CUDNNvsTENSORRT;
+    }
+    std::cout<<ret<<std::endl;
+
+    checkCuda( cudaFree(data) );
+    net->releaseLayers();
+    delete net;
+    netRT->destroy();
+    delete netRT;
+    return ret;
+}
@@ -0,0 +1,46 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <sstream>
+#include "CocoEvaluator.h"
+#include "../tracking/tracking_test.h"
+
+/*
+    CocoEvaluator must give the stats of pycocotools COCOeval on a fixture
+    with crowd regions, small, medium and large groundtruths whose area is
+    not the box area, images with more than 10 and fewer than 100
+    detections, and categories detected on images where they have no
+    groundtruth. The fixture and the expected stats are written by
+    coco_fixture.py.
+
+    usage: test_coco_evaluator [instances.json] [results.json]
+*/
+
+// COCOeval.stats of pycocotools 2.0 on the fixture
+static const double expected[12] = {
+    0.28174881773891675, 0.53549426371208542, 0.35400373370670402, 0.21707920792079208,
+    0.14283828382838284, 0.53927392739273927, 0.20138888888888887, 0.49166666666666664,
+    0.49166666666666664, 0.29999999999999999, 0.38333333333333336, 0.59999999999999998 };
+
+int main(int argc, char *argv[]) {
+    std::string instances = "../tests/evaluation/coco/instances.json";
+    std::string results = "../tests/evaluation/coco/results.json";
+    if(argc > 1)
+        instances = argv[1];
+    if(argc > 2)
+        results = argv[2];
+
+    tk::dnn::CocoEvaluator coco;
+    coco.readGroundtruth(instances);
+    coco.readResults(results);
+    coco.evaluate();
+    coco.summarize();
+
+    double max_diff = 0;
+    for(int i=0; i<12; i++)
+        max_diff = std::max(max_diff, std::fabs(coco.stats[i] - expected[i]));
+    std::ostringstream detail;
+    detail<<"max difference "<<max_diff;
+    int errors = testCheck("CocoEvaluator vs pycocotools", coco.stats.size() == 12 && max_diff < 1e-9, detail.str());
+    return errors != 0;
+}
@@ -0,0 +1,69 @@
+"""
+Writes the COCO fixture of test_coco_evaluator (coco/instances.json and
+coco/results.json) and prints the stats pycocotools COCOeval gives on it,
+which the test compares with CocoEvaluator.
+
+usage: python3 coco_fixture.py
+"""
+import json
+import os
+import random
+
+from pycocotools.coco import COCO
+from pycocotools.cocoeval import COCOeval
+
+random.seed(7)
+here = os.path.join(os.path.dirname(os.path.abspath(__file__)), "coco")
+os.makedirs(here, exist_ok=True)
+
+images = [{"id": i, "width": 640, "height": 480} for i in (3, 8, 15, 42, 99)]
+categories = [{"id": c, "name": str(c)} for c in (1, 3, 7)]
+annotations, results = [], []
+
+def jitter(box, amount):
+    x, y, w, h = box
+    return [round(x + random.uniform(-amount, amount) * w, 2),
+            round(y + random.uniform(-amount, amount) * h, 2),
+            round(w * random.uniform(1 - amount, 1 + amount), 2),
+            round(h * random.uniform(1 - amount, 1 + amount), 2)]
+
+for img in images:
+    for _ in range(random.randint(2, 6)):
+        # small (< 32^2), medium and large (> 96^2) areas
+        side = random.choice([random.uniform(10, 30), random.uniform(35, 90), random.uniform(100, 200)])
+        w, h = round(side * random.uniform(0.7, 1.3), 2), round(side * random.uniform(0.7, 1.3), 2)
+        box = [round(random.uniform(0, 640 - w), 2), round(random.uniform(0, 480 - h), 2), w, h]
+        cat = random.choice(categories)["id"]
+        # the segmentation area is smaller than the box
+        annotations.append({"id": len(annotations) + 1, "image_id": img["id"], "category_id": cat,
+                            "bbox": box, "area": round(w * h * random.uniform(0.6, 0.95), 2), "iscrowd": 0})
+        for _ in range(random.choice([0, 1, 1, 2])):
+            results.append({"image_id": img["id"], "category_id": cat, "bbox": jitter(box, 0.15),
+                            "score": round(random.uniform(0.05, 1), 3)})
+    # a crowd region, with detections of the people in it
+    box = [100, 100, 200, 150]
+    annotations.append({"id": len(annotations) + 1, "image_id": img["id"], "category_id": 1,
+                        "bbox": box, "area": 200 * 150, "iscrowd": 1})
+    for _ in range(random.randint(0, 3)):
+        results.append({"image_id": img["id"], "category_id": 1,
+                        "bbox": [100 + random.uniform(0, 150), 100 + random.uniform(0, 100), 40, 50],
+                        "score": round(random.uniform(0.05, 1), 3)})
+    # false positives, up to 15 detections on an image (more than maxDets 10)
+    for _ in range(random.randint(1, 6)):
+        results.append({"image_id": img["id"], "category_id": random.choice(categories)["id"],
+                        "bbox": [round(random.uniform(0, 500), 2), round(random.uniform(0, 380), 2),
+                                 round(random.uniform(10, 140), 2), round(random.uniform(10, 100), 2)],
+                        "score": round(random.uniform(0.05, 1), 3)})
+
+with open(os.path.join(here, "instances.json"), "w") as f:
+    json.dump({"images": images, "categories": categories, "annotations": annotations}, f, indent=1)
+with open(os.path.join(here, "results.json"), "w") as f:
+    json.dump(results, f, indent=1)
+
+gt = COCO(os.path.join(here, "instances.json"))
+dt = gt.loadRes(os.path.join(here, "results.json"))
+ev = COCOeval(gt, dt, "bbox")
+ev.evaluate()
+ev.accumulate()
+ev.summarize()
+print(", ".join("%.17g" % s for s in ev.stats))
@@ -0,0 +1,258 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <sstream>
+#include <cmath>
+#include "evaluation.h"
+#include "../tracking/tracking_test.h"
+
+/*
+    computeMap must give the mAP of the precision-recall table it replaced
+    (one PR row per class and detection, kept here as oldComputeMap), to
+    the last bit, on random frames with ties in confidence, detections
+    under the confidence threshold, a class with detections and no
+    groundtruth and one with neither. computeMapNIoULevels, which matches
+    the frames once for all the IoU levels, must give at each level of
+    mAP@0.5:0.95 the mAP of a computeMap call, and their mean.
+
+    usage: test_map
+*/
+
+/**
+    computeMap before the single pass rewrite, without the verbose prints
+*/
+double oldComputeMap(std::vector<tk::dnn::Frame> &images, const int classes,
+                     const float IoU_thresh, const float conf_thresh, const int map_points) {
+    int detections_count = 0;
+    int groundtruths_count = 0;
+    std::vector<int> truth_classes_count(classes,0);
+    for(auto i:images){
+        for(auto gt:i.gt)
+            truth_classes_count[gt.cl]++;
+        detections_count += i.det.size();
+        groundtruths_count += i.gt.size();
+    }
+
+    std::vector<tk::dnn::BoundingBox> all_dets;
+    int gt_checked = 0;
+    for(auto &img:images){
+        for(size_t i=0; i<img.det.size(); i++){
+            if(img.det[i].prob > conf_thresh){
+                float maxIoU = 0;
+                int truth_index = -1;
+                for(size_t j=0; j<img.gt.size(); j++){
+                    float currentIoU = img.det[i].IoU(img.gt[j]);
+                    if(currentIoU > maxIoU && img.det[i].cl == img.gt[j].cl){
+                        maxIoU = currentIoU;
+                        truth_index = j;
+                    }
+                }
+                if(truth_index > -1 && maxIoU > IoU_thresh){
+                    img.det[i].uniqueTruthIndex = truth_index + gt_checked;
+                    img.det[i].truthFlag = 1;
+                    img.det[i].maxIoU = maxIoU;
+                }
+            }
+            all_dets.push_back(img.det[i]);
+        }
+        gt_checked += img.gt.size();
+    }
+
+    std::sort(all_dets.begin(), all_dets.end(), tk::dnn::boxComparison);
+    std::vector<int> truth_flags(groundtruths_count,0);
+
+    std::vector<std::vector<tk::dnn::PR>> pr(classes, std::vector<tk::dnn::PR>(detections_count));
+    for(int rank = 0; rank< detections_count; ++rank){
+        if (rank > 0) {
+            for (int class_id = 0; class_id < classes; ++class_id) {
+                pr[class_id][rank].tp = pr[class_id][rank - 1].tp;
+                pr[class_id][rank].fp = pr[class_id][rank - 1].fp;
+            }
+        }
+        if (all_dets[rank].truthFlag == 1 && truth_flags[all_dets[rank].uniqueTruthIndex] == 0) {
+            truth_flags[all_dets[rank].uniqueTruthIndex] = 1;
+            pr[all_dets[rank].cl][rank].tp++;
+        }
+        else {
+            pr[all_dets[rank].cl][rank].fp++;
+        }
+        for (int i = 0; i < classes; ++i){
+            const int tp = pr[i][rank].tp;
+            const int fp = pr[i][rank].fp;
+            const int fn = truth_classes_count[i] - tp;
+            pr[i][rank].fn = fn;
+            pr[i][rank].precision = (tp + fp) > 0 ? (double)tp / (double)(tp + fp) : 0;
+            pr[i][rank].recall = (tp + fn) > 0 ? (double)tp / (double)(tp + fn) : 0;
+        }
+    }
+
+    double mean_average_precision = 0;
+    for (int i = 0; i < classes; ++i) {
+        double avg_precision = 0;
+        if (map_points == 0){
+            double last_recall = pr[i][detections_count - 1].recall;
+            double last_precision = pr[i][detections_count - 1].precision;
+            for (int rank = detections_count - 2; rank >= 0; --rank){
+                double delta_recall = last_recall - pr[i][rank].recall;
+                last_recall = pr[i][rank].recall;
+                if (pr[i][rank].precision > last_precision)
+                    last_precision = pr[i][rank].precision;
+                avg_precision += delta_recall * last_precision;
+            }
+        }
+        else {
+            for (int point = 0; point < map_points; ++point) {
+                double cur_recall = point * 1.0 / ( map_points - 1 );
+                double cur_precision = 0;
+                for (int rank = 0; rank < detections_count; ++rank)
+                    if (pr[i][rank].recall >= cur_recall && pr[i][rank].precision > cur_precision)
+                        cur_precision = pr[i][rank].precision;
+                avg_precision += cur_precision;
+            }
+            avg_precision = avg_precision / map_points;
+        }
+        mean_average_precision += avg_precision;
+    }
+    return mean_average_precision / classes;
+}
+
+static const int CLASSES = 6;       // class 4 is never seen, class 5 is only detected
+
+static tk::dnn::BoundingBox makeBox(const int cl, const float x, const float y, const float w, const float h,
+                                    const float prob) {
+    tk::dnn::BoundingBox b;
+    b.cl = cl;
+    b.x = x;
+    b.y = y;
+    b.w = w;
+    b.h = h;
+    b.prob = prob;
+    return b;
+}
+
+/**
+    Frames of normalized center boxes: groundtruths of classes 0-3, each
+    detected (maybe twice) with noise or missed, plus false positives of
+    classes 0-3 and 5. With ties the confidences are multiples of 0.05.
+*/
+static std::vector<tk::dnn::Frame> makeFrames(std::mt19937 &gen, const int n_frames, const bool ties = true) {
+    std::uniform_real_distribution<float> u(0, 1), noise(-0.02f, 0.02f);
+    auto prob = [&]() { return ties ? std::round(u(gen)*20) / 20 : u(gen); };
+    std::vector<tk::dnn::Frame> frames(n_frames);
+    for(auto &f: frames) {
+        f.width = 640;
+        f.height = 480;
+        const int n_gt = gen() % 8;
+        for(int i=0; i<n_gt; i++) {
+            tk::dnn::BoundingBox g = makeBox(gen() % 4, u(gen), u(gen), 0.05f + 0.2f*u(gen), 0.05f + 0.2f*u(gen), 1);
+            f.gt.push_back(g);
+            for(int copies = gen() % 3; copies > 0; copies--)
+                f.det.push_back(makeBox(g.cl, g.x + noise(gen), g.y + noise(gen), g.w + noise(gen), g.h + noise(gen), prob()));
+        }
+        for(int i = gen() % 4; i > 0; i--) {
+            const int cl = gen() % 5;
+            f.det.push_back(makeBox(cl == 4 ? 5 : cl, u(gen), u(gen), 0.05f + 0.2f*u(gen), 0.05f + 0.2f*u(gen), prob()));
+        }
+        std::shuffle(f.det.begin(), f.det.end(), gen);
+    }
+    // the old table needs at least one detection
+    frames[0].det.push_back(makeBox(0, 0.5f, 0.5f, 0.1f, 0.1f, 0.5f));
+    return frames;
+}
+
+static void clearMatches(std::vector<tk::dnn::Frame> &frames) {
+    for(auto &f: frames)
+        for(auto &d: f.det)
+            d.clear();
+}
+
+int checkComputeMap() {
+    std::mt19937 gen(1);
+    int errors = 0, runs = 0;
+    for(int trial=0; trial<50; trial++) {
+        std::vector<tk::dnn::Frame> frames = makeFrames(gen, 1 + gen() % 40);
+        for(float IoU_thresh: {0.3f, 0.5f, 0.75f})
+            for(int map_points: {0, 11, 101}) {
+                clearMatches(frames);
+                const double expected = oldComputeMap(frames, CLASSES, IoU_thresh, 0.3f, map_points);
+                clearMatches(frames);
+                const double map = tk::dnn::computeMap(frames, CLASSES, IoU_thresh, 0.3f, map_points);
+                errors += map != expected;
+                runs++;
+            }
+    }
+    std::ostringstream detail;
+    detail<<runs<<" runs, "<<errors<<" different";
+    return testCheck("computeMap vs PR table", errors == 0, detail.str());
+}
+
+int checkIoULevels() {
+    std::mt19937 gen(2);
+    const int levels = 10;
+    const float step = 0.05f;
+    int errors = 0, runs = 0;
+    for(int trial=0; trial<20; trial++) {
+        std::vector<tk::dnn::Frame> frames = makeFrames(gen, 1 + gen() % 40);
+        for(int map_points: {0, 101}) {
+            // thresholds accumulated in float, as computeMapNIoULevels does
+            double mean = 0;
+            float IoU_thresh = 0.5f;
+            for(int l=0; l<levels; l++) {
+                clearMatches(frames);
+                const double expected = oldComputeMap(frames, CLASSES, IoU_thresh, 0.3f, map_points);
+                clearMatches(frames);
+                const double map = tk::dnn::computeMap(frames, CLASSES, IoU_thresh, 0.3f, map_points);
+                const double level = tk::dnn::computeMapNIoULevels(frames, CLASSES, IoU_thresh, 0.3f,
+                                                                   map_points, step, 1);
+                errors += map != expected || level != expected;
+                mean += map;
+                IoU_thresh += step;
+                runs++;
+            }
+            mean /= levels;
+            const double all = tk::dnn::computeMapNIoULevels(frames, CLASSES, 0.5f, 0.3f, map_points, step, levels);
+            errors += all != mean;
+            runs++;
+        }
+    }
+    std::ostringstream detail;
+    detail<<runs<<" runs, "<<errors<<" different";
+    return testCheck("computeMapNIoULevels vs computeMap per level", errors == 0, detail.str());
+}
+
+int checkAccumulator() {
+    std::mt19937 gen(3);
+    const int levels = 10;
+    int runs = 0;
+    double max_diff = 0;
+    for(int trial=0; trial<20; trial++) {
+        std::vector<tk::dnn::Frame> frames = makeFrames(gen, 1 + gen() % 40, false);
+        for(int map_points: {0, 101}) {
+            tk::dnn::MapAccumulator acc(CLASSES, 0.5f, 0.3f, map_points, 0.05f, levels);
+            for(const auto &f: frames)
+                acc.add(f);
+            float IoU_thresh = 0.5f;
+            for(int l=0; l<levels; l++) {
+                const double level = tk::dnn::computeMapNIoULevels(frames, CLASSES, IoU_thresh, 0.3f,
+                                                                   map_points, 0.05f, 1);
+                max_diff = std::max(max_diff, std::fabs(acc.map(l) - level));
+                IoU_thresh += 0.05f;
+                runs++;
+            }
+            const double all = tk::dnn::computeMapNIoULevels(frames, CLASSES, 0.5f, 0.3f, map_points, 0.05f, levels);
+            max_diff = std::max(max_diff, std::fabs(acc.mapNIoULevels() - all));
+            runs++;
+        }
+    }
+    std::ostringstream detail;
+    detail<<runs<<" runs, max difference "<<max_diff;
+    return testCheck("MapAccumulator vs computeMapNIoULevels", max_diff == 0, detail.str());
+}
+
+int main() {
+    int errors = checkComputeMap();
+    errors += checkIoULevels();
+    errors += checkAccumulator();
+    return errors != 0;
+}
@@ -0,0 +1,276 @@
+#include<iostream>
+#include<vector>
+#include<fstream>
+#include<random>
+#include<math.h>
+#include<algorithm>
+#include "tkdnn.h"
+#include "OnnxParser.h"
+
+/*
+    ONNX importer: writes a small onnx model with random initializers covering
+    the supported operators (conv + batchnorm folding, standalone batchnorm,
+    activations, pooling, add, concat, resize, scalar mul, flatten and gemm),
+    checks the layers holding imported weights against a CPU reference and then
+    cuDNN against tensorRT.
+
+    usage: test_onnx_layers [model.onnx]
+    with a model only cuDNN and tensorRT are compared
+*/
+
+std::mt19937 gen(42);
+
+std::vector<float> rnd(int n, float lo = -0.5f, float hi = 0.5f) {
+    std::uniform_real_distribution<float> dist(lo, hi);
+    std::vector<float> v(n);
+    for(auto &x: v)
+        x = dist(gen);
+    return v;
+}
+
+// protobuf writer, just what is needed to encode an onnx model
+struct pb_t {
+    std::string buf;
+    void varint(uint64_t v) {
+        for(; v >= 0x80; v >>= 7)
+            buf += char(v | 0x80);
+        buf += char(v);
+    }
+    pb_t& integer(int field, int64_t v) { varint(field << 3 | 0); varint(uint64_t(v)); return *this; }
+    pb_t& real(int field, float v)      { varint(field << 3 | 5); buf.append((char*) &v, 4); return *this; }
+    pb_t& bytes(int field, const std::string &s) { varint(field << 3 | 2); varint(s.size()); buf += s; return *this; }
+    pb_t& msg(int field, const pb_t &m) { return bytes(field, m.buf); }
+};
+
+struct wgs_t { std::string name; std::vector<int64_t> dims; std::vector<float> data; };
+
+pb_t tensor(const wgs_t &w) {
+    pb_t t;
+    for(auto d: w.dims)
+        t.integer(1, d);
+    t.integer(2, 1).bytes(8, w.name).bytes(9, std::string((char*) w.data.data(), w.data.size()*sizeof(float)));
+    return t;
+}
+pb_t attrInt(const std::string &name, int64_t v)  { return pb_t().bytes(1, name).integer(3, v).integer(20, 2); }
+pb_t attrFloat(const std::string &name, float v)  { return pb_t().bytes(1, name).real(2, v).integer(20, 1); }
+pb_t attrInts(const std::string &name, std::vector<int64_t> v) {
+    pb_t a;
+    a.bytes(1, name);
+    for(auto i: v)
+        a.integer(8, i);
+    return a.integer(20, 7);
+}
+pb_t node(const std::string &op, std::vector<std::string> in, std::string out, std::vector<pb_t> attrs = {}) {
+    pb_t n;
+    for(auto &i: in)
+        n.bytes(1, i);
+    n.bytes(2, out).bytes(3, out).bytes(4, op);
+    for(auto &a: attrs)
+        n.msg(5, a);
+    return n;
+}
+pb_t valueInfo(const std::string &name, std::vector<int64_t> dims) {
+    pb_t shape;
+    for(auto d: dims)
+        shape.msg(1, pb_t().integer(1, d));
+    return pb_t().bytes(1, name).msg(2, pb_t().msg(1, pb_t().integer(1, 1).msg(2, shape)));
+}
+
+std::vector<float> hostData(tk::dnn::Layer *l) {
+    std::vector<float> v(l->output_dim.tot());
+    checkCuda( cudaDeviceSynchronize() );
+    checkCuda( cudaMemcpy(v.data(), l->dstData, v.size()*sizeof(dnnType), cudaMemcpyDeviceToHost) );
+    return v;
+}
+
+int checkLayer(const std::string &name, tk::dnn::Layer *l, std::vector<float> ref) {
+    std::vector<float> out = hostData(l);
+    std::cout<<name<<" CUDNN vs CPU";
+    return checkResult(ref.size(), out.data(), ref.data(), false) == 0 ? 0 : ERROR_CPUvsCUDNN;
+}
+
+int main(int argc, char *argv[]) {
+    std::string bin_path  = "onnx_layers";
+    std::string onnx_path = bin_path + "/onnx_layers.onnx";
+    bool generated = argc < 2;
+    if(!generated)
+        onnx_path = argv[1];
+    system( (std::string("mkdir -p ") + bin_path).c_str() );
+
+    std::map<std::string, wgs_t> w;
+    auto add = [&w](const std::string &name, std::vector<int64_t> dims, std::vector<float> data) {
+        w[name] = { name, dims, data };
+    };
+    if(generated) {
+        add("w0", {8, 3, 3, 3}, rnd(8*3*3*3)); add("b0", {8}, rnd(8));
+        add("s0", {8}, rnd(8, 0.5, 1.5)); add("o0", {8}, rnd(8)); add("m0", {8}, rnd(8)); add("v0", {8}, rnd(8, 0.5, 1.5));
+        add("w1", {8, 8, 1, 1}, rnd(8*8));
+        add("s2", {8}, rnd(8, 0.5, 1.5)); add("o2", {8}, rnd(8)); add("m2", {8}, rnd(8)); add("v2", {8}, rnd(8, 0.5, 1.5));
+        add("scales", {4}, {1, 1, 2, 2});
+        add("half", {}, {0.5});
+        add("wg", {10, 16}, rnd(10*16)); add("bg", {10}, rnd(10));
+
+        pb_t graph;
+        graph.msg(1, node("Conv", {"x", "w0", "b0"}, "c0", { attrInts("kernel_shape", {3, 3}), attrInts("pads", {1, 1, 1, 1}) }));
+        graph.msg(1, node("BatchNormalization", {"c0", "s0", "o0", "m0", "v0"}, "bn0", { attrFloat("epsilon", 1e-3) }));
+        graph.msg(1, node("LeakyRelu", {"bn0"}, "a0", { attrFloat("alpha", 0.1) }));
+        graph.msg(1, node("MaxPool", {"a0"}, "p0", { attrInts("kernel_shape", {2, 2}), attrInts("strides", {2, 2}) }));
+        graph.msg(1, node("Conv", {"p0", "w1"}, "c1", { attrInts("kernel_shape", {1, 1}) }));
+        graph.msg(1, node("Relu", {"c1"}, "r1"));
+        graph.msg(1, node("Add", {"r1", "p0"}, "sum"));
+        graph.msg(1, node("BatchNormalization", {"sum", "s2", "o2", "m2", "v2"}, "bn2"));
+        graph.msg(1, node("Concat", {"p0", "bn2"}, "cat", { attrInt("axis", 1) }));
+        graph.msg(1, node("Resize", {"cat", "", "scales"}, "up"));
+        graph.msg(1, node("AveragePool", {"up"}, "ap", { attrInts("kernel_shape", {3, 3}), attrInts("strides", {2, 2}),
+                                                        attrInts("pads", {1, 1, 1, 1}) }));
+        graph.msg(1, node("Mul", {"ap", "half"}, "mul"));
+        graph.msg(1, node("GlobalAveragePool", {"mul"}, "gap"));
+        graph.msg(1, node("Flatten", {"gap"}, "flat"));
+        graph.msg(1, node("Gemm", {"flat", "wg", "bg"}, "fc", { attrInt("transB", 1) }));
+        graph.msg(1, node("Sigmoid", {"fc"}, "y"));
+        graph.bytes(2, "onnx_layers");
+        for(auto &t: w)
+            graph.msg(5, tensor(t.second));
+        graph.msg(11, valueInfo("x", {1, 3, 32, 32}));
+        graph.msg(12, valueInfo("y", {1, 10}));
+
+        pb_t model;
+        model.integer(1, 7).msg(8, pb_t().integer(2, 13)).msg(7, graph);
+        std::ofstream f(onnx_path, std::ios::out | std::ios::binary);
+        f.write(model.buf.data(), model.buf.size());
+    }
+
+    // parse onnx network
+    tk::dnn::Network *net = tk::dnn::onnxParser(onnx_path);
+    net->print();
+
+    dnnType *data;
+    std::vector<float> input = rnd(net->input_dim.tot(), 0, 1);
+    checkCuda( cudaMalloc(&data, input.size()*sizeof(dnnType)) );
+    checkCuda( cudaMemcpy(data, input.data(), input.size()*sizeof(dnnType), cudaMemcpyHostToDevice) );
+
+    tk::dnn::dataDim_t dim1 = net->input_dim;
+    printCenteredTitle(" CUDNN inference ", '=', 30); {
+        dim1.print();
+        TKDNN_TSTART
+        net->infer(dim1, data);
+        TKDNN_TSTOP
+        dim1.print();
+    }
+
+    int ret = 0;
+    if(generated) {
+        printCenteredTitle(" CPU REFERENCE CHECK ", '=', 30);
+        // onnx semantics, from the input of each layer
+        for(int i=0; i<net->num_layers; i++) {
+            tk::dnn::Layer *l = net->layers[i];
+            std::vector<float> in = i == 0 ? input : hostData(net->layers[i-1]);
+            tk::dnn::dataDim_t idim = l->input_dim, odim = l->output_dim;
+            int wh = odim.w*odim.h;
+            std::vector<float> ref(odim.tot(), 0);
+
+            switch(l->getLayerType()) {
+            case tk::dnn::LAYER_CONV2D: {
+                tk::dnn::Conv2d *c = (tk::dnn::Conv2d*) l;
+                bool depthwise = c->kernelH == 1 && c->inputs == 1;
+                std::string s = depthwise ? "2" : "0";
+                if(!depthwise && c->kernelH != 3)
+                    continue;
+                for(int o=0; o<odim.c; o++) {
+                    float k = w["s" + s].data[o] / sqrt(w["v" + s].data[o] + (depthwise ? 1e-5 : 1e-3));
+                    for(int y=0; y<odim.h; y++)
+                    for(int x=0; x<odim.w; x++) {
+                        float v = 0;
+                        if(depthwise) {
+                            v = in[o*wh + y*odim.w + x];
+                        } else {
+                            for(int ci=0; ci<idim.c; ci++)
+                            for(int m=0; m<3; m++)
+                            for(int n=0; n<3; n++) {
+                                int iy = y + m - 1, ix = x + n - 1;
+                                if(iy >= 0 && iy < idim.h && ix >= 0 && ix < idim.w)
+                                    v += w["w0"].data[((o*idim.c + ci)*3 + m)*3 + n] * in[(ci*idim.h + iy)*idim.w + ix];
+                            }
+                            v += w["b0"].data[o];
+                        }
+                        ref[o*wh + y*odim.w + x] = (v - w["m" + s].data[o])*k + w["o" + s].data[o];
+                    }
+                }
+                ret |= checkLayer(depthwise ? "batchnorm     " : "conv+batchnorm", l, ref);
+                break;
+            }
+            case tk::dnn::LAYER_SHORTCUT: {
+                std::vector<float> back = hostData(((tk::dnn::Shortcut*) l)->backLayer);
+                for(int j=0; j<ref.size(); j++)
+                    ref[j] = in[j] + back[j];
+                ret |= checkLayer("add           ", l, ref);
+                break;
+            }
+            case tk::dnn::LAYER_POOLING: {
+                tk::dnn::Pooling *p = (tk::dnn::Pooling*) l;
+                if(p->pool_mode != tk::dnn::POOLING_AVERAGE_EXCLUDE_PADDING || p->paddingH == 0)
+                    continue;
+                for(int c=0; c<odim.c; c++)
+                for(int y=0; y<odim.h; y++)
+                for(int x=0; x<odim.w; x++) {
+                    float sum = 0;
+                    int count = 0;
+                    for(int m=0; m<p->winH; m++)
+                    for(int n=0; n<p->winW; n++) {
+                        int iy = y*p->strideH + m - p->paddingH, ix = x*p->strideW + n - p->paddingW;
+                        if(iy < 0 || iy >= idim.h || ix < 0 || ix >= idim.w)
+                            continue;
+                        sum += in[(c*idim.h + iy)*idim.w + ix];
+                        count++;
+                    }
+                    ref[(c*odim.h + y)*odim.w + x] = sum / count;
+                }
+                ret |= checkLayer("averagepool   ", l, ref);
+                break;
+            }
+            case tk::dnn::LAYER_DENSE: {
+                for(int o=0; o<odim.c; o++) {
+                    ref[o] = w["bg"].data[o];
+                    for(int j=0; j<idim.tot(); j++)
+                        ref[o] += w["wg"].data[o*idim.tot() + j]*in[j];
+                }
+                ret |= checkLayer("gemm          ", l, ref);
+                break;
+            }
+            default:
+                continue;
+            }
+        }
+    }
+
+    //convert network to tensorRT
+    tk::dnn::NetworkRT *netRT = new tk::dnn::NetworkRT(net, net->getNetworkRTName(bin_path.c_str()));
+    tk::dnn::dataDim_t dim2 = net->input_dim;
+    printCenteredTitle(" TENSORRT inference ", '=', 30); {
+        dim2.print();
+        TKDNN_TSTART
+        netRT->infer(dim2, data);
+        TKDNN_TSTOP
+        dim2.print();
+    }
+
+    std::vector<tk::dnn::Layer*> outputs;
+    for(int i=0; i<net->num_layers; i++)
+        if(net->layers[i]->final)
+            outputs.push_back(net->layers[i]);
+    if(outputs.empty())
+        outputs.push_back(net->layers[net->num_layers-1]);
+    for(int i=0; i<outputs.size(); i++) {
+        std::cout<<"CUDNN vs TRT    ";
+        ret |= checkResult(outputs[i]->output_dim.tot(), outputs[i]->dstData,
+                           (dnnType*) netRT->buffersRT[i+1]) == 0 ? 0 : ERROR_CUDNNvsTENSORRT;
+    }
+    std::cout<<ret<<std::endl;
+
+    checkCuda( cudaFree(data) );
+    net->releaseLayers();
+    delete net;
+    netRT->destroy();
+    delete netRT;
+    return ret;
+}
@@ -0,0 +1,91 @@
+#include <iostream>
+#include <vector>
+#include <fstream>
+#include "tkdnn.h"
+#include "pagecache.h"
+
+/*
+    Time to first inference of already built engines: deserialize the .rt file
+    (as the detectors do, without the network) and run one inference, with cold
+    and warm page cache. Also prints the resident memory left after each run, that
+    should not grow with the engine size once the engine is destroyed.
+
+    usage: test_first_inference [engine.rt ...]
+    the engines are built by the tests, e.g. ./test_yolo4tiny ./test_yolo4 ./test_yolo4x
+*/
+
+// resident set size of the process in MB
+double residentMB() {
+#ifdef __linux__
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while(std::getline(status, line))
+        if(line.compare(0, 6, "VmRSS:") == 0)
+            return atof(line.c_str() + 6) / 1024;
+#endif
+    return 0;
+}
+
+struct run_t { std::string engine; bool cold; double size_mb, load_ms, infer_ms, rss_mb; };
+
+void firstInference(run_t &r) {
+    if(r.cold)
+        dropFileCache(r.engine);
+
+    auto start = std::chrono::steady_clock::now();
+    tk::dnn::NetworkRT *netRT = new tk::dnn::NetworkRT(NULL, r.engine.c_str());
+    auto loaded = std::chrono::steady_clock::now();
+
+    dnnType *input_d;
+    tk::dnn::dataDim_t dim = netRT->input_dim;
+    checkCuda( cudaMalloc(&input_d, dim.tot()*sizeof(dnnType)) );
+    checkCuda( cudaMemset(input_d, 0, dim.tot()*sizeof(dnnType)) );
+    netRT->infer(dim, input_d);
+    checkCuda( cudaDeviceSynchronize() );
+    auto end = std::chrono::steady_clock::now();
+
+    checkCuda( cudaFree(input_d) );
+    netRT->destroy();
+    delete netRT;
+
+    r.load_ms  = std::chrono::duration<double, std::milli>(loaded - start).count();
+    r.infer_ms = std::chrono::duration<double, std::milli>(end - loaded).count();
+    r.rss_mb   = residentMB();
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<std::string> engines;
+    for(int i=1; i<argc; i++)
+        engines.push_back(argv[i]);
+    if(engines.empty())
+        engines = { "yolo4tiny_fp32.rt", "yolo4_fp32.rt", "yolo4x_fp32.rt" };
+
+    std::vector<run_t> runs;
+    for(auto &e: engines) {
+        std::ifstream file(e, std::ios::binary | std::ios::ate);
+        if(!file) {
+            std::cout<<COL_ORANGEB<<"Missing engine "<<e<<", build it with the corresponding test"<<COL_END<<"\n";
+            continue;
+        }
+        double size_mb = double(file.tellg()) / (1024*1024);
+        runs.push_back({ e, true,  size_mb });
+        runs.push_back({ e, false, size_mb });
+    }
+    if(runs.empty())
+        return 1;
+
+    for(auto &r: runs)
+        firstInference(r);
+
+    printCenteredTitle(" TIME TO FIRST INFERENCE ", '=', 80);
+    std::cout<<std::setw(24)<<"engine"<<std::setw(6)<<"cache"<<std::setw(10)<<"MB"
+             <<std::setw(12)<<"load ms"<<std::setw(12)<<"infer ms"<<std::setw(12)<<"total ms"
+             <<std::setw(10)<<"RSS MB"<<"\n";
+    for(auto &r: runs) {
+        std::cout<<std::fixed<<std::setprecision(1)
+                 <<std::setw(24)<<r.engine<<std::setw(6)<<(r.cold ? "cold" : "warm")<<std::setw(10)<<r.size_mb
+                 <<std::setw(12)<<r.load_ms<<std::setw(12)<<r.infer_ms<<std::setw(12)<<r.load_ms + r.infer_ms
+                 <<std::setw(10)<<r.rss_mb<<"\n";
+    }
+    return 0;
+}
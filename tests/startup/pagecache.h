@@ -0,0 +1,35 @@
+#ifndef PAGECACHE_H
+#define PAGECACHE_H
+
+#include <string>
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// evict a file from the page cache (only clean pages, does not need root)
+inline void dropFileCache(const std::string &fname) {
+#ifdef __linux__
+    int fd = open(fname.c_str(), O_RDONLY);
+    if(fd < 0)
+        return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+#endif
+}
+
+inline void dropFolderCache(const std::string &folder) {
+#ifdef __linux__
+    DIR *dir = opendir(folder.c_str());
+    if(dir == nullptr)
+        return;
+    while(struct dirent *e = readdir(dir))
+        dropFileCache(folder + "/" + e->d_name);
+    closedir(dir);
+#endif
+    dropFileCache(folder + ".tkw");
+}
+
+#endif //PAGECACHE_H
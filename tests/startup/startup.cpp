@@ -0,0 +1,137 @@
+#include <iostream>
+#include <vector>
+#include <string.h>
+#include "tkdnn.h"
+#include "DarknetParser.h"
+#include "WeightsArchive.h"
+#include "NetworkSnapshot.h"
+#include "pagecache.h"
+
+/*
+    Network construction benchmark: builds a darknet model reading weights from
+    the per layer .bin files (synchronously and prefetched in background) and from
+    the packed weights archive, and from a network snapshot (no cfg parsing), with
+    warm and cold page cache (cold drops the weights files from the cache before the run).
+    Then it checks that host weights released with TKDNN_WEIGHTS_RESIDENCY=reload
+    are read back unchanged, printing the resident bytes per layer.
+
+    usage: test_startup [cfg] [layers folder] [names]
+    the archive is created with: python3 scripts/pack_weights.py <layers folder>
+*/
+
+void weightsCrcs(tk::dnn::Network *net, std::vector<uint32_t> &crcs) {
+    crcs.clear();
+    for(int i=0; i<net->num_layers; i++) {
+        tk::dnn::layerType_t t = net->layers[i]->getLayerType();
+        if(t != tk::dnn::LAYER_CONV2D && t != tk::dnn::LAYER_DECONV2D && t != tk::dnn::LAYER_DENSE)
+            continue;
+        tk::dnn::LayerWgs *l = (tk::dnn::LayerWgs*) net->layers[i];
+        crcs.push_back(tk::dnn::WeightsArchive::crc32(l->data_h, l->n_params*sizeof(dnnType)));
+    }
+}
+
+// release the host weights with the reload policy and read them back
+int checkResidency(const std::string &cfg_path, const std::string &wgs_path, const std::string &name_path,
+                   const std::vector<uint32_t> &ref) {
+    setenv("TKDNN_WEIGHTS_RESIDENCY", "reload", 1);
+    tk::dnn::Network *net = tk::dnn::darknetParser(cfg_path, wgs_path, name_path);
+    unsetenv("TKDNN_WEIGHTS_RESIDENCY");
+
+    printCenteredTitle(" HOST WEIGHTS ", '=', 50);
+    net->printHostWeights(true);
+    net->applyWeightsResidency();
+    net->reloadHostWeights();
+    net->printHostWeights();
+
+    std::vector<uint32_t> crcs;
+    weightsCrcs(net, crcs);
+    net->releaseLayers();
+    delete net;
+    if(crcs != ref) {
+        std::cout<<COL_REDB<<"reloaded weights differ from the bin files"<<COL_END<<"\n";
+        return 1;
+    }
+    return 0;
+}
+
+// build the net and return the elapsed ms, crcs gets a checksum of every layer weights
+double buildNetwork(const std::string &cfg_path, const std::string &wgs_path, const std::string &name_path,
+                    const std::string &snapshot, bool archive, bool prefetch, bool cold, std::vector<uint32_t> &crcs) {
+    setenv("TKDNN_WEIGHTS_ARCHIVE", archive ? "1" : "0", 1);
+    setenv("TKDNN_WEIGHTS_PREFETCH", prefetch ? "1" : "0", 1);
+    if(cold) {
+        dropFolderCache(wgs_path);
+        dropFileCache(snapshot);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    tk::dnn::Network *net = snapshot.empty() ? tk::dnn::darknetParser(cfg_path, wgs_path, name_path) :
+                                               tk::dnn::loadNetworkSnapshot(snapshot);
+    if(net == nullptr)
+        FatalError("could not load " + snapshot);
+    checkCuda( cudaDeviceSynchronize() );
+    auto end = std::chrono::steady_clock::now();
+
+    weightsCrcs(net, crcs);
+    net->releaseLayers();
+    delete net;
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char *argv[]) {
+    std::string cfg_path  = "../tests/darknet/cfg/yolo4.cfg";
+    std::string wgs_path  = "yolo4/layers";
+    std::string name_path = "../tests/darknet/names/coco.names";
+    if(argc > 1) cfg_path  = argv[1];
+    if(argc > 2) wgs_path  = argv[2];
+    if(argc > 3) name_path = argv[3];
+
+    bool has_archive = fileExist((wgs_path + ".tkw").c_str());
+    if(!has_archive)
+        std::cout<<COL_ORANGEB<<"No weights archive found, run: python3 scripts/pack_weights.py "
+                 <<wgs_path<<COL_END<<"\n";
+
+    // snapshot of the parsed network, loaded without the cfg
+    std::string snapshot_path = "startup.tkn";
+    {
+        setenv("TKDNN_WEIGHTS_ARCHIVE", "0", 1);
+        tk::dnn::Network *net = tk::dnn::darknetParser(cfg_path, wgs_path, name_path);
+        tk::dnn::saveNetworkSnapshot(net, snapshot_path);
+        net->releaseLayers();
+        delete net;
+    }
+
+    struct run_t { const char *name; bool snapshot, archive, prefetch, cold; double ms; std::vector<uint32_t> crcs; };
+    std::vector<run_t> runs = {
+        { "bin files,  cold", false, false, false, true },
+        { "bin files,  warm", false, false, false, false },
+        { "prefetched, cold", false, false, true,  true },
+        { "prefetched, warm", false, false, true,  false },
+        { "archive,    cold", false, true,  false, true },
+        { "archive,    warm", false, true,  false, false },
+        { "snapshot,   cold", true,  false, true,  true },
+        { "snapshot,   warm", true,  false, true,  false },
+    };
+
+    int ret = 0;
+    for(auto &r: runs) {
+        if(r.archive && !has_archive)
+            continue;
+        r.ms = buildNetwork(cfg_path, wgs_path, name_path, r.snapshot ? snapshot_path : "",
+                            r.archive, r.prefetch, r.cold, r.crcs);
+        if(r.crcs != runs[0].crcs) {
+            std::cout<<COL_REDB<<r.name<<": weights differ from the bin files"<<COL_END<<"\n";
+            ret = 1;
+        }
+    }
+
+    printCenteredTitle(" NETWORK CONSTRUCTION ", '=', 40);
+    for(auto &r: runs) {
+        if(r.archive && !has_archive)
+            continue;
+        std::cout<<r.name<<": "<<std::setw(10)<<r.ms<<" ms\n";
+    }
+
+    ret |= checkResidency(cfg_path, wgs_path, name_path, runs[0].crcs);
+    return ret;
+}
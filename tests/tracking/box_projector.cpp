@@ -0,0 +1,199 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#ifdef OPENCV
+#include <opencv2/core/core.hpp>
+#endif
+#include "BoxProjector.h"
+#include "tracking_test.h"
+
+/*
+    The corners must match compute_box_3d / project_to_image of CenterNet
+    done box by box (R * corners + location, then P * homogeneous points).
+    On frames of 10 to 1000 boxes the projector must give the corners of
+    the per box loop and, with OpenCV, of the cv::Mat products it replaced
+    in CenternetDetection3D and CenterTrack, and take less time than the
+    per box loop (add() and project() against compute and project box by
+    box, timed on the same frames); the time per box of each is printed.
+
+    usage: test_box_projector
+*/
+
+struct box_t {
+    float h, w, l, x, y, z, rot_y;
+};
+
+// KITTI-like projection matrix
+static const float calib[12] = { 707.0493f, 0, 604.0814f, 45.75831f,
+                                 0, 707.0493f, 180.5066f, -0.3454157f,
+                                 0, 0, 1, 0.004981016f };
+
+static void makeBoxes(std::mt19937 &gen, const int n, std::vector<box_t> &boxes) {
+    std::uniform_real_distribution<float> ud(0.5f, 4), ux(-20, 20), uy(0.5f, 2.5f), uz(2, 60), ur(-2*M_PI, 2*M_PI);
+    boxes.resize(n);
+    for(auto &b: boxes)
+        b = { ud(gen), ud(gen), ud(gen), ux(gen), uy(gen), uz(gen), ur(gen) };
+}
+
+static void reference(const box_t &b, float *out) {
+    const float R[3][3] = { { std::cos(b.rot_y), 0, std::sin(b.rot_y) },
+                            { 0, 1, 0 },
+                            { -std::sin(b.rot_y), 0, std::cos(b.rot_y) } };
+    const float corners[3][8] = {
+        { b.l/2, b.l/2, -b.l/2, -b.l/2, b.l/2, b.l/2, -b.l/2, -b.l/2 },
+        { 0, 0, 0, 0, -b.h, -b.h, -b.h, -b.h },
+        { b.w/2, -b.w/2, -b.w/2, b.w/2, b.w/2, -b.w/2, -b.w/2, b.w/2 } };
+    const float loc[3] = { b.x, b.y, b.z };
+    for(int k=0; k<8; k++) {
+        float p[4] = { 0, 0, 0, 1 };
+        for(int r=0; r<3; r++) {
+            for(int c=0; c<3; c++)
+                p[r] += R[r][c] * corners[c][k];
+            p[r] += loc[r];
+        }
+        float img[3] = { 0, 0, 0 };
+        for(int r=0; r<3; r++)
+            for(int c=0; c<4; c++)
+                img[r] += calib[r*4 + c] * p[c];
+        out[2*k] = img[0] / img[2];
+        out[2*k + 1] = img[1] / img[2];
+    }
+}
+
+#ifdef OPENCV
+/**
+    The per box cv::Mat path removed from CenternetDetection3D::postprocess
+    and CenterTrack::draw, with its matrices kept between boxes as the
+    class members were
+*/
+struct matProjector {
+    cv::Mat r, corners, pts3DHomo, calib;
+
+    matProjector() {
+        r = cv::Mat::zeros(3, 3, CV_32F);
+        r.at<float>(1,1) = 1.0;
+        corners = cv::Mat::zeros(3, 8, CV_32F);
+        pts3DHomo = cv::Mat::ones(4, 8, CV_32F);
+        calib = cv::Mat(3, 4, CV_32F, (void *) ::calib).clone();
+    }
+
+    void project(const box_t &b, std::vector<float> &res) {
+        r.at<float>(0,0) = std::cos(b.rot_y);
+        r.at<float>(0,2) = std::sin(b.rot_y);
+        r.at<float>(2,0) = -std::sin(b.rot_y);
+        r.at<float>(2,2) = std::cos(b.rot_y);
+        for(int k=0; k<8; k++) {
+            corners.at<float>(0,k) = (k % 4 < 2 ? b.l : -b.l) / 2;
+            corners.at<float>(1,k) = k < 4 ? 0 : -b.h;
+            corners.at<float>(2,k) = (k % 4 == 0 || k % 4 == 3 ? b.w : -b.w) / 2;
+        }
+        cv::Mat aus = r * corners;
+        for(int k=0; k<8; k++) {
+            aus.at<float>(0,k) += b.x;
+            aus.at<float>(1,k) += b.y;
+            aus.at<float>(2,k) += b.z;
+        }
+        for(int k1=0; k1<3; k1++)
+            for(int k2=0; k2<8; k2++)
+                pts3DHomo.at<float>(k1,k2) = aus.at<float>(k1,k2);
+        aus.release();
+        aus = calib * pts3DHomo;
+        res.clear();
+        for(int k=0; k<8; k++) {
+            res.push_back(aus.at<float>(0,k) / aus.at<float>(2,k));
+            res.push_back(aus.at<float>(1,k) / aus.at<float>(2,k));
+        }
+    }
+};
+#endif
+
+static bool approx(const float a, const float ref) {
+    return std::abs(a - ref) <= 1e-3f * std::max(1.0f, std::abs(ref));
+}
+
+int checkCorners() {
+    std::mt19937 gen(1);
+    tk::dnn::BoxProjector proj;
+    std::vector<box_t> boxes;
+    std::vector<float> corners;
+    float expected[16];
+    int errors = 0;
+    for(int trial=0; trial<100; trial++) {
+        makeBoxes(gen, gen() % 200, boxes);
+        proj.clear();
+        for(auto &b: boxes)
+            proj.add(b.h, b.w, b.l, b.x, b.y, b.z, b.rot_y);
+        proj.project(calib);
+
+        for(size_t i=0; i<boxes.size(); i++) {
+            reference(boxes[i], expected);
+            proj.corners(i, corners);
+            for(int k=0; k<16; k++)
+                errors += !approx(corners[k], expected[k]);
+            for(int k=0; k<8; k++)
+                errors += proj.u(i, k) != corners[2*k] || proj.v(i, k) != corners[2*k + 1];
+        }
+    }
+    return testCheck("projector vs per box", errors == 0);
+}
+
+int crowd(const int n, const int frames) {
+    std::mt19937 gen(n);
+    tk::dnn::BoxProjector proj;
+    std::vector<box_t> boxes;
+    std::vector<float> ref(16*n), res;
+    double ms[3] = {0, 0, 0};
+    int errors = 0;
+    proj.reserve(n);
+    makeBoxes(gen, n, boxes);
+#ifdef OPENCV
+    matProjector mat;
+    std::vector<float> mat_out(16*n);
+#endif
+
+    for(int f=0; f<frames; f++) {
+        auto start = std::chrono::steady_clock::now();
+        for(int i=0; i<n; i++)
+            reference(boxes[i], &ref[16*i]);
+        auto mid = std::chrono::steady_clock::now();
+
+        proj.clear();
+        for(auto &b: boxes)
+            proj.add(b.h, b.w, b.l, b.x, b.y, b.z, b.rot_y);
+        proj.project(calib);
+        auto end = std::chrono::steady_clock::now();
+        ms[0] += std::chrono::duration<double, std::milli>(mid - start).count();
+        ms[1] += std::chrono::duration<double, std::milli>(end - mid).count();
+
+#ifdef OPENCV
+        start = std::chrono::steady_clock::now();
+        for(int i=0; i<n; i++) {
+            mat.project(boxes[i], res);
+            std::copy(res.begin(), res.end(), mat_out.begin() + 16*i);
+        }
+        ms[2] += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        for(int k=0; k<16*n; k++)
+            errors += !approx(mat_out[k], ref[k]);
+#endif
+        for(int i=0; i<n; i++)
+            for(int k=0; k<8; k++)
+                errors += !approx(proj.u(i, k), ref[16*i + 2*k]) || !approx(proj.v(i, k), ref[16*i + 2*k + 1]);
+    }
+
+    std::ostringstream detail;
+    detail<<"per box: "<<ms[0]*1e6/frames/n<<" ns/box\tprojector: "<<ms[1]*1e6/frames/n<<" ns/box";
+#ifdef OPENCV
+    detail<<"\tcv::Mat: "<<ms[2]*1e6/frames/n<<" ns/box";
+#endif
+    return testCheck(std::to_string(n) + " boxes", errors == 0 && ms[1] < ms[0], detail.str());
+}
+
+int main() {
+    int errors = checkCorners();
+    for(int n: {10, 100, 1000})
+        errors += crowd(n, 100000 / n);
+    return errors != 0;
+}
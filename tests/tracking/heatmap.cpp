@@ -0,0 +1,131 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <sstream>
+#include "HeatmapRenderer.h"
+#include "tracking_test.h"
+
+/*
+    Frames of moving objects rendered incrementally must match a full
+    render of a cleared map (gaussians computed directly), and the rows
+    reported as changed must contain every difference with the previous
+    frame. With 1 to 100 objects the incremental render must keep giving
+    the map of clearing and rendering again; the time of both and the
+    changed rows are printed.
+
+    usage: test_heatmap
+*/
+
+struct object_t {
+    float x, y, w, h;
+};
+
+static void renderFull(std::vector<float> &map, const int W, const int H, const std::vector<object_t> &objs) {
+    std::fill(map.begin(), map.end(), 0.0f);
+    for(const auto &o: objs) {
+        if(!(o.x >= 0 && o.y >= 0 && o.x < W && o.y < H))
+            continue;
+        const int r = tk::dnn::HeatmapRenderer::gaussianRadius(std::ceil(o.h), std::ceil(o.w));
+        const int cx = o.x, cy = o.y;
+        const double sigma = (2*r + 1) / 6.0;
+        for(int y=std::max(0, cy - r); y<std::min(H, cy + r + 1); y++)
+            for(int x=std::max(0, cx - r); x<std::min(W, cx + r + 1); x++) {
+                double g = std::exp(-((x - cx)*(x - cx) + (y - cy)*(y - cy)) / (2*sigma*sigma));
+                map[y*W + x] = std::max(map[y*W + x], float(g));
+            }
+    }
+}
+
+static void scene(std::mt19937 &gen, const int n, const int W, const int H, std::vector<object_t> &objs) {
+    std::uniform_real_distribution<float> u(0, 1);
+    objs.resize(n);
+    for(auto &o: objs)
+        o = { u(gen)*W*1.1f - W*0.05f, u(gen)*H*1.1f - H*0.05f, 8 + u(gen)*120, 8 + u(gen)*200 };
+}
+
+static void move(std::mt19937 &gen, std::vector<object_t> &objs) {
+    std::uniform_real_distribution<float> u(-6, 6);
+    for(auto &o: objs) {
+        o.x += u(gen);
+        o.y += u(gen);
+    }
+}
+
+int check() {
+    const int W = 512, H = 512;
+    std::mt19937 gen(1);
+    tk::dnn::HeatmapRenderer r;
+    r.init(W, H);
+    std::vector<float> ref(W*H), prev(W*H, 0);
+    std::vector<object_t> objs;
+    int errors = 0;
+    for(int f=0; f<100; f++) {
+        if(f % 20 == 0)
+            scene(gen, gen() % 40, W, H, objs);
+        move(gen, objs);
+        r.begin();
+        for(const auto &o: objs)
+            r.splat(o.x, o.y, o.w, o.h);
+        renderFull(ref, W, H, objs);
+
+        int y0, y1;
+        bool changed = r.changedRows(y0, y1);
+        for(int i=0; i<W*H; i++) {
+            if(std::fabs(r.data()[i] - ref[i]) > 1e-6f)
+                errors++;
+            if(r.data()[i] != prev[i] && (!changed || i/W < y0 || i/W >= y1))
+                errors++;
+        }
+        memcpy(prev.data(), r.data(), W*H*sizeof(float));
+    }
+    return testCheck("incremental vs full render", errors == 0);
+}
+
+int crowd(const int n) {
+    const int W = 512, H = 512, frames = 100;
+    std::mt19937 gen(n);
+    tk::dnn::HeatmapRenderer r, full;
+    r.init(W, H);
+    full.init(W, H);
+    std::vector<object_t> objs;
+    scene(gen, n, W, H, objs);
+
+    double ms[2] = {0, 0};
+    long rows = 0, errors = 0;
+    for(int f=0; f<frames; f++) {
+        move(gen, objs);
+        auto start = std::chrono::steady_clock::now();
+        r.begin();
+        for(const auto &o: objs)
+            r.splat(o.x, o.y, o.w*0.3f, o.h*0.3f);
+        auto mid = std::chrono::steady_clock::now();
+        // clearing and uploading the whole map every frame
+        full.init(W, H);
+        for(const auto &o: objs)
+            full.splat(o.x, o.y, o.w*0.3f, o.h*0.3f);
+        auto end = std::chrono::steady_clock::now();
+
+        for(int i=0; i<W*H; i++)
+            errors += r.data()[i] != full.data()[i];
+        int y0, y1;
+        if(r.changedRows(y0, y1))
+            rows += y1 - y0;
+        ms[0] += std::chrono::duration<double, std::milli>(mid - start).count();
+        ms[1] += std::chrono::duration<double, std::milli>(end - mid).count();
+    }
+    std::ostringstream detail;
+    detail<<"incremental "<<ms[0]/frames<<" ms\tclear + render "<<ms[1]/frames
+          <<" ms\tchanged rows "<<rows/frames<<"/"<<H;
+    return testCheck("incremental vs clear + render, " + std::to_string(n) + " objects", errors == 0, detail.str());
+}
+
+int main() {
+    int errors = check();
+    for(int n: {1, 5, 20, 100})
+        errors += crowd(n);
+    return errors != 0;
+}
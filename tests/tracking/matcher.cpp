@@ -0,0 +1,168 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include "Matcher.h"
+#include "tracking_test.h"
+
+/*
+    The optimal assignment must reach the minimum cost of a brute force
+    search on small random cost matrices. On synthetic crowds of 10 to 1000
+    objects (tracks at the previous positions, shuffled detections moved
+    and perturbed, a few missed and new objects, pairs gated as in
+    CenterTrack) it must never cost more than greedy; the time and the
+    share of correct matches of both are printed.
+
+    usage: test_matcher
+*/
+
+struct bruteForce_t {
+    int T, D;
+    float L;
+    std::vector<float> C;   // T*D, <0 if not gated
+    double best;
+
+    void search(int t, std::vector<char> &used, double acc) {
+        if(acc >= best)
+            return;
+        if(t == T) {
+            best = acc;
+            return;
+        }
+        search(t + 1, used, acc + L);
+        for(int d=0; d<D; d++) {
+            float c = C[t*D + d];
+            if(!used[d] && c >= 0 && c < L) {
+                used[d] = 1;
+                search(t + 1, used, acc + c);
+                used[d] = 0;
+            }
+        }
+    }
+};
+
+int checkOptimal() {
+    std::mt19937 gen(1);
+    tk::dnn::Matcher m;
+    std::vector<int> det_track, track_det;
+    int errors = 0;
+    for(int trial=0; trial<2000; trial++) {
+        bruteForce_t bf;
+        bf.T = gen() % 7;
+        bf.D = gen() % 7;
+        bf.L = 1 + gen() % 100;
+        bf.C.assign(bf.T*bf.D, -1);
+        m.clear(bf.T, bf.D);
+        for(int t=0; t<bf.T; t++)
+            for(int d=0; d<bf.D; d++)
+                if(gen() % 3) {
+                    bf.C[t*bf.D + d] = (gen() % 4 == 0) ? float(gen() % 5) : float(gen() % 12000) / 100.0f;
+                    m.addPair(t, d, bf.C[t*bf.D + d]);
+                }
+        m.solve(tk::dnn::MATCH_OPTIMAL, bf.L, det_track, track_det);
+
+        double total = 0;
+        for(int t=0; t<bf.T; t++) {
+            int d = track_det[t];
+            if(d == -1)
+                total += bf.L;
+            else if(det_track[d] != t || bf.C[t*bf.D + d] < 0)
+                errors++;
+            else
+                total += bf.C[t*bf.D + d];
+        }
+        std::vector<char> used(bf.D, 0);
+        bf.best = 1e30;
+        bf.search(0, used, 0);
+        if(std::fabs(total - bf.best) > 1e-3)
+            errors++;
+    }
+    return testCheck("optimal vs brute force", errors == 0);
+}
+
+struct object_t {
+    float x, y, size;
+};
+
+int crowd(const int n_objects, const int frames) {
+    std::mt19937 gen(n_objects);
+    std::uniform_real_distribution<float> ux(0, 1920), uy(0, 1080), usz(20, 80), noise(-4, 4);
+
+    // a crowd of objects, with the same density of a 1000 object scene
+    float scale = std::sqrt(n_objects / 1000.0f);
+    std::vector<object_t> tracks(n_objects);
+    tk::dnn::Matcher m;
+    std::vector<int> det_track, track_det;
+    const float cost_limit = 1 << 16;
+    double ms[2] = {0, 0}, correct[2] = {0, 0}, cost[2] = {0, 0};
+    int n_dets_tot = 0;
+
+    for(int f=0; f<frames; f++) {
+        for(auto &t: tracks)
+            t = { ux(gen)*scale, uy(gen)*scale, usz(gen) };
+
+        // detections: moved objects in random order, 5% missed, 5% new
+        std::vector<object_t> dets;
+        std::vector<int> truth;
+        for(int i=0; i<n_objects; i++) {
+            if(gen() % 20 == 0)
+                continue;
+            float s = tracks[i].size;
+            dets.push_back({ tracks[i].x + s*0.2f + noise(gen), tracks[i].y + noise(gen), s + noise(gen) });
+            truth.push_back(i);
+        }
+        for(int i=0; i<n_objects/20; i++) {
+            dets.push_back({ ux(gen)*scale, uy(gen)*scale, usz(gen) });
+            truth.push_back(-1);
+        }
+        std::vector<int> perm(dets.size());
+        for(size_t i=0; i<perm.size(); i++)
+            perm[i] = i;
+        std::shuffle(perm.begin(), perm.end(), gen);
+        n_dets_tot += dets.size();
+
+        m.clear(tracks.size(), dets.size());
+        for(size_t d=0; d<dets.size(); d++) {
+            const object_t &det = dets[perm[d]];
+            for(size_t t=0; t<tracks.size(); t++) {
+                float dist = std::pow(tracks[t].x - det.x, 2) + std::pow(tracks[t].y - det.y, 2);
+                if(dist <= tracks[t].size*tracks[t].size && dist <= det.size*det.size)
+                    m.addPair(t, d, dist);
+            }
+        }
+
+        for(int mode=0; mode<2; mode++) {
+            auto start = std::chrono::steady_clock::now();
+            m.solve(mode == 0 ? tk::dnn::MATCH_GREEDY : tk::dnn::MATCH_OPTIMAL, cost_limit, det_track, track_det);
+            ms[mode] += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            for(size_t d=0; d<dets.size(); d++) {
+                int t = det_track[d];
+                correct[mode] += t == truth[perm[d]];
+                if(t != -1) {
+                    const object_t &det = dets[perm[d]];
+                    cost[mode] += std::pow(tracks[t].x - det.x, 2) + std::pow(tracks[t].y - det.y, 2);
+                }
+            }
+            for(int d: track_det)
+                cost[mode] += d == -1 ? cost_limit : 0;
+        }
+    }
+
+    std::ostringstream detail;
+    detail<<"pairs/frame "<<m.pairs()
+          <<"\tgreedy: "<<ms[0]/frames<<" ms, correct "<<100.0*correct[0]/n_dets_tot<<"%"
+          <<"\toptimal: "<<ms[1]/frames<<" ms, correct "<<100.0*correct[1]/n_dets_tot<<"%";
+    // tolerance for the rounding of the summed costs
+    return testCheck("optimal <= greedy cost, " + std::to_string(n_objects) + " objects",
+                     cost[1] <= cost[0] * (1 + 1e-6), detail.str());
+}
+
+int main() {
+    int errors = checkOptimal();
+    for(int n: {10, 30, 100, 300, 1000})
+        errors += crowd(n, 20);
+    return errors != 0;
+}
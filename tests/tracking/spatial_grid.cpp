@@ -0,0 +1,112 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include "SpatialGrid.h"
+#include "tracking_test.h"
+
+/*
+    The candidate pairs of the grid must be the ones of the all-pairs
+    search, for any cell size. On crowds of growing density in a full HD
+    frame (more people means smaller boxes; the gating radius is the box
+    size, the cell size the mean box size) the pair counts must agree too,
+    and the time per object of the two searches is printed.
+
+    usage: test_spatial_grid
+*/
+
+struct object_t {
+    float x, y, r;
+};
+
+static void makeScene(std::mt19937 &gen, const int n, std::vector<object_t> &objs) {
+    // a person every ~4 box areas
+    const float size = std::sqrt(1920.0f*1080.0f / n) * 0.5f;
+    std::uniform_real_distribution<float> ux(0, 1920), uy(0, 1080), ur(size*0.5f, size*1.5f);
+    objs.resize(n);
+    for(auto &o: objs)
+        o = { ux(gen), uy(gen), ur(gen) };
+}
+
+static double meanRadius(const std::vector<object_t> &objs) {
+    double r = 0;
+    for(auto &o: objs)
+        r += o.r;
+    return objs.empty() ? 1 : r / objs.size();
+}
+
+int checkPairs() {
+    std::mt19937 gen(1);
+    tk::dnn::SpatialGrid grid;
+    std::vector<object_t> tracks, dets;
+    std::vector<int> found;
+    int errors = 0;
+    for(int trial=0; trial<200; trial++) {
+        int n = 1 + gen() % 500;
+        makeScene(gen, n, tracks);
+        makeScene(gen, n + gen() % 20, dets);
+
+        // any cell size must give the same pairs
+        float cell = meanRadius(dets) * (0.1f + (gen() % 40) / 10.0f);
+        grid.clear(cell);
+        for(auto &d: dets)
+            grid.add(d.x, d.y);
+        grid.build();
+
+        for(auto &t: tracks) {
+            grid.candidates(t.x, t.y, t.r, found);
+            std::sort(found.begin(), found.end());
+            std::vector<int> expected;
+            for(size_t i=0; i<dets.size(); i++)
+                if(std::pow(dets[i].x - t.x, 2) + std::pow(dets[i].y - t.y, 2) <= t.r*t.r)
+                    expected.push_back(i);
+            errors += found != expected;
+        }
+    }
+    return testCheck("grid vs all pairs", errors == 0);
+}
+
+int crowd(const int n, const int frames) {
+    std::mt19937 gen(n);
+    tk::dnn::SpatialGrid grid;
+    std::vector<object_t> tracks, dets;
+    double ms[2] = {0, 0};
+    long pairs[2] = {0, 0};
+
+    for(int f=0; f<frames; f++) {
+        makeScene(gen, n, tracks);
+        makeScene(gen, n, dets);
+
+        auto start = std::chrono::steady_clock::now();
+        for(auto &t: tracks)
+            for(auto &d: dets)
+                pairs[0] += (d.x - t.x)*(d.x - t.x) + (d.y - t.y)*(d.y - t.y) <= t.r*t.r;
+        auto mid = std::chrono::steady_clock::now();
+
+        grid.clear(meanRadius(dets));
+        for(auto &d: dets)
+            grid.add(d.x, d.y);
+        grid.build();
+        for(auto &t: tracks)
+            grid.query(t.x, t.y, t.r, [&](const int, const float) { pairs[1]++; });
+        auto end = std::chrono::steady_clock::now();
+
+        ms[0] += std::chrono::duration<double, std::milli>(mid - start).count();
+        ms[1] += std::chrono::duration<double, std::milli>(end - mid).count();
+    }
+    std::ostringstream detail;
+    detail<<"pairs/frame "<<pairs[1]/frames
+          <<"\tall pairs: "<<ms[0]/frames<<" ms, "<<ms[0]*1e6/frames/n<<" ns/object"
+          <<"\tgrid: "<<ms[1]/frames<<" ms, "<<ms[1]*1e6/frames/n<<" ns/object";
+    return testCheck("grid pairs, " + std::to_string(n) + " objects", pairs[0] == pairs[1], detail.str());
+}
+
+int main() {
+    int errors = checkPairs();
+    for(int n: {10, 100, 1000, 3000, 10000})
+        errors += crowd(n, 10);
+    return errors != 0;
+}
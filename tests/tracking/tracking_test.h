@@ -0,0 +1,34 @@
+#ifndef TRACKING_TEST_H
+#define TRACKING_TEST_H
+
+#include <iostream>
+#include <string>
+
+/*
+    Reporting of the tracking tests, which build without CUDA: the colors
+    of utils.h and one pass/fail line per check.
+*/
+
+#ifndef COL_END
+#define COL_END "\033[0m"
+#endif
+#ifndef COL_REDB
+#define COL_REDB "\033[1;31m"
+#endif
+#ifndef COL_GREENB
+#define COL_GREENB "\033[1;32m"
+#endif
+
+/**
+    Print "what: OK" or "what: FAILED", followed by detail, and return 1 on
+    failure so that main can sum the failed checks
+*/
+inline int testCheck(const std::string &what, const bool ok, const std::string &detail = "") {
+    std::cout<<what<<": "<<(ok ? COL_GREENB "OK" : COL_REDB "FAILED")<<COL_END;
+    if(!detail.empty())
+        std::cout<<"\t"<<detail;
+    std::cout<<"\n";
+    return !ok;
+}
+
+#endif //TRACKING_TEST_H